@@ -9,6 +9,7 @@ struct S_PASS {
     vec4 vLightPos;
     vec4 vLightColor;
     vec4 vParams;
+    vec4 vClusterParams;    // slice scale, slice bias, tiles per pixel x/y
 };
 
 #endif
\ No newline at end of file
@@ -24,14 +24,28 @@ layout(location = 0) in INTERFACE {
     S_INTERFACE In;
 };
 
-layout(set = 0, binding = 0) uniform stc_ubo_PassData {
+layout(set = 0, binding = 0) uniform dyn_ubo_PassData {
     S_PASS passdata;
 };
 
-layout(set = 0, binding = 3) uniform stc_ubo_LightData {
-    S_LIGHT lightdata[16];
+layout(std430, set = 0, binding = 3) readonly buffer stc_ssbo_LightData {
+    S_LIGHT lightdata[];
 };
 
+// (offset, count) into lightIndices
+layout(std430, set = 0, binding = 4) readonly buffer dyn_ssbo_LightClusters {
+    uvec2 lightClusters[];
+};
+
+layout(std430, set = 0, binding = 5) readonly buffer dyn_ssbo_LightIndices {
+    uint lightIndices[];
+};
+
+// must match jsr::LightClusters
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+
 layout(set = 0, binding = 2) uniform sampler2D samp0;
 layout(set = 1, binding = 0) uniform sampler2D samp_material[4];
 
@@ -186,8 +200,17 @@ void main() {
 */
     const vec3 Fd = diffuseColor * Fd_Lambert();
     vec3 finalColor = vec3(0.0);
-    for(uint i = 0; i < lightdata.length(); ++i)
+    const float viewDepth = -In.FragCoordVS.z;
+    const float sliceDepth = log(viewDepth) * passdata.vClusterParams.x + passdata.vClusterParams.y;
+    const uint slice = uint(clamp(sliceDepth, 0.0, float(CLUSTER_GRID_Z - 1)));
+    const uvec2 tile = min(uvec2(gl_FragCoord.xy * passdata.vClusterParams.zw), uvec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+    const uvec2 cluster = lightClusters[(slice * CLUSTER_GRID_Y + tile.y) * CLUSTER_GRID_X + tile.x];
+    // the grid ends where the farthest light does
+    const uint clusterLightCount = sliceDepth < float(CLUSTER_GRID_Z) ? cluster.y : 0u;
+
+    for(uint n = 0; n < clusterLightCount; ++n)
     {
+        const uint i = lightIndices[cluster.x + n];
         vec4 lightPosVS = passdata.mtxView * vec4(lightdata[i].position,1.0);
         vec3 lightVec = lightPosVS.xyz - In.FragCoordVS;
         vec3 L = normalize(lightVec);
@@ -10,7 +10,7 @@ layout(location = 3) in vec4 inTangent;
 
 #include "passData.glsl"
 
-layout(set = 0, binding = 0) uniform stc_ubo_PassData {
+layout(set = 0, binding = 0) uniform dyn_ubo_PassData {
     S_PASS passdata;
 };
 
@@ -20,8 +20,9 @@ struct S_DRAW_DATA {
     vec4 color;
 };
 
-layout(set = 0, binding = 1) uniform dyn_ubo_DrawData {
-    S_DRAW_DATA drawdata;
+// indexed by gl_InstanceIndex, firstInstance of the draw points to its first instance
+layout(std430, set = 0, binding = 1) readonly buffer dyn_ssbo_DrawData {
+    S_DRAW_DATA drawdata[];
 };
 
 struct S_INTERFACE {
@@ -38,13 +39,13 @@ layout(location = 0) out INTERFACE {
 
 void main() {
     vec3 light = passdata.vLightPos.xyz;
-    vec4 posVS = ( passdata.mtxView * drawdata.mtxModel ) * vec4( inPosition, 1.0 );
+    vec4 posVS = ( passdata.mtxView * drawdata[gl_InstanceIndex].mtxModel ) * vec4( inPosition, 1.0 );
     
     //output the position of each vertex
     gl_Position = passdata.mtxProjection * posVS;
     gl_Position.y = -gl_Position.y;
 
-	mat3 mtxNormal = mat3( passdata.mtxView * drawdata.mtxNormal );
+	mat3 mtxNormal = mat3( passdata.mtxView * drawdata[gl_InstanceIndex].mtxNormal );
 	
 	vec4 localTangent = inTangent * 2.0 - 1.0;
 	vec3 localNormal = inNormal * 2.0 - 1.0;
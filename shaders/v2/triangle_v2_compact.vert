@@ -0,0 +1,71 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_ARB_shader_draw_parameters : require
+
+// jsr::VertexCompact, mtxModel of the draw data includes the dequantization of the position
+layout(location = 0) in vec4 inPosition;   // w: tangent w, 0 is -1
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in vec2 inNormal;     // octahedral
+layout(location = 3) in vec2 inTangent;    // octahedral
+
+#include "passData.glsl"
+
+layout(set = 0, binding = 0) uniform dyn_ubo_PassData {
+    S_PASS passdata;
+};
+
+struct S_DRAW_DATA {
+    mat4 mtxModel;
+    mat4 mtxNormal;
+    vec4 color;
+};
+
+// indexed by gl_InstanceIndex, firstInstance of the draw points to its first instance
+layout(std430, set = 0, binding = 1) readonly buffer dyn_ssbo_DrawData {
+    S_DRAW_DATA drawdata[];
+};
+
+struct S_INTERFACE {
+    vec3 FragCoordVS;
+    vec2 UV;
+    vec3 NormalVS;
+    vec3 TangentVS;
+    vec3 BitangentVS;
+};
+
+layout(location = 0) out INTERFACE {
+    S_INTERFACE Out;
+};
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main() {
+    vec3 light = passdata.vLightPos.xyz;
+    vec4 posVS = ( passdata.mtxView * drawdata[gl_InstanceIndex].mtxModel ) * vec4( inPosition.xyz, 1.0 );
+    
+    //output the position of each vertex
+    gl_Position = passdata.mtxProjection * posVS;
+    gl_Position.y = -gl_Position.y;
+
+	mat3 mtxNormal = mat3( passdata.mtxView * drawdata[gl_InstanceIndex].mtxNormal );
+	
+	vec4 localTangent = vec4( octDecode( inTangent ), inPosition.w * 2.0 - 1.0 );
+	vec3 localNormal = octDecode( inNormal );
+
+	vec3 T = normalize( mtxNormal * localTangent.xyz );
+	vec3 N = normalize( mtxNormal * localNormal );
+	T = normalize(T - dot( T, N ) * N);
+	vec3 B = normalize( cross( N, T ) * localTangent.w );
+
+    Out.NormalVS = N;
+    Out.TangentVS = T;
+    Out.BitangentVS = B;
+    Out.FragCoordVS = posVS.xyz;
+    Out.UV = inUV;
+}
@@ -184,7 +184,7 @@ namespace jsr {
 			vec4(b[1][0], b[1][1], b[0][2], 1.0f),
 			vec4(b[1][0], b[1][1], b[1][2], 1.0f) };
 	}	
-	bool Bounds::RayIntersect(const glm::vec3& start, const glm::vec3& invDir, float& tnear, float& tfar)
+	bool Bounds::RayIntersect(const glm::vec3& start, const glm::vec3& invDir, float& tnear, float& tfar) const
 	{
 
 		// fast slab method
@@ -61,7 +61,7 @@ namespace jsr {
 		compute the near and far intersections of the cube(stored in the x and y components) using the slab method
 		no intersection means vec.x > vec.y (really tNear > tFar)
 		*/
-		bool RayIntersect(const glm::vec3& start, const glm::vec3& invdir, float& tmin, float& tmax);
+		bool RayIntersect(const glm::vec3& start, const glm::vec3& invdir, float& tmin, float& tmax) const;
 		bool Intersects(const Sphere& s);
 		bool operator==(const Bounds& other) const;
 		bool operator!=(const Bounds& other) const;
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <cstring>
+#include "draw_list.h"
+#include "jobsys.h"
+
+namespace jsr {
+
+	static const size_t RADIX_MIN_CHUNK = 4096;
+	static const size_t RADIX_MAX_CHUNKS = 32;
+	static const uint32_t RADIX_BUCKETS = 256;
+
+	uint64_t DrawKey::make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t lod, float depth, bool backToFront)
+	{
+		// saturated, a wider value would spill into the field above it
+		pass = std::min(pass, 15u);
+		pipeline = std::min(pipeline, (1u << PIPELINE_BITS) - 1);
+		material = std::min(material, (1u << MATERIAL_BITS) - 1);
+		mesh = std::min(mesh, (1u << MESH_BITS) - 1);
+		lod = std::min(lod, (1u << LOD_BITS) - 1);
+
+		const uint32_t depthMax = (1u << DEPTH_BITS) - 1;
+		const float d = std::min(std::max(depth, 0.0f), 1.0f);
+		uint64_t qdepth = uint64_t(d * float(depthMax));
+
+		const uint64_t state =
+			(uint64_t(pipeline) << (MATERIAL_BITS + MESH_BITS + LOD_BITS)) |
+			(uint64_t(material) << (MESH_BITS + LOD_BITS)) |
+			(uint64_t(mesh) << LOD_BITS) |
+			uint64_t(lod);
+
+		if (backToFront) {
+			qdepth = depthMax - qdepth;
+			return (uint64_t(pass) << 60) | (qdepth << STATE_BITS) | state;
+		}
+
+		return (uint64_t(pass) << 60) | (state << DEPTH_BITS) | qdepth;
+	}
+
+	uint32_t DrawKey::getPipeline(uint64_t key)
+	{
+		return uint32_t(getStateField(key) >> (MATERIAL_BITS + MESH_BITS + LOD_BITS)) & ((1u << PIPELINE_BITS) - 1);
+	}
+
+	uint32_t DrawKey::getMaterial(uint64_t key)
+	{
+		return uint32_t(getStateField(key) >> (MESH_BITS + LOD_BITS)) & ((1u << MATERIAL_BITS) - 1);
+	}
+
+	uint32_t DrawKey::getMesh(uint64_t key)
+	{
+		return uint32_t(getStateField(key) >> LOD_BITS) & ((1u << MESH_BITS) - 1);
+	}
+
+	uint32_t DrawKey::getLod(uint64_t key)
+	{
+		return uint32_t(getStateField(key)) & ((1u << LOD_BITS) - 1);
+	}
+
+	uint64_t DrawKey::getState(uint64_t key)
+	{
+		const uint64_t depthMask = (1ull << DEPTH_BITS) - 1;
+		const uint32_t shift = isBackToFront(key) ? STATE_BITS : 0;
+		return key & ~(depthMask << shift);
+	}
+
+	uint64_t DrawKey::getStateField(uint64_t key)
+	{
+		const uint64_t stateMask = (1ull << STATE_BITS) - 1;
+		return isBackToFront(key) ? (key & stateMask) : ((key >> DEPTH_BITS) & stateMask);
+	}
+
+	void radixSort(DrawItem* items, DrawItem* temp, size_t count)
+	{
+		if (count < 2) {
+			return;
+		}
+
+		const size_t chunkCount = std::min(RADIX_MAX_CHUNKS, std::max(size_t(1), count / RADIX_MIN_CHUNK));
+		const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+		// run fn for every chunk, in parallel if there is more than one
+		auto forEachChunk = [&](auto fn)
+		{
+			if (chunkCount == 1) {
+				fn(size_t(0), size_t(0), count);
+				return;
+			}
+			jsrlib::counting_semaphore counter;
+			for (size_t c = 0; c < chunkCount; ++c)
+			{
+				const size_t first = c * chunkSize;
+				const size_t last = std::min(count, first + chunkSize);
+				jobsys.submitJob([&fn, c, first, last](int) { fn(c, first, last); }, &counter);
+			}
+			counter.wait();
+		};
+
+		// bits that differ between keys, constant digits need no pass
+		std::vector<uint64_t> andBits(chunkCount, ~0ull), orBits(chunkCount, 0ull);
+		forEachChunk([&](size_t c, size_t first, size_t last)
+			{
+				uint64_t a = ~0ull, o = 0ull;
+				for (size_t i = first; i < last; ++i) {
+					a &= items[i].key;
+					o |= items[i].key;
+				}
+				andBits[c] = a;
+				orBits[c] = o;
+			});
+		uint64_t diff = 0;
+		{
+			uint64_t a = ~0ull, o = 0ull;
+			for (size_t c = 0; c < chunkCount; ++c) {
+				a &= andBits[c];
+				o |= orBits[c];
+			}
+			diff = a ^ o;
+		}
+
+		std::vector<uint32_t> histogram(chunkCount * RADIX_BUCKETS);
+		DrawItem* src = items;
+		DrawItem* dst = temp;
+
+		for (uint32_t shift = 0; shift < 64; shift += 8)
+		{
+			if (((diff >> shift) & 0xFF) == 0) {
+				continue;
+			}
+
+			forEachChunk([&](size_t c, size_t first, size_t last)
+				{
+					uint32_t* h = &histogram[c * RADIX_BUCKETS];
+					memset(h, 0, RADIX_BUCKETS * sizeof(uint32_t));
+					for (size_t i = first; i < last; ++i) {
+						h[(src[i].key >> shift) & 0xFF]++;
+					}
+				});
+
+			// exclusive prefix sum in digit-major, chunk-minor order keeps the sort stable
+			uint32_t offset = 0;
+			for (uint32_t b = 0; b < RADIX_BUCKETS; ++b)
+			{
+				for (size_t c = 0; c < chunkCount; ++c)
+				{
+					const uint32_t n = histogram[c * RADIX_BUCKETS + b];
+					histogram[c * RADIX_BUCKETS + b] = offset;
+					offset += n;
+				}
+			}
+
+			forEachChunk([&](size_t c, size_t first, size_t last)
+				{
+					uint32_t* h = &histogram[c * RADIX_BUCKETS];
+					for (size_t i = first; i < last; ++i) {
+						dst[h[(src[i].key >> shift) & 0xFF]++] = src[i];
+					}
+				});
+
+			std::swap(src, dst);
+		}
+
+		if (src != items) {
+			memcpy(items, src, count * sizeof(DrawItem));
+		}
+	}
+
+	void DrawList::sort()
+	{
+		m_temp.resize(m_items.size());
+		radixSort(m_items.data(), m_temp.data(), m_items.size());
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "pch.h"
+
+namespace jsr {
+
+	enum DrawPass {
+		DrawPass_Opaque = 0,
+		DrawPass_AlphaTest = 1,
+		DrawPass_Blend = 2
+	};
+
+	struct DrawItem {
+		uint64_t key;
+		uint32_t index;		// user data, usually the object index
+	};
+
+	/*
+	64 bit draw sort key.
+	Front to back (opaque):	pass:4 | pipeline:8 | material:12 | mesh:16 | lod:4 | depth:20
+	Back to front (blend):	pass:4 | ~depth:20  | pipeline:8  | material:12 | mesh:16 | lod:4
+	Ordering by the key minimizes state changes inside a pass, depth only breaks ties
+	for opaque draws while it is the primary order for blended ones.
+	*/
+	class DrawKey {
+	public:
+		static const uint32_t PIPELINE_BITS = 8;
+		static const uint32_t MATERIAL_BITS = 12;
+		static const uint32_t MESH_BITS = 16;
+		static const uint32_t LOD_BITS = 4;
+		static const uint32_t DEPTH_BITS = 20;
+		static const uint32_t STATE_BITS = PIPELINE_BITS + MATERIAL_BITS + MESH_BITS + LOD_BITS;
+
+		// depth is normalized to [0,1]. Fields past their bits are saturated to the largest value,
+		// such keys still sort by the other fields but equal states no longer mean the same mesh or material
+		static uint64_t make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t lod, float depth, bool backToFront);
+
+		static uint32_t getPass(uint64_t key) { return uint32_t(key >> 60); }
+		static bool isBackToFront(uint64_t key) { return getPass(key) >= DrawPass_Blend; }
+		static uint32_t getPipeline(uint64_t key);
+		static uint32_t getMaterial(uint64_t key);
+		static uint32_t getMesh(uint64_t key);
+		static uint32_t getLod(uint64_t key);
+		// the key without depth, equal states can be drawn instanced
+		static uint64_t getState(uint64_t key);
+	private:
+		static uint64_t getStateField(uint64_t key);
+	};
+
+	/*
+	Parallel LSD radix sort, 8 bit digits. Stable, the result is in items.
+	Digits that are the same for every key are skipped.
+	*/
+	void radixSort(DrawItem* items, DrawItem* temp, size_t count);
+
+	class DrawList {
+	public:
+		void clear() { m_items.clear(); }
+		void reserve(size_t n) { m_items.reserve(n); }
+		void add(uint64_t key, uint32_t index) { m_items.push_back({ key, index }); }
+		void sort();
+
+		size_t size() const { return m_items.size(); }
+		bool empty() const { return m_items.empty(); }
+		const DrawItem& operator[](size_t i) const { return m_items[i]; }
+		std::vector<DrawItem>::const_iterator begin() const { return m_items.begin(); }
+		std::vector<DrawItem>::const_iterator end() const { return m_items.end(); }
+	private:
+		std::vector<DrawItem> m_items;
+		std::vector<DrawItem> m_temp;
+	};
+}
@@ -94,6 +94,21 @@ namespace jsr {
 		return true;
 	}
 
+	bool Frustum::Intersects(const Sphere& sphere) const
+	{
+		const vec4 center = vec4(sphere.GetCenter(), 1.0f);
+		const float radius = sphere.GetRadius();
+		for (int pid = 0; pid < 6; ++pid)
+		{
+			if (dot(planes[pid], center) + radius < 0.0f)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
 	bool Frustum::Intersects2(const Bounds& box) const
 	{
 		bool result = true; // inside
@@ -130,6 +145,39 @@ namespace jsr {
 		return result;
 	}
 
+	CullResult Frustum::Intersects2(const Bounds& box, uint8_t& planeMask, CullState& state, int& planeTests) const
+	{
+		const uint8_t inMask = planeMask;
+		uint8_t outMask = 0;
+
+		for (int k = 0; k < 6; ++k)
+		{
+			// start with the plane that rejected the box in the previous frame
+			const int i = (state.lastPlane + k) % 6;
+			const uint8_t bit = uint8_t(1u << i);
+			if ((inMask & bit) == 0) continue;
+
+			const float pos = planes[i].w;
+			const vec3 normal = vec3(planes[i]);
+
+			++planeTests;
+			if (dot(normal, box.GetPositiveVertex(normal)) + pos < 0.0f)
+			{
+				state.lastPlane = uint8_t(i);
+				return CullResult_Outside;
+			}
+
+			if (dot(normal, box.GetNegativeVertex(normal)) + pos < 0.0f)
+			{
+				outMask |= bit;
+			}
+		}
+
+		planeMask = outMask;
+
+		return outMask ? CullResult_Intersect : CullResult_Inside;
+	}
+
 	void Frustum::GetCorners(std::vector<glm::vec3>& v)
 	{
 		for (int i = 0; i < 8; ++i) v.push_back(corners[i]);
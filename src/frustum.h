@@ -17,13 +17,28 @@ namespace jsr {
 		glm::vec4 GetVec4() const { return glm::vec4(normal, distance); }
 	};
 
+	enum CullResult { CullResult_Outside, CullResult_Intersect, CullResult_Inside };
+
+	/*
+	Per-object culling state carried between frames.
+	lastPlane is the plane that rejected the object last time, it is tested first.
+	*/
+	struct CullState {
+		uint8_t lastPlane = 0;
+	};
+
+	static const uint8_t FRUSTUM_ALL_PLANES = 0x3F;
+
 	class Frustum
 	{
 	public:
 		Frustum(const glm::mat4& vp);
 		bool Intersects(const Bounds& box) const;
 		bool Intersects(const glm::vec3& point) const;
+		bool Intersects(const Sphere& sphere) const;
 		bool Intersects2(const Bounds& box) const;
+		// planeMask: in - planes to test, out - planes the box straddles (pass it to the children)
+		CullResult Intersects2(const Bounds& box, uint8_t& planeMask, CullState& state, int& planeTests) const;
 		void GetCorners(std::vector<glm::vec3>& v);
 		const glm::vec4* GetPlanes() const;
 	private:
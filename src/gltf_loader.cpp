@@ -1,6 +1,12 @@
 
 #include "pch.h"
 #include "gltf_loader.h"
+#include "mesh_lod.h"
+#include "mesh_optimize.h"
+#include "meshlet.h"
+#include "mesh_tangents.h"
+#include "jobsys.h"
+#include "gltf_view.h"
 #include <map>
 #include <tiny_gltf.h>
 #include <jsrlib/jsr_logger.h>
@@ -10,13 +16,35 @@ namespace jsr {
 
 	namespace fs = std::filesystem;
 
+	// accessor indices of a validated primitive
+	struct GltfPrimitive {
+		const tinygltf::Primitive* primitive;
+		int position;
+		int normal;
+		int tangent;
+		int uv;
+	};
+
+	struct GltfPrimitiveStats {
+		size_t vertices;
+		size_t weldedVertices;
+		bool tangentsGenerated;
+		bool rejected;				// attribute counts or indices do not match, left empty
+		double tangentMs;
+		double weldMs;
+	};
+
 	static bool getGltfAttributeIndex(const std::map<std::string, int>& attributes, const std::string& name, int* out);
-	static std::vector<uint8_t> getGltfAttribute(const tinygltf::Model& model, int attribIndex, size_t typeSize, int expectedType, int expectedCompType);
+	// converted to a tightly packed array of T, the MeshData layout
+	template<class T> static void getGltfAttribute(const tinygltf::Model& model, int attribIndex, std::vector<uint8_t>& out);
 	static void processGltfMaterials(const tinygltf::Model& model, World& world);
-	static bool processGltfMeshes(const tinygltf::Model& model, World& world);
+	static void decodeGltfPrimitive(const tinygltf::Model& model, const GltfPrimitive& prim, MeshData& data, GltfPrimitiveStats& stats);
 	static void processGltfNodes(const tinygltf::Model& model, World& world);
+	static void generateLods(World& world);
+	static void optimizeMeshes(World& world);
+	static void generateMeshlets(World& world);
 
-	bool gltfLoadWorld(std::filesystem::path filename, World& world)
+	bool gltfLoadWorld(std::filesystem::path filename, World& world, std::vector<std::filesystem::path>* sources)
 	{
 		std::string warn, err;
 		tinygltf::Model model;
@@ -39,8 +67,25 @@ namespace jsr {
 			jsrlib::Info("load GLTF warning: %s", warn.c_str());
 		}
 
+		if (sources) {
+			sources->push_back(filename);
+			for (const auto& buffer : model.buffers) {
+				if (buffer.uri.empty() || buffer.uri.compare(0, 5, "data:") == 0) {
+					continue;
+				}
+				std::string uri = buffer.uri;
+				for (size_t found = uri.find("%20"); found != std::string::npos; found = uri.find("%20")) {
+					uri.replace(found, 3, " ");
+				}
+				sources->push_back(filename.parent_path() / fs::u8path(uri));
+			}
+		}
+
 		processGltfMaterials(model, world);
-		processGltfMeshes(model, world);
+		gltfProcessMeshes(model, world, &jobsys);
+		generateLods(world);
+		optimizeMeshes(world);
+		generateMeshlets(world);
 		processGltfNodes(model, world);
 		world.update();
 
@@ -56,24 +101,6 @@ namespace jsr {
 		return false;
 	}
 
-	std::vector<uint8_t> getGltfAttribute(const tinygltf::Model& model, int attribIndex, size_t typeSize, int expectedType, int expectedCompType)
-	{
-		const tinygltf::Accessor& accessor = model.accessors[attribIndex];
-		const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
-		const tinygltf::Buffer& buffer = model.buffers[view.buffer];
-
-		assert(expectedType == accessor.type);
-		assert(expectedCompType == accessor.componentType);
-		assert(view.byteStride == 0 || view.byteStride == typeSize);
-		
-		const size_t byteCount = accessor.count * typeSize;
-
-		std::vector<uint8_t> byteData(byteCount);
-		memcpy(byteData.data(), buffer.data.data() + view.byteOffset + accessor.byteOffset, byteCount);
-
-		return std::move(byteData);
-	}
-
 	void processGltfMaterials(const tinygltf::Model& model, World& world)
 	{
 		world.materials.resize(model.materials.size());
@@ -112,66 +139,219 @@ namespace jsr {
 		}
 	}
 
-	bool processGltfMeshes(const tinygltf::Model& model, World& world)
+	bool gltfProcessMeshes(const tinygltf::Model& model, World& world, jsrlib::JobSystem* jobs)
 	{
-		size_t mesh_count(0);
-		std::vector<uint8_t> attribVec;
+		std::vector<GltfPrimitive> primitives;
 
+		// serial pass: validation and the output slot of every primitive
 		for (size_t i = 0; i < model.meshes.size(); ++i)
 		{
 			const tinygltf::Mesh& mesh = model.meshes[i];
 			for (size_t j = 0; j < mesh.primitives.size(); ++j)
 			{
-				++mesh_count;
 				const auto& tris = mesh.primitives[j];
+				GltfPrimitive prim{ &tris, -1, -1, -1, -1 };
 				bool allAttribExists = true;
-				int pos_index(-1), normal_index(-1), color_index(-1), tangent_index(-1), uv_index(-1);
-				allAttribExists &= getGltfAttributeIndex(tris.attributes, "POSITION", &pos_index);
-				allAttribExists &= getGltfAttributeIndex(tris.attributes, "NORMAL", &normal_index);
-				allAttribExists &= getGltfAttributeIndex(tris.attributes, "TANGENT", &tangent_index);
-				allAttribExists &= getGltfAttributeIndex(tris.attributes, "TEXCOORD_0", &uv_index);
-				getGltfAttributeIndex(tris.attributes, "COLOR_0", &color_index);
+				allAttribExists &= getGltfAttributeIndex(tris.attributes, "POSITION", &prim.position);
+				allAttribExists &= getGltfAttributeIndex(tris.attributes, "NORMAL", &prim.normal);
+				allAttribExists &= getGltfAttributeIndex(tris.attributes, "TEXCOORD_0", &prim.uv);
+				// generated when missing
+				getGltfAttributeIndex(tris.attributes, "TANGENT", &prim.tangent);
 
 				if (!allAttribExists) {
 					jsrlib::Error("File contains meshes with missing attributes");
 					return false;
 				}
-				MeshData data;
-				data.material = tris.material;
-				data.aabb.Extend(glm::vec3(glm::make_vec3(model.accessors[pos_index].minValues.data())));
-				data.aabb.Extend(glm::vec3(glm::make_vec3(model.accessors[pos_index].maxValues.data())));
-
-				constexpr size_t vec2_size = 2 * sizeof(float);
-				constexpr size_t vec3_size = 3 * sizeof(float);
-				constexpr size_t vec4_size = 4 * sizeof(float);
-				{
-					data.positions = getGltfAttribute(model, pos_index, vec3_size, TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_FLOAT);
-					data.normals = getGltfAttribute(model, normal_index, vec3_size, TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_FLOAT);
-					data.tangents = getGltfAttribute(model, tangent_index, vec4_size, TINYGLTF_TYPE_VEC4, TINYGLTF_COMPONENT_TYPE_FLOAT);
-					data.uvs = getGltfAttribute(model, uv_index, vec2_size, TINYGLTF_TYPE_VEC2, TINYGLTF_COMPONENT_TYPE_FLOAT);
+				primitives.push_back(prim);
+			}
+		}
+
+		const size_t firstMesh = world.meshes.size();
+		world.meshes.resize(firstMesh + primitives.size());
+
+		// primitives are independent, every job writes only its own MeshData
+		const auto start = std::chrono::steady_clock::now();
+		std::vector<GltfPrimitiveStats> stats(primitives.size());
+		if (jobs)
+		{
+			jsrlib::counting_semaphore counter;
+			for (size_t i = 0; i < primitives.size(); ++i)
+			{
+				jobs->submitJob([&model, &primitives, &world, &stats, firstMesh, i](int threadId)
+					{
+						decodeGltfPrimitive(model, primitives[i], world.meshes[firstMesh + i], stats[i]);
+					}, &counter);
+			}
+			counter.wait();
+		}
+		else
+		{
+			for (size_t i = 0; i < primitives.size(); ++i) {
+				decodeGltfPrimitive(model, primitives[i], world.meshes[firstMesh + i], stats[i]);
+			}
+		}
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		GltfPrimitiveStats total{};
+		int tangentPrimitives = 0;
+		for (size_t i = 0; i < stats.size(); ++i)
+		{
+			const GltfPrimitiveStats& s = stats[i];
+			total.vertices += s.vertices;
+			total.weldedVertices += s.weldedVertices;
+			total.tangentMs += s.tangentMs;
+			total.weldMs += s.weldMs;
+			tangentPrimitives += s.tangentsGenerated ? 1 : 0;
+			if (s.rejected) {
+				jsrlib::Error("Primitive %d has attributes or indices of different vertex counts, it is skipped", (int)i);
+			}
+		}
+		// the tangent and weld times are summed over the jobs, the decode time is wall clock
+		jsrlib::Info("Primitives decoded in %.1f ms: tangents generated for %d of %d (%.1f ms), vertices welded %d -> %d (%.1f ms)",
+			ms, tangentPrimitives, (int)primitives.size(), total.tangentMs, (int)total.vertices, (int)total.weldedVertices, total.weldMs);
+
+		return true;
+	}
+
+	void decodeGltfPrimitive(const tinygltf::Model& model, const GltfPrimitive& prim, MeshData& data, GltfPrimitiveStats& stats)
+	{
+		data.material = prim.primitive->material;
+		data.aabb.Extend(glm::vec3(glm::make_vec3(model.accessors[prim.position].minValues.data())));
+		data.aabb.Extend(glm::vec3(glm::make_vec3(model.accessors[prim.position].maxValues.data())));
+
+		getGltfAttribute<glm::vec3>(model, prim.position, data.positions);
+		getGltfAttribute<glm::vec3>(model, prim.normal, data.normals);
+		getGltfAttribute<glm::vec2>(model, prim.uv, data.uvs);
+		if (prim.tangent > -1) {
+			getGltfAttribute<glm::vec4>(model, prim.tangent, data.tangents);
+		}
+
+		if (prim.primitive->indices > -1)
+		{
+			const gltf_view<uint32_t> indices(model, prim.primitive->indices);
+			data.indices.resize(indices.size());
+			indices.copy_to(data.indices.data());
+		}
+
+		stats = {};
+		stats.vertices = data.positions.size() / (3 * sizeof(float));
+		auto start = std::chrono::steady_clock::now();
+		if (prim.tangent < 0)
+		{
+			stats.tangentsGenerated = generateMeshTangents(data);
+			if (!stats.tangentsGenerated) {
+				const glm::vec4 tangent(1.0f, 0.0f, 0.0f, 1.0f);
+				data.tangents.resize(data.positions.size() / (3 * sizeof(float)) * sizeof(tangent));
+				for (size_t offset = 0; offset < data.tangents.size(); offset += sizeof(tangent)) {
+					memcpy(&data.tangents[offset], &tangent, sizeof(tangent));
 				}
+			}
+			const auto now = std::chrono::steady_clock::now();
+			stats.tangentMs = std::chrono::duration<double, std::milli>(now - start).count();
+			start = now;
+		}
+		stats.weldedVertices = weldMeshVertices(data);
+		stats.weldMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (stats.weldedVertices == 0 && stats.vertices > 0)
+		{
+			// the streams would be read with the vertex count of the positions
+			stats.rejected = true;
+			data.indices.clear();
+			data.positions.clear();
+			data.normals.clear();
+			data.tangents.clear();
+			data.uvs.clear();
+		}
+	}
+
+	template<class T>
+	void getGltfAttribute(const tinygltf::Model& model, int attribIndex, std::vector<uint8_t>& out)
+	{
+		const gltf_view<T> view(model, attribIndex);
+		out.resize(view.size() * sizeof(T));
+		view.copy_to(reinterpret_cast<T*>(out.data()));
+	}
+
+	void generateLods(World& world)
+	{
+		jsrlib::counting_semaphore counter;
 
-				if (model.accessors[tris.indices].componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
+		for (size_t i = 0; i < world.meshes.size(); ++i)
+		{
+			jobsys.submitJob([&world, i](int threadId)
 				{
-					const std::vector<uint8_t> indexBytes = getGltfAttribute(model, tris.indices, sizeof(uint16_t), TINYGLTF_TYPE_SCALAR, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT);
-					data.indices.reserve(indexBytes.size() / sizeof(uint16_t));
-					for (size_t i = 0; i < indexBytes.size(); i += sizeof(uint16_t)) {
-						data.indices.push_back(*reinterpret_cast<const uint16_t*>(&indexBytes[i]));
-					}
-				}
-				else if (model.accessors[tris.indices].componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT)
+					generateMeshLods(world.meshes[i]);
+				}, &counter);
+		}
+
+		counter.wait();
+
+		size_t triangles = 0, lodTriangles = 0;
+		for (const auto& mesh : world.meshes)
+		{
+			triangles += mesh.indices.size() / 3;
+			for (const auto& lod : mesh.lods) {
+				lodTriangles += lod.indices.size() / 3;
+			}
+		}
+		jsrlib::Info("Mesh LODs generated: %d triangles, %d in LODs", (int)triangles, (int)lodTriangles);
+	}
+
+	void optimizeMeshes(World& world)
+	{
+		jsrlib::counting_semaphore counter;
+		std::vector<VertexCacheStats> before(world.meshes.size());
+		std::vector<VertexCacheStats> after(world.meshes.size());
+
+		for (size_t i = 0; i < world.meshes.size(); ++i)
+		{
+			jobsys.submitJob([&world, &before, &after, i](int threadId)
 				{
-					const std::vector<uint8_t> indexBytes = getGltfAttribute(model, tris.indices, sizeof(uint32_t), TINYGLTF_TYPE_SCALAR, TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT);
-					data.indices.reserve(indexBytes.size() / sizeof(uint32_t));
-					for (size_t i = 0; i < indexBytes.size(); i += sizeof(uint32_t)) {
-						data.indices.push_back(*reinterpret_cast<const uint32_t*>(&indexBytes[i]));
-					}
-				}
+					optimizeMesh(world.meshes[i], &before[i], &after[i]);
+				}, &counter);
+		}
+
+		counter.wait();
+
+		VertexCacheStats totalBefore, totalAfter;
+		for (size_t i = 0; i < world.meshes.size(); ++i)
+		{
+			totalBefore += before[i];
+			totalAfter += after[i];
+		}
+		jsrlib::Info("Mesh vertex cache optimized: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+			totalBefore.acmr(), totalAfter.acmr(), totalBefore.atvr(), totalAfter.atvr());
+	}
 
-				world.meshes.push_back(std::move(data));
+	void generateMeshlets(World& world)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		jsrlib::counting_semaphore counter;
+
+		for (size_t i = 0; i < world.meshes.size(); ++i)
+		{
+			jobsys.submitJob([&world, i](int threadId)
+				{
+					buildMeshlets(world.meshes[i]);
+				}, &counter);
+		}
+
+		counter.wait();
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		size_t meshlets = 0, vertices = 0, triangles = 0, cones = 0;
+		for (const auto& mesh : world.meshes)
+		{
+			meshlets += mesh.meshlets.size();
+			vertices += mesh.meshletVertices.size();
+			triangles += mesh.meshletTriangles.size() / 3;
+			for (const auto& meshlet : mesh.meshlets) {
+				cones += meshlet.coneCutoff < 1.0f ? 1 : 0;
 			}
 		}
-		return true;
+		const float count = float(std::max(meshlets, size_t(1)));
+		jsrlib::Info("Meshlets built in %.1f ms: %d meshlets, %.1f vertices, %.1f triangles on average, %d with a normal cone",
+			ms, (int)meshlets, float(vertices) / count, float(triangles) / count, (int)cones);
 	}
 
 	void processGltfNodes(const tinygltf::Model& model, World& world)
@@ -1,9 +1,22 @@
 #pragma once
 
 #include "world.h"
+#include "jsrlib/jsr_jobsystem2.h"
+
+namespace tinygltf {
+	class Model;
+}
 
 namespace jsr {
 
-	bool gltfLoadWorld(std::filesystem::path filename, World& world);
+	// sources receives the files the world was built from: the glTF and its external buffers
+	bool gltfLoadWorld(std::filesystem::path filename, World& world, std::vector<std::filesystem::path>* sources = nullptr);
+
+	/*
+	The meshes step of gltfLoadWorld: a MeshData per primitive appended to world.meshes, with the
+	attributes decoded, missing tangents generated and the vertices welded. A job per primitive with jobs,
+	serially without, the meshes are the same. False if a primitive misses a required attribute.
+	*/
+	bool gltfProcessMeshes(const tinygltf::Model& model, World& world, jsrlib::JobSystem* jobs);
 
 }
\ No newline at end of file
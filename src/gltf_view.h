@@ -0,0 +1,253 @@
+#pragma once
+
+#include "pch.h"
+#include <cstring>
+#include <type_traits>
+#include <tiny_gltf.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JSR_GLTF_VIEW_SSE2
+#endif
+
+namespace jsr {
+
+	template<class T> struct gltf_view_traits {
+		static_assert(std::is_arithmetic<T>::value, "gltf_view element has to be a scalar or a glm vector");
+		using scalar_type = T;
+		static const int components = 1;
+	};
+
+	template<glm::length_t N, class S, glm::qualifier Q> struct gltf_view_traits<glm::vec<N, S, Q>> {
+		using scalar_type = S;
+		static const int components = N;
+	};
+
+	/*
+	Typed view of a glTF accessor, elements are read from the tinygltf buffers on access, nothing is copied up front.
+	Handles the byte stride of interleaved buffer views, converts the component type to the one of T
+	(normalized integers become floats as the glTF spec defines) and applies sparse substitutions.
+	copy_to() is a single memcpy when the accessor is laid out exactly like an array of T,
+	16 to 32 bit index widening is vectorized.
+	*/
+	template<class T>
+	class gltf_view
+	{
+	public:
+		using scalar_type = typename gltf_view_traits<T>::scalar_type;
+		static const int components = gltf_view_traits<T>::components;
+
+		gltf_view(const tinygltf::Model& model, int accessorIndex);
+
+		size_t size() const { return m_count; }
+		bool empty() const { return m_count == 0; }
+		// tightly packed T without sparse values, data() is valid
+		bool dense() const { return m_dense; }
+		const T* data() const { return m_dense ? reinterpret_cast<const T*>(m_base) : nullptr; }
+
+		T operator[](size_t i) const;
+		// dst has room for size() elements
+		void copy_to(T* dst) const;
+	private:
+		T read(const uint8_t* p) const;
+		scalar_type read_component(const uint8_t* p) const;
+		// index of element i in the sparse table, ~0 if it is not substituted
+		size_t find_sparse(size_t i) const;
+		size_t sparse_index(size_t k) const;
+
+		const uint8_t* m_base = nullptr;			// nullptr: all zeros, a sparse accessor without a buffer view
+		size_t m_count = 0;
+		size_t m_stride = 0;
+		size_t m_componentSize = 0;
+		int m_componentType = 0;
+		bool m_normalized = false;
+		bool m_packed = false;						// no gaps between elements, no sparse values
+		bool m_dense = false;						// packed and the component type is the scalar of T
+
+		const uint8_t* m_sparseIndices = nullptr;	// strictly increasing by the spec
+		size_t m_sparseIndexSize = 0;
+		const uint8_t* m_sparseValues = nullptr;	// tightly packed, same component type as the accessor
+		size_t m_sparseCount = 0;
+	};
+
+	template<class T>
+	inline gltf_view<T>::gltf_view(const tinygltf::Model& model, int accessorIndex)
+	{
+		const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+		assert(tinygltf::GetNumComponentsInType(uint32_t(accessor.type)) == components);
+
+		m_count = accessor.count;
+		m_componentType = accessor.componentType;
+		m_componentSize = size_t(tinygltf::GetComponentSizeInBytes(uint32_t(accessor.componentType)));
+		m_normalized = accessor.normalized;
+		m_stride = m_componentSize * components;
+
+		if (accessor.bufferView > -1)
+		{
+			const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+			m_base = model.buffers[view.buffer].data.data() + view.byteOffset + accessor.byteOffset;
+			m_stride = size_t(accessor.ByteStride(view));
+		}
+
+		if (accessor.sparse.isSparse && accessor.sparse.count > 0)
+		{
+			const auto& indices = accessor.sparse.indices;
+			const tinygltf::BufferView& indexView = model.bufferViews[indices.bufferView];
+			m_sparseIndices = model.buffers[indexView.buffer].data.data() + indexView.byteOffset + indices.byteOffset;
+			m_sparseIndexSize = size_t(tinygltf::GetComponentSizeInBytes(uint32_t(indices.componentType)));
+
+			const auto& values = accessor.sparse.values;
+			const tinygltf::BufferView& valueView = model.bufferViews[values.bufferView];
+			m_sparseValues = model.buffers[valueView.buffer].data.data() + valueView.byteOffset + values.byteOffset;
+			m_sparseCount = size_t(accessor.sparse.count);
+		}
+
+		m_packed = m_base && m_sparseCount == 0 && m_stride == m_componentSize * components;
+		m_dense = m_packed && m_componentSize == sizeof(scalar_type) && sizeof(T) == sizeof(scalar_type) * components &&
+			(std::is_floating_point<scalar_type>::value ?
+				m_componentType == TINYGLTF_COMPONENT_TYPE_FLOAT :
+				m_componentType != TINYGLTF_COMPONENT_TYPE_FLOAT && !m_normalized &&
+				std::is_signed<scalar_type>::value == (m_componentType == TINYGLTF_COMPONENT_TYPE_BYTE || m_componentType == TINYGLTF_COMPONENT_TYPE_SHORT));
+	}
+
+	template<class T>
+	inline typename gltf_view<T>::scalar_type gltf_view<T>::read_component(const uint8_t* p) const
+	{
+		// unaligned sources are allowed, components are read with memcpy
+		switch (m_componentType)
+		{
+		case TINYGLTF_COMPONENT_TYPE_FLOAT: {
+			float v;
+			memcpy(&v, p, sizeof(v));
+			return scalar_type(v);
+		}
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+			const uint8_t v = *p;
+			return m_normalized ? scalar_type(float(v) / 255.0f) : scalar_type(v);
+		}
+		case TINYGLTF_COMPONENT_TYPE_BYTE: {
+			const int8_t v = int8_t(*p);
+			return m_normalized ? scalar_type(std::max(float(v) / 127.0f, -1.0f)) : scalar_type(v);
+		}
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+			uint16_t v;
+			memcpy(&v, p, sizeof(v));
+			return m_normalized ? scalar_type(float(v) / 65535.0f) : scalar_type(v);
+		}
+		case TINYGLTF_COMPONENT_TYPE_SHORT: {
+			int16_t v;
+			memcpy(&v, p, sizeof(v));
+			return m_normalized ? scalar_type(std::max(float(v) / 32767.0f, -1.0f)) : scalar_type(v);
+		}
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+			uint32_t v;
+			memcpy(&v, p, sizeof(v));
+			return scalar_type(v);
+		}
+		default:
+			assert(false);
+			return scalar_type(0);
+		}
+	}
+
+	template<class T>
+	inline T gltf_view<T>::read(const uint8_t* p) const
+	{
+		if constexpr (components == 1) {
+			return read_component(p);
+		}
+		else {
+			T result;
+			for (int c = 0; c < components; ++c) {
+				result[c] = read_component(p + c * m_componentSize);
+			}
+			return result;
+		}
+	}
+
+	template<class T>
+	inline size_t gltf_view<T>::sparse_index(size_t k) const
+	{
+		const uint8_t* p = m_sparseIndices + k * m_sparseIndexSize;
+		if (m_sparseIndexSize == 1) return *p;
+		if (m_sparseIndexSize == 2) {
+			uint16_t v;
+			memcpy(&v, p, sizeof(v));
+			return v;
+		}
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	template<class T>
+	inline size_t gltf_view<T>::find_sparse(size_t i) const
+	{
+		size_t lo = 0, hi = m_sparseCount;
+		while (lo < hi)
+		{
+			const size_t mid = (lo + hi) / 2;
+			const size_t index = sparse_index(mid);
+			if (index == i) return mid;
+			if (index < i) lo = mid + 1;
+			else hi = mid;
+		}
+		return ~size_t(0);
+	}
+
+	template<class T>
+	inline T gltf_view<T>::operator[](size_t i) const
+	{
+		assert(i < m_count);
+		if (m_sparseCount > 0)
+		{
+			const size_t k = find_sparse(i);
+			if (k != ~size_t(0)) {
+				return read(m_sparseValues + k * m_componentSize * components);
+			}
+		}
+		return m_base ? read(m_base + i * m_stride) : T(0);
+	}
+
+	template<class T>
+	inline void gltf_view<T>::copy_to(T* dst) const
+	{
+		if (m_dense)
+		{
+			memcpy(dst, m_base, m_count * sizeof(T));
+			return;
+		}
+
+		size_t i = 0;
+		if (!m_base)
+		{
+			std::fill(dst, dst + m_count, T(0));
+			i = m_count;
+		}
+#ifdef JSR_GLTF_VIEW_SSE2
+		else if constexpr (std::is_same<T, uint32_t>::value)
+		{
+			if (m_packed && m_componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
+			{
+				const __m128i zero = _mm_setzero_si128();
+				for (; i + 8 <= m_count; i += 8)
+				{
+					const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_base + i * sizeof(uint16_t)));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(v, zero));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(v, zero));
+				}
+			}
+		}
+#endif
+		for (; i < m_count; ++i) {
+			dst[i] = read(m_base + i * m_stride);
+		}
+
+		for (size_t k = 0; k < m_sparseCount; ++k)
+		{
+			const size_t index = sparse_index(k);
+			if (index < m_count) {
+				dst[index] = read(m_sparseValues + k * m_componentSize * components);
+			}
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "pch.h"
+
+namespace jsr {
+
+	// S_CULL_OBJECT of shaders/v2/cull_v2.comp, std430
+	struct GpuCullObject {
+		glm::vec4 boundsMin;		// world space AABB
+		glm::vec4 boundsMax;
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+		uint32_t batch;
+		uint32_t commandBase;		// first command of the batch
+		uint32_t drawDataIndex;		// becomes firstInstance
+		uint32_t pad0;
+		uint32_t pad1;
+	};
+	static_assert(sizeof(GpuCullObject) == 64, "layout of S_CULL_OBJECT");
+
+	// S_DRAW_COMMAND, laid out as VkDrawIndexedIndirectCommand
+	struct GpuDrawCommand {
+		uint32_t indexCount;
+		uint32_t instanceCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+		uint32_t firstInstance;
+	};
+
+	// push constants of cull_v2.comp
+	struct GpuCullConstants {
+		glm::vec4 frustumPlanes[6];
+		uint32_t objectCount;
+		uint32_t pad[3];
+	};
+
+	static const uint32_t GPU_CULL_GROUP_SIZE = 64;		// local_size_x of cull_v2.comp
+
+	// the test of cull_v2.comp: outside when the corner furthest along a plane normal is behind the plane
+	inline bool gpuCullVisible(const glm::vec4* planes, const glm::vec4& bmin, const glm::vec4& bmax)
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			const glm::vec4& plane = planes[i];
+			const glm::vec3 p(
+				plane.x >= 0.0f ? bmax.x : bmin.x,
+				plane.y >= 0.0f ? bmax.y : bmin.y,
+				plane.z >= 0.0f ? bmax.z : bmin.z);
+			if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
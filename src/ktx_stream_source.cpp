@@ -0,0 +1,193 @@
+#include <cstring>
+#include <cmath>
+#include "ktx_stream_source.h"
+
+namespace jsr {
+
+	// KTX2 file layout: the format, the level count and the supercompression scheme are in the header,
+	// the level index follows it with the byte offset, byte length and uncompressed length of every level
+	static const size_t KTX2_VK_FORMAT_OFFSET = 12;
+	static const size_t KTX2_LEVEL_COUNT_OFFSET = 40;
+	static const size_t KTX2_SUPERCOMPRESSION_OFFSET = 44;
+	static const size_t KTX2_LEVEL_INDEX_OFFSET = 80;
+	static const size_t KTX2_LEVEL_INDEX_SIZE = 3 * sizeof(uint64_t);
+
+	bool selectKtxTranscodeFormat(ktxTexture2* texture, const KtxTranscodeTargets& targets, ktx_texture_transcode_fmt_e& format)
+	{
+		const khr_df_model_e colorModel = ktxTexture2_GetColorModel_e(texture);
+		if (colorModel == KHR_DF_MODEL_UASTC && targets.astc) {
+			format = KTX_TTF_ASTC_4x4_RGBA;
+		}
+		else if (colorModel == KHR_DF_MODEL_ETC1S && targets.etc2) {
+			format = KTX_TTF_ETC;
+		}
+		else if (targets.astc) {
+			format = KTX_TTF_ASTC_4x4_RGBA;
+		}
+		else if (targets.etc2) {
+			format = KTX_TTF_ETC2_RGBA;
+		}
+		else if (targets.bc) {
+			format = KTX_TTF_BC7_RGBA;
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+
+	bool KtxStreamSource::transcode(const std::string& filename, ktxTexture2* texture, ktx_texture_transcode_fmt_e format) const
+	{
+		if (!ktxTexture_GetData(ktxTexture(texture)) && ktxTexture_LoadImageData(ktxTexture(texture), nullptr, 0) != KTX_SUCCESS) {
+			return false;
+		}
+		if (ktxTexture2_TranscodeBasis(texture, format, 0) != KTX_SUCCESS) {
+			return false;
+		}
+		if (m_cache) {
+			m_cache->write(filename, format, texture);
+		}
+		return true;
+	}
+
+	bool KtxStreamSource::describe(const std::string& filename, TextureStreamDesc& desc) const
+	{
+		ktxTexture2* texture;
+		if (ktxTexture2_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_NO_FLAGS, &texture) != KTX_SUCCESS) {
+			return false;
+		}
+
+		// the streamed image is recreated with the full chain from the resident level down
+		const uint32_t fullChain = uint32_t(std::floor(std::log2(std::max(texture->baseWidth, texture->baseHeight)))) + 1;
+		bool ok = texture->numDimensions == 2 && !texture->isArray && texture->numFaces == 1 && texture->numLevels == fullChain;
+		desc.width = texture->baseWidth;
+		desc.height = texture->baseHeight;
+		desc.levelSizes.resize(texture->numLevels);
+
+		// the size of the transcoded levels is known after transcoding only
+		if (ok && ktxTexture2_NeedsTranscoding(texture))
+		{
+			ktx_texture_transcode_fmt_e format;
+			CachedTexture entry;
+			ok = selectKtxTranscodeFormat(texture, m_targets, format);
+			if (ok && m_cache && m_cache->open(filename, format, entry) && entry.getLevelCount() == texture->numLevels)
+			{
+				for (uint32_t level = 0; level < texture->numLevels; ++level) {
+					desc.levelSizes[level] = entry.getLevelSize(level);
+				}
+				ktxTexture_Destroy(ktxTexture(texture));
+				return true;
+			}
+			ok = ok && transcode(filename, texture, format);
+		}
+
+		if (ok)
+		{
+			for (uint32_t level = 0; level < texture->numLevels; ++level) {
+				desc.levelSizes[level] = ktxTexture_GetImageSize(ktxTexture(texture), level);
+			}
+		}
+		ktxTexture_Destroy(ktxTexture(texture));
+
+		return ok;
+	}
+
+	bool KtxStreamSource::loadLevels(const std::string& filename, uint32_t firstLevel, TextureStreamData& out) const
+	{
+		std::ifstream file(filename, std::ios::binary);
+		uint8_t header[KTX2_LEVEL_INDEX_OFFSET];
+		if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+			return false;
+		}
+		uint32_t format, levelCount, supercompression;
+		memcpy(&format, &header[KTX2_VK_FORMAT_OFFSET], sizeof(uint32_t));
+		memcpy(&levelCount, &header[KTX2_LEVEL_COUNT_OFFSET], sizeof(uint32_t));
+		memcpy(&supercompression, &header[KTX2_SUPERCOMPRESSION_OFFSET], sizeof(uint32_t));
+		if (firstLevel >= levelCount) {
+			return false;
+		}
+
+		// plain levels are read straight from the file, the finer ones are not touched.
+		// UASTC is not supercompressed either but its format is undefined, it needs transcoding
+		if (supercompression == KTX_SS_NONE && format != 0)
+		{
+			std::vector<uint64_t> index(size_t(levelCount) * 3);
+			if (!file.read(reinterpret_cast<char*>(index.data()), levelCount * KTX2_LEVEL_INDEX_SIZE)) {
+				return false;
+			}
+			out.format = format;
+			size_t size = 0;
+			for (uint32_t level = firstLevel; level < levelCount; ++level) {
+				size += size_t(index[level * 3 + 1]);
+			}
+			out.data.resize(size);
+
+			size_t offset = 0;
+			for (uint32_t level = firstLevel; level < levelCount; ++level)
+			{
+				const size_t length = size_t(index[level * 3 + 1]);
+				file.seekg(std::streamoff(index[level * 3]));
+				if (!file.read(reinterpret_cast<char*>(&out.data[offset]), length)) {
+					return false;
+				}
+				offset += length;
+			}
+			return true;
+		}
+		file.close();
+
+		ktxTexture2* texture;
+		if (ktxTexture2_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_NO_FLAGS, &texture) != KTX_SUCCESS) {
+			return false;
+		}
+		bool ok;
+		if (ktxTexture2_NeedsTranscoding(texture))
+		{
+			ktx_texture_transcode_fmt_e format;
+			auto entry = std::make_shared<CachedTexture>();
+			ok = selectKtxTranscodeFormat(texture, m_targets, format);
+			if (ok && m_cache && m_cache->open(filename, format, *entry) && entry->getLevelCount() == texture->numLevels)
+			{
+				// uploaded from the mapping, KTX2 stores the smallest level first so the block is not in level order
+				const uint8_t* first = entry->getLevel(firstLevel);
+				const uint8_t* last = first + entry->getLevelSize(firstLevel);
+				for (uint32_t level = firstLevel; level < entry->getLevelCount(); ++level) {
+					first = std::min(first, entry->getLevel(level));
+					last = std::max(last, entry->getLevel(level) + entry->getLevelSize(level));
+				}
+				out.format = entry->getFormat();
+				out.data.clear();
+				out.levelOffsets.clear();
+				for (uint32_t level = firstLevel; level < entry->getLevelCount(); ++level) {
+					out.levelOffsets.push_back(size_t(entry->getLevel(level) - first));
+				}
+				out.mapped = first;
+				out.mappedSize = size_t(last - first);
+				out.owner = std::move(entry);
+				ktxTexture_Destroy(ktxTexture(texture));
+				return true;
+			}
+			ok = ok && transcode(filename, texture, format);
+		}
+		else
+		{
+			ok = ktxTexture_LoadImageData(ktxTexture(texture), nullptr, 0) == KTX_SUCCESS;
+		}
+		if (ok)
+		{
+			out.format = texture->vkFormat;
+			out.data.clear();
+			for (uint32_t level = firstLevel; level < texture->numLevels; ++level)
+			{
+				ktx_size_t offset;
+				ok = ok && ktxTexture_GetImageOffset(ktxTexture(texture), level, 0, 0, &offset) == KTX_SUCCESS;
+				if (!ok) break;
+				const uint8_t* data = ktxTexture_GetData(ktxTexture(texture)) + offset;
+				out.data.insert(out.data.end(), data, data + ktxTexture_GetImageSize(ktxTexture(texture), level));
+			}
+		}
+		ktxTexture_Destroy(ktxTexture(texture));
+
+		return ok;
+	}
+}
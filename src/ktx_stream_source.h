@@ -0,0 +1,44 @@
+#pragma once
+
+#include "pch.h"
+#include "ktx.h"
+#include "texture_streamer.h"
+#include "texture_cache.h"
+
+namespace jsr {
+
+	// the block compressed formats the device can sample
+	struct KtxTranscodeTargets {
+		bool astc = false;
+		bool etc2 = false;
+		bool bc = false;
+	};
+
+	/*
+	The format a Basis Universal texture is transcoded to: UASTC prefers ASTC, ETC1S prefers ETC,
+	then ASTC, ETC2 and BC7 in this order. Returns false if none of them is supported.
+	*/
+	bool selectKtxTranscodeFormat(ktxTexture2* texture, const KtxTranscodeTargets& targets, ktx_texture_transcode_fmt_e& format);
+
+	/*
+	The mip levels of 2D KTX2 textures with a full mip chain, for the TextureStreamer. The levels of uncompressed
+	files are read alone, supercompressed and Basis files are loaded whole and transcoded, the requested levels are kept.
+	With a cache the transcoded Basis files are stored there and read from it the next time.
+	Stateless, it can be called from several threads. TextureStreamData::format is the VkFormat.
+	*/
+	class KtxStreamSource
+	{
+	public:
+		explicit KtxStreamSource(const KtxTranscodeTargets& targets, const TextureCache* cache = nullptr) : m_targets(targets), m_cache(cache) {}
+
+		// false if the file is missing or the texture cannot be streamed
+		bool describe(const std::string& filename, TextureStreamDesc& desc) const;
+		bool loadLevels(const std::string& filename, uint32_t firstLevel, TextureStreamData& out) const;
+	private:
+		// loads the image data if needed, transcodes and stores the result in the cache
+		bool transcode(const std::string& filename, ktxTexture2* texture, ktx_texture_transcode_fmt_e format) const;
+
+		KtxTranscodeTargets m_targets;
+		const TextureCache* m_cache;
+	};
+}
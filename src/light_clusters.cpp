@@ -0,0 +1,187 @@
+#include "light_clusters.h"
+#include "jobsys.h"
+
+namespace jsr {
+
+	using namespace glm;
+
+	void LightClusters::setup(const glm::mat4& proj, float zNear, float zFar)
+	{
+		m_zNear = zNear;
+		m_zFar = zFar;
+
+		const float logRatio = std::log(zFar / zNear);
+		m_sliceScale = float(GRID_Z) / logRatio;
+		m_sliceBias = -float(GRID_Z) * std::log(zNear) / logRatio;
+
+		for (uint32_t z = 0; z < GRID_Z; ++z)
+		{
+			const float d0 = zNear * std::pow(zFar / zNear, float(z) / GRID_Z);
+			const float d1 = zNear * std::pow(zFar / zNear, float(z + 1) / GRID_Z);
+			m_sliceDepth[z] = { d0, d1 };
+
+			// view space extent of the tile on the near and far plane of the slice
+			for (uint32_t x = 0; x < GRID_X; ++x)
+			{
+				const float n0 = -1.0f + 2.0f * float(x) / GRID_X;
+				const float n1 = -1.0f + 2.0f * float(x + 1) / GRID_X;
+				const float v[4] = { n0 * d0 / proj[0][0], n0 * d1 / proj[0][0], n1 * d0 / proj[0][0], n1 * d1 / proj[0][0] };
+				m_tileX[z][x] = { std::min({ v[0], v[1], v[2], v[3] }), std::max({ v[0], v[1], v[2], v[3] }) };
+			}
+			for (uint32_t y = 0; y < GRID_Y; ++y)
+			{
+				const float n0 = -1.0f + 2.0f * float(y) / GRID_Y;
+				const float n1 = -1.0f + 2.0f * float(y + 1) / GRID_Y;
+				const float v[4] = { n0 * d0 / proj[1][1], n0 * d1 / proj[1][1], n1 * d0 / proj[1][1], n1 * d1 / proj[1][1] };
+				m_tileY[z][y] = { std::min({ v[0], v[1], v[2], v[3] }), std::max({ v[0], v[1], v[2], v[3] }) };
+			}
+		}
+
+		m_sliceLights.resize(GRID_Z);
+		m_clusterLights.resize(CLUSTER_COUNT);
+		m_clusters.resize(CLUSTER_COUNT);
+		m_ready = true;
+	}
+
+	float LightClusters::getLightFarDepth(const Light* lights, size_t lightCount, const glm::mat4& viewMatrix, float zNear, float zFar)
+	{
+		float farDepth = 0.0f;
+		for (size_t i = 0; i < lightCount; ++i)
+		{
+			const Light& light = lights[i];
+			if (light.type == LightType_Directional) continue;
+			if (light.range <= 0.0f) return zFar;
+
+			const float depth = -(viewMatrix * vec4(light.position[0], light.position[1], light.position[2], 1.0f)).z;
+			farDepth = std::max(farDepth, depth + light.range);
+		}
+		// an empty grid still needs a valid depth range
+		return clamp(farDepth, 2.0f * zNear, zFar);
+	}
+
+	uint32_t LightClusters::getSlice(float viewDepth) const
+	{
+		const float slice = std::log(std::max(viewDepth, m_zNear)) * m_sliceScale + m_sliceBias;
+		return uint32_t(clamp(int(slice), 0, int(GRID_Z) - 1));
+	}
+
+	void LightClusters::update(const Light* lights, size_t lightCount, const glm::mat4& viewMatrix)
+	{
+		assert(m_ready);
+
+		// view space position and radius, w < 0 marks lights not to cluster
+		std::vector<vec4> viewLights(lightCount);
+		for (auto& list : m_sliceLights) list.clear();
+
+		for (size_t i = 0; i < lightCount; ++i)
+		{
+			const Light& light = lights[i];
+			if (light.type == LightType_Directional) {
+				viewLights[i] = vec4(0.0f, 0.0f, 0.0f, -1.0f);
+				continue;
+			}
+
+			// range 0 means infinite range
+			const float radius = light.range > 0.0f ? light.range : m_zFar;
+			const vec3 pos = vec3(viewMatrix * vec4(light.position[0], light.position[1], light.position[2], 1.0f));
+			viewLights[i] = vec4(pos, radius);
+
+			const float depth = -pos.z;
+			if (depth + radius < m_zNear || depth - radius > m_zFar) {
+				continue;
+			}
+
+			const uint32_t s0 = getSlice(depth - radius);
+			const uint32_t s1 = getSlice(std::min(depth + radius, m_zFar));
+			for (uint32_t s = s0; s <= s1; ++s) {
+				m_sliceLights[s].push_back(uint32_t(i));
+			}
+		}
+
+		jsrlib::counting_semaphore counter;
+		for (uint32_t s = 0; s < GRID_Z; ++s)
+		{
+			jobsys.submitJob([this, s, &viewLights](int threadId)
+				{
+					AssignSlice(s, viewLights);
+				}, &counter);
+		}
+		counter.wait();
+
+		uint32_t offset = 0;
+		for (uint32_t c = 0; c < CLUSTER_COUNT; ++c)
+		{
+			const uint32_t count = (uint32_t)m_clusterLights[c].size();
+			m_clusters[c] = { offset, count };
+			offset += count;
+		}
+
+		m_lightIndices.resize(offset);
+		for (uint32_t c = 0; c < CLUSTER_COUNT; ++c)
+		{
+			std::copy(m_clusterLights[c].begin(), m_clusterLights[c].end(), m_lightIndices.begin() + m_clusters[c].offset);
+		}
+	}
+
+	void LightClusters::AssignSlice(uint32_t slice, const std::vector<glm::vec4>& viewLights)
+	{
+		for (uint32_t y = 0; y < GRID_Y; ++y)
+		{
+			for (uint32_t x = 0; x < GRID_X; ++x)
+			{
+				m_clusterLights[getClusterIndex(x, y, slice)].clear();
+			}
+		}
+
+		const Range depthRange = m_sliceDepth[slice];
+		const Range* tileX = m_tileX[slice];
+		const Range* tileY = m_tileY[slice];
+
+		for (const uint32_t lightIdx : m_sliceLights[slice])
+		{
+			const vec4& l = viewLights[lightIdx];
+			const float radius = l.w;
+			const float r2 = radius * radius;
+			const float depth = -l.z;
+
+			const float dz = std::max(0.0f, std::max(depthRange.min - depth, depth - depthRange.max));
+			if (dz * dz > r2) continue;
+
+			// tile ranges are monotonic, find the overlapped columns and rows first
+			uint32_t x0 = GRID_X, x1 = 0;
+			for (uint32_t x = 0; x < GRID_X; ++x)
+			{
+				if (tileX[x].max >= l.x - radius && tileX[x].min <= l.x + radius) {
+					x0 = std::min(x0, x);
+					x1 = x;
+				}
+			}
+			uint32_t y0 = GRID_Y, y1 = 0;
+			for (uint32_t y = 0; y < GRID_Y; ++y)
+			{
+				if (tileY[y].max >= l.y - radius && tileY[y].min <= l.y + radius) {
+					y0 = std::min(y0, y);
+					y1 = y;
+				}
+			}
+			if (x0 > x1 || y0 > y1) continue;
+
+			// exact sphere - cluster AABB test
+			for (uint32_t y = y0; y <= y1; ++y)
+			{
+				const float dy = std::max(0.0f, std::max(tileY[y].min - l.y, l.y - tileY[y].max));
+				const float dyz = dy * dy + dz * dz;
+				if (dyz > r2) continue;
+
+				for (uint32_t x = x0; x <= x1; ++x)
+				{
+					const float dx = std::max(0.0f, std::max(tileX[x].min - l.x, l.x - tileX[x].max));
+					if (dx * dx + dyz <= r2) {
+						m_clusterLights[getClusterIndex(x, y, slice)].push_back(lightIdx);
+					}
+				}
+			}
+		}
+	}
+
+}
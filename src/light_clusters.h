@@ -0,0 +1,65 @@
+#pragma once
+
+#include "pch.h"
+#include "light.h"
+
+namespace jsr {
+
+	/*
+	View space froxel grid with exponential depth slices.
+	Point and spot lights are assigned to the clusters their range sphere touches,
+	directional lights are not clustered.
+	The result is an (offset,count) pair per cluster plus a compact light index list,
+	laid out for std430 storage buffers.
+	*/
+	class LightClusters
+	{
+	public:
+		static const uint32_t GRID_X = 16;
+		static const uint32_t GRID_Y = 9;
+		static const uint32_t GRID_Z = 24;
+		static const uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+		struct Cluster {
+			uint32_t offset;
+			uint32_t count;
+		};
+
+		/*
+		proj must map view space to framebuffer oriented NDC (y down, like the shaders output it).
+		Cluster (x,y) is the tile of gl_FragCoord.xy, z is the slice of the view depth.
+		*/
+		void setup(const glm::mat4& proj, float zNear, float zFar);
+		// the view depth past which no point or spot light reaches, at most zFar; the far plane for setup()
+		static float getLightFarDepth(const Light* lights, size_t lightCount, const glm::mat4& viewMatrix, float zNear, float zFar);
+		void update(const Light* lights, size_t lightCount, const glm::mat4& viewMatrix);
+
+		const std::vector<Cluster>& getClusters() const { return m_clusters; }
+		const std::vector<uint32_t>& getLightIndices() const { return m_lightIndices; }
+		// slice = log(viewDepth) * x + y
+		glm::vec2 getSliceScaleBias() const { return glm::vec2(m_sliceScale, m_sliceBias); }
+		uint32_t getSlice(float viewDepth) const;
+		static uint32_t getClusterIndex(uint32_t x, uint32_t y, uint32_t z) { return (z * GRID_Y + y) * GRID_X + x; }
+		bool ready() const { return m_ready; }
+	private:
+		struct Range { float min, max; };
+
+		void AssignSlice(uint32_t slice, const std::vector<glm::vec4>& viewLights);
+
+		bool m_ready = false;
+		float m_zNear = 0.1f;
+		float m_zFar = 100.0f;
+		float m_sliceScale = 0.0f;
+		float m_sliceBias = 0.0f;
+		// cluster bounds are separable: x depends on (x,z), y on (y,z), depth on z only
+		Range m_sliceDepth[GRID_Z];
+		Range m_tileX[GRID_Z][GRID_X];
+		Range m_tileY[GRID_Z][GRID_Y];
+
+		std::vector<std::vector<uint32_t>> m_sliceLights;			// light candidates per slice
+		std::vector<std::vector<uint32_t>> m_clusterLights;		// per cluster scratch lists
+		std::vector<Cluster> m_clusters;
+		std::vector<uint32_t> m_lightIndices;
+	};
+
+}
@@ -0,0 +1,109 @@
+#include "pch.h"
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace jsr {
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	bool MappedFile::open(const std::filesystem::path& path)
+	{
+		close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER fileSize{};
+		HANDLE mapping = nullptr;
+		if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+			mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		}
+		if (!mapping) {
+			CloseHandle(file);
+			return false;
+		}
+		const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!data) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+		m_file = file;
+		m_mapping = mapping;
+		m_size = size_t(fileSize.QuadPart);
+#else
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat st {};
+		void* data = MAP_FAILED;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		}
+		// the mapping keeps the file referenced
+		::close(fd);
+		if (data == MAP_FAILED) return false;
+		m_size = size_t(st.st_size);
+#endif
+		m_data = static_cast<const uint8_t*>(data);
+
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (!m_data) return;
+
+#ifdef _WIN32
+		UnmapViewOfFile(m_data);
+		CloseHandle(m_mapping);
+		CloseHandle(m_file);
+		m_mapping = nullptr;
+		m_file = nullptr;
+#else
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	uint64_t fnv1a(uint64_t hash, const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	bool hashFile(const std::filesystem::path& path, uint64_t& result)
+	{
+		std::ifstream in(path, std::ios::binary);
+		if (!in) return false;
+
+		std::vector<uint8_t> chunk(1024 * 1024);
+		uint64_t hash = FNV1A_SEED;
+		while (in)
+		{
+			in.read(reinterpret_cast<char*>(chunk.data()), chunk.size());
+			hash = fnv1a(hash, chunk.data(), size_t(in.gcount()));
+		}
+		result = hash;
+
+		return in.eof();
+	}
+}
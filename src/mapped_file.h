@@ -0,0 +1,38 @@
+#pragma once
+
+#include "pch.h"
+
+namespace jsr {
+
+	/*
+	Read only memory mapping of a whole file, for the caches that are used straight from the disk.
+	*/
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		// false if the file is missing or empty
+		bool open(const std::filesystem::path& path);
+		void close();
+		bool isOpen() const { return m_data != nullptr; }
+
+		const uint8_t* data() const { return m_data; }
+		size_t size() const { return m_size; }
+	private:
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#endif
+	};
+
+	// 64 bit FNV-1a, start with FNV1A_SEED or continue a previous hash
+	static const uint64_t FNV1A_SEED = 0xcbf29ce484222325ull;
+	uint64_t fnv1a(uint64_t hash, const void* data, size_t size);
+	bool hashFile(const std::filesystem::path& path, uint64_t& result);
+}
@@ -0,0 +1,136 @@
+#include <cassert>
+#include <condition_variable>
+#include "material_image.h"
+#include "stb_image.h"
+
+namespace jsr {
+
+	namespace fs = std::filesystem;
+
+	void loadMaterialImage(MaterialImage& image, const KtxTranscodeTargets& targets, const TextureCache* cache)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		fs::path name = fs::path(image.filename).filename();
+		name.replace_extension("ktx2");
+		const fs::path ktx = fs::path(image.filename).parent_path() / "ktx" / name;
+
+		ktxTexture2* kTexture;
+		if (ktxTexture2_CreateFromNamedFile(ktx.u8string().c_str(), KTX_TEXTURE_CREATE_NO_FLAGS, &kTexture) == KTX_SUCCESS)
+		{
+			bool ok = true;
+			if (ktxTexture2_NeedsTranscoding(kTexture)) {
+				ktx_texture_transcode_fmt_e tf;
+				image.noTranscodeTarget = !selectKtxTranscodeFormat(kTexture, targets, tf);
+				auto entry = std::make_unique<CachedTexture>();
+				if (!image.noTranscodeTarget && cache && cache->open(ktx, tf, *entry) && entry->getLevelCount() == kTexture->numLevels) {
+					// uploaded straight from the mapping, the levels are one block in the file
+					const uint8_t* first = entry->getLevel(0);
+					const uint8_t* last = entry->getLevel(0) + entry->getLevelSize(0);
+					for (uint32_t level = 0; level < entry->getLevelCount(); ++level) {
+						first = std::min(first, entry->getLevel(level));
+						last = std::max(last, entry->getLevel(level) + entry->getLevelSize(level));
+					}
+					for (uint32_t level = 0; level < entry->getLevelCount(); ++level) {
+						image.levelOffsets.push_back(entry->getLevel(level) - first);
+					}
+					image.format = VkFormat(entry->getFormat());
+					image.extent = { entry->getWidth(), entry->getHeight(), 1 };
+					image.mappedData = first;
+					image.mappedSize = size_t(last - first);
+					image.cached = std::move(entry);
+					ktxTexture_Destroy(ktxTexture(kTexture));
+					image.decodeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+					return;
+				}
+				ok = !image.noTranscodeTarget &&
+					ktxTexture_LoadImageData(ktxTexture(kTexture), nullptr, 0) == KTX_SUCCESS &&
+					ktxTexture2_TranscodeBasis(kTexture, tf, 0) == KTX_SUCCESS;
+				if (ok && cache) {
+					cache->write(ktx, tf, kTexture);
+				}
+			}
+			else {
+				ok = ktxTexture_LoadImageData(ktxTexture(kTexture), nullptr, 0) == KTX_SUCCESS;
+			}
+			if (ok) {
+				image.format = VkFormat(kTexture->vkFormat);
+				image.extent = { kTexture->baseWidth, kTexture->baseHeight, kTexture->baseDepth };
+				for (uint32_t level = 0; level < kTexture->numLevels; ++level) {
+					ktx_size_t offset{};
+					ktxResult res = ktxTexture_GetImageOffset(ktxTexture(kTexture), level, 0, 0, &offset);
+					assert(res == KTX_SUCCESS);
+					image.levelOffsets.push_back(offset);
+				}
+				const uint8_t* data = ktxTexture_GetData(ktxTexture(kTexture));
+				image.data.assign(data, data + ktxTexture_GetDataSize(ktxTexture(kTexture)));
+			}
+			ktxTexture_Destroy(ktxTexture(kTexture));
+		}
+
+		if (image.format == VK_FORMAT_UNDEFINED && !image.noTranscodeTarget)
+		{
+			// only level 0 is in data, the rest is generated after the transfer
+			int w, h, nc;
+			auto* data = stbi_load(image.filename.c_str(), &w, &h, &nc, STBI_rgb_alpha);
+			if (data) {
+				image.format = VK_FORMAT_R8G8B8A8_UNORM;
+				image.extent = { uint32_t(w), uint32_t(h), 1 };
+				image.generateMips = true;
+				image.levelOffsets.push_back(0);
+				image.data.assign(data, data + size_t(w) * h * 4);
+				stbi_image_free(data);
+			}
+		}
+		image.decodeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	bool loadMaterialImages(jsrlib::JobSystem& jobs, const std::vector<std::string>& filenames, const KtxTranscodeTargets& targets,
+		const TextureCache* cache, size_t maxInFlight, const std::function<void(MaterialImage&)>& consume)
+	{
+		maxInFlight = std::max(size_t(1), maxInFlight);
+		std::mutex mutex;
+		std::condition_variable decoded;
+		std::deque<MaterialImage> done;
+		jsrlib::counting_semaphore counter;
+		size_t submitted = 0;
+		for (size_t consumed = 0; consumed < filenames.size(); ++consumed)
+		{
+			for (; submitted < filenames.size() && submitted - consumed < maxInFlight; ++submitted)
+			{
+				jobs.submitJob([&targets, cache, fn = filenames[submitted], &mutex, &decoded, &done](int)
+					{
+						MaterialImage image;
+						image.filename = fn;
+						loadMaterialImage(image, targets, cache);
+						{
+							std::lock_guard<std::mutex> lck(mutex);
+							done.push_back(std::move(image));
+						}
+						decoded.notify_one();
+					}, &counter);
+			}
+
+			std::unique_lock<std::mutex> lck(mutex);
+			decoded.wait(lck, [&done] { return !done.empty(); });
+			MaterialImage image = std::move(done.front());
+			done.pop_front();
+			lck.unlock();
+
+			// the jobs still running use the locals
+			if (image.noTranscodeTarget) {
+				counter.wait();
+				return false;
+			}
+			try {
+				consume(image);
+			}
+			catch (...) {
+				counter.wait();
+				throw;
+			}
+		}
+		counter.wait();
+
+		return true;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "pch.h"
+#include "vkjs/vkjs.h"
+#include "jsrlib/jsr_jobsystem2.h"
+#include "ktx_stream_source.h"
+#include "texture_cache.h"
+
+namespace jsr {
+
+	// a material texture decoded and transcoded on a worker, uploaded on the main thread
+	struct MaterialImage {
+		std::string filename;
+		VkFormat format = VK_FORMAT_UNDEFINED;		// undefined: neither the ktx2 nor the image file could be loaded
+		VkExtent3D extent{};
+		bool generateMips = false;					// data has level 0 only
+		bool noTranscodeTarget = false;
+		std::vector<uint8_t> data;
+		std::vector<VkDeviceSize> levelOffsets;
+		// a texture cache hit is uploaded from the mapping of the entry instead of data
+		std::unique_ptr<CachedTexture> cached;
+		const uint8_t* mappedData = nullptr;
+		size_t mappedSize = 0;
+		float decodeMs = 0.0f;
+	};
+
+	/*
+	Loads ktx/<name>.ktx2 next to the file, transcoded to a format of targets when it is a Basis texture,
+	with a cache the transcoded ones are stored there and mapped from it the next time.
+	Without the ktx2 the file itself is loaded with stb_image as RGBA8, mips to be generated.
+	*/
+	void loadMaterialImage(MaterialImage& image, const KtxTranscodeTargets& targets, const TextureCache* cache);
+
+	/*
+	loadMaterialImage() of every file as jobs, consume() gets the images on the calling thread in the order
+	they finish. At most maxInFlight decoded images wait for it, that bounds their memory.
+	Stops at an image without a transcode target and returns false after the running jobs finished.
+	*/
+	bool loadMaterialImages(jsrlib::JobSystem& jobs, const std::vector<std::string>& filenames, const KtxTranscodeTargets& targets,
+		const TextureCache* cache, size_t maxInFlight, const std::function<void(MaterialImage&)>& consume);
+}
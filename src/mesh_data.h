@@ -4,9 +4,37 @@
 #include "vkjs/vkjs.h"
 
 namespace jsr {
+
+    static const int MAX_MESH_LODS = 5;     // including the full detail indices
+
+    struct MeshLod {
+        std::vector<uint32_t> indices;
+        float error;                        // object space distance from the full detail surface
+    };
     
+    static const uint32_t MESHLET_MAX_VERTICES = 64;
+    static const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+    struct Meshlet {
+        uint32_t vertexOffset;              // in MeshData::meshletVertices
+        uint32_t triangleOffset;            // in MeshData::meshletTriangles
+        uint32_t vertexCount;
+        uint32_t triangleCount;
+        Sphere sphere;
+        Bounds aabb;
+        // every triangle faces away from a camera with dot(normalize(coneApex - camera), coneAxis) > coneCutoff
+        glm::vec3 coneApex;
+        glm::vec3 coneAxis;
+        float coneCutoff;                   // sine of the normal cone half angle, 1: never backfacing
+    };
+
     struct MeshData {
         std::vector<uint32_t>  indices;
+        std::vector<MeshLod>   lods;        // simplified index buffers, lods[0] is LOD 1
+
+        std::vector<Meshlet>   meshlets;    // of the full detail indices
+        std::vector<uint32_t>  meshletVertices;
+        std::vector<uint8_t>   meshletTriangles;   // 3 meshlet local vertex indices per triangle
 
         std::vector<uint8_t> positions;
         std::vector<uint8_t> normals;
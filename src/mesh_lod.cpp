@@ -0,0 +1,335 @@
+#include <queue>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include "mesh_lod.h"
+
+namespace jsr {
+
+	using namespace glm;
+
+	static const float LOD_HYSTERESIS = 0.75f;
+	static const size_t MIN_LOD_TRIANGLES = 32;
+
+	// symmetric 4x4 matrix, upper triangle
+	struct Quadric {
+		double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+		double a11 = 0, a12 = 0, a13 = 0;
+		double a22 = 0, a23 = 0;
+		double a33 = 0;
+
+		void addPlane(const dvec3& n, double d)
+		{
+			a00 += n.x * n.x; a01 += n.x * n.y; a02 += n.x * n.z; a03 += n.x * d;
+			a11 += n.y * n.y; a12 += n.y * n.z; a13 += n.y * d;
+			a22 += n.z * n.z; a23 += n.z * d;
+			a33 += d * d;
+		}
+		void add(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+			a11 += q.a11; a12 += q.a12; a13 += q.a13;
+			a22 += q.a22; a23 += q.a23;
+			a33 += q.a33;
+		}
+		double eval(const dvec3& p) const
+		{
+			const double r = p.x * p.x * a00 + p.y * p.y * a11 + p.z * p.z * a22
+				+ 2.0 * (p.x * p.y * a01 + p.x * p.z * a02 + p.y * p.z * a12)
+				+ 2.0 * (p.x * a03 + p.y * a13 + p.z * a23) + a33;
+			return std::max(0.0, r);
+		}
+	};
+
+	struct Collapse {
+		double cost;
+		uint32_t from, to;
+		uint32_t fromVersion, toVersion;
+		bool operator<(const Collapse& other) const { return cost > other.cost; }
+	};
+
+	// closest point of the triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5)
+	static double distanceToTriangle(const dvec3& p, const dvec3& a, const dvec3& b, const dvec3& c)
+	{
+		const dvec3 ab = b - a, ac = c - a, ap = p - a;
+		const double d1 = dot(ab, ap), d2 = dot(ac, ap);
+		if (d1 <= 0.0 && d2 <= 0.0) return length(ap);
+
+		const dvec3 bp = p - b;
+		const double d3 = dot(ab, bp), d4 = dot(ac, bp);
+		if (d3 >= 0.0 && d4 <= d3) return length(bp);
+
+		const double vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0) return length(p - (a + ab * (d1 / (d1 - d3))));
+
+		const dvec3 cp = p - c;
+		const double d5 = dot(ab, cp), d6 = dot(ac, cp);
+		if (d6 >= 0.0 && d5 <= d6) return length(cp);
+
+		const double vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0) return length(p - (a + ac * (d2 / (d2 - d6))));
+
+		const double va = d3 * d6 - d5 * d4;
+		if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0) return length(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+
+		const double denom = va + vb + vc;
+		if (denom <= 0.0) return std::min(length(ap), std::min(length(bp), length(cp)));
+		return length(p - (a + ab * (vb / denom) + ac * (vc / denom)));
+	}
+
+	std::vector<uint32_t> simplifyMesh(const float* positions, size_t vertexCount, const std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError, float* resultError)
+	{
+		const size_t triCount = indices.size() / 3;
+		auto pos = [positions](uint32_t v) { return dvec3(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]); };
+
+		std::vector<uint32_t> tris(indices.begin(), indices.begin() + triCount * 3);
+		std::vector<bool> triRemoved(triCount, false);
+		std::vector<std::vector<uint32_t>> vertexTris(vertexCount);
+		std::vector<Quadric> quadrics(vertexCount);
+		std::vector<uint32_t> version(vertexCount, 0);
+		std::vector<bool> locked(vertexCount, false);
+		std::vector<bool> removed(vertexCount, false);
+		std::vector<uint32_t> collapsedInto(vertexCount);
+		std::iota(collapsedInto.begin(), collapsedInto.end(), 0u);
+
+		// vertices sharing a position (uv/normal seams) can not collapse independently
+		{
+			std::vector<uint32_t> order(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; ++v) order[v] = v;
+			auto less = [positions](uint32_t a, uint32_t b) { return memcmp(&positions[a * 3], &positions[b * 3], 3 * sizeof(float)) < 0; };
+			std::sort(order.begin(), order.end(), less);
+			for (size_t i = 1; i < order.size(); ++i)
+			{
+				if (!less(order[i - 1], order[i])) {
+					locked[order[i - 1]] = true;
+					locked[order[i]] = true;
+				}
+			}
+		}
+
+		// border edges: edges used by a single triangle
+		{
+			std::unordered_map<uint64_t, int> edgeUse;
+			for (size_t t = 0; t < triCount; ++t)
+			{
+				for (int e = 0; e < 3; ++e)
+				{
+					const uint32_t a = tris[t * 3 + e], b = tris[t * 3 + (e + 1) % 3];
+					const uint64_t key = (uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+					edgeUse[key]++;
+				}
+			}
+			for (const auto& it : edgeUse)
+			{
+				if (it.second == 1) {
+					locked[uint32_t(it.first >> 32)] = true;
+					locked[uint32_t(it.first & 0xFFFFFFFFull)] = true;
+				}
+			}
+		}
+
+		for (uint32_t t = 0; t < triCount; ++t)
+		{
+			const uint32_t* v = &tris[t * 3];
+			const dvec3 p0 = pos(v[0]), p1 = pos(v[1]), p2 = pos(v[2]);
+			dvec3 n = cross(p1 - p0, p2 - p0);
+			const double len = length(n);
+			if (len > 0.0) {
+				n /= len;
+				Quadric q;
+				q.addPlane(n, -dot(n, p0));
+				for (int i = 0; i < 3; ++i) quadrics[v[i]].add(q);
+			}
+			for (int i = 0; i < 3; ++i) vertexTris[v[i]].push_back(t);
+		}
+
+		std::priority_queue<Collapse> heap;
+
+		auto pushEdge = [&](uint32_t a, uint32_t b)
+		{
+			Quadric q = quadrics[a];
+			q.add(quadrics[b]);
+			if (!locked[a]) heap.push({ q.eval(pos(b)), a, b, version[a], version[b] });
+			if (!locked[b]) heap.push({ q.eval(pos(a)), b, a, version[b], version[a] });
+		};
+
+		for (size_t t = 0; t < triCount; ++t)
+		{
+			for (int e = 0; e < 3; ++e)
+			{
+				const uint32_t a = tris[t * 3 + e], b = tris[t * 3 + (e + 1) % 3];
+				if (a < b) pushEdge(a, b);
+			}
+		}
+
+		size_t liveTris = triCount;
+		const double maxCost = double(maxError) * double(maxError);
+
+		while (!heap.empty() && liveTris * 3 > targetIndexCount)
+		{
+			const Collapse c = heap.top();
+			heap.pop();
+
+			if (removed[c.from] || removed[c.to] || version[c.from] != c.fromVersion || version[c.to] != c.toVersion) {
+				continue;
+			}
+			if (c.cost > maxCost) {
+				break;
+			}
+
+			// reject the collapse if any remaining triangle would flip
+			const dvec3 target = pos(c.to);
+			bool flips = false;
+			for (const uint32_t t : vertexTris[c.from])
+			{
+				if (triRemoved[t]) continue;
+				const uint32_t* v = &tris[t * 3];
+				if (v[0] == c.to || v[1] == c.to || v[2] == c.to) continue;
+
+				dvec3 p[3], q[3];
+				for (int i = 0; i < 3; ++i) {
+					p[i] = pos(v[i]);
+					q[i] = v[i] == c.from ? target : p[i];
+				}
+				const dvec3 n0 = cross(p[1] - p[0], p[2] - p[0]);
+				const dvec3 n1 = cross(q[1] - q[0], q[2] - q[0]);
+				if (dot(n0, n1) <= 0.0) {
+					flips = true;
+					break;
+				}
+			}
+			if (flips) {
+				continue;
+			}
+
+			for (const uint32_t t : vertexTris[c.from])
+			{
+				if (triRemoved[t]) continue;
+				uint32_t* v = &tris[t * 3];
+				if (v[0] == c.to || v[1] == c.to || v[2] == c.to) {
+					triRemoved[t] = true;
+					--liveTris;
+					continue;
+				}
+				for (int i = 0; i < 3; ++i) {
+					if (v[i] == c.from) v[i] = c.to;
+				}
+				vertexTris[c.to].push_back(t);
+			}
+			vertexTris[c.from].clear();
+			removed[c.from] = true;
+			collapsedInto[c.from] = c.to;
+			quadrics[c.to].add(quadrics[c.from]);
+			version[c.to]++;
+
+			for (const uint32_t t : vertexTris[c.to])
+			{
+				if (triRemoved[t]) continue;
+				for (int i = 0; i < 3; ++i) {
+					const uint32_t w = tris[t * 3 + i];
+					if (w != c.to) pushEdge(c.to, w);
+				}
+			}
+		}
+
+		std::vector<uint32_t> result;
+		result.reserve(liveTris * 3);
+		for (size_t t = 0; t < triCount; ++t)
+		{
+			if (triRemoved[t]) continue;
+			result.insert(result.end(), &tris[t * 3], &tris[t * 3] + 3);
+		}
+
+		if (resultError)
+		{
+			// the quadric cost sums the squared distances to every merged plane and grows with them, the error is
+			// measured instead: every removed vertex against the triangles left within two rings of the one it went to
+			std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+			for (size_t i = 0; i < result.size(); ++i) adjacencyOffset[result[i] + 1]++;
+			for (size_t v = 0; v < vertexCount; ++v) adjacencyOffset[v + 1] += adjacencyOffset[v];
+			std::vector<uint32_t> adjacency(adjacencyOffset.back());
+			{
+				std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+				for (size_t i = 0; i < result.size(); ++i) adjacency[fill[result[i]]++] = uint32_t(i / 3);
+			}
+			auto corner = [&](uint32_t t, int k) { return pos(result[t * 3 + k]); };
+			// the last vertex that tested a triangle, the rings share most of them
+			std::vector<uint32_t> tested(result.size() / 3, ~0u);
+
+			double worst = 0.0;
+			for (uint32_t v = 0; v < vertexCount; ++v)
+			{
+				if (!removed[v]) continue;
+				uint32_t to = collapsedInto[v];
+				while (collapsedInto[to] != to) to = collapsedInto[to];
+
+				const dvec3 p = pos(v);
+				double nearest = std::numeric_limits<double>::max();
+				for (uint32_t a = adjacencyOffset[to]; a < adjacencyOffset[to + 1]; ++a)
+				{
+					for (int k = 0; k < 3; ++k)
+					{
+						const uint32_t w = result[adjacency[a] * 3 + k];
+						for (uint32_t b = adjacencyOffset[w]; b < adjacencyOffset[w + 1]; ++b)
+						{
+							const uint32_t t = adjacency[b];
+							if (tested[t] == v) continue;
+							tested[t] = v;
+							nearest = std::min(nearest, distanceToTriangle(p, corner(t, 0), corner(t, 1), corner(t, 2)));
+						}
+					}
+				}
+				if (nearest < std::numeric_limits<double>::max()) worst = std::max(worst, nearest);
+			}
+			*resultError = float(worst);
+		}
+
+		return result;
+	}
+
+	void generateMeshLods(MeshData& mesh)
+	{
+		mesh.lods.clear();
+
+		const float* positions = reinterpret_cast<const float*>(mesh.positions.data());
+		const size_t vertexCount = mesh.positions.size() / (3 * sizeof(float));
+		size_t prevCount = mesh.indices.size();
+		float prevError = 0.0f;
+
+		for (int lod = 1; lod < MAX_MESH_LODS; ++lod)
+		{
+			const size_t target = (prevCount / 2) / 3 * 3;
+			if (target < MIN_LOD_TRIANGLES * 3) {
+				break;
+			}
+
+			float error = 0.0f;
+			std::vector<uint32_t> lodIndices = simplifyMesh(positions, vertexCount, mesh.indices, target, std::numeric_limits<float>::max(), &error);
+
+			// locked borders/seams stop the simplification, no point in keeping almost identical levels
+			if (lodIndices.size() > prevCount * 9 / 10) {
+				break;
+			}
+
+			prevCount = lodIndices.size();
+			prevError = std::max(prevError, error);
+			mesh.lods.push_back({ std::move(lodIndices), prevError });
+		}
+	}
+
+	int selectMeshLod(const MeshData& mesh, float pixelsPerUnit, float errorBudget, int currentLod)
+	{
+		int lod = 0;
+		for (int i = 0; i < (int)mesh.lods.size(); ++i)
+		{
+			const float pixels = mesh.lods[i].error * pixelsPerUnit;
+			const float limit = (i + 1 > currentLod) ? errorBudget * LOD_HYSTERESIS : errorBudget;
+			if (pixels > limit) {
+				break;
+			}
+			lod = i + 1;
+		}
+
+		return lod;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "pch.h"
+#include "mesh_data.h"
+
+namespace jsr {
+
+	/*
+	Quadric error metric edge collapse simplification (Garland-Heckbert).
+	Vertices are not moved or created, edges collapse into one of their endpoints,
+	so the result indexes the original vertex buffer. Border and seam vertices are locked.
+	maxError limits the quadric error of a collapse. Returns the simplified index list, resultError receives
+	the largest object space distance of a removed vertex to the simplified triangles.
+	*/
+	std::vector<uint32_t> simplifyMesh(
+		const float* positions,
+		size_t vertexCount,
+		const std::vector<uint32_t>& indices,
+		size_t targetIndexCount,
+		float maxError,
+		float* resultError);
+
+	// fills mesh.lods with halving triangle counts
+	void generateMeshLods(MeshData& mesh);
+
+	/*
+	Picks the coarsest LOD whose error projected to the screen is within errorBudget (pixels).
+	pixelsPerUnit: object space unit projected to pixels at the object's distance.
+	Going coarser needs extra margin to avoid popping between two levels.
+	*/
+	int selectMeshLod(const MeshData& mesh, float pixelsPerUnit, float errorBudget, int currentLod);
+}
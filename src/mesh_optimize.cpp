@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include "mesh_optimize.h"
+#include <glm/gtc/type_ptr.hpp>
+
+namespace jsr {
+
+	using namespace glm;
+
+	// FIFO cache of vertex indices, a vertex is in the cache while less than cacheSize misses happened since its own
+	class FifoCache
+	{
+	public:
+		FifoCache(size_t vertexCount, uint32_t cacheSize) : m_timestamps(vertexCount, 0), m_cacheSize(cacheSize) {}
+
+		// true on a miss
+		bool access(uint32_t v)
+		{
+			if (m_timestamps[v] != 0 && m_time - m_timestamps[v] < m_cacheSize) {
+				return false;
+			}
+			m_timestamps[v] = ++m_time;
+			return true;
+		}
+		void clear()
+		{
+			// older than any cached entry
+			m_time += m_cacheSize;
+		}
+	private:
+		std::vector<size_t> m_timestamps;
+		size_t m_time = 0;
+		uint32_t m_cacheSize;
+	};
+
+	VertexCacheStats& VertexCacheStats::operator+=(const VertexCacheStats& other)
+	{
+		transformed += other.transformed;
+		triangles += other.triangles;
+		vertices += other.vertices;
+		return *this;
+	}
+
+	VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+	{
+		VertexCacheStats result;
+		result.triangles = indices.size() / 3;
+		result.vertices = vertexCount;
+
+		FifoCache cache(vertexCount, cacheSize);
+		for (const uint32_t v : indices) {
+			result.transformed += cache.access(v) ? 1 : 0;
+		}
+
+		return result;
+	}
+
+	std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize, std::vector<uint32_t>* hardBoundaries)
+	{
+		const size_t triCount = indices.size() / 3;
+		std::vector<uint32_t> result;
+		result.reserve(triCount * 3);
+		if (hardBoundaries) hardBoundaries->clear();
+		if (triCount == 0) return result;
+
+		// vertex -> triangles adjacency, live triangle count per vertex
+		std::vector<uint32_t> live(vertexCount, 0);
+		for (size_t i = 0; i < triCount * 3; ++i) {
+			++live[indices[i]];
+		}
+		std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; ++v) {
+			adjacencyOffset[v + 1] = adjacencyOffset[v] + live[v];
+		}
+		std::vector<uint32_t> adjacency(adjacencyOffset.back());
+		{
+			std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+			for (size_t i = 0; i < triCount * 3; ++i) {
+				adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+			}
+		}
+
+		std::vector<size_t> cacheTime(vertexCount, 0);
+		std::vector<bool> emitted(triCount, false);
+		std::vector<uint32_t> deadEnd;
+		std::vector<uint32_t> candidates;
+		size_t time = cacheSize + 1;
+		size_t cursor = 0;
+
+		auto inCache = [&](uint32_t v) { return time - cacheTime[v] <= cacheSize; };
+
+		int64_t fan = indices[0];
+		while (fan >= 0)
+		{
+			candidates.clear();
+			const uint32_t f = uint32_t(fan);
+			for (uint32_t a = adjacencyOffset[f]; a < adjacencyOffset[f + 1]; ++a)
+			{
+				const uint32_t t = adjacency[a];
+				if (emitted[t]) continue;
+				emitted[t] = true;
+
+				for (int k = 0; k < 3; ++k)
+				{
+					const uint32_t v = indices[t * 3 + k];
+					result.push_back(v);
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					--live[v];
+					if (!inCache(v)) {
+						cacheTime[v] = time++;
+					}
+				}
+			}
+
+			// the candidate that stays in the cache the longest after its remaining fans
+			int64_t next = -1;
+			size_t bestPriority = 0;
+			for (const uint32_t v : candidates)
+			{
+				if (live[v] == 0) continue;
+
+				size_t priority = 0;
+				if (time - cacheTime[v] + 2 * size_t(live[v]) <= cacheSize) {
+					priority = time - cacheTime[v];
+				}
+				if (next < 0 || priority > bestPriority) {
+					bestPriority = priority;
+					next = v;
+				}
+			}
+
+			if (next < 0)
+			{
+				// dead end: recently used vertices first, then the next one in input order
+				while (!deadEnd.empty() && next < 0)
+				{
+					const uint32_t v = deadEnd.back();
+					deadEnd.pop_back();
+					if (live[v] > 0) next = v;
+				}
+				while (next < 0 && cursor < vertexCount)
+				{
+					if (live[cursor] > 0) next = int64_t(cursor);
+					++cursor;
+				}
+				if (next >= 0 && hardBoundaries && !inCache(uint32_t(next))) {
+					hardBoundaries->push_back(uint32_t(result.size()));
+				}
+			}
+			fan = next;
+		}
+
+		return result;
+	}
+
+	void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<uint32_t>& hardBoundaries, const float* positions, size_t vertexCount, uint32_t cacheSize, float threshold)
+	{
+		const size_t triCount = indices.size() / 3;
+		if (triCount == 0) return;
+
+		// cluster starts in triangles, soft boundaries where a cold cache costs little more than the warm one
+		std::vector<uint32_t> clusters = { 0 };
+		{
+			FifoCache warm(vertexCount, cacheSize);
+			FifoCache cold(vertexCount, cacheSize);
+			size_t hard = 0;
+			size_t warmMisses = 0, coldMisses = 0;
+			for (size_t t = 0; t < triCount; ++t)
+			{
+				while (hard < hardBoundaries.size() && hardBoundaries[hard] < t * 3) ++hard;
+				const bool hardStart = hard < hardBoundaries.size() && hardBoundaries[hard] == t * 3;
+				const bool softStart = t - clusters.back() >= cacheSize && float(coldMisses) <= threshold * float(warmMisses);
+				if (t > clusters.back() && (hardStart || softStart))
+				{
+					clusters.push_back(uint32_t(t));
+					cold.clear();
+					warmMisses = coldMisses = 0;
+				}
+				for (int k = 0; k < 3; ++k)
+				{
+					warmMisses += warm.access(indices[t * 3 + k]) ? 1 : 0;
+					coldMisses += cold.access(indices[t * 3 + k]) ? 1 : 0;
+				}
+			}
+		}
+		clusters.push_back(uint32_t(triCount));
+		const size_t clusterCount = clusters.size() - 1;
+
+		auto pos = [positions](uint32_t v) { return make_vec3(&positions[v * 3]); };
+
+		// area weighted centroid and normal of every cluster
+		std::vector<vec3> centroids(clusterCount);
+		std::vector<vec3> normals(clusterCount);
+		vec3 meshCentroid(0.0f);
+		float meshArea = 0.0f;
+		for (size_t c = 0; c < clusterCount; ++c)
+		{
+			vec3 centroid(0.0f), normal(0.0f);
+			float area = 0.0f;
+			for (uint32_t t = clusters[c]; t < clusters[c + 1]; ++t)
+			{
+				const vec3 p0 = pos(indices[t * 3]), p1 = pos(indices[t * 3 + 1]), p2 = pos(indices[t * 3 + 2]);
+				const vec3 n = cross(p1 - p0, p2 - p0);
+				const float a = length(n);
+				centroid += (p0 + p1 + p2) * (a / 3.0f);
+				normal += n;
+				area += a;
+			}
+			meshCentroid += centroid;
+			meshArea += area;
+			centroids[c] = area > 0.0f ? centroid / area : pos(indices[clusters[c] * 3]);
+			normals[c] = length(normal) > 0.0f ? normalize(normal) : vec3(0.0f);
+		}
+		meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : vec3(0.0f);
+
+		std::vector<float> sortKey(clusterCount);
+		for (size_t c = 0; c < clusterCount; ++c) {
+			sortKey[c] = dot(centroids[c] - meshCentroid, normals[c]);
+		}
+		std::vector<uint32_t> order(clusterCount);
+		std::iota(order.begin(), order.end(), 0u);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKey[a] > sortKey[b]; });
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+		for (const uint32_t c : order) {
+			result.insert(result.end(), indices.begin() + size_t(clusters[c]) * 3, indices.begin() + size_t(clusters[c + 1]) * 3);
+		}
+		// a partial triangle at the end is kept as is
+		result.insert(result.end(), indices.begin() + triCount * 3, indices.end());
+		indices = std::move(result);
+	}
+
+	std::vector<uint32_t> optimizeVertexFetchRemap(const std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		std::vector<uint32_t> remap(vertexCount, ~0u);
+		uint32_t next = 0;
+		for (const uint32_t v : indices)
+		{
+			if (remap[v] == ~0u) remap[v] = next++;
+		}
+		for (auto& r : remap)
+		{
+			if (r == ~0u) r = next++;
+		}
+
+		return remap;
+	}
+
+	static void remapStream(std::vector<uint8_t>& stream, const std::vector<uint32_t>& remap, size_t stride)
+	{
+		if (stream.size() != remap.size() * stride) return;
+
+		std::vector<uint8_t> result(stream.size());
+		for (size_t v = 0; v < remap.size(); ++v) {
+			memcpy(&result[remap[v] * stride], &stream[v * stride], stride);
+		}
+		stream = std::move(result);
+	}
+
+	void optimizeMesh(MeshData& mesh, VertexCacheStats* before, VertexCacheStats* after)
+	{
+		const size_t vertexCount = mesh.positions.size() / (3 * sizeof(float));
+		if (before) *before = analyzeVertexCache(mesh.indices, vertexCount);
+
+		std::vector<uint32_t> hardBoundaries;
+		mesh.indices = optimizeVertexCache(mesh.indices, vertexCount, VERTEX_CACHE_SIZE, &hardBoundaries);
+		optimizeOverdraw(mesh.indices, hardBoundaries, reinterpret_cast<const float*>(mesh.positions.data()), vertexCount);
+		for (auto& lod : mesh.lods) {
+			lod.indices = optimizeVertexCache(lod.indices, vertexCount);
+		}
+
+		// LOD vertices are a subset of the full detail ones
+		const std::vector<uint32_t> remap = optimizeVertexFetchRemap(mesh.indices, vertexCount);
+		remapStream(mesh.positions, remap, 3 * sizeof(float));
+		remapStream(mesh.normals, remap, 3 * sizeof(float));
+		remapStream(mesh.tangents, remap, 4 * sizeof(float));
+		remapStream(mesh.uvs, remap, 2 * sizeof(float));
+		for (auto& index : mesh.indices) {
+			index = remap[index];
+		}
+		for (auto& lod : mesh.lods) {
+			for (auto& index : lod.indices) {
+				index = remap[index];
+			}
+		}
+
+		if (after) *after = analyzeVertexCache(mesh.indices, vertexCount);
+	}
+}
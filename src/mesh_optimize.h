@@ -0,0 +1,45 @@
+#pragma once
+
+#include "pch.h"
+#include "mesh_data.h"
+
+namespace jsr {
+
+	static const uint32_t VERTEX_CACHE_SIZE = 16;
+
+	struct VertexCacheStats {
+		size_t transformed = 0;		// cache misses of a FIFO post-transform cache
+		size_t triangles = 0;
+		size_t vertices = 0;
+		// average cache miss ratio: transformed / triangles, 0.5 at best, 3 at worst
+		float acmr() const { return triangles ? float(transformed) / float(triangles) : 0.0f; }
+		// average transform to vertex ratio: transformed / vertices, 1 at best
+		float atvr() const { return vertices ? float(transformed) / float(vertices) : 0.0f; }
+		VertexCacheStats& operator+=(const VertexCacheStats& other);
+	};
+
+	VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+	/*
+	Tipsify (Sander, Nehab, Barczak: Fast Triangle Reordering for Vertex Locality and Reduced Overdraw, 2007).
+	Fans around the vertex that stays in the cache the longest, linear in the triangle count.
+	hardBoundaries receives the index offsets where the walk had to jump to a vertex out of the cache.
+	*/
+	std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE, std::vector<uint32_t>* hardBoundaries = nullptr);
+
+	/*
+	Splits the cache optimized triangles into clusters at the hard boundaries and where restarting with a cold
+	cache costs at most threshold times the misses of the original order, then sorts the clusters
+	outward facing first, so they occlude the rest. The triangle order inside a cluster is kept.
+	*/
+	void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<uint32_t>& hardBoundaries, const float* positions, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE, float threshold = 1.05f);
+
+	// the vertex order of first use in indices, unused vertices go last: remap[old] = new
+	std::vector<uint32_t> optimizeVertexFetchRemap(const std::vector<uint32_t>& indices, size_t vertexCount);
+
+	/*
+	Vertex cache and overdraw order of the full detail indices, vertex cache order of the LODs,
+	then the vertex streams in first use order. The stats are of the full detail indices.
+	*/
+	void optimizeMesh(MeshData& mesh, VertexCacheStats* before = nullptr, VertexCacheStats* after = nullptr);
+}
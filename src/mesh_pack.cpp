@@ -0,0 +1,147 @@
+#include <atomic>
+#include <cassert>
+#include "mesh_pack.h"
+
+namespace jsr {
+
+	static size_t getVertexCount(const MeshData& mesh)
+	{
+		return mesh.positions.size() / (3 * sizeof(float));
+	}
+
+	template<class T>
+	static bool packIndices(const std::vector<uint32_t>& indices, size_t vertexCount, T* dst)
+	{
+		bool ok = true;
+		for (size_t k = 0; k < indices.size(); ++k)
+		{
+			ok = ok && indices[k] < vertexCount;
+			dst[k] = static_cast<T>(indices[k]);
+		}
+		return ok;
+	}
+
+	static bool packMesh(const MeshData& mesh, const PackedMesh& packed, VertexFormat format, uint32_t indexSize, uint8_t* vertices, uint8_t* indices)
+	{
+		const glm::vec4 one(1.0f);
+		const size_t numVerts = getVertexCount(mesh);
+		if (format == VERTEX_FORMAT_COMPACT)
+		{
+			VertexCompact* dst = reinterpret_cast<VertexCompact*>(vertices) + packed.firstVertex;
+			for (size_t v = 0; v < numVerts; ++v)
+			{
+				dst[v].set_position((const float*)&mesh.positions[v * 3 * sizeof(float)], mesh.aabb);
+				dst[v].set_uv((const float*)&mesh.uvs[v * 2 * sizeof(float)]);
+				dst[v].pack_normal((const float*)&mesh.normals[v * 3 * sizeof(float)]);
+				dst[v].pack_tangent((const float*)&mesh.tangents[v * 4 * sizeof(float)]);
+			}
+		}
+		else
+		{
+			Vertex* dst = reinterpret_cast<Vertex*>(vertices) + packed.firstVertex;
+			for (size_t v = 0; v < numVerts; ++v)
+			{
+				dst[v].set_position((const float*)&mesh.positions[v * 3 * sizeof(float)]);
+				dst[v].set_uv((const float*)&mesh.uvs[v * 2 * sizeof(float)]);
+				dst[v].pack_normal((const float*)&mesh.normals[v * 3 * sizeof(float)]);
+				dst[v].pack_tangent((const float*)&mesh.tangents[v * 4 * sizeof(float)]);
+				dst[v].pack_color(&one[0]);
+			}
+		}
+
+		// an index past 16 bits would wrap to another vertex of the buffer
+		const size_t maxVertices = indexSize == sizeof(uint16_t) ? std::min(numVerts, MAX_PACKED_VERTICES_UINT16) : numVerts;
+		bool ok = true;
+		for (uint32_t l = 0; l < packed.lodCount; ++l)
+		{
+			const std::vector<uint32_t>& src = l == 0 ? mesh.indices : mesh.lods[l - 1].indices;
+			uint8_t* dst = indices + size_t(packed.lods[l].firstIndex) * indexSize;
+			if (indexSize == sizeof(uint16_t)) {
+				ok = packIndices(src, maxVertices, reinterpret_cast<uint16_t*>(dst)) && ok;
+			}
+			else {
+				ok = packIndices(src, maxVertices, reinterpret_cast<uint32_t*>(dst)) && ok;
+			}
+		}
+		return ok;
+	}
+
+	uint32_t getPackedIndexSize(const std::vector<MeshData>& meshes)
+	{
+		for (const auto& mesh : meshes)
+		{
+			if (getVertexCount(mesh) > MAX_PACKED_VERTICES_UINT16) {
+				return sizeof(uint32_t);
+			}
+		}
+		return sizeof(uint16_t);
+	}
+
+	void layoutPackedMeshes(const std::vector<MeshData>& meshes, std::vector<PackedMesh>& packed, uint32_t& vertexCount, uint32_t& indexCount)
+	{
+		vertexCount = 0;
+		indexCount = 0;
+		packed.resize(meshes.size());
+		for (size_t i = 0; i < meshes.size(); ++i)
+		{
+			const MeshData& mesh = meshes[i];
+			PackedMesh& pm = packed[i];
+			pm.firstVertex = vertexCount;
+			pm.vertexCount = uint32_t(getVertexCount(mesh));
+			vertexCount += pm.vertexCount;
+
+			pm.lodCount = 1;
+			pm.lods[0] = { indexCount, uint32_t(mesh.indices.size()) };
+			indexCount += pm.lods[0].indexCount;
+			for (const auto& lod : mesh.lods)
+			{
+				if (pm.lodCount == uint32_t(MAX_MESH_LODS)) break;
+				pm.lods[pm.lodCount++] = { indexCount, uint32_t(lod.indices.size()) };
+				indexCount += uint32_t(lod.indices.size());
+			}
+		}
+	}
+
+	bool packMeshes(const std::vector<MeshData>& meshes, const std::vector<PackedMesh>& packed, VertexFormat format, uint32_t indexSize,
+		std::vector<uint8_t>& vertices, std::vector<uint8_t>& indices, jsrlib::JobSystem* jobs)
+	{
+		assert(meshes.size() == packed.size());
+		assert(indexSize == sizeof(uint16_t) || indexSize == sizeof(uint32_t));
+		const size_t vertexStride = format == VERTEX_FORMAT_COMPACT ? sizeof(VertexCompact) : sizeof(Vertex);
+		size_t vertexCount = 0, indexCount = 0;
+		for (const PackedMesh& pm : packed)
+		{
+			vertexCount = std::max(vertexCount, size_t(pm.firstVertex) + pm.vertexCount);
+			for (uint32_t l = 0; l < pm.lodCount; ++l) {
+				indexCount = std::max(indexCount, size_t(pm.lods[l].firstIndex) + pm.lods[l].indexCount);
+			}
+		}
+		vertices.assign(vertexCount * vertexStride, 0);
+		indices.assign(indexCount * indexSize, 0);
+
+		if (!jobs)
+		{
+			bool ok = true;
+			for (size_t i = 0; i < meshes.size(); ++i) {
+				ok = packMesh(meshes[i], packed[i], format, indexSize, vertices.data(), indices.data()) && ok;
+			}
+			return ok;
+		}
+
+		// every job writes only the ranges of its mesh
+		std::atomic<bool> ok{ true };
+		jsrlib::counting_semaphore counter;
+		for (size_t i = 0; i < meshes.size(); ++i)
+		{
+			jobs->submitJob([&meshes, &packed, &vertices, &indices, &ok, format, indexSize, i](int)
+				{
+					if (!packMesh(meshes[i], packed[i], format, indexSize, vertices.data(), indices.data())) {
+						ok = false;
+					}
+				}, &counter);
+		}
+		counter.wait();
+
+		return ok;
+	}
+}
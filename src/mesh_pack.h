@@ -0,0 +1,42 @@
+#pragma once
+
+#include "pch.h"
+#include "mesh_data.h"
+#include "vertex.h"
+#include "jsrlib/jsr_jobsystem2.h"
+
+namespace jsr {
+
+	struct PackedIndexRange {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	// a mesh in the scene vertex and index buffers, its indices are relative to firstVertex
+	struct PackedMesh {
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+		uint32_t lodCount;
+		PackedIndexRange lods[MAX_MESH_LODS];	// lods[0] is the full detail mesh
+	};
+
+	// 16 bit indices reach 0x10000 vertices from the first vertex of a mesh
+	static const size_t MAX_PACKED_VERTICES_UINT16 = 0x10000;
+
+	// 2 while every mesh fits 16 bit indices, 4 otherwise
+	uint32_t getPackedIndexSize(const std::vector<MeshData>& meshes);
+
+	/*
+	The ranges of every mesh in the scene buffers, the meshes one after the other with the LOD indices
+	after the full detail ones. vertexCount and indexCount receive the totals.
+	*/
+	void layoutPackedMeshes(const std::vector<MeshData>& meshes, std::vector<PackedMesh>& packed, uint32_t& vertexCount, uint32_t& indexCount);
+
+	/*
+	Writes the vertices of every mesh in format and its indices as indexSize bytes each at the ranges of
+	layoutPackedMeshes(). The buffers are resized to hold them. A job per mesh with jobs, the output is the same.
+	False if an index does not fit indexSize, the buffers are not complete then.
+	*/
+	bool packMeshes(const std::vector<MeshData>& meshes, const std::vector<PackedMesh>& packed, VertexFormat format, uint32_t indexSize,
+		std::vector<uint8_t>& vertices, std::vector<uint8_t>& indices, jsrlib::JobSystem* jobs = nullptr);
+}
@@ -0,0 +1,173 @@
+#include <cstring>
+#include <numeric>
+#include "mesh_tangents.h"
+#include <mikktspace.h>
+#include <weldmesh.h>
+
+namespace jsr {
+
+	// indexed input, unindexed tangents: 4 floats for every face corner
+	struct MikkMesh {
+		const float* positions;
+		const float* normals;
+		const float* uvs;
+		const uint32_t* indices;
+		int faceCount;
+		float* tangents;
+	};
+
+	static const MikkMesh& getMikkMesh(const SMikkTSpaceContext* context)
+	{
+		return *static_cast<const MikkMesh*>(context->m_pUserData);
+	}
+
+	static int getNumFaces(const SMikkTSpaceContext* context)
+	{
+		return getMikkMesh(context).faceCount;
+	}
+
+	static int getNumVerticesOfFace(const SMikkTSpaceContext*, const int)
+	{
+		return 3;
+	}
+
+	static void getPosition(const SMikkTSpaceContext* context, float out[], const int face, const int vert)
+	{
+		const MikkMesh& m = getMikkMesh(context);
+		memcpy(out, &m.positions[m.indices[face * 3 + vert] * 3], 3 * sizeof(float));
+	}
+
+	static void getNormal(const SMikkTSpaceContext* context, float out[], const int face, const int vert)
+	{
+		const MikkMesh& m = getMikkMesh(context);
+		memcpy(out, &m.normals[m.indices[face * 3 + vert] * 3], 3 * sizeof(float));
+	}
+
+	static void getTexCoord(const SMikkTSpaceContext* context, float out[], const int face, const int vert)
+	{
+		const MikkMesh& m = getMikkMesh(context);
+		memcpy(out, &m.uvs[m.indices[face * 3 + vert] * 2], 2 * sizeof(float));
+	}
+
+	static void setTSpaceBasic(const SMikkTSpaceContext* context, const float tangent[], const float sign, const int face, const int vert)
+	{
+		float* out = &getMikkMesh(context).tangents[(face * 3 + vert) * 4];
+		memcpy(out, tangent, 3 * sizeof(float));
+		out[3] = sign;
+	}
+
+	static void unindexStream(std::vector<uint8_t>& stream, const std::vector<uint32_t>& indices, size_t stride)
+	{
+		std::vector<uint8_t> result(indices.size() * stride);
+		for (size_t i = 0; i < indices.size(); ++i) {
+			memcpy(&result[i * stride], &stream[indices[i] * stride], stride);
+		}
+		stream = std::move(result);
+	}
+
+	bool generateMeshTangents(MeshData& mesh)
+	{
+		const size_t vertexCount = mesh.positions.size() / (3 * sizeof(float));
+		if (mesh.normals.size() != vertexCount * 3 * sizeof(float) || mesh.uvs.size() != vertexCount * 2 * sizeof(float)) {
+			return false;
+		}
+		if (mesh.indices.empty())
+		{
+			mesh.indices.resize(vertexCount);
+			std::iota(mesh.indices.begin(), mesh.indices.end(), 0u);
+		}
+		mesh.indices.resize(mesh.indices.size() / 3 * 3);
+
+		std::vector<uint8_t> tangents(mesh.indices.size() * 4 * sizeof(float));
+		MikkMesh m{
+			reinterpret_cast<const float*>(mesh.positions.data()),
+			reinterpret_cast<const float*>(mesh.normals.data()),
+			reinterpret_cast<const float*>(mesh.uvs.data()),
+			mesh.indices.data(),
+			int(mesh.indices.size() / 3),
+			reinterpret_cast<float*>(tangents.data()) };
+
+		SMikkTSpaceInterface callbacks{};
+		callbacks.m_getNumFaces = getNumFaces;
+		callbacks.m_getNumVerticesOfFace = getNumVerticesOfFace;
+		callbacks.m_getPosition = getPosition;
+		callbacks.m_getNormal = getNormal;
+		callbacks.m_getTexCoord = getTexCoord;
+		callbacks.m_setTSpaceBasic = setTSpaceBasic;
+		const SMikkTSpaceContext context{ &callbacks, &m };
+		if (!genTangSpaceDefault(&context)) {
+			return false;
+		}
+
+		unindexStream(mesh.positions, mesh.indices, 3 * sizeof(float));
+		unindexStream(mesh.normals, mesh.indices, 3 * sizeof(float));
+		unindexStream(mesh.uvs, mesh.indices, 2 * sizeof(float));
+		mesh.tangents = std::move(tangents);
+		std::iota(mesh.indices.begin(), mesh.indices.end(), 0u);
+
+		return true;
+	}
+
+	size_t weldMeshVertices(MeshData& mesh)
+	{
+		const size_t vertexCount = mesh.positions.size() / (3 * sizeof(float));
+		if (vertexCount == 0 || mesh.positions.size() != vertexCount * 3 * sizeof(float)) return 0;
+
+		// the present streams are interleaved, Welder compares whole vertices
+		struct Stream {
+			std::vector<uint8_t>* data;
+			size_t floats;
+		};
+		std::vector<Stream> streams;
+		size_t stride = 0;
+		for (const Stream s : { Stream{ &mesh.positions, 3 }, Stream{ &mesh.normals, 3 }, Stream{ &mesh.tangents, 4 }, Stream{ &mesh.uvs, 2 } })
+		{
+			if (s.data->empty()) continue;
+			// welding the others would leave this one indexed by the old vertices
+			if (s.data->size() != vertexCount * s.floats * sizeof(float)) return 0;
+			streams.push_back(s);
+			stride += s.floats;
+		}
+
+		for (const uint32_t index : mesh.indices) {
+			if (index >= vertexCount) return 0;
+		}
+		if (mesh.indices.empty())
+		{
+			mesh.indices.resize(vertexCount);
+			std::iota(mesh.indices.begin(), mesh.indices.end(), 0u);
+		}
+
+		std::vector<float> interleaved(vertexCount * stride);
+		size_t offset = 0;
+		for (const auto& s : streams)
+		{
+			const float* src = reinterpret_cast<const float*>(s.data->data());
+			for (size_t v = 0; v < vertexCount; ++v) {
+				memcpy(&interleaved[v * stride + offset], &src[v * s.floats], s.floats * sizeof(float));
+			}
+			offset += s.floats;
+		}
+
+		std::vector<int> remap(vertexCount);
+		std::vector<float> welded(vertexCount * stride);
+		const int uniqueCount = WeldMesh(remap.data(), welded.data(), interleaved.data(), int(vertexCount), int(stride));
+		if (uniqueCount <= 0) return vertexCount;
+
+		offset = 0;
+		for (const auto& s : streams)
+		{
+			s.data->resize(size_t(uniqueCount) * s.floats * sizeof(float));
+			float* dst = reinterpret_cast<float*>(s.data->data());
+			for (size_t v = 0; v < size_t(uniqueCount); ++v) {
+				memcpy(&dst[v * s.floats], &welded[v * stride + offset], s.floats * sizeof(float));
+			}
+			offset += s.floats;
+		}
+		for (auto& index : mesh.indices) {
+			index = uint32_t(remap[index]);
+		}
+
+		return size_t(uniqueCount);
+	}
+}
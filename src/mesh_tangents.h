@@ -0,0 +1,22 @@
+#pragma once
+
+#include "pch.h"
+#include "mesh_data.h"
+
+namespace jsr {
+
+	/*
+	MikkTSpace tangents from the positions, normals and uvs of the indexed triangles.
+	MikkTSpace works on face corners, so the mesh is left unindexed, weld it after.
+	Returns false if the mesh has no normals or uvs.
+	*/
+	bool generateMeshTangents(MeshData& mesh);
+
+	/*
+	Merges the vertices equal in every attribute (Welder) and remaps the indices.
+	A mesh without indices is treated as a triangle list. Returns the new vertex count, or 0 and leaves
+	the mesh unchanged if a stream that is not empty has another vertex count than the positions
+	or an index is out of their range.
+	*/
+	size_t weldMeshVertices(MeshData& mesh);
+}
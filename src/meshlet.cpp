@@ -0,0 +1,172 @@
+#include "meshlet.h"
+#include <glm/gtc/type_ptr.hpp>
+
+namespace jsr {
+
+	using namespace glm;
+
+	MeshletCullStats& MeshletCullStats::operator+=(const MeshletCullStats& other)
+	{
+		meshlets += other.meshlets;
+		frustumCulled += other.frustumCulled;
+		backfaceCulled += other.backfaceCulled;
+		triangles += other.triangles;
+		visibleTriangles += other.visibleTriangles;
+		return *this;
+	}
+
+	static void computeMeshletBounds(const MeshData& mesh, Meshlet& meshlet)
+	{
+		const float* positions = reinterpret_cast<const float*>(mesh.positions.data());
+		auto pos = [&](uint32_t local) { return make_vec3(&positions[mesh.meshletVertices[meshlet.vertexOffset + local] * 3]); };
+
+		meshlet.aabb = Bounds();
+		for (uint32_t v = 0; v < meshlet.vertexCount; ++v) {
+			meshlet.aabb.Extend(pos(v));
+		}
+		const vec3 center = meshlet.aabb.GetCenter();
+		float radius = 0.0f;
+		for (uint32_t v = 0; v < meshlet.vertexCount; ++v) {
+			radius = std::max(radius, length(pos(v) - center));
+		}
+		meshlet.sphere = Sphere(center, radius);
+
+		// axis is the average of the unit normals, degenerate triangles are left out
+		std::vector<vec3> normals;
+		std::vector<vec3> corners;
+		normals.reserve(meshlet.triangleCount);
+		corners.reserve(meshlet.triangleCount);
+		vec3 axis(0.0f);
+		for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+		{
+			const uint8_t* tri = &mesh.meshletTriangles[meshlet.triangleOffset + t * 3];
+			const vec3 p0 = pos(tri[0]), p1 = pos(tri[1]), p2 = pos(tri[2]);
+			const vec3 n = cross(p1 - p0, p2 - p0);
+			const float area = length(n);
+			if (area == 0.0f) continue;
+			normals.push_back(n / area);
+			corners.push_back(p0);
+			axis += n / area;
+		}
+
+		meshlet.coneApex = center;
+		meshlet.coneAxis = vec3(0.0f, 0.0f, 1.0f);
+		meshlet.coneCutoff = 1.0f;
+		const float axisLength = length(axis);
+		if (normals.empty() || axisLength == 0.0f) return;
+		axis /= axisLength;
+
+		float minDot = 1.0f;
+		for (const auto& n : normals) {
+			minDot = std::min(minDot, dot(axis, n));
+		}
+		meshlet.coneAxis = axis;
+		// wider than about 84 degrees, culling would almost never happen
+		if (minDot <= 0.1f) return;
+
+		// apex on the axis behind every triangle plane, the cone test is exact from there
+		float maxT = 0.0f;
+		for (size_t t = 0; t < normals.size(); ++t) {
+			maxT = std::max(maxT, dot(center - corners[t], normals[t]) / dot(axis, normals[t]));
+		}
+		meshlet.coneApex = center - axis * maxT;
+		meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+
+	void buildMeshlets(MeshData& mesh)
+	{
+		mesh.meshlets.clear();
+		mesh.meshletVertices.clear();
+		mesh.meshletTriangles.clear();
+
+		const size_t vertexCount = mesh.positions.size() / (3 * sizeof(float));
+		const size_t triCount = mesh.indices.size() / 3;
+		if (triCount == 0) return;
+
+		// the meshlet a vertex was last added to and its local index there
+		std::vector<uint32_t> vertexMeshlet(vertexCount, ~0u);
+		std::vector<uint8_t> localIndex(vertexCount, 0);
+
+		Meshlet current{};
+		auto finish = [&]()
+		{
+			if (current.triangleCount == 0) return;
+			mesh.meshlets.push_back(current);
+			current = Meshlet{};
+			current.vertexOffset = uint32_t(mesh.meshletVertices.size());
+			current.triangleOffset = uint32_t(mesh.meshletTriangles.size());
+		};
+
+		for (size_t t = 0; t < triCount; ++t)
+		{
+			const uint32_t* tri = &mesh.indices[t * 3];
+			const uint32_t meshletIndex = uint32_t(mesh.meshlets.size());
+			uint32_t newVertices = 0;
+			for (int k = 0; k < 3; ++k)
+			{
+				const bool duplicate = (k > 0 && tri[k] == tri[0]) || (k > 1 && tri[k] == tri[1]);
+				newVertices += vertexMeshlet[tri[k]] != meshletIndex && !duplicate ? 1 : 0;
+			}
+			if (current.vertexCount + newVertices > MESHLET_MAX_VERTICES || current.triangleCount + 1 > MESHLET_MAX_TRIANGLES) {
+				finish();
+			}
+
+			const uint32_t target = uint32_t(mesh.meshlets.size());
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint32_t v = tri[k];
+				if (vertexMeshlet[v] != target)
+				{
+					vertexMeshlet[v] = target;
+					localIndex[v] = uint8_t(current.vertexCount++);
+					mesh.meshletVertices.push_back(v);
+				}
+				mesh.meshletTriangles.push_back(localIndex[v]);
+			}
+			current.triangleCount++;
+		}
+		finish();
+
+		for (auto& meshlet : mesh.meshlets) {
+			computeMeshletBounds(mesh, meshlet);
+		}
+	}
+
+	void cullMeshlets(const MeshData& mesh, const mat4& mtxModel, const Frustum& frustum, const vec3& cameraPosition, bool backfaceCulling,
+		std::vector<uint32_t>* visible, MeshletCullStats* stats)
+	{
+		const mat3 linear(mtxModel);
+		const float scale = std::max(length(linear[0]), std::max(length(linear[1]), length(linear[2])));
+		// facing is kept by affine transforms, the cone is tested in object space. Mirroring flips it, those are not cone culled.
+		const bool testCone = backfaceCulling && determinant(linear) > 0.0f;
+		const vec3 localCamera = testCone ? vec3(inverse(mtxModel) * vec4(cameraPosition, 1.0f)) : vec3(0.0f);
+
+		MeshletCullStats result;
+		result.meshlets = mesh.meshlets.size();
+		for (size_t i = 0; i < mesh.meshlets.size(); ++i)
+		{
+			const Meshlet& meshlet = mesh.meshlets[i];
+			result.triangles += meshlet.triangleCount;
+
+			const Sphere worldSphere(vec3(mtxModel * vec4(meshlet.sphere.GetCenter(), 1.0f)), meshlet.sphere.GetRadius() * scale);
+			if (!frustum.Intersects(worldSphere)) {
+				result.frustumCulled++;
+				continue;
+			}
+			if (testCone && meshlet.coneCutoff < 1.0f)
+			{
+				const vec3 view = meshlet.coneApex - localCamera;
+				const float distance = length(view);
+				if (distance > 0.0f && dot(view / distance, meshlet.coneAxis) > meshlet.coneCutoff) {
+					result.backfaceCulled++;
+					continue;
+				}
+			}
+
+			result.visibleTriangles += meshlet.triangleCount;
+			if (visible) visible->push_back(uint32_t(i));
+		}
+
+		if (stats) *stats += result;
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "pch.h"
+#include "mesh_data.h"
+#include "frustum.h"
+
+namespace jsr {
+
+	struct MeshletCullStats {
+		size_t meshlets = 0;
+		size_t frustumCulled = 0;
+		size_t backfaceCulled = 0;
+		size_t triangles = 0;
+		size_t visibleTriangles = 0;
+		MeshletCullStats& operator+=(const MeshletCullStats& other);
+	};
+
+	/*
+	Splits the full detail indices into meshlets of at most MESHLET_MAX_VERTICES vertices and
+	MESHLET_MAX_TRIANGLES triangles. Triangles are taken in index order, so it is best run on
+	vertex cache optimized indices, their locality keeps the meshlets compact.
+	Fills the bounding sphere, the AABB and the normal cone of every meshlet.
+	*/
+	void buildMeshlets(MeshData& mesh);
+
+	/*
+	CPU reference of the meshlet culling, frustum test of the bounding sphere and, with backfaceCulling,
+	the normal cone test. frustum and cameraPosition are in world space.
+	visible receives the indices of the meshlets passing both tests, stats are accumulated.
+	*/
+	void cullMeshlets(const MeshData& mesh, const glm::mat4& mtxModel, const Frustum& frustum, const glm::vec3& cameraPosition, bool backfaceCulling,
+		std::vector<uint32_t>* visible, MeshletCullStats* stats);
+}
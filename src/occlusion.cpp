@@ -0,0 +1,318 @@
+#include <xmmintrin.h>
+#include "occlusion.h"
+#include "jobsys.h"
+
+namespace jsr {
+
+	using namespace glm;
+
+	// vertices closer than this (clip w) are not rasterized / make boxes visible
+	static const float NEAR_W = 1e-3f;
+
+	OcclusionBuffer::OcclusionBuffer(int width, int height) :
+		m_width((width + TILE_WIDTH - 1) & ~(TILE_WIDTH - 1)),
+		m_height((height + TILE_HEIGHT - 1) & ~(TILE_HEIGHT - 1)),
+		m_viewProj(1.0f)
+	{
+		m_tilesX = m_width / TILE_WIDTH;
+		m_tilesY = m_height / TILE_HEIGHT;
+		m_depth.resize(size_t(m_width) * m_height, 0.0f);
+		m_tileBins.resize(size_t(m_tilesX) * m_tilesY);
+
+		int w = m_width, h = m_height;
+		for (;;)
+		{
+			Level level;
+			level.width = w;
+			level.height = h;
+			level.minZ.resize(size_t(w) * h, 0.0f);
+			level.maxZ.resize(size_t(w) * h, 0.0f);
+			m_levels.push_back(std::move(level));
+			if (w == 1 && h == 1) break;
+			w = std::max(1, (w + 1) / 2);
+			h = std::max(1, (h + 1) / 2);
+		}
+	}
+
+	void OcclusionBuffer::begin(const glm::mat4& viewProj)
+	{
+		m_viewProj = viewProj;
+		m_triangles.clear();
+		for (auto& bin : m_tileBins) bin.clear();
+		std::fill(m_depth.begin(), m_depth.end(), 0.0f);
+	}
+
+	void OcclusionBuffer::addOccluder(const glm::mat4& model, const float* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount)
+	{
+		const mat4 mvp = m_viewProj * model;
+		std::vector<vec4> clip(vertexCount);
+		for (size_t i = 0; i < vertexCount; ++i)
+		{
+			clip[i] = mvp * vec4(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2], 1.0f);
+		}
+
+		for (size_t i = 0; i + 2 < indexCount; i += 3)
+		{
+			AddTriangle(clip[indices[i]], clip[indices[i + 1]], clip[indices[i + 2]]);
+		}
+	}
+
+	void OcclusionBuffer::addOccluder(const MeshData& mesh, const glm::mat4& model)
+	{
+		const size_t vertexCount = mesh.positions.size() / (3 * sizeof(float));
+		addOccluder(model, (const float*)mesh.positions.data(), vertexCount, mesh.indices.data(), mesh.indices.size());
+	}
+
+	void OcclusionBuffer::addOccluder(const Bounds& box)
+	{
+		static const uint32_t boxIndices[36] = {
+			0,1,3, 0,3,2,	// -x
+			4,6,7, 4,7,5,	// +x
+			0,4,5, 0,5,1,	// -y
+			2,3,7, 2,7,6,	// +y
+			0,2,6, 0,6,4,	// -z
+			1,5,7, 1,7,3 };	// +z
+
+		// same corner order as GetHomogenousCorners()
+		float corners[8 * 3];
+		for (int i = 0; i < 8; ++i)
+		{
+			corners[i * 3 + 0] = box[(i >> 2) & 1].x;
+			corners[i * 3 + 1] = box[(i >> 1) & 1].y;
+			corners[i * 3 + 2] = box[i & 1].z;
+		}
+		addOccluder(mat4(1.0f), corners, 8, boxIndices, 36);
+	}
+
+	void OcclusionBuffer::AddTriangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2)
+	{
+		// Triangles crossing the near plane are dropped, missing an occluder is always safe.
+		if (c0.w < NEAR_W || c1.w < NEAR_W || c2.w < NEAR_W) {
+			return;
+		}
+
+		const vec2 scale(0.5f * m_width, 0.5f * m_height);
+		vec3 v[3];
+		const vec4* c[3] = { &c0, &c1, &c2 };
+		for (int i = 0; i < 3; ++i)
+		{
+			const float invW = 1.0f / c[i]->w;
+			v[i].x = (c[i]->x * invW + 1.0f) * scale.x;
+			v[i].y = (c[i]->y * invW + 1.0f) * scale.y;
+			v[i].z = clamp(c[i]->z * invW, 0.0f, 1.0f);
+		}
+
+		float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+		if (std::abs(area) < 1e-6f) {
+			return;
+		}
+		// occluders are rasterized double sided
+		if (area < 0.0f) {
+			std::swap(v[1], v[2]);
+			area = -area;
+		}
+
+		Triangle tri;
+		tri.minX = std::max(0, (int)std::floor(std::min({ v[0].x, v[1].x, v[2].x })));
+		tri.minY = std::max(0, (int)std::floor(std::min({ v[0].y, v[1].y, v[2].y })));
+		tri.maxX = std::min(m_width - 1, (int)std::ceil(std::max({ v[0].x, v[1].x, v[2].x })));
+		tri.maxY = std::min(m_height - 1, (int)std::ceil(std::max({ v[0].y, v[1].y, v[2].y })));
+		if (tri.minX > tri.maxX || tri.minY > tri.maxY) {
+			return;
+		}
+
+		// edge i is opposite to vertex i, its value is the unnormalized barycentric of vertex i
+		for (int i = 0; i < 3; ++i)
+		{
+			const vec3& a = v[(i + 1) % 3];
+			const vec3& b = v[(i + 2) % 3];
+			const float A = a.y - b.y;
+			const float B = b.x - a.x;
+			tri.edge[i] = vec3(A, B, -(A * a.x + B * a.y));
+		}
+
+		const float invArea = 1.0f / area;
+		tri.depth = (tri.edge[0] * v[0].z + tri.edge[1] * v[1].z + tri.edge[2] * v[2].z) * invArea;
+
+		// write the farthest depth the triangle has inside the pixel, not the one at the center
+		tri.depth.z -= 0.5f * (std::abs(tri.depth.x) + std::abs(tri.depth.y));
+
+		const uint32_t triIdx = (uint32_t)m_triangles.size();
+		m_triangles.push_back(tri);
+
+		const int tx0 = tri.minX / TILE_WIDTH, tx1 = tri.maxX / TILE_WIDTH;
+		const int ty0 = tri.minY / TILE_HEIGHT, ty1 = tri.maxY / TILE_HEIGHT;
+		for (int ty = ty0; ty <= ty1; ++ty)
+		{
+			for (int tx = tx0; tx <= tx1; ++tx)
+			{
+				m_tileBins[ty * m_tilesX + tx].push_back(triIdx);
+			}
+		}
+	}
+
+	void OcclusionBuffer::RasterizeTile(int tileIdx)
+	{
+		const int tileX0 = (tileIdx % m_tilesX) * TILE_WIDTH;
+		const int tileY0 = (tileIdx / m_tilesX) * TILE_HEIGHT;
+		const int tileX1 = tileX0 + TILE_WIDTH - 1;
+		const int tileY1 = tileY0 + TILE_HEIGHT - 1;
+
+		const __m128 laneOffset = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		for (const uint32_t triIdx : m_tileBins[tileIdx])
+		{
+			const Triangle& tri = m_triangles[triIdx];
+			const int x0 = std::max(tri.minX, tileX0) & ~3;
+			const int x1 = std::min(tri.maxX, tileX1);
+			const int y0 = std::max(tri.minY, tileY0);
+			const int y1 = std::min(tri.maxY, tileY1);
+
+			const __m128 A0 = _mm_set1_ps(tri.edge[0].x), B0 = _mm_set1_ps(tri.edge[0].y), C0 = _mm_set1_ps(tri.edge[0].z);
+			const __m128 A1 = _mm_set1_ps(tri.edge[1].x), B1 = _mm_set1_ps(tri.edge[1].y), C1 = _mm_set1_ps(tri.edge[1].z);
+			const __m128 A2 = _mm_set1_ps(tri.edge[2].x), B2 = _mm_set1_ps(tri.edge[2].y), C2 = _mm_set1_ps(tri.edge[2].z);
+			const __m128 ZA = _mm_set1_ps(tri.depth.x), ZB = _mm_set1_ps(tri.depth.y), ZC = _mm_set1_ps(tri.depth.z);
+
+			for (int y = y0; y <= y1; ++y)
+			{
+				const __m128 py = _mm_set1_ps(float(y) + 0.5f);
+				const __m128 row0 = _mm_add_ps(_mm_mul_ps(B0, py), C0);
+				const __m128 row1 = _mm_add_ps(_mm_mul_ps(B1, py), C1);
+				const __m128 row2 = _mm_add_ps(_mm_mul_ps(B2, py), C2);
+				const __m128 rowZ = _mm_add_ps(_mm_mul_ps(ZB, py), ZC);
+				float* dst = &m_depth[size_t(y) * m_width];
+
+				for (int x = x0; x <= x1; x += 4)
+				{
+					const __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), laneOffset);
+					const __m128 e0 = _mm_add_ps(_mm_mul_ps(A0, px), row0);
+					const __m128 e1 = _mm_add_ps(_mm_mul_ps(A1, px), row1);
+					const __m128 e2 = _mm_add_ps(_mm_mul_ps(A2, px), row2);
+					const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+					if (_mm_movemask_ps(inside) == 0) continue;
+
+					__m128 z = _mm_add_ps(_mm_mul_ps(ZA, px), rowZ);
+					z = _mm_min_ps(_mm_max_ps(z, zero), one);
+					// reversed-Z: keep the nearest (largest) depth
+					const __m128 old = _mm_loadu_ps(dst + x);
+					_mm_storeu_ps(dst + x, _mm_max_ps(old, _mm_and_ps(inside, z)));
+				}
+			}
+		}
+	}
+
+	void OcclusionBuffer::BuildPyramid()
+	{
+		Level& base = m_levels[0];
+		base.minZ = m_depth;
+		base.maxZ = m_depth;
+
+		for (size_t l = 1; l < m_levels.size(); ++l)
+		{
+			const Level& src = m_levels[l - 1];
+			Level& dst = m_levels[l];
+			for (int y = 0; y < dst.height; ++y)
+			{
+				const int sy0 = std::min(y * 2, src.height - 1);
+				const int sy1 = std::min(y * 2 + 1, src.height - 1);
+				for (int x = 0; x < dst.width; ++x)
+				{
+					const int sx0 = std::min(x * 2, src.width - 1);
+					const int sx1 = std::min(x * 2 + 1, src.width - 1);
+					const size_t i00 = size_t(sy0) * src.width + sx0, i01 = size_t(sy0) * src.width + sx1;
+					const size_t i10 = size_t(sy1) * src.width + sx0, i11 = size_t(sy1) * src.width + sx1;
+					dst.minZ[size_t(y) * dst.width + x] = std::min(std::min(src.minZ[i00], src.minZ[i01]), std::min(src.minZ[i10], src.minZ[i11]));
+					dst.maxZ[size_t(y) * dst.width + x] = std::max(std::max(src.maxZ[i00], src.maxZ[i01]), std::max(src.maxZ[i10], src.maxZ[i11]));
+				}
+			}
+		}
+	}
+
+	void OcclusionBuffer::end()
+	{
+		jsrlib::counting_semaphore counter;
+
+		for (int i = 0; i < (int)m_tileBins.size(); ++i)
+		{
+			if (m_tileBins[i].empty()) continue;
+			jobsys.submitJob([this, i](int threadId)
+				{
+					RasterizeTile(i);
+				}, &counter);
+		}
+
+		counter.wait();
+		BuildPyramid();
+	}
+
+	bool OcclusionBuffer::isVisible(const Bounds& box) const
+	{
+		vec2 rectMin(std::numeric_limits<float>::max());
+		vec2 rectMax(std::numeric_limits<float>::lowest());
+		float boxZ = 0.0f;
+
+		for (const vec4& corner : box.GetHomogenousCorners())
+		{
+			const vec4 clip = m_viewProj * corner;
+			if (clip.w < NEAR_W) {
+				return true;
+			}
+			const float invW = 1.0f / clip.w;
+			const vec2 p((clip.x * invW + 1.0f) * 0.5f * m_width, (clip.y * invW + 1.0f) * 0.5f * m_height);
+			rectMin = min(rectMin, p);
+			rectMax = max(rectMax, p);
+			boxZ = std::max(boxZ, clip.z * invW);
+		}
+
+		// Coverage is sampled at pixel centers, so grow the rectangle by a pixel to reach
+		// the uncovered neighbours of partially covered edge pixels.
+		const int x0 = std::max(0, (int)std::floor(rectMin.x) - 1);
+		const int y0 = std::max(0, (int)std::floor(rectMin.y) - 1);
+		const int x1 = std::min(m_width - 1, (int)std::floor(rectMax.x) + 1);
+		const int y1 = std::min(m_height - 1, (int)std::floor(rectMax.y) + 1);
+		if (x0 > x1 || y0 > y1) {
+			// off screen, left to the frustum culler
+			return true;
+		}
+
+		// pick the level where the rectangle covers at most 2x2 texels (3x3 when unaligned)
+		const int extent = std::max(x1 - x0, y1 - y0);
+		int level = 0;
+		while ((extent >> level) > 1 && level + 1 < (int)m_levels.size()) {
+			++level;
+		}
+
+		const Level& lvl = m_levels[level];
+		const int lx0 = x0 >> level, lx1 = std::min(lvl.width - 1, x1 >> level);
+		const int ly0 = y0 >> level, ly1 = std::min(lvl.height - 1, y1 >> level);
+
+		float farthest = 1.0f;
+		float nearest = 0.0f;
+		for (int y = ly0; y <= ly1; ++y)
+		{
+			for (int x = lx0; x <= lx1; ++x)
+			{
+				farthest = std::min(farthest, lvl.minZ[size_t(y) * lvl.width + x]);
+				nearest = std::max(nearest, lvl.maxZ[size_t(y) * lvl.width + x]);
+			}
+		}
+
+		// in front of every occluder in the area
+		if (boxZ >= nearest) {
+			return true;
+		}
+
+		return boxZ >= farthest;
+	}
+
+	void OcclusionBuffer::cull(RenderEntityList& list) const
+	{
+		list.erase(std::remove_if(list.begin(), list.end(), [this](const RenderEntity& e)
+			{
+				return !isVisible(e.aabb);
+			}), list.end());
+	}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "pch.h"
+#include "bounds.h"
+#include "world.h"
+
+namespace jsr {
+
+	/*
+	Low resolution software rasterized depth buffer with a min/max depth pyramid.
+	Depth is reversed-Z like the renderer: 1.0 is near, 0.0 is far.
+	Usage: begin() -> addOccluder()... -> end() -> isVisible()/cull()
+	*/
+	class OcclusionBuffer
+	{
+	public:
+		static const int TILE_WIDTH = 32;	// must be a multiple of 4 (SSE lanes)
+		static const int TILE_HEIGHT = 16;
+
+		OcclusionBuffer(int width = 256, int height = 128);
+
+		void begin(const glm::mat4& viewProj);
+		void addOccluder(const glm::mat4& model, const float* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount);
+		void addOccluder(const MeshData& mesh, const glm::mat4& model);
+		void addOccluder(const Bounds& box);
+		// rasterizes the occluders and builds the depth pyramid
+		void end();
+
+		bool isVisible(const Bounds& box) const;
+		// removes the occluded entities from the list
+		void cull(RenderEntityList& list) const;
+
+		int getWidth() const { return m_width; }
+		int getHeight() const { return m_height; }
+		int getLevelCount() const { return (int)m_levels.size(); }
+		const float* getDepth() const { return m_depth.data(); }
+		size_t getTriangleCount() const { return m_triangles.size(); }
+	private:
+		struct Triangle {
+			glm::vec3 edge[3];		// edge functions (A,B,C): A*x + B*y + C >= 0 inside
+			glm::vec3 depth;		// depth plane: z = A*x + B*y + C
+			int minX, minY, maxX, maxY;
+		};
+		struct Level {
+			int width, height;
+			std::vector<float> minZ;
+			std::vector<float> maxZ;
+		};
+
+		void AddTriangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2);
+		void RasterizeTile(int tileIdx);
+		void BuildPyramid();
+
+		int m_width;
+		int m_height;
+		int m_tilesX;
+		int m_tilesY;
+		glm::mat4 m_viewProj;
+		std::vector<float> m_depth;
+		std::vector<Triangle> m_triangles;
+		std::vector<std::vector<uint32_t>> m_tileBins;
+		std::vector<Level> m_levels;
+	};
+
+}
@@ -3,6 +3,7 @@
 #include "jsrlib/jsr_semaphore.h"
 #include "jsrlib/jsr_logger.h"
 #include "jobsys.h"
+#include "gltf_view.h"
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/matrix_decompose.hpp>
 
@@ -10,88 +11,52 @@ namespace jsr {
 
     S_MATERIAL convertMaterialtoShaderFormat(const Material& m, const VulkanRenderer* backend);
 
-    std::vector<glm::vec3> Model::getPositions(const tinygltf::Model& model, const tinygltf::Primitive& primitive) {
-        std::vector<glm::vec3> out;
-        if (primitive.attributes.find("POSITION") != primitive.attributes.end()) {
-            int positions = primitive.attributes.at("POSITION");
-            int view = model.accessors[positions].bufferView;
-            int buffer = model.bufferViews[view].buffer;
-
-            glm::vec3* buf = (glm::vec3*)(model.buffers[buffer].data.data() + model.bufferViews[view].byteOffset + model.accessors[positions].byteOffset);
-            out.resize(model.accessors[positions].count);
-            memcpy(out.data(), buf, out.size() * sizeof(glm::vec3));
+    template<class T>
+    static std::vector<T> readAttribute(const tinygltf::Model& model, const tinygltf::Primitive& primitive, const char* name) {
+        std::vector<T> out;
+        const auto it = primitive.attributes.find(name);
+        if (it != primitive.attributes.end()) {
+            const gltf_view<T> view(model, it->second);
+            out.resize(view.size());
+            view.copy_to(out.data());
         }
         return out;
     }
 
+    std::vector<glm::vec3> Model::getPositions(const tinygltf::Model& model, const tinygltf::Primitive& primitive) {
+        return readAttribute<glm::vec3>(model, primitive, "POSITION");
+    }
+
     std::vector<glm::vec3> Model::getNormals(const tinygltf::Model& model, const tinygltf::Primitive& primitive) {
-        std::vector<glm::vec3> out;
-        if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-            int accessor = primitive.attributes.at("NORMAL");
-            int view = model.accessors[accessor].bufferView;
-            int buffer = model.bufferViews[view].buffer;
-
-            glm::vec3* buf = (glm::vec3*)(model.buffers[buffer].data.data() + model.bufferViews[view].byteOffset + model.accessors[accessor].byteOffset);
-            out.resize(model.accessors[accessor].count);
-            memcpy(out.data(), buf, out.size() * sizeof(glm::vec3));
-        }
-        return out;
+        return readAttribute<glm::vec3>(model, primitive, "NORMAL");
     }
 
     std::vector<glm::vec4> Model::getTangents(const tinygltf::Model& model, const tinygltf::Primitive& primitive) {
-        std::vector<glm::vec4> out;
-        if (primitive.attributes.find("TANGENT") != primitive.attributes.end()) {
-            int accessor = primitive.attributes.at("TANGENT");
-            int view = model.accessors[accessor].bufferView;
-            int buffer = model.bufferViews[view].buffer;
-
-            glm::vec4* buf = (glm::vec4*)(model.buffers[buffer].data.data() + model.bufferViews[view].byteOffset + model.accessors[accessor].byteOffset);
-            out.resize(model.accessors[accessor].count);
-            memcpy(out.data(), buf, out.size() * sizeof(glm::vec4));
-        }
-        return out;
+        return readAttribute<glm::vec4>(model, primitive, "TANGENT");
     }
 
     std::vector<glm::vec2> Model::getUVs(const tinygltf::Model& model, const tinygltf::Primitive& primitive) {
-        std::vector<glm::vec2> out;
-        if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-            int accessor = primitive.attributes.at("TEXCOORD_0");
-            int view = model.accessors[accessor].bufferView;
-            int buffer = model.bufferViews[view].buffer;
-
-            glm::vec2* buf = (glm::vec2*)(model.buffers[buffer].data.data() + model.bufferViews[view].byteOffset + model.accessors[accessor].byteOffset);
-            out.resize(model.accessors[accessor].count);
-            memcpy(out.data(), buf, out.size() * sizeof(glm::vec2));
-        }
-        return out;
+        return readAttribute<glm::vec2>(model, primitive, "TEXCOORD_0");
     }
 
     std::vector<glm::vec4> Model::getColors(const tinygltf::Model& model, const tinygltf::Primitive& primitive) {
         std::vector<glm::vec4> out;
-        if (primitive.attributes.find("COLOR_0") != primitive.attributes.end()) {
-            int accessor = primitive.attributes.at("COLOR_0");
-            int view = model.accessors[accessor].bufferView;
-            int buffer = model.bufferViews[view].buffer;
-
-            const void* buf = (model.buffers[buffer].data.data() + model.bufferViews[view].byteOffset + model.accessors[accessor].byteOffset);
-
-            const auto& accessorRef = model.accessors[accessor];
-
-            if (accessorRef.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT) {
-                return out;
-            }
+        const auto it = primitive.attributes.find("COLOR_0");
+        if (it == primitive.attributes.end()) {
+            return out;
+        }
 
-            out.resize(model.accessors[accessor].count);
-            if (accessorRef.type == TINYGLTF_TYPE_VEC3) {
-                const glm::vec3* ptr = reinterpret_cast<const glm::vec3*>(buf);
-                for (int i = 0; i < out.size(); ++i) {
-                    out[i] = glm::vec4(ptr[i], 1.0f);
-                }
-            }
-            else {
-                memcpy(out.data(), buf, out.size() * sizeof(glm::vec4));
+        // COLOR_0 is RGB or RGBA, float or normalized integers
+        if (model.accessors[it->second].type == TINYGLTF_TYPE_VEC3) {
+            const gltf_view<glm::vec3> view(model, it->second);
+            out.resize(view.size());
+            for (size_t i = 0; i < out.size(); ++i) {
+                out[i] = glm::vec4(view[i], 1.0f);
             }
         }
+        else {
+            out = readAttribute<glm::vec4>(model, primitive, "COLOR_0");
+        }
 
         return out;
     }
@@ -233,7 +198,7 @@ namespace jsr {
         int stat_vertexCount(0), stat_indexCount(0);
         {
             std::vector<jsr::Vertex> hwVertices;
-            std::vector<uint16_t> hwIndices;
+            std::vector<uint32_t> hwIndices;
             hwVertices.reserve(1000000);
             hwIndices.reserve(1000000);
 
@@ -252,11 +217,7 @@ namespace jsr {
                 for (size_t primitiveIdx(0); primitiveIdx < mesh.primitives.size(); ++primitiveIdx)
                 {
                     const auto& primitive = mesh.primitives[primitiveIdx];
-                    const auto& indices = model.accessors[primitive.indices];
-                    const uint16_t* index16 = (uint16_t*)(
-                        model.buffers[model.bufferViews[indices.bufferView].buffer].data.data() +
-                        model.bufferViews[indices.bufferView].byteOffset +
-                        indices.byteOffset);
+                    const gltf_view<uint32_t> indices(model, primitive.indices);
 
                     int positions = primitive.attributes.at("POSITION");
                     MeshPrimitive triangles = {};
@@ -265,7 +226,7 @@ namespace jsr {
                     auto tangents = getTangents(model, primitive);
                     auto uvs = getUVs(model, primitive);
 
-                    triangles.indexCount = (uint32_t)indices.count;
+                    triangles.indexCount = (uint32_t)indices.size();
                     triangles.baseVertex = baseVertex;
                     triangles.firstIndex = firstIndex;
                     triangles.material = primitive.material;                
@@ -273,7 +234,7 @@ namespace jsr {
                     triangles.bbox[1] = glm::make_vec3(model.accessors[positions].maxValues.data());
 
                     baseVertex += (uint32_t)xyz.size();
-                    firstIndex += (uint32_t)indices.count;
+                    firstIndex += (uint32_t)indices.size();
 
                     for (size_t vert(0); vert < xyz.size(); ++vert)
                     {
@@ -287,28 +248,31 @@ namespace jsr {
                     }
                     _mesh.primitives.push_back(triangles);
 
-                    for (size_t x = 0; x < indices.count; ++x)
-                    {
-                        if (indices.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
-                            hwIndices.push_back(index16[x]);
-                        }
-                        else {
-                            idxType = INDEX_TYPE_UINT32;
-                            hwIndices.push_back(index16[x * 2 + 0]);
-                            hwIndices.push_back(index16[x * 2 + 1]);
-                        }
+                    // indices are relative to baseVertex, 16 bits are enough up to 65536 vertices per primitive
+                    if (xyz.size() > 0x10000) {
+                        idxType = INDEX_TYPE_UINT32;
                     }
+                    const size_t indexOffset = hwIndices.size();
+                    hwIndices.resize(indexOffset + indices.size());
+                    indices.copy_to(hwIndices.data() + indexOffset);
 
                     /***************/
                     stat_vertexCount += static_cast<uint32_t>(xyz.size());
-                    stat_indexCount += static_cast<uint32_t>(indices.count);
+                    stat_indexCount += static_cast<uint32_t>(indices.size());
                     /***************/
 
                 }
                 m_meshes.push_back(_mesh);
             }
 
-            meshInfo.indexBuffer = std::move(hwIndices);
+            // one index type for the whole buffer, 32 bit indices are stored as pairs of 16 bit words
+            if (idxType == INDEX_TYPE_UINT32) {
+                meshInfo.indexBuffer.resize(hwIndices.size() * 2);
+                memcpy(meshInfo.indexBuffer.data(), hwIndices.data(), hwIndices.size() * sizeof(uint32_t));
+            }
+            else {
+                meshInfo.indexBuffer.assign(hwIndices.begin(), hwIndices.end());
+            }
             meshInfo.vertexBuffer = jsr::toCharArray(hwVertices.size() * sizeof(Vertex), hwVertices.data());
             meshInfo.indexCount = firstIndex;
             meshInfo.vertexCount = baseVertex;
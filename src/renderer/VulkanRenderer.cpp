@@ -75,6 +75,10 @@ namespace jsr {
 	void VulkanRenderer::drawMeshes(const std::vector<DrawMeshDescription>& descr, uint32_t threadId, const void* pushConstants)
 	{
 		size_t pc_offset = 0;
+		// skip binds that are the same as the previous draw's, descr is expected to be sorted by state
+		VkCommandBuffer lastCmd = VK_NULL_HANDLE;
+		uint32_t lastMesh = ~0u;
+		uint32_t lastResources = ~0u;
 		for (size_t drawIdx = 0; drawIdx < descr.size(); ++drawIdx)
 		{
 			const auto& pipeline = m_graphicsPipelines[ descr[ drawIdx ].pipeline.index ];
@@ -90,8 +94,15 @@ namespace jsr {
 				pc_offset += pipeline.vkPipeline->getPushConstantsSize();
 			}
 
-			if (!handle::is_valid(m_mergedMesh) || descr[drawIdx].mesh.index != m_mergedMesh.index)
+			if (cmd != lastCmd) {
+				lastCmd = cmd;
+				lastMesh = ~0u;
+				lastResources = ~0u;
+			}
+
+			if ((!handle::is_valid(m_mergedMesh) || descr[drawIdx].mesh.index != m_mergedMesh.index) && descr[drawIdx].mesh.index != lastMesh)
 			{
+				lastMesh = descr[drawIdx].mesh.index;
 				const auto& MESH = m_meshes[descr[drawIdx].mesh.index];
 				const VkBuffer vBuffer = MESH.vertexBuffer->handle;
 				const VkBuffer iBuffer = MESH.indexBuffer->handle;
@@ -101,8 +112,9 @@ namespace jsr {
 				vkCmdBindIndexBuffer(cmd, iBuffer, 0, MESH.indexType);
 			}
 
-			if (handle::is_valid(descr[drawIdx].meshResources))
+			if (handle::is_valid(descr[drawIdx].meshResources) && descr[drawIdx].meshResources.index != lastResources)
 			{
+				lastResources = descr[drawIdx].meshResources.index;
 				vkCmdBindDescriptorSets(
 					cmd,
 					VK_PIPELINE_BIND_POINT_GRAPHICS,
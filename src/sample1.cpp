@@ -4,6 +4,7 @@
 #include "jobsys.h"
 #include "world.h"
 #include "gltf_loader.h"
+#include "scene_cache.h"
 #include "stb_image.h"
 #include "bounds.h"
 #include "frustum.h"
@@ -24,6 +25,7 @@
 #include "jsrlib/jsr_math.h"
 
 #include <random>
+#include <algorithm>
 //#define _USE_MATH_DEFINES
 #include <cmath>
 
@@ -81,11 +83,10 @@ void Sample1App::init_lights()
     std::random_device rdev;
     std::uniform_real_distribution<float> randomFloats(0.0f, 1.0f); // random floats between [0.0, 1.0]
     std::default_random_engine generator(rdev());
-    jvk::Buffer stage;
 
    
     /* Init ligths */
-    lights = {};
+    lights.assign(lightCount, jsr::Light{});
     
     for (size_t i(0); i < lights.size(); ++i)
     {
@@ -107,16 +108,41 @@ void Sample1App::init_lights()
         float Id = a / 0.02f;
         lights[i].range = range > 0.0f ? range : 0.1f * sqrtf(Id);
         lights[i].falloff = falloff;
-        jsrlib::Info("Light %i: I=%f", i, lights[i].range);
     }
-    pDevice->create_staging_buffer(lights.size() * sizeof(lights[0]), &stage);
-    stage.copyTo(0, stage.size, lights.data());
-    for (size_t i(0); i < MAX_CONCURRENT_FRAMES; ++i)
+    jsrlib::Info("%d lights, range: %f", (int)lights.size(), lights[0].range);
+    // the frames in flight keep drawing with their own copy
+    lightsDirty.fill(true);
+}
+
+void Sample1App::update_light_clusters()
+{
+    jvk::GpuProfiler::CpuScope cpuScope(gpuProfiler.get(), "Light clusters");
+    lightClusters.update(lights.data(), lights.size(), passData.mtxView);
+
+    const auto& clusters = lightClusters.getClusters();
+    const auto& indices = lightClusters.getLightIndices();
+
+    auto clusterUpload = uploadRing->AllocateStorage(LightClusters::CLUSTER_COUNT * sizeof(LightClusters::Cluster));
+    auto indexUpload = uploadRing->AllocateStorage(MAX_LIGHT_INDICES * sizeof(uint32_t));
+    assert(clusterUpload && indexUpload);
+    frameUploads.lightClusters = uint32_t(clusterUpload.offset);
+    frameUploads.lightIndices = uint32_t(indexUpload.offset);
+
+    const size_t indexCount = std::min(indices.size(), MAX_LIGHT_INDICES);
+    memcpy(clusterUpload.data, clusters.data(), clusters.size() * sizeof(clusters[0]));
+    memcpy(indexUpload.data, indices.data(), indexCount * sizeof(indices[0]));
+    if (indices.size() <= MAX_LIGHT_INDICES)
     {
-        //pDevice->buffer_copy(&stage, uboLights[ i ]->buffer(), 0, 0, stage.size);
-        uboLights[i]->CopyTo(&stage, 0, 0, stage.size);
+        return;
+    }
+
+    // too many light-cluster pairs, drop what does not fit
+    auto* clamped = reinterpret_cast<LightClusters::Cluster*>(clusterUpload.data);
+    for (size_t i = 0; i < clusters.size(); ++i)
+    {
+        auto& c = clamped[i];
+        c.count = c.offset >= MAX_LIGHT_INDICES ? 0 : std::min<uint32_t>(c.count, uint32_t(MAX_LIGHT_INDICES - c.offset));
     }
-    pDevice->destroy_buffer(&stage);
 }
 
 void Sample1App::on_window_resized()
@@ -143,23 +169,26 @@ void Sample1App::on_window_resized()
 
 void Sample1App::setup_descriptor_sets()
 {
+    const VkDescriptorBufferInfo ringPassData{ uploadRing->GetBuffer(), 0, sizeof(PassData) };
+    const VkDescriptorBufferInfo ringDrawData{ uploadRing->GetBuffer(), 0, MAX_DRAW_INSTANCES * sizeof(DrawData) };
+    const VkDescriptorBufferInfo ringLightClusters{ uploadRing->GetBuffer(), 0, LightClusters::CLUSTER_COUNT * sizeof(LightClusters::Cluster) };
+    const VkDescriptorBufferInfo ringLightIndices{ uploadRing->GetBuffer(), 0, MAX_LIGHT_INDICES * sizeof(uint32_t) };
+    const VkDescriptorBufferInfo ringPostProcessData{ uploadRing->GetBuffer(), 0, sizeof(PostProcessData) };
+
     for (size_t i(0); i < MAX_CONCURRENT_FRAMES; ++i)
     {
 
-        //VkDescriptorBufferInfo drawbufInfo = uboDrawData.descriptor;
-        VkDescriptorBufferInfo drawbufInfo = drawPool[i]->descriptor;
-        drawbufInfo.range = sizeof(DrawData);
-
-        uboPassData[i]->GetBuffer()->descriptor.range = sizeof(PassData);
-        uboPassData[i]->GetBuffer()->descriptor.offset = 0;
         const VkShaderStageFlags stageBits = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-        uboLights[i]->SetupDescriptor();
+        ssboLights[i]->SetupDescriptor();
 
+        // the offsets are supplied at bind time from frameUploads
         descMgr.builder()
-            .bind_buffer(0, &uboPassData[i]->GetBuffer()->descriptor, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
-            .bind_buffer(1, &drawbufInfo, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT)
+            .bind_buffer(0, &ringPassData, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+            .bind_buffer(1, &ringDrawData, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT)
             .bind_image(2, &ssaoNoise.descriptor, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-            .bind_buffer(3, &uboLights[i]->GetBuffer()->descriptor, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .bind_buffer(3, &ssboLights[i]->GetBuffer()->descriptor, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .bind_buffer(4, &ringLightClusters, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .bind_buffer(5, &ringLightIndices, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
             .build(triangleDescriptors[i]);
 
         HDRImage[i].setup_descriptor();
@@ -171,13 +200,10 @@ void Sample1App::setup_descriptor_sets()
         zinf.imageView = (settings.msaaSamples > VK_SAMPLE_COUNT_1_BIT) ? depthResolvedView[i] : deptOnlyView;
         zinf.sampler = sampNearestClampBorder;
 
-        uboPostProcessData[i]->SetupDescriptor();
-        uboPostProcessData[i]->GetBuffer()->descriptor.range = sizeof(PostProcessData);
-
         descMgr.builder()
             .bind_image(0, &HDRImage[i].descriptor, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
             .bind_image(1, &zinf, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-            .bind_buffer(2, &uboPostProcessData[i]->GetBuffer()->descriptor, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .bind_buffer(2, &ringPostProcessData, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
             .build(HDRDescriptor[i]);
 
         pDevice->set_descriptor_set_name(HDRDescriptor[i], "Tonemap DSET " + std::to_string(i));
@@ -199,11 +225,6 @@ void Sample1App::setup_objects()
     std::default_random_engine reng(rdev());
     std::uniform_real_distribution<float> range(0.0f, 0.25f);
 
-    dynamicAlignment = sizeof(DrawData);
-    if (minUboAlignment > 0) {
-        dynamicAlignment = (dynamicAlignment + minUboAlignment - 1) & ~(minUboAlignment - 1);
-    }
-
     drawDataStruct.clear();
     while (nodesToProcess.empty() == false)
     {
@@ -216,14 +237,16 @@ void Sample1App::setup_objects()
             for (auto e : node.getEntities()) {
                 Object obj;
                 obj.mesh = e;
+                obj.lod = 0;
                 obj.mtxModel = mtxModel;
                 obj.aabb = world->meshes[e].aabb.Transform(mtxModel);
                 obj.vkResources = materials[world->meshes[e].material].resources;
 
+                const mat4 mtxPosition = vertexFormat == jsr::VERTEX_FORMAT_COMPACT ? mtxModel * jsr::VertexCompact::dequantization(world->meshes[e].aabb) : mtxModel;
                 drawDataStruct.emplace_back(
                     DrawData
                     {
-                        mtxModel,
+                        mtxPosition,
                         mat4(transpose(inverse(mat3(mtxModel)))),
                         vec4(range(reng), range(reng), range(reng), 1.0f) 
                     });
@@ -234,16 +257,114 @@ void Sample1App::setup_objects()
             nodesToProcess.push_back(e);
         }
     }
+}
 
-    drawDataBufferAligned.resize(drawDataStruct.size() * dynamicAlignment);
+void Sample1App::setup_gpu_culling()
+{
+    // one batch per material, opaque and alpha tested objects only
+    std::vector<uint32_t> batchOfMaterial(world->materials.size(), ~0u);
+    cullBatches.clear();
+    cullObjects.clear();
+
+    const size_t objectCount = std::min(objects.size(), size_t(MAX_DRAW_INSTANCES));
+    for (size_t i = 0; i < objectCount; ++i) {
+        const int materialIndex = world->meshes[objects[i].mesh].material;
+        if (world->materials[materialIndex].alphaMode == ALPHA_MODE_BLEND) {
+            continue;
+        }
+        if (batchOfMaterial[materialIndex] == ~0u) {
+            batchOfMaterial[materialIndex] = uint32_t(cullBatches.size());
+            cullBatches.push_back({ objects[i].vkResources, 0, 0 });
+        }
+        cullBatches[batchOfMaterial[materialIndex]].maxCount++;
+    }
 
-    size_t offset = 0;
-    for (size_t i(0); i < drawDataStruct.size(); ++i) {
-        memcpy(&drawDataBufferAligned[offset], &drawDataStruct[i], sizeof(DrawData));
-        offset += dynamicAlignment;
+    uint32_t commandCount = 0;
+    for (auto& batch : cullBatches) {
+        batch.firstCommand = commandCount;
+        commandCount += batch.maxCount;
     }
 
-    //    memcpy(drawData.data(), drawDataStruct.data(), drawDataStruct.size() * sizeof(DrawData));
+    for (size_t i = 0; i < objectCount; ++i) {
+        const auto& obj = objects[i];
+        const int materialIndex = world->meshes[obj.mesh].material;
+        const uint32_t batch = batchOfMaterial[materialIndex];
+        if (batch == ~0u) {
+            continue;
+        }
+        const auto& mesh = meshes[obj.mesh];
+        jsr::GpuCullObject co{};
+        co.boundsMin = vec4(obj.aabb.Min(), 1.0f);
+        co.boundsMax = vec4(obj.aabb.Max(), 1.0f);
+        // no LOD selection on the GPU yet, always the full detail mesh
+        co.indexCount = mesh.lods[0].indexCount;
+        co.firstIndex = mesh.lods[0].firstIndex;
+        co.vertexOffset = int32_t(mesh.firstVertex);
+        co.batch = batch;
+        co.commandBase = cullBatches[batch].firstCommand;
+        co.drawDataIndex = uint32_t(i);
+        cullObjects.push_back(co);
+    }
+
+    const size_t objectBytes = std::max(size_t(1), cullObjects.size()) * sizeof(jsr::GpuCullObject);
+    ssboCullObjects = StorageBuffer::CreateShared(pDevice, objectBytes, false);
+    ssboCullObjects->SetName("Cull objects SSBO");
+    if (!cullObjects.empty()) {
+        uploadManager->UploadBuffer(ssboCullObjects->GetBuffer(), 0, cullObjects.data(), cullObjects.size() * sizeof(jsr::GpuCullObject),
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+    ssboCullObjects->SetupDescriptor();
+
+    VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+    for (size_t i = 0; i < MAX_CONCURRENT_FRAMES; ++i) {
+        cullCommands[i] = IndirectBuffer::CreateShared(pDevice, std::max(1u, commandCount) * sizeof(VkDrawIndexedIndirectCommand), false);
+        cullCommands[i]->SetName("Cull draw commands " + std::to_string(i));
+        cullCommands[i]->SetupDescriptor();
+
+        // host visible to read back the visible object count
+        const size_t countBytes = std::max(size_t(1), cullBatches.size()) * sizeof(uint32_t);
+        cullCounts[i] = IndirectBuffer::CreateShared(pDevice, countBytes, true);
+        cullCounts[i]->Map();
+        cullCounts[i]->Fill(0, countBytes, 0);
+        cullCounts[i]->SetName("Cull draw counts " + std::to_string(i));
+        cullCounts[i]->SetupDescriptor();
+
+        cullExpected[i] = -1;
+
+        descMgr.builder()
+            .bind_buffer(0, &ssboCullObjects->GetBuffer()->descriptor, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .bind_buffer(1, &cullCommands[i]->GetBuffer()->descriptor, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .bind_buffer(2, &cullCounts[i]->GetBuffer()->descriptor, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build(cullDescriptors[i], &cullSetLayout);
+    }
+
+    VkPushConstantRange pushConstants{};
+    pushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstants.offset = 0;
+    pushConstants.size = sizeof(jsr::GpuCullConstants);
+
+    VkPipelineLayoutCreateInfo plci = vks::initializers::pipelineLayoutCreateInfo(&cullSetLayout, 1);
+    plci.pushConstantRangeCount = 1;
+    plci.pPushConstantRanges = &pushConstants;
+    VK_CHECK(vkCreatePipelineLayout(d, &plci, nullptr, &cullPipelineLayout));
+
+    jvk::ShaderModule comp_module(*pDevice);
+    VK_CHECK(comp_module.create(basePath / "shaders/bin/cull_v2.comp.spv"));
+
+    VkComputePipelineCreateInfo cpci{};
+    cpci.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    cpci.layout = cullPipelineLayout;
+    cpci.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    cpci.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    cpci.stage.module = comp_module.module();
+    cpci.stage.pName = "main";
+    VK_CHECK(vkCreateComputePipelines(d, VK_NULL_HANDLE, 1, &cpci, nullptr, &cullPipeline));
+    pDevice->set_object_name((uint64_t)cullPipeline, VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT, "GPU culling pipeline");
+
+    // the upload is acquired on the graphics queue
+    cullObjectsOnCompute = false;
+
+    jsrlib::Info("GPU culling: %d objects in %d batches", (int)cullObjects.size(), (int)cullBatches.size());
 }
 
 void Sample1App::setup_samplers()
@@ -283,6 +404,7 @@ Sample1App::~Sample1App()
     if (!d || !prepared) return;
 
     vkDeviceWaitIdle(d);
+    pDevice->profiler = nullptr;
 
     std::array<RenderPass*, 3> rpasses = { &passes.preZ,&passes.tonemap,&passes.triangle };
     for (const auto* pass : rpasses)
@@ -290,6 +412,8 @@ Sample1App::~Sample1App()
         if (pass->pPipeline) delete pass->pPipeline;
     }
 
+    if (cullPipeline) vkDestroyPipeline(d, cullPipeline, nullptr);
+    if (cullPipelineLayout) vkDestroyPipelineLayout(d, cullPipelineLayout, nullptr);
     if (debugPipeline) vkDestroyPipeline(d, debugPipeline, nullptr);
     if (debugPipelineLayout) vkDestroyPipelineLayout(d, debugPipelineLayout, nullptr);
 
@@ -302,6 +426,9 @@ Sample1App::~Sample1App()
 
     for (size_t i(0); i < MAX_CONCURRENT_FRAMES; ++i)
     {
+        for (VkCommandPool pool : recordCmdPools[i]) {
+            if (pool) vkDestroyCommandPool(d, pool, nullptr);
+        }
         vkDestroyFramebuffer(d, fb[i], 0);
         vkDestroyFramebuffer(d, HDRFramebuffer[i], 0);
         vkDestroyImageView(d, depthResolvedView[i], 0);
@@ -309,122 +436,455 @@ Sample1App::~Sample1App()
     jsrlib::Info("Allocated descriptors: %d", vkutil::DescriptorAllocator::allocatedDescriptorCount);
 }
 
-void Sample1App::build_command_buffers()
+uint32_t Sample1App::record_draw_commands(VkCommandBuffer cmd, size_t first, size_t last)
 {
-    const bool MSAA_ENABLED = (settings.msaaSamples > VK_SAMPLE_COUNT_1_BIT);
-
-    VkCommandBuffer cmd = drawCmdBuffers[currentFrame];
     const VkDeviceSize offset = 0;
 
-    drawPool[currentFrame]->reset();
-
-    auto const col1 = vec4(1.f, .5f, 0.f, 1.f);
-    pDevice->begin_debug_marker_region(cmd, &col1.r, "Forward Pass");
-    VkRenderPassBeginInfo beginPass = vks::initializers::renderPassBeginInfo();
-    VkClearValue clearVal[3];
-    glm::vec4 sky = glm::vec4{ 0.2f, 0.3f, 0.4f, 0.0f };
-
-    clearVal[0].color = { sky.r,sky.g,sky.b,sky.a };
-    clearVal[1].color = { 0.0f,0.0f,0.0f,0.0f };
-    clearVal[2].depthStencil.depth = 0.0f;
-    //clearVal[3].color = { 0.0f,0.0f,0.0f,0.0f };
-    //clearVal[4].color = { 0.0f,0.0f,0.0f,0.0f };
-
-    beginPass.clearValueCount = 3;
-    beginPass.pClearValues = &clearVal[0];
-    beginPass.renderPass = passes.triangle.pass;
-    beginPass.framebuffer = HDRFramebuffer[currentFrame];
-    beginPass.renderArea.extent = swapchain.vkb_swapchain.extent;
-    beginPass.renderArea.offset = { 0,0 };
-
-    HDRImage_MS[currentFrame].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    vkCmdBeginRenderPass(cmd, &beginPass, VK_SUBPASS_CONTENTS_INLINE);
-
-    // vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, passes.triangle.pipeline);
     passes.triangle.pPipeline->bind(cmd);
-
     vkCmdBindVertexBuffers(cmd, 0, 1, &vtxbuf.buffer, &offset);
-    vkCmdBindIndexBuffer(cmd, idxbuf.buffer, 0ull, VK_INDEX_TYPE_UINT16);
+    vkCmdBindIndexBuffer(cmd, idxbuf.buffer, 0ull, indexType);
     VkViewport viewport{ 0.f,0.f,float(width),float(height),0.0f,1.0f };
     VkRect2D scissor{ 0,0,width,height };
     vkCmdSetViewport(cmd, 0, 1, &viewport);
     vkCmdSetScissor(cmd, 0, 1, &scissor);
+    // dynamic offsets in binding order: pass data, draw data, light clusters, light indices
+    const std::array<uint32_t, 4> dynamicOffsets = { frameUploads.passData, frameUploads.drawData, frameUploads.lightClusters, frameUploads.lightIndices };
+    passes.triangle.pPipeline->bind_descriptor_sets(cmd, 0, 1, &triangleDescriptors[currentFrame], uint32_t(dynamicOffsets.size()), dynamicOffsets.data());
+
+    uint32_t materialBinds = 0;
+    VkDescriptorSet boundMaterial = VK_NULL_HANDLE;
+    for (size_t i = first; i < last; ++i) {
+        const DrawCommand& dc = drawCommands[i];
+        if (dc.material != boundMaterial) {
+            passes.triangle.pPipeline->bind_descriptor_sets(cmd, 1, 1, &dc.material, 0, nullptr);
+            boundMaterial = dc.material;
+            materialBinds++;
+        }
+        vkCmdDrawIndexed(cmd, dc.range.indexCount, dc.instanceCount, dc.range.firstIndex, dc.vertexOffset, dc.firstInstance);
+    }
 
-    const mat4 vp = passData.mtxProjection * passData.mtxView;
-    jsr::Frustum frustum(vp);
+    return materialBinds;
+}
 
-    uint32_t dynOffset = 0;
-    size_t transientVtxOffset = 0;
+void Sample1App::upload_draw_data(const DrawData* data, size_t count)
+{
+    // the descriptor range is fixed, the allocation always covers it
+    auto upload = uploadRing->AllocateStorage(MAX_DRAW_INSTANCES * sizeof(DrawData));
+    assert(upload);
+    memcpy(upload.data, data, std::min(count, size_t(MAX_DRAW_INSTANCES)) * sizeof(DrawData));
+    frameUploads.drawData = uint32_t(upload.offset);
+}
 
-    jsr::Vertex v{};
+void Sample1App::record_forward_pass_cpu_culled(VkCommandBuffer cmd, const VkRenderPassBeginInfo& beginPass, const glm::mat4& vp)
+{
+    jsr::Frustum frustum(vp);
 
     visibleObjectCount = 0;
+    occludedObjectCount = 0;
+    submittedTriangleCount = 0;
+    meshletCullStats = {};
+    meshletCullMs = 0.0f;
+    // size of one unit at unit distance in pixels
+    const float pixelsPerUnit = 0.5f * float(height) * std::abs(passData.mtxProjection[1][1]);
     uint32_t objIdx = 0;
 
+    std::vector<bool> inFrustum(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i) {
+        inFrustum[i] = frustum.Intersects2(objects[i].aabb);
+    }
 
-    for (const auto& obj : objects) {
-        const auto& mesh = meshes[obj.mesh];
+    if (occlusionCulling) {
+        // big opaque objects close to the camera are used as occluders
+        occlusionBuffer.begin(vp);
+        size_t triangleBudget = MAX_OCCLUDER_TRIANGLES;
+        for (size_t i = 0; i < objects.size(); ++i) {
+            const auto& obj = objects[i];
+            const auto& md = world->meshes[obj.mesh];
+            const size_t triCount = md.indices.size() / 3;
+            if (!inFrustum[i] || world->materials[md.material].alphaMode != ALPHA_MODE_OPAQUE || triCount > triangleBudget) {
+                continue;
+            }
+            const float dist = std::max(postProcessData.fZnear, length(obj.aabb.GetCenter() - camera.Position));
+            if (obj.aabb.GetRadius() / dist < occluderMinSize) {
+                continue;
+            }
+            occlusionBuffer.addOccluder(md, obj.mtxModel);
+            triangleBudget -= triCount;
+        }
+        occlusionBuffer.end();
+    }
+
+    drawList.clear();
+    drawList.reserve(objects.size());
+
+    for (auto& obj : objects) {
         const int materialIndex = world->meshes[obj.mesh].material;
         const auto& material = world->materials[materialIndex];
 
-        const bool visible = frustum.Intersects2(obj.aabb);
+        bool visible = inFrustum[objIdx];
+        if (visible && occlusionCulling && !occlusionBuffer.isVisible(obj.aabb)) {
+            visible = false;
+            occludedObjectCount++;
+        }
 
         if (visible && material.alphaMode != ALPHA_MODE_BLEND) {
 
             visibleObjectCount++;
 
-            auto corners = obj.aabb.GetHomogenousCorners();
-            vec4 pp[8];
-
-            for (uint32_t i = 0; i < 8; ++i) {
-                vec4 p = vp * corners[i];
-                p /= p.w;
-                v.set_position(&p.x);
-                assert((transientVtxOffset + sizeof(jsr::Vertex)) < vtxStagingBuffer.size);
-                vtxStagingBuffer.copyTo(transientVtxOffset, sizeof(jsr::Vertex), &v);
-                transientVtxOffset += sizeof(jsr::Vertex);
+            if (meshletStats) {
+                const auto start = std::chrono::steady_clock::now();
+                jsr::cullMeshlets(world->meshes[obj.mesh], obj.mtxModel, frustum, camera.Position, !material.doubleSided, nullptr, &meshletCullStats);
+                meshletCullMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
             }
 
-            auto bufferDescr = drawPool[currentFrame]->Allocate<DrawData>(1, &drawDataStruct[objIdx]);
-            const VkDescriptorSet dsets[2] = { triangleDescriptors[currentFrame], obj.vkResources };
-            passes.triangle.pPipeline->bind_descriptor_sets(cmd, 2, dsets, 1, (uint32_t*)(&bufferDescr.offset));
+            const float centerDist = length(obj.aabb.GetCenter() - camera.Position);
+            if (lodEnabled) {
+                const float scale = std::max(length(vec3(obj.mtxModel[0])), std::max(length(vec3(obj.mtxModel[1])), length(vec3(obj.mtxModel[2]))));
+                const float dist = std::max(postProcessData.fZnear, centerDist - obj.aabb.GetRadius());
+                obj.lod = jsr::selectMeshLod(world->meshes[obj.mesh], pixelsPerUnit * scale / dist, lodErrorBudget, obj.lod);
+            }
+            else {
+                obj.lod = 0;
+            }
 
-            vkCmdDrawIndexed(cmd, mesh.indexCount, 1, mesh.firstIndex, mesh.firstVertex, objIdx);
+            const uint32_t pass = material.alphaMode == ALPHA_MODE_MASK ? jsr::DrawPass_AlphaTest : jsr::DrawPass_Opaque;
+            const uint64_t key = jsr::DrawKey::make(pass, 0, uint32_t(materialIndex), obj.mesh, obj.lod, centerDist / postProcessData.fZfar, false);
+            drawList.add(key, objIdx);
         }
-        dynOffset += dynamicAlignment;
         objIdx++;
     }
-    vkCmdEndRenderPass(cmd);
-    pDevice->end_debug_marker_region(cmd);
 
-    if (transientVtxOffset > 0)
+    drawList.sort();
+
+    // runs of the same state (pipeline, material, mesh, LOD) become one instanced draw,
+    // per instance data is read from the DrawData storage buffer with gl_InstanceIndex
+    const auto recordStart = std::chrono::high_resolution_clock::now();
+    drawCommands.clear();
+    instanceData.clear();
+    for (size_t first = 0; first < drawList.size() && instanceData.size() < MAX_DRAW_INSTANCES;) {
+        const auto& obj = objects[drawList[first].index];
+        const auto& mesh = meshes[obj.mesh];
+        const uint64_t state = jsr::DrawKey::getState(drawList[first].key);
+
+        size_t last = first + 1;
+        if (instancingEnabled) {
+            const size_t maxLast = std::min(drawList.size(), first + (MAX_DRAW_INSTANCES - instanceData.size()));
+            // the key saturates mesh and material indices past its fields, those are compared too
+            auto sameState = [&](size_t i) {
+                const auto& other = objects[drawList[i].index];
+                return jsr::DrawKey::getState(drawList[i].key) == state && other.mesh == obj.mesh && other.lod == obj.lod &&
+                    other.vkResources == obj.vkResources;
+            };
+            while (last < maxLast && sameState(last)) {
+                ++last;
+            }
+        }
+
+        DrawCommand dc;
+        dc.material = obj.vkResources;
+        dc.range = mesh.lods[obj.lod];
+        dc.vertexOffset = mesh.firstVertex;
+        dc.firstInstance = uint32_t(instanceData.size());
+        dc.instanceCount = uint32_t(last - first);
+        drawCommands.push_back(dc);
+
+        for (size_t i = first; i < last; ++i) {
+            instanceData.push_back(drawDataStruct[drawList[i].index]);
+        }
+        submittedTriangleCount += dc.instanceCount * dc.range.indexCount / 3;
+        first = last;
+    }
+    upload_draw_data(instanceData.data(), instanceData.size());
+
+    drawCallCount = uint32_t(drawCommands.size());
+    descriptorBindCount = 0;
+    materialBindCount = 0;
+
+    // secondary command buffers pay off only when there is enough to record
+    const uint32_t chunkCount = parallelRecording ? std::min(recordThreadCount, uint32_t(drawCommands.size() / MIN_DRAWS_PER_RECORD_CHUNK)) : 0;
+    if (chunkCount > 1) {
+        vkCmdBeginRenderPass(cmd, &beginPass, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+        VkCommandBufferInheritanceInfo inheritance = vks::initializers::commandBufferInheritanceInfo();
+        inheritance.renderPass = passes.triangle.pass;
+        inheritance.subpass = 0;
+        inheritance.framebuffer = HDRFramebuffer[currentFrame];
+
+        // chunks are contiguous to keep the sorted order, executed in order below
+        std::array<uint32_t, MAX_RECORD_THREADS> chunkBinds{};
+        const size_t chunkSize = (drawCommands.size() + chunkCount - 1) / chunkCount;
+        jsrlib::counting_semaphore counter;
+        for (uint32_t c = 0; c < chunkCount; ++c) {
+            jsr::jobsys.submitJob([this, c, chunkSize, &inheritance, &chunkBinds](int threadId)
+                {
+                    jvk::GpuProfiler::CpuScope cpuScope(gpuProfiler.get(), "Record draw chunk", uint32_t(threadId) + 1);
+                    VkCommandBuffer secondary = recordCmdBuffers[currentFrame][c];
+                    VK_CHECK(vkResetCommandPool(d, recordCmdPools[currentFrame][c], 0));
+
+                    VkCommandBufferBeginInfo beginInfo = vks::initializers::commandBufferBeginInfo();
+                    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                    beginInfo.pInheritanceInfo = &inheritance;
+                    VK_CHECK(vkBeginCommandBuffer(secondary, &beginInfo));
+
+                    const size_t first = c * chunkSize;
+                    const size_t last = std::min(drawCommands.size(), first + chunkSize);
+                    chunkBinds[c] = record_draw_commands(secondary, first, last);
+
+                    VK_CHECK(vkEndCommandBuffer(secondary));
+                }, &counter);
+        }
+        counter.wait();
+
+        vkCmdExecuteCommands(cmd, chunkCount, recordCmdBuffers[currentFrame].data());
+        for (uint32_t c = 0; c < chunkCount; ++c) {
+            materialBindCount += chunkBinds[c];
+        }
+        descriptorBindCount = chunkCount + materialBindCount;
+    }
+    else {
+        vkCmdBeginRenderPass(cmd, &beginPass, VK_SUBPASS_CONTENTS_INLINE);
+        materialBindCount = record_draw_commands(cmd, 0, drawCommands.size());
+        descriptorBindCount = 1 + materialBindCount;
+    }
+    recordChunkCount = chunkCount > 1 ? chunkCount : 0;
+    recordTimeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+
+}
+
+static_assert(sizeof(jsr::GpuDrawCommand) == sizeof(VkDrawIndexedIndirectCommand), "layout of the indirect commands");
+
+void Sample1App::record_gpu_cull(VkCommandBuffer cmd, const glm::mat4& vp)
+{
+    const uint32_t objectCount = uint32_t(cullObjects.size());
+    const jsr::Frustum frustum(vp);
+
+    // counters of this frame slot were written MAX_CONCURRENT_FRAMES frames ago, the frame fence has been waited for
+    const uint32_t* counts = reinterpret_cast<const uint32_t*>(cullCounts[currentFrame]->GetBuffer()->mapped);
+    uint32_t gpuVisible = 0;
+    for (size_t b = 0; b < cullBatches.size(); ++b) {
+        gpuVisible += counts[b];
+    }
+    if (cullExpected[currentFrame] >= 0 && gpuVisible != uint32_t(cullExpected[currentFrame])) {
+        jsrlib::Warning("GPU culling: %u objects visible, CPU reference: %d", gpuVisible, cullExpected[currentFrame]);
+    }
+    visibleObjectCount = gpuVisible;
+    occludedObjectCount = 0;
+    submittedTriangleCount = 0;
+
+    cullExpected[currentFrame] = -1;
+    if (validateGpuCulling) {
+        int expected = 0;
+        for (const auto& obj : cullObjects) {
+            expected += jsr::gpuCullVisible(frustum.GetPlanes(), obj.boundsMin, obj.boundsMax) ? 1 : 0;
+        }
+        cullExpected[currentFrame] = expected;
+    }
+
+    // indirect draws index DrawData by object
+    upload_draw_data(drawDataStruct.data(), drawDataStruct.size());
+
+    jsr::GpuCullConstants constants{};
+    memcpy(constants.frustumPlanes, frustum.GetPlanes(), sizeof(constants.frustumPlanes));
+    constants.objectCount = objectCount;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullDescriptors[currentFrame], 0, nullptr);
+    vkCmdPushConstants(cmd, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(cmd, (objectCount + jsr::GPU_CULL_GROUP_SIZE - 1) / jsr::GPU_CULL_GROUP_SIZE, 1, 1);
+}
+
+jvk::RenderGraph::PassBuilder Sample1App::add_gpu_cull_passes(jvk::RenderGraph& graph, const glm::mat4& vp, jvk::RenderGraph::Handle& countsRes, jvk::RenderGraph::Handle& commandsRes)
+{
+    countsRes = graph.ImportBuffer("Cull counts", cullCounts[currentFrame]->GetBuffer()->buffer);
+    commandsRes = graph.ImportBuffer("Cull draw commands", cullCommands[currentFrame]->GetBuffer()->buffer);
+
+    graph.AddPass("Clear cull counts", [this](VkCommandBuffer cmd)
+        {
+            vkCmdFillBuffer(cmd, cullCounts[currentFrame]->GetBuffer()->buffer, 0, cullBatches.size() * sizeof(uint32_t), 0);
+        })
+        .Write(countsRes, jvk::rg::TransferWrite, true);
+
+    auto cullPass = graph.AddPass("GPU cull", [this, vp](VkCommandBuffer cmd)
+        {
+            auto const col = vec4(1.f, 1.f, .5f, 1.f);
+            pDevice->begin_debug_marker_region(cmd, &col.r, "GPU cull");
+            record_gpu_cull(cmd, vp);
+            pDevice->end_debug_marker_region(cmd);
+        });
+    cullPass
+        .Read(countsRes, jvk::rg::ComputeShaderReadWrite)
+        .Write(countsRes, jvk::rg::ComputeShaderReadWrite)
+        .Write(commandsRes, jvk::rg::ComputeShaderWrite, true);
+
+    return cullPass;
+}
+
+void Sample1App::record_forward_pass_gpu_culled(VkCommandBuffer cmd, const VkRenderPassBeginInfo& beginPass, const glm::mat4& vp)
+{
+    const auto recordStart = std::chrono::high_resolution_clock::now();
+    const VkBuffer countBuffer = cullCounts[currentFrame]->GetBuffer()->buffer;
+    const VkBuffer commandBuffer = cullCommands[currentFrame]->GetBuffer()->buffer;
+
+    vkCmdBeginRenderPass(cmd, &beginPass, VK_SUBPASS_CONTENTS_INLINE);
+    record_draw_commands(cmd, 0, 0);
+
+    // one indirect draw per material, the count comes from the culling shader
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    for (size_t b = 0; b < cullBatches.size(); ++b) {
+        const CullBatch& batch = cullBatches[b];
+        passes.triangle.pPipeline->bind_descriptor_sets(cmd, 1, 1, &batch.material, 0, nullptr);
+        vkCmdDrawIndexedIndirectCount(cmd, commandBuffer, VkDeviceSize(batch.firstCommand) * stride, countBuffer, b * sizeof(uint32_t), batch.maxCount, stride);
+    }
+
+    drawCallCount = uint32_t(cullBatches.size());
+    materialBindCount = uint32_t(cullBatches.size());
+    descriptorBindCount = 1 + materialBindCount;
+    recordChunkCount = 0;
+    recordTimeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+}
+
+void Sample1App::build_command_buffers()
+{
+    const bool MSAA_ENABLED = (settings.msaaSamples > VK_SAMPLE_COUNT_1_BIT);
+
+    VkCommandBuffer cmd = drawCmdBuffers[currentFrame];
+    const VkDeviceSize offset = 0;
+
+    // the fence of this frame slot has been waited for, its queries are ready
+    gpuProfiler->BeginFrame(currentFrame);
+    jvk::GpuProfiler::CpuScope cpuScope(gpuProfiler.get(), "Build command buffers");
+
+    const jvk::UploadManager::Ticket uploadTicket = uploadManager->RecordAcquire(cmd);
+    if (uploadTicket) {
+        add_frame_wait(uploadManager->GetSemaphore(), uploadTicket, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    }
+
+    const mat4 vp = passData.mtxProjection * passData.mtxView;
+    jvk::RenderGraph::Handle cullCountsRes = jvk::RenderGraph::INVALID_HANDLE;
+    jvk::RenderGraph::Handle cullCommandsRes = jvk::RenderGraph::INVALID_HANDLE;
+
+    // GPU culling goes to the compute queue once the cull objects are owned by it,
+    // it overlaps the graphics work of the previous frame and the forward pass waits for it
+    asyncCompute->SetEnabled(asyncComputeEnabled);
+    const bool asyncCull = gpuCulling && asyncCompute->IsEnabled() && cullObjectsOnCompute;
+    if (gpuCulling && cullObjectsOnCompute)
     {
-        VkBufferCopy copy;
-        copy.srcOffset = 0;
-        copy.dstOffset = 0;
-        copy.size = transientVtxOffset;
-        vkCmdCopyBuffer(cmd, vtxStagingBuffer.buffer, transientVtxBuf[currentFrame].buffer, 1u, &copy);
-        VkMemoryBarrier vkmb = vks::initializers::memoryBarrier();
-        vkmb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        vkmb.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
-        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &vkmb, 0, nullptr, 0, nullptr);
+        VkCommandBuffer computeCmd = asyncCompute->Begin(currentFrame);
+        if (asyncCull)
+        {
+            computeGraph.Reset();
+            // the results leave the graph through the queue family release
+            add_gpu_cull_passes(computeGraph, vp, cullCountsRes, cullCommandsRes).SideEffect();
+            computeGraph.Execute(computeCmd);
+
+            asyncCompute->ReleaseToGraphics(cullCommands[currentFrame]->GetBuffer()->buffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+            // read back by the next use of this frame slot
+            asyncCompute->ReleaseToGraphics(cullCounts[currentFrame]->GetBuffer()->buffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT);
+        }
+        else
+        {
+            // back to a single queue
+            asyncCompute->ReleaseToGraphics(ssboCullObjects->GetBuffer()->buffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+            cullObjectsOnCompute = false;
+        }
+        const jvk::AsyncCompute::Ticket computeTicket = asyncCompute->Submit();
+        add_frame_wait(asyncCompute->GetSemaphore(), computeTicket, asyncCompute->RecordAcquire(cmd));
     }
 
-    /*
-        HDRImage[currentFrame].record_change_layout(cmd, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-    */
-    HDRImage_MS[currentFrame].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    HDR_NormalImage_MS[currentFrame].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-    auto const col2 = vec4(.5f, 1.f, .5f, 1.f);
-    pDevice->begin_debug_marker_region(cmd, &col2.r, "PostProcess Pass");
+    // passes declare their resources, the graph records the barriers between them
+    frameGraph.Reset();
+    const auto hdrColor = frameGraph.ImportImage("HDR color", &HDRImage[currentFrame]);
+    const auto backBuffer = frameGraph.ImportImage("Swapchain", &swapchain_images[currentBuffer], { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0 });
+    // the ImGui pass draws on top of it
+    frameGraph.SetOutput(backBuffer, jvk::rg::ColorAttachmentWrite);
+
+    VkRenderPassBeginInfo beginPass = vks::initializers::renderPassBeginInfo();
+    VkClearValue clearVal[3];
+    glm::vec4 sky = glm::vec4{ 0.2f, 0.3f, 0.4f, 0.0f };
+
+    clearVal[0].color = { sky.r,sky.g,sky.b,sky.a };
+    clearVal[1].color = { 0.0f,0.0f,0.0f,0.0f };
+    clearVal[2].depthStencil.depth = 0.0f;
+    //clearVal[3].color = { 0.0f,0.0f,0.0f,0.0f };
+    //clearVal[4].color = { 0.0f,0.0f,0.0f,0.0f };
+
+    beginPass.clearValueCount = 3;
+    beginPass.pClearValues = &clearVal[0];
+    beginPass.renderPass = passes.triangle.pass;
+    beginPass.framebuffer = HDRFramebuffer[currentFrame];
+    beginPass.renderArea.extent = swapchain.vkb_swapchain.extent;
+    beginPass.renderArea.offset = { 0,0 };
 
-    clearVal[0].color = { 0.f,0.f,0.f,1.f };
-    beginPass.clearValueCount = 1;
-    beginPass.renderPass = passes.tonemap.pass;
-    beginPass.framebuffer = fb[currentFrame];
-    //vkCmdBeginRenderPass(cmd, &beginPass, VK_SUBPASS_CONTENTS_INLINE);
+    HDRImage_MS[currentFrame].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkViewport viewport{ 0.f,0.f,float(width),float(height),0.0f,1.0f };
+    VkRect2D scissor{ 0,0,width,height };
+
+    if (asyncCull) {
+        // acquired from the compute queue, visible to the indirect draws and the host
+        cullCountsRes = frameGraph.ImportBuffer("Cull counts", cullCounts[currentFrame]->GetBuffer()->buffer, jvk::rg::IndirectRead);
+        cullCommandsRes = frameGraph.ImportBuffer("Cull draw commands", cullCommands[currentFrame]->GetBuffer()->buffer, jvk::rg::IndirectRead);
+    }
+    else if (gpuCulling) {
+        add_gpu_cull_passes(frameGraph, vp, cullCountsRes, cullCommandsRes);
+    }
+    if (gpuCulling) {
+        // read back by the next use of this frame slot
+        frameGraph.SetOutput(cullCountsRes, jvk::rg::HostRead);
+    }
+
+    // the light buffer of this slot is not read by a frame in flight, its fence has been waited for
+    jvk::RenderGraph::Handle lightsRes = jvk::RenderGraph::INVALID_HANDLE;
+    if (lightsDirty[currentFrame])
+    {
+        // a full partition leaves it for the next use of the slot
+        const jvk::UploadRing::Allocation upload = uploadRing->UploadStorage(lights.data(), lights.size());
+        if (upload)
+        {
+            const VkBuffer dst = ssboLights[currentFrame]->GetBuffer()->buffer;
+            lightsRes = frameGraph.ImportBuffer("Lights", dst, jvk::rg::FragmentShaderRead);
+            frameGraph.AddPass("Upload lights", [upload, dst](VkCommandBuffer cmd)
+                {
+                    const VkBufferCopy copy{ upload.offset, 0, upload.size };
+                    vkCmdCopyBuffer(cmd, upload.buffer, dst, 1, &copy);
+                })
+                .Write(lightsRes, jvk::rg::TransferWrite);
+            lightsDirty[currentFrame] = false;
+        }
+    }
+
+    auto forwardPass = frameGraph.AddPass("Forward Pass", [&](VkCommandBuffer cmd)
+        {
+            auto const col1 = vec4(1.f, .5f, 0.f, 1.f);
+            pDevice->begin_debug_marker_region(cmd, &col1.r, "Forward Pass");
+            if (gpuCulling) {
+                record_forward_pass_gpu_culled(cmd, beginPass, vp);
+            }
+            else {
+                record_forward_pass_cpu_culled(cmd, beginPass, vp);
+            }
+
+            vkCmdEndRenderPass(cmd);
+            pDevice->end_debug_marker_region(cmd);
+
+            HDRImage_MS[currentFrame].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            HDR_NormalImage_MS[currentFrame].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        });
+    // the render pass transitions its attachments, its external dependency covers the tonemap reads
+    forwardPass.Attachment(hdrColor, jvk::rg::ColorAttachmentWrite, jvk::rg::FragmentShaderRead);
+    if (gpuCulling) {
+        forwardPass.Read(cullCountsRes, jvk::rg::IndirectRead).Read(cullCommandsRes, jvk::rg::IndirectRead);
+    }
+    if (lightsRes != jvk::RenderGraph::INVALID_HANDLE) {
+        forwardPass.Read(lightsRes, jvk::rg::FragmentShaderRead);
+    }
 
     // New structures are used to define the attachments used in dynamic rendering
     VkRenderingAttachmentInfoKHR colorAttachment{};
@@ -444,40 +904,46 @@ void Sample1App::build_command_buffers()
     renderingInfo.pDepthAttachment = 0;
     renderingInfo.pStencilAttachment = 0;
 
-    if (swapchain_images[currentBuffer].layout != VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
-    {
-        swapchain_images[currentBuffer].record_layout_change(cmd,
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT);
-        swapchain_images[currentBuffer].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    frameGraph.AddPass("PostProcess Pass", [&](VkCommandBuffer cmd)
+        {
+            auto const col2 = vec4(.5f, 1.f, .5f, 1.f);
+            pDevice->begin_debug_marker_region(cmd, &col2.r, "PostProcess Pass");
+
+            // Begin dynamic rendering
+            vkCmdBeginRenderingKHR(cmd, &renderingInfo);
+
+            vkCmdSetViewport(cmd, 0, 1, &viewport);
+            vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+            //vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, passes.tonemap.pipeline);
+            passes.tonemap.pPipeline->bind(cmd);
+            passes.tonemap.pPipeline->bind_descriptor_sets(cmd, 1, &HDRDescriptor[currentFrame], 1, &frameUploads.postProcessData);
+            //vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, passes.tonemap.layout, 0, 1, &HDRDescriptor[currentFrame], 0, nullptr);
+            vkCmdDraw(cmd, 3, 1, 0, 0);
+            // End dynamic rendering
+            vkCmdEndRenderingKHR(cmd);
+
+            pDevice->end_debug_marker_region(cmd);
+        })
+        .Read(hdrColor, jvk::rg::FragmentShaderRead)
+        .Write(backBuffer, jvk::rg::ColorAttachmentWrite, true);
+
+    frameGraph.Compile();
+    frameGraph.Execute(cmd);
+
+    if (gpuCulling && !cullObjectsOnCompute && asyncCompute->IsEnabled()) {
+        // culled on this queue for the last time, the compute queue takes over from the next frame
+        asyncCompute->ReleaseToCompute(cmd, ssboCullObjects->GetBuffer()->buffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        cullObjectsOnCompute = true;
     }
-    // Begin dynamic rendering
-    vkCmdBeginRenderingKHR(cmd, &renderingInfo);
-
-    vkCmdSetViewport(cmd, 0, 1, &viewport);
-    vkCmdSetScissor(cmd, 0, 1, &scissor);
-
-    //vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, passes.tonemap.pipeline);
-    passes.tonemap.pPipeline->bind(cmd);
-    passes.tonemap.pPipeline->bind_descriptor_sets(cmd, 1, &HDRDescriptor[currentFrame]);
-    //vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, passes.tonemap.layout, 0, 1, &HDRDescriptor[currentFrame], 0, nullptr);
-    vkCmdDraw(cmd, 3, 1, 0, 0);
-#if 0
-    if (visibleObjectCount > 0)
-    {
-        vkCmdBindVertexBuffers(cmd, 0, 1, &transientVtxBuf[currentFrame].buffer, &offset);
-        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, debugPipeline);
-        vkCmdDraw(cmd, (transientVtxOffset / sizeof(vkjs::Vertex)), 1, 0, 0);
+    if (const jvk::AsyncCompute::Ticket graphicsSignal = asyncCompute->TakeGraphicsSignal()) {
+        add_frame_signal(asyncCompute->GetGraphicsSemaphore(), graphicsSignal);
     }
-#endif
-    //vkCmdEndRenderPass(cmd);
-    // End dynamic rendering
-    vkCmdEndRenderingKHR(cmd);
 
-    pDevice->end_debug_marker_region(cmd);
+    // host writes of this frame become visible at submit
+    uploadRing->Flush();
 }
 
 void Sample1App::render()
@@ -526,6 +992,14 @@ void Sample1App::render()
     passData.vScaleBias.w = 0.f;
     passData.vParams.y = exposure;
 
+    // the shaders flip y, the cluster tiles follow the framebuffer
+    mat4 clusterProj = passData.mtxProjection;
+    clusterProj[1][1] = -clusterProj[1][1];
+    // the slices end where the farthest light does, fragments past it get no clustered lights
+    lightClusters.setup(clusterProj, zNear, LightClusters::getLightFarDepth(lights.data(), lights.size(), passData.mtxView, zNear, zFar));
+    const vec2 sliceScaleBias = lightClusters.getSliceScaleBias();
+    passData.vClusterParams = vec4(sliceScaleBias, float(LightClusters::GRID_X) / width, float(LightClusters::GRID_Y) / height);
+
     postProcessData.fExposure = exposure;
     postProcessData.mtxInvProj = inverse(passData.mtxProjection * passData.mtxView);
     postProcessData.fZnear = zNear;
@@ -548,6 +1022,16 @@ void Sample1App::render()
     fbci.height = height;
     VK_CHECK(vkCreateFramebuffer(d, &fbci, 0, &fb[currentFrame]));
 
+    // images replaced by streaming are destroyed once no frame in flight samples them
+    while (!retiredImages.empty() && retiredImages.front().first <= frameCounter) {
+        pDevice->destroy_image(&retiredImages.front().second);
+        retiredImages.pop_front();
+    }
+    request_streamed_textures(passData.mtxProjection * passData.mtxView);
+    textureStreamer->update();
+    update_streamed_materials();
+
+    uploadManager->Submit();
     build_command_buffers();
 
     firstRun = false;
@@ -661,11 +1145,12 @@ void Sample1App::setup_triangle_pipeline(RenderPass& pass)
 
     if (pass.pPipeline) delete pass.pPipeline;
 
-    auto vertexInput = jsr::Vertex::vertex_input_description();
+    const bool compact = vertexFormat == jsr::VERTEX_FORMAT_COMPACT;
+    auto vertexInput = compact ? jsr::VertexCompact::vertex_input_description() : jsr::Vertex::vertex_input_description();
 
     jvk::ShaderModule vert_module(*pDevice);
     jvk::ShaderModule frag_module(*pDevice);
-    VK_CHECK(vert_module.create(basePath / "shaders/bin/triangle_v2.vert.spv"));
+    VK_CHECK(vert_module.create(basePath / (compact ? "shaders/bin/triangle_v2_compact.vert.spv" : "shaders/bin/triangle_v2.vert.spv")));
     VK_CHECK(frag_module.create(basePath / "shaders/bin/triangle_v2.frag.spv"));
 
     jvk::GraphicsShaderInfo shaders = {};
@@ -816,9 +1301,10 @@ void Sample1App::setup_triangle_pass()
     size_t dep = 0;
     deps[dep].sType = VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2;
     deps[dep].dependencyFlags = 0;
-    deps[dep].srcAccessMask = VK_ACCESS_NONE;
+    // the color attachments of all frame slots alias, wait for the writes of the previous frame
+    deps[dep].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
     deps[dep].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
-    deps[dep].srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    deps[dep].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     deps[dep].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     deps[dep].srcSubpass = VK_SUBPASS_EXTERNAL;
     deps[dep].dstSubpass = 0;
@@ -962,6 +1448,30 @@ void Sample1App::setup_tonemap_pass()
 
 void Sample1App::setup_images()
 {
+    const bool msaaEnabled = settings.msaaSamples > VK_SAMPLE_COUNT_1_BIT;
+
+    // Attachments that are dead outside the forward pass share memory. Every frame slot counts as one pass:
+    // the external dependency of the forward render pass orders the attachment writes of consecutive frames.
+    if (!transientTargets) {
+        transientTargets = std::make_unique<jvk::TransientAllocator>(pDevice);
+    }
+    transientTargets->Release();
+    for (uint32_t i = 0; i < MAX_CONCURRENT_FRAMES; ++i)
+    {
+        if (msaaEnabled) {
+            transientTargets->AddColorAttachment(&HDRImage_MS[i], HDR_RT_FMT, swapchain.extent(), settings.msaaSamples, i, i);
+            transientTargets->AddColorAttachment(&HDR_NormalImage_MS[i], NORMAL_RT_FMT, swapchain.extent(), settings.msaaSamples, i, i);
+        }
+        // never sampled, only written by the forward pass
+        transientTargets->AddColorAttachment(&HDR_NormalImage[i], NORMAL_RT_FMT, swapchain.extent(), VK_SAMPLE_COUNT_1_BIT, i, i);
+    }
+    VK_CHECK(transientTargets->Allocate());
+    {
+        const auto& ts = transientTargets->GetStats();
+        jsrlib::Info("Transient targets: %d images, %d MB allocated (%d MB lazily), %d MB saved by aliasing",
+            (int)ts.imageCount, int(ts.allocatedBytes >> 20), int(ts.lazyBytes >> 20), int((ts.requestedBytes - ts.allocatedBytes) >> 20));
+    }
+
     for (size_t i(0); i < MAX_CONCURRENT_FRAMES; ++i)
     {
         if (HDRFramebuffer[i] != VK_NULL_HANDLE) {
@@ -971,15 +1481,6 @@ void Sample1App::setup_images()
             pDevice->destroy_image(&depthResolved[i]);
             vkDestroyImageView(d, depthResolvedView[i], nullptr);
         }
-        if (HDRImage_MS[i].image != VK_NULL_HANDLE) {
-            pDevice->destroy_image(&HDRImage_MS[i]);
-        }
-        if (HDR_NormalImage_MS[i].image != VK_NULL_HANDLE) {
-            pDevice->destroy_image(&HDR_NormalImage_MS[i]);
-        }
-        if (HDR_NormalImage[i].image != VK_NULL_HANDLE) {
-            pDevice->destroy_image(&HDR_NormalImage[i]);
-        }
 
         VK_CHECK(pDevice->create_depth_stencil_attachment(depth_format,
             swapchain.extent(),
@@ -998,40 +1499,27 @@ void Sample1App::setup_images()
         VK_CHECK(vkCreateImageView(d, &view, nullptr, &depthResolvedView[i]));
         pDevice->set_object_name((uint64_t)depthResolvedView[i], VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_VIEW_EXT, "Resolved Depth View");
 
-        VK_CHECK(pDevice->create_color_attachment(HDR_RT_FMT,
-            swapchain.extent(),
-            settings.msaaSamples,
-            &HDRImage_MS[i]));
         VK_CHECK(pDevice->create_color_attachment(HDR_RT_FMT,
             swapchain.extent(),
             VK_SAMPLE_COUNT_1_BIT,
             &HDRImage[i]));
-        VK_CHECK(pDevice->create_color_attachment(NORMAL_RT_FMT,
-            swapchain.extent(),
-            settings.msaaSamples,
-            &HDR_NormalImage_MS[i]));
-        VK_CHECK(pDevice->create_color_attachment(NORMAL_RT_FMT,
-            swapchain.extent(),
-            VK_SAMPLE_COUNT_1_BIT,
-            &HDR_NormalImage[i]));
 
-        pDevice->set_image_name(&HDRImage_MS[i], "HDR MS Img");
         pDevice->set_image_name(&HDRImage[i], "Resolved HDR Img");
-        pDevice->set_image_name(&HDR_NormalImage_MS[i], "Normal map MS Img");
         pDevice->set_image_name(&HDR_NormalImage[i], "Normal map Img");
-
-        pDevice->set_object_name((uint64_t)HDRImage_MS[i].view, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_VIEW_EXT, "HDR MS View");
         pDevice->set_object_name((uint64_t)HDRImage[i].view, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_VIEW_EXT, "Resolved HDR View");
-        pDevice->set_object_name((uint64_t)HDR_NormalImage_MS[i].view, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_VIEW_EXT, "Normal map View");
         pDevice->set_object_name((uint64_t)HDR_NormalImage[i].view, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_VIEW_EXT, "Resolved Normal map View");
 
         //depthResolved[i].change_layout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
-        pDevice->set_image_name(&HDRImage_MS[i], "Forward Color Attachment " + std::to_string(i));
-        pDevice->set_image_name(&HDR_NormalImage_MS[i], "Forward Normal Attachment " + std::to_string(i));
+        if (msaaEnabled) {
+            pDevice->set_image_name(&HDRImage_MS[i], "Forward Color Attachment " + std::to_string(i));
+            pDevice->set_image_name(&HDR_NormalImage_MS[i], "Forward Normal Attachment " + std::to_string(i));
+            pDevice->set_object_name((uint64_t)HDRImage_MS[i].view, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_VIEW_EXT, "HDR MS View");
+            pDevice->set_object_name((uint64_t)HDR_NormalImage_MS[i].view, VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_VIEW_EXT, "Normal map View");
+        }
 
         std::vector<VkImageView> targets;
-        if (settings.msaaSamples > VK_SAMPLE_COUNT_1_BIT)
+        if (msaaEnabled)
         {
             targets = {
                 HDRImage_MS[i].view,
@@ -1055,8 +1543,8 @@ void Sample1App::setup_images()
         fbci.layers = 1;
         fbci.attachmentCount = static_cast<uint32_t>(targets.size());
         fbci.pAttachments = targets.data();
-        fbci.width = HDRImage_MS[i].extent.width;
-        fbci.height = HDRImage_MS[i].extent.height;
+        fbci.width = HDRImage[i].extent.width;
+        fbci.height = HDRImage[i].extent.height;
         VK_CHECK(vkCreateFramebuffer(d, &fbci, 0, &HDRFramebuffer[i]));
 
         if (ssaoNoise.image == VK_NULL_HANDLE)
@@ -1094,9 +1582,7 @@ void Sample1App::prepare()
     setup_descriptor_pools();
     setup_samplers();
 
-    // Calculate required alignment based on minimum device offset alignment
-    minUboAlignment = pDevice->vkbPhysicalDevice.properties.limits.minUniformBufferOffsetAlignment;
-    drawDataBufferSize = 1024 * align_size(sizeof(DrawData), minUboAlignment);
+    recordThreadCount = std::min(MAX_RECORD_THREADS, uint32_t(std::max(1, jsr::jobsys.getWorkerCount())));
     camera.MovementSpeed = 0.003f;
     passData.vLightPos = glm::vec4(0.f, 1.5f, 0.f, 10.f);
     passData.vLightColor = glm::vec4(0.800f, 0.453f, 0.100f, 2300.f);
@@ -1127,7 +1613,17 @@ void Sample1App::prepare()
     pDevice->create_buffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 128ULL * 1024 * 1024, &vtxbuf);
     pDevice->create_buffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 128ULL * 1024 * 1024, &idxbuf);
 
-    pDevice->create_staging_buffer(static_cast<VkDeviceSize>(1 * 1024) * 1024, &vtxStagingBuffer);
+    uploadRing = std::make_unique<jvk::UploadRing>(pDevice, UPLOAD_RING_FRAME_SIZE, MAX_CONCURRENT_FRAMES,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    uploadRing->SetName("Upload ring");
+    uploadManager = std::make_unique<jvk::UploadManager>(pDevice);
+    asyncCompute = std::make_unique<jvk::AsyncCompute>(pDevice, MAX_CONCURRENT_FRAMES);
+    gpuProfiler = std::make_unique<jvk::GpuProfiler>(pDevice, MAX_CONCURRENT_FRAMES);
+    pDevice->profiler = gpuProfiler.get();
+    if (!gpuProfiler->IsSupported()) {
+        jsrlib::Warning("GPU profiler: no timestamp support on the graphics and compute queues, only CPU scopes are recorded");
+    }
+    jsrlib::Info("Async compute: %s", asyncCompute->IsAvailable() ? "dedicated compute queue" : "not available, single queue");
 
     pDevice->set_buffer_name(&vtxbuf, "Vertex Buffer");
     pDevice->set_buffer_name(&idxbuf, "Index Buffer");
@@ -1144,27 +1640,20 @@ void Sample1App::prepare()
     uvChecker.setup_descriptor();
     uvChecker.descriptor.sampler = sampLinearRepeat;
 
-    jvk::Buffer* drawBuf = new jvk::Buffer();
-    pDevice->create_uniform_buffer(drawDataBufferSize * MAX_CONCURRENT_FRAMES, false, drawBuf); drawBuf->map();
-
     for (size_t i = 0; i < MAX_CONCURRENT_FRAMES; ++i)
     {
-        VK_CHECK(pDevice->create_buffer(
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            1ULL * 1024 * 1024, &transientVtxBuf[i]));
-
-        uboPassData[i] = UniformBuffer::CreateShared(pDevice, 8 * 1024, false);
-        uboPassData[i]->Map();
-        uboPassData[i]->SetName("PerPass UBO " + std::to_string(i));
-
-        uboPostProcessData[i] = UniformBuffer::CreateShared(pDevice, sizeof(PostProcessData), false);
-        uboPostProcessData[i]->Map();
-        uboPostProcessData[i]->SetName("PostProcData UBO " + std::to_string(i));
+        // one pool per recording chunk, a pool is only touched by the job recording that chunk
+        for (uint32_t c = 0; c < recordThreadCount; ++c) {
+            VkCommandPoolCreateInfo cpci = vks::initializers::commandPoolCreateInfo();
+            cpci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            cpci.queueFamilyIndex = pDevice->queue_family_indices.graphics;
+            VK_CHECK(vkCreateCommandPool(d, &cpci, nullptr, &recordCmdPools[i][c]));
+            VkCommandBufferAllocateInfo cbai = vks::initializers::commandBufferAllocateInfo(recordCmdPools[i][c], VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+            VK_CHECK(vkAllocateCommandBuffers(d, &cbai, &recordCmdBuffers[i][c]));
+        }
 
-        drawPool[i] = new UniformBufferPool(drawBuf, drawDataBufferSize, i * drawDataBufferSize, minUboAlignment);
-        //pDevice->create_uniform_buffer(lights.size() * sizeof(Light), true, &uboLights[i]);
-        uboLights[i] = UniformBuffer::CreateShared(pDevice, lights.size() * sizeof(Light), true);
+        ssboLights[i] = StorageBuffer::CreateShared(pDevice, MAX_LIGHTS * sizeof(Light), false);
+        ssboLights[i]->SetName("Lights SSBO " + std::to_string(i));
     }
 
     world = std::make_unique<World>();
@@ -1183,16 +1672,40 @@ void Sample1App::prepare()
 
     const int sceneIdx = 0;
     auto scenePath = scenes[sceneIdx].dir;
-    jsr::gltfLoadWorld(scenePath / scenes[sceneIdx].file, *world);
-
-    std::vector<jsr::Vertex> vertices;
-    std::vector<uint16_t> indices;
+    const fs::path sourcePath = scenePath / scenes[sceneIdx].file;
+    fs::path cachePath = sourcePath;
+    cachePath += ".jscache";
+
+    // cold start parses the glTF and bakes the cache, warm start maps it
+    const auto loadStart = std::chrono::steady_clock::now();
+    jsr::SceneCache sceneCache;
+    std::vector<fs::path> sceneSources;
+    // a cache baked with the other vertex format fails on the stride
+    const bool compactVertices = vertexFormat == jsr::VERTEX_FORMAT_COMPACT;
+    const size_t vertexStride = compactVertices ? sizeof(jsr::VertexCompact) : sizeof(jsr::Vertex);
+    // the index size depends on the meshes, either one is accepted
+    const bool warmStart = sceneCache.open(cachePath, uint32_t(vertexStride), 0) && sceneCache.load(*world);
+    if (!warmStart) {
+        world = std::make_unique<World>();
+        jsr::gltfLoadWorld(sourcePath, *world, &sceneSources);
+    }
+    // texture loading is the same on both paths, it is not part of the timing
+    double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
 
-    uint32_t firstIndex(0);
-    uint32_t firstVertex(0);
+    std::vector<uint8_t> vertices;
+    std::vector<uint8_t> indices;
 
     materials.resize(world->materials.size());
 
+    const VkPhysicalDeviceFeatures& deviceFeatures = pDevice->vkbPhysicalDevice.features;
+    transcodeTargets.astc = deviceFeatures.textureCompressionASTC_LDR;
+    transcodeTargets.etc2 = deviceFeatures.textureCompressionETC2;
+    transcodeTargets.bc = deviceFeatures.textureCompressionBC;
+    // transcoding is the slow part of loading, a warm cache skips it
+    textureCache = std::make_unique<jsr::TextureCache>(scenePath / "ktx" / "cache");
+    streamBackend = std::make_unique<StreamedTextureBackend>(this, transcodeTargets, textureCache.get());
+    textureStreamer = std::make_unique<jsr::TextureStreamer>(*streamBackend, size_t(textureBudgetMB) << 20, MAX_TEXTURE_STREAM_LOADS);
+
     int i = 0;
     jsrlib::Info("Loading images...");
     for (auto it = world->materials.begin(); it != world->materials.end(); it++)
@@ -1212,89 +1725,106 @@ void Sample1App::prepare()
                 fname[i] = fname[i].replace(found, 3, " ");
             }
         }
-        create_material_texture(fname[0]);
-        create_material_texture(fname[1]);
-        create_material_texture(fname[2]);
-        create_material_texture(fname[3]);
-
-        std::array<VkDescriptorImageInfo, 4> images{
-            imageCache.at(fname[0]).descriptor,
-            imageCache.at(fname[1]).descriptor,
-            imageCache.at(fname[2]).descriptor,
-            imageCache.at(fname[3]).descriptor
-        };
-
-        descMgr.builder()
-            .bind_images(0, static_cast<uint32_t>(images.size()), images.data(), VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-            //            .bind_image(1, &imageCache.at(fname[1]).descriptor, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-            //            .bind_image(2, &imageCache.at(fname[2]).descriptor, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-            .build(materials[i++].resources);
+        for (int t = 0; t < 4; ++t) {
+            materials[i].textures[t] = fname[t];
+            materials[i].streamIds[t] = add_streamed_texture(fname[t], uint32_t(i));
+        }
+        ++i;
     }
 
-    const vec4 v4_one = vec4(1.0f);
-    for (size_t i(0); i < world->meshes.size(); ++i)
+    // the mip tails of the streamed textures load in parallel, the finer levels come with the frames
+    const auto tailStart = std::chrono::steady_clock::now();
+    textureStreamer->loadMipTails();
+    jsrlib::Info("Mip tails of %d streamed textures loaded in %.1f ms, %d KB, texture cache %d hits, %d misses, %d rejected",
+        int(textureStreamer->getStats().streamedTextures),
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tailStart).count(),
+        int(textureStreamer->getStats().residentBytes >> 10),
+        int(textureCache->getStats().hits), int(textureCache->getStats().misses), int(textureCache->getStats().rejected));
+
+    // the rest is decoded and transcoded on the job system
+    std::vector<std::string> wholeTextures;
+    for (auto& material : materials)
     {
-        auto& mesh = world->meshes[i];
-        const size_t numVerts = mesh.positions.size() / (3 * sizeof(float));
-        for (size_t i(0); i < numVerts; ++i)
-        {
-            vertices.emplace_back();
-            auto& v = vertices.back();
-            v.set_position((float*)&mesh.positions[i * 3 * sizeof(float)]);
-            v.set_uv((float*)&mesh.uvs[i * 2 * sizeof(float)]);
-            v.pack_normal((float*)&mesh.normals[i * 3 * sizeof(float)]);
-            v.pack_tangent((float*)&mesh.tangents[i * 4 * sizeof(float)]);
-            v.pack_color(&v4_one[0]);
-        }
-        meshes.emplace_back();
-        auto& rmesh = meshes.back();
-        rmesh.firstVertex = firstVertex;
-        firstVertex += numVerts;
-
-        for (size_t i(0); i < mesh.indices.size(); ++i)
-        {
-            indices.push_back((uint16_t)mesh.indices[i]);
+        for (int t = 0; t < 4; ++t) {
+            if (material.streamIds[t] != ~0u && !textureStreamer->isStreamed(material.streamIds[t])) {
+                material.streamIds[t] = ~0u;
+            }
+            if (material.streamIds[t] == ~0u) {
+                wholeTextures.push_back(material.textures[t]);
+            }
         }
-        rmesh.firstIndex = firstIndex;
-        rmesh.indexCount = mesh.indices.size();
-        firstIndex += rmesh.indexCount;
-
     }
+    create_material_textures(wholeTextures);
 
-    VkDeviceSize vertexBytes = sizeof(vertices[0]) * vertices.size();
-    VkDeviceSize indexBytes = sizeof(indices[0]) * indices.size();
-
-    jvk::Buffer stagingBuffer;
-
-    pDevice->create_staging_buffer(std::max(vertexBytes, indexBytes), &stagingBuffer);
-    stagingBuffer.copyTo(0, vertexBytes, vertices.data());
-    pDevice->buffer_copy(&stagingBuffer, &vtxbuf, 0, 0, vertexBytes);
-    stagingBuffer.copyTo(0, indexBytes, indices.data());
-    pDevice->buffer_copy(&stagingBuffer, &idxbuf, 0, 0, indexBytes);
-    pDevice->destroy_buffer(&stagingBuffer);
+    for (auto& material : materials)
+    {
+        bool streamed = false;
+        for (uint32_t id : material.streamIds) {
+            streamed = streamed || id != ~0u;
+        }
 
-    setup_objects();
+        std::array<VkDescriptorImageInfo, 4> images{
+            imageCache.at(material.textures[0]).descriptor,
+            imageCache.at(material.textures[1]).descriptor,
+            imageCache.at(material.textures[2]).descriptor,
+            imageCache.at(material.textures[3]).descriptor
+        };
 
-    const size_t size = drawDataBufferSize * MAX_CONCURRENT_FRAMES;
-    //pDevice->create_uniform_buffer(size, false, &uboDrawData);
-    uboDrawData = std::make_unique<jvk::UniformBuffer>(pDevice, size, false);
-    uboDrawData->SetName("DrawData UBO");
-    
-    jvk::Buffer stage;
-    pDevice->create_staging_buffer(size, &stage);
-    stage.copyTo(0, drawDataBufferAligned.size(), drawDataBufferAligned.data());
-    for (size_t i = 0; i < MAX_CONCURRENT_FRAMES; ++i)
-    {
-        //pDevice->buffer_copy(&stage, &uboDrawData, 0, i * drawDataBufferSize, drawData.size());
-        uboDrawData->CopyTo(&stage, 0, i * drawDataBufferSize, drawDataBufferAligned.size());
+        const size_t setCount = streamed ? material.sets.size() : 1;
+        for (size_t s = 0; s < setCount; ++s) {
+            descMgr.builder()
+                .bind_images(0, static_cast<uint32_t>(images.size()), images.data(), VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+                .build(material.sets[s]);
+        }
+        material.resources = material.sets[0];
+    }
+    // the sets were just built with the tails
+    dirtyMaterials.clear();
+
+    const auto geometryStart = std::chrono::steady_clock::now();
+    // offsets of every mesh first, a prefix sum over the vertex and index counts
+    uint32_t vertexCount, indexCount;
+    jsr::layoutPackedMeshes(world->meshes, meshes, vertexCount, indexCount);
+
+    // then a job per mesh packs straight into its own range of the final arrays
+    jsr::SceneCache::GpuBlobs blobs = sceneCache.getGpuBlobs();
+    if (!warmStart) {
+        const uint32_t indexSize = jsr::getPackedIndexSize(world->meshes);
+        if (!jsr::packMeshes(world->meshes, meshes, vertexFormat, indexSize, vertices, indices, &jsr::jobsys)) {
+            jsrlib::Error("Scene has indices past the vertices of their mesh");
+        }
+        blobs.vertices = vertices.data();
+        blobs.vertexBytes = vertices.size();
+        blobs.vertexStride = uint32_t(vertexStride);
+        blobs.indices = indices.data();
+        blobs.indexBytes = indices.size();
+        blobs.indexSize = indexSize;
+    }
+    indexType = blobs.indexSize == sizeof(uint32_t) ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+    // the staging copy is made here, the mapping can go after it
+    uploadManager->UploadBuffer(&vtxbuf, 0, blobs.vertices, blobs.vertexBytes, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    uploadManager->UploadBuffer(&idxbuf, 0, blobs.indices, blobs.indexBytes, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+
+    loadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - geometryStart).count();
+    if (warmStart) {
+        sceneCache.close();
+        jsrlib::Info("Scene loaded from cache in %.1f ms (warm start)", loadMs);
+    }
+    else {
+        jsrlib::Info("Scene loaded from glTF in %.1f ms (cold start)", loadMs);
+        const auto bakeStart = std::chrono::steady_clock::now();
+        if (!sceneSources.empty() && jsr::SceneCache::write(cachePath, sceneSources, *world, blobs)) {
+            jsrlib::Info("Scene cache baked in %.1f ms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bakeStart).count());
+        }
     }
-    pDevice->destroy_buffer(&stage);
 
+    setup_objects();
 
     const int kernelSize = sizeof(passData.avSSAOkernel) / sizeof(passData.avSSAOkernel[0]);
 
     init_lights();
     setup_descriptor_sets();
+    setup_gpu_culling();
 
     postProcessData.fExposure = 1.0f;
     postProcessData.vFogParams = { 0.001f,0.0001f,0.0f,0.0f };
@@ -1317,6 +1847,7 @@ void Sample1App::get_enabled_features()
     enabled_features.textureCompressionBC = VK_TRUE;
     enabled_features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
     enabled_features.sampleRateShading = VK_TRUE;
+    enabled_features.multiDrawIndirect = VK_TRUE;
 
     enabled_features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
     enabled_features12.pNext = nullptr;
@@ -1328,6 +1859,8 @@ void Sample1App::get_enabled_features()
     enabled_features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
     enabled_features12.shaderFloat16 = VK_TRUE;
     enabled_features12.descriptorIndexing = VK_TRUE;
+    enabled_features12.drawIndirectCount = VK_TRUE;
+    enabled_features12.timelineSemaphore = VK_TRUE;
 }
 
 void Sample1App::get_enabled_extensions()
@@ -1346,144 +1879,180 @@ void Sample1App::get_enabled_extensions()
     required_generic_features.push_back(jvk::GenericFeature(dynamicRenderingFeaturesKHR));
 }
 
-void Sample1App::create_material_texture(const std::string& filename)
+void Sample1App::create_material_image(const jsr::MaterialImage& image)
 {
-    std::string fn = filename;
-
-    if (imageCache.find(fn) == imageCache.end())
+    jvk::Image newImage;
+    if (image.format == VK_FORMAT_UNDEFINED)
     {
-        int w, h, nc;
-        // load image
-        jvk::Image newImage;
-        fs::path base = fs::path(fn).parent_path();
-        fs::path name = fs::path(fn).filename();
-        name.replace_extension("ktx2");
-        auto dds = base / "dds" / name;
-        auto ktx = base / "ktx" / name;
-
-        bool bOk = false;
-#if 0
-        gli::texture tex = gli::load(dds.u8string());
+        jsrlib::Error("%s notfund", image.filename.c_str());
+        pDevice->create_texture2d(VK_FORMAT_R8G8B8A8_UNORM, { 1,1,1 }, &newImage);
+        newImage.layout_change(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+    else
+    {
+        VK_CHECK(pDevice->create_texture2d_with_mips(image.format, image.extent, &newImage));
+        const uint8_t* data = image.cached ? image.mappedData : image.data.data();
+        const size_t size = image.cached ? image.mappedSize : image.data.size();
+        uploadManager->UploadImage(&newImage, data, size,
+            [&image](uint32_t layer, uint32_t face, uint32_t level, jvk::Image::UploadInfo* inf)
+            {
+                inf->extent = { std::max(1u, image.extent.width >> level), std::max(1u, image.extent.height >> level), 1 };
+                inf->offset = image.levelOffsets[level];
+            }, image.generateMips);
+    }
+    newImage.setup_descriptor();
+    newImage.descriptor.sampler = sampLinearRepeat;
+    imageCache.insert({ image.filename, newImage });
+}
 
-        if (!tex.empty())
-        {
-            device->create_texture2d_with_mips(gliutils::convert_format(tex.format()), gliutils::convert_extent(tex.extent()), &newImage);
-            vkjs::Buffer stagebuf;
-            device->create_staging_buffer(tex.size(), &stagebuf);
-            stagebuf.copyTo(0, tex.size(), tex.data());
-            newImage.upload([&tex](uint32_t layer, uint32_t face, uint32_t level, vkjs::Image::UploadInfo* inf)
-                {
-                    inf->extent = gliutils::convert_extent(tex.extent(level));
-                    inf->offset = (size_t)tex.data(layer, face, level) - (size_t)tex.data();
-                }, &stagebuf);
-            newImage.change_layout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-            device->destroy_buffer(&stagebuf);
-            jsrlib::Info("%s Loaded", dds.u8string().c_str());
+void Sample1App::create_material_textures(const std::vector<std::string>& filenames)
+{
+    std::vector<std::string> pending;
+    std::unordered_set<std::string> seen;
+    for (const auto& fn : filenames) {
+        if (imageCache.find(fn) == imageCache.end() && seen.insert(fn).second) {
+            pending.push_back(fn);
         }
-#endif
+    }
+    if (pending.empty()) {
+        return;
+    }
 
-        ktxTexture* kTexture;
-        KTX_error_code result;
+    // decoded images wait for the main thread to upload them, the number of them is bounded
+    const size_t workers = size_t(std::max(1, jsr::jobsys.getWorkerCount()));
+    const size_t maxInFlight = MAX_TEXTURE_DECODES_PER_WORKER * workers;
+    const auto start = std::chrono::steady_clock::now();
+    float decodeMs = 0.0f;
+    const uint32_t cacheHits = textureCache->getStats().hits;
+    const bool ok = jsr::loadMaterialImages(jsr::jobsys, pending, transcodeTargets, textureCache.get(), maxInFlight, [this, &decodeMs](jsr::MaterialImage& image)
+        {
+            decodeMs += image.decodeMs;
+            create_material_image(image);
+        });
+    if (!ok) {
+        const std::string message = "Vulkan implementation does not support any available transcode target.";
+        throw std::runtime_error(message.c_str());
+    }
 
-        result = ktxTexture_CreateFromNamedFile(ktx.u8string().c_str(),
-            KTX_TEXTURE_CREATE_NO_FLAGS,
-            &kTexture);
+    const float wallMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    jsrlib::Info("%d material textures loaded in %.1f ms, decode and transcode %.1f ms on %d workers (%.1fx), at most %d in flight, %d from the texture cache",
+        int(pending.size()), wallMs, decodeMs, int(workers), wallMs > 0.0f ? decodeMs / wallMs : 0.0f, int(maxInFlight),
+        int(textureCache->getStats().hits - cacheHits));
+}
 
-        if (result == KTX_SUCCESS)
-        {
-            if (ktxTexture2_NeedsTranscoding((ktxTexture2*)kTexture)) {
-                ktx_texture_transcode_fmt_e tf;
-
-                // Using VkGetPhysicalDeviceFeatures or GL_COMPRESSED_TEXTURE_FORMATS or
-                // extension queries, determine what compressed texture formats are
-                // supported and pick a format. For example
-                VkPhysicalDeviceFeatures deviceFeatures = pDevice->vkbPhysicalDevice.features;
-                khr_df_model_e colorModel = ktxTexture2_GetColorModel_e((ktxTexture2*)kTexture);
-                if (colorModel == KHR_DF_MODEL_UASTC
-                    && deviceFeatures.textureCompressionASTC_LDR) {
-                    tf = KTX_TTF_ASTC_4x4_RGBA;
-                }
-                else if (colorModel == KHR_DF_MODEL_ETC1S
-                    && deviceFeatures.textureCompressionETC2) {
-                    tf = KTX_TTF_ETC;
-                }
-                else if (deviceFeatures.textureCompressionASTC_LDR) {
-                    tf = KTX_TTF_ASTC_4x4_RGBA;
-                }
-                else if (deviceFeatures.textureCompressionETC2)
-                    tf = KTX_TTF_ETC2_RGBA;
-                else if (deviceFeatures.textureCompressionBC)
-                    tf = KTX_TTF_BC7_RGBA;
-                else {
-                    const std::string message = "Vulkan implementation does not support any available transcode target.";
-                    throw std::runtime_error(message.c_str());
-                }
+uint32_t Sample1App::add_streamed_texture(const std::string& filename, uint32_t material)
+{
+    fs::path name = fs::path(filename).filename();
+    name.replace_extension("ktx2");
+    const fs::path ktx = fs::path(filename).parent_path() / "ktx" / name;
+    if (!fs::exists(ktx)) {
+        return ~0u;
+    }
 
-                result = ktxTexture2_TranscodeBasis((ktxTexture2*)kTexture, tf, 0);
+    auto it = streamedTextureIds.find(filename);
+    if (it == streamedTextureIds.end()) {
+        it = streamedTextureIds.insert({ filename, textureStreamer->addTexture() }).first;
+        streamedTextureNames.push_back(filename);
+        streamedTextureMaterials.emplace_back();
+        streamBackend->files.push_back(ktx.u8string());
+    }
+    auto& users = streamedTextureMaterials[it->second];
+    if (users.empty() || users.back() != material) {
+        users.push_back(material);
+    }
+    return it->second;
+}
 
-                // Then use VkUpload or GLUpload to create a texture object on the GPU.
+void Sample1App::make_texture_resident(uint32_t texture, uint32_t firstLevel, const jsr::TextureStreamDesc& desc, const jsr::TextureStreamData& levels)
+{
+    // a new image with the full chain from the resident level, the views of the old one cannot be narrowed
+    // without the minLod feature and growing it needs new memory anyway
+    jvk::Image newImage;
+    const VkExtent3D extent{ std::max(1u, desc.width >> firstLevel), std::max(1u, desc.height >> firstLevel), 1 };
+    VK_CHECK(pDevice->create_texture2d_with_mips(VkFormat(levels.format), extent, &newImage));
+
+    // a texture cache hit comes with the offsets of the levels in the mapping
+    std::vector<VkDeviceSize> offsets(levels.levelOffsets.begin(), levels.levelOffsets.end());
+    if (offsets.empty()) {
+        offsets.push_back(0);
+        for (size_t level = firstLevel; level + 1 < desc.levelSizes.size(); ++level) {
+            offsets.push_back(offsets.back() + desc.levelSizes[level]);
+        }
+    }
+    uploadManager->UploadImage(&newImage, levels.getData(), levels.getSize(),
+        [&offsets, extent](uint32_t layer, uint32_t face, uint32_t level, jvk::Image::UploadInfo* inf)
+        {
+            inf->extent = { std::max(1u, extent.width >> level), std::max(1u, extent.height >> level), 1 };
+            inf->offset = offsets[level];
+        });
+    newImage.setup_descriptor();
+    newImage.descriptor.sampler = sampLinearRepeat;
+
+    const std::string& name = streamedTextureNames[texture];
+    auto it = imageCache.find(name);
+    if (it == imageCache.end()) {
+        imageCache.insert({ name, newImage });
+    }
+    else {
+        retiredImages.push_back({ frameCounter + MAX_CONCURRENT_FRAMES, it->second });
+        it->second = newImage;
+    }
+    dirtyMaterials.insert(dirtyMaterials.end(), streamedTextureMaterials[texture].begin(), streamedTextureMaterials[texture].end());
+}
+
+void Sample1App::request_streamed_textures(const glm::mat4& vp)
+{
+    // the textures of the objects in the frustum, sized by the screen size of the object bounds
+    const jsr::Frustum frustum(vp);
+    const float pixelsPerUnit = 0.5f * float(height) * std::abs(passData.mtxProjection[1][1]);
+    for (const auto& obj : objects) {
+        const auto& material = materials[world->meshes[obj.mesh].material];
+        if (!frustum.Intersects(obj.aabb.GetSphere())) {
+            continue;
+        }
+        const float radius = obj.aabb.GetRadius();
+        const float dist = std::max(postProcessData.fZnear, length(obj.aabb.GetCenter() - camera.Position) - radius);
+        const float pixels = 2.0f * radius * pixelsPerUnit / dist;
+        for (uint32_t id : material.streamIds) {
+            if (id != ~0u) {
+                textureStreamer->requestTexture(id, pixels);
             }
+        }
+    }
+}
 
-            // Retrieve information about the texture from fields in the ktxTexture
-            // such as:
-            ktx_uint32_t numLevels = kTexture->numLevels;
-            ktx_uint32_t baseWidth = kTexture->baseWidth;
-            ktx_uint32_t baseHeight = kTexture->baseHeight;
-            ktx_bool_t isArray = kTexture->isArray;
+void Sample1App::update_streamed_materials()
+{
+    if (dirtyMaterials.empty()) {
+        return;
+    }
+    std::sort(dirtyMaterials.begin(), dirtyMaterials.end());
+    dirtyMaterials.erase(std::unique(dirtyMaterials.begin(), dirtyMaterials.end()), dirtyMaterials.end());
 
-            pDevice->create_texture2d_with_mips(
-                ktxTexture2_GetVkFormat((ktxTexture2*)kTexture),
-                VkExtent3D{ kTexture->baseWidth,kTexture->baseHeight,kTexture->baseDepth },
-                &newImage);
+    // one set switch per material and frame, so the set rewritten was left MAX_CONCURRENT_FRAMES frames ago at least
+    for (uint32_t m : dirtyMaterials) {
+        auto& material = materials[m];
+        const VkDescriptorSet oldSet = material.resources;
+        material.currentSet = (material.currentSet + 1) % uint32_t(material.sets.size());
+        material.resources = material.sets[material.currentSet];
 
-            jvk::StagingBuffer stagebuf(pDevice, ktxTexture_GetDataSize(kTexture));
-            stagebuf.CopyTo(0, ktxTexture_GetDataSize(kTexture), ktxTexture_GetData(kTexture));
+        std::array<VkDescriptorImageInfo, 4> images{
+            imageCache.at(material.textures[0]).descriptor,
+            imageCache.at(material.textures[1]).descriptor,
+            imageCache.at(material.textures[2]).descriptor,
+            imageCache.at(material.textures[3]).descriptor
+        };
+        const VkWriteDescriptorSet write = vks::initializers::writeDescriptorSet(material.resources, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, images.data(), uint32_t(images.size()));
+        vkUpdateDescriptorSets(d, 1, &write, 0, nullptr);
 
-            pDevice->execute_commands([&](VkCommandBuffer cmd)
-                {
-                    newImage.record_upload(cmd, [kTexture, baseWidth, baseHeight](uint32_t layer, uint32_t face, uint32_t level, jvk::Image::UploadInfo* inf)
-                        {
-                            size_t offset{};
-                            uint32_t w = baseWidth >> level;
-                            uint32_t h = baseHeight >> level;
-                            w = std::max(w, 1u);
-                            h = std::max(h, 1u);
-
-                            // Retrieve a pointer to the image for a specific mip level, array layer
-                            // & face or depth slice.
-                            ktxResult res = ktxTexture_GetImageOffset(kTexture, level, layer, face, &offset);
-                            assert(res == KTX_SUCCESS);
-
-                            inf->extent = { w,h,1 };
-                            inf->offset = offset;
-
-                        }, stagebuf.GetBuffer());
-
-                    newImage.record_layout_change(cmd,
-                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                        VK_PIPELINE_STAGE_TRANSFER_BIT,
-                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-
-                    newImage.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                });
-
-            //newImage.change_layout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-            ktxTexture_Destroy(kTexture);
-        }
-        else if (!load_texture2d(fn, &newImage, true, w, h, nc))
-        {
-            jsrlib::Error("%s notfund", fn.c_str());
-            pDevice->create_texture2d(VK_FORMAT_R8G8B8A8_UNORM, { 1,1,1 }, &newImage);
-            newImage.layout_change(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        for (auto& obj : objects) {
+            if (obj.vkResources == oldSet) obj.vkResources = material.resources;
         }
-        else
-        {
-            jsrlib::Info("%s Loaded", fn.c_str());
+        for (auto& batch : cullBatches) {
+            if (batch.material == oldSet) batch.material = material.resources;
         }
-        newImage.setup_descriptor();
-        newImage.descriptor.sampler = sampLinearRepeat;
-        imageCache.insert({ fn,newImage });
     }
+    dirtyMaterials.clear();
 }
 
 bool Sample1App::load_texture2d(std::string filename, jvk::Image* dest, bool autoMipmap, int& w, int& h, int& nchannel)
@@ -1498,10 +2067,6 @@ bool Sample1App::load_texture2d(std::string filename, jvk::Image* dest, bool aut
 
 
     size_t size = w * h * 4;
-    jvk::Buffer stage;
-    pDevice->create_staging_buffer(size, &stage);
-    stage.copyTo(0, size, data);
-    stbi_image_free(data);
     const VkExtent3D extent = { (uint32_t)w,(uint32_t)h,1 };
 
     if (autoMipmap) {
@@ -1511,14 +2076,61 @@ bool Sample1App::load_texture2d(std::string filename, jvk::Image* dest, bool aut
         pDevice->create_texture2d(VK_FORMAT_R8G8B8A8_UNORM, extent, dest);
     }
 
-    dest->upload(extent, 0, 0, 0, 0ull, &stage);
-    if (autoMipmap) {
-        dest->generate_mipmaps();
-    }
-    else {
-        dest->layout_change(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    }
+    // only level 0 is in data, the rest is generated after the transfer
+    uploadManager->UploadImage(dest, data, size, [extent](uint32_t layer, uint32_t face, uint32_t level, jvk::Image::UploadInfo* inf)
+        {
+            inf->extent = extent;
+            inf->offset = 0;
+        }, autoMipmap);
+    stbi_image_free(data);
 
     return true;
 }
 
+
+void Sample1App::draw_profiler_window()
+{
+    if (!ImGui::Begin("GPU profiler", &showProfiler)) {
+        ImGui::End();
+        return;
+    }
+
+    const auto stats = gpuProfiler->GetStats();
+    if (ImGui::BeginTable("regions", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV)) {
+        ImGui::TableSetupColumn("Region");
+        ImGui::TableSetupColumn("last ms");
+        ImGui::TableSetupColumn("min ms");
+        ImGui::TableSetupColumn("avg ms");
+        ImGui::TableSetupColumn("p99 ms");
+        ImGui::TableHeadersRow();
+        for (const auto& s : stats) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Indent(float(s.depth) * 10.0f + 1.0f);
+            ImGui::TextUnformatted(s.name.c_str());
+            ImGui::Unindent(float(s.depth) * 10.0f + 1.0f);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", s.lastMs);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", s.minMs);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", s.avgMs);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", s.p99Ms);
+        }
+        ImGui::EndTable();
+    }
+
+    if (ImGui::Button("Export CSV")) {
+        if (gpuProfiler->WriteCsv("gpu_profile.csv")) {
+            jsrlib::Info("GPU profile written to gpu_profile.csv");
+        }
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Export Chrome trace")) {
+        if (gpuProfiler->WriteChromeTrace("gpu_trace.json")) {
+            jsrlib::Info("Trace written to gpu_trace.json, open it in chrome://tracing");
+        }
+    }
+    ImGui::End();
+}
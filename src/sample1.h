@@ -5,58 +5,27 @@
 #include "vkjs/VulkanInitializers.hpp"
 #include "vkjs/appbase.h"
 #include "vkjs/pipeline.h"
+#include "vkjs/upload_ring.h"
+#include "vkjs/upload_manager.h"
+#include "vkjs/render_graph.h"
+#include "vkjs/transient_allocator.h"
+#include "vkjs/async_compute.h"
+#include "vkjs/gpu_profiler.h"
 #include "glm/glm.hpp"
 #include "bounds.h"
 #include "imgui.h"
 #include "world.h"
 #include "light.h"
-
-struct UniformBufferPool {
-    jvk::Buffer* buffer{};
-    std::atomic_uint32_t bytesAlloced = 0u;
-    uint32_t offsetAligment = 64u;
-    uint32_t internalOffset = 0u;
-    size_t _size = 0ULL;
-    VkDescriptorBufferInfo descriptor = {};
-
-    UniformBufferPool() = delete;
-    UniformBufferPool(jvk::Buffer* buffer, size_t size, uint32_t startOffset, uint32_t offsetAligment) :
-        buffer(buffer), _size(size), offsetAligment(offsetAligment), bytesAlloced(0) {
-
-        internalOffset = startOffset;
-        descriptor.buffer = buffer->buffer;
-        descriptor.offset = internalOffset;
-        descriptor.range = size;
-    }
-
-    template<class T>
-    VkDescriptorBufferInfo Allocate(uint32_t count, const T* data)
-    {
-        const uint32_t alignedSize = static_cast<uint32_t>(align_size(sizeof(T), offsetAligment));
-        const uint32_t size = count * alignedSize;
-        const uint32_t offset = bytesAlloced.fetch_add(size, std::memory_order_relaxed);
-
-
-        assert((internalOffset + offset + size) < buffer->size);
-
-        VkDescriptorBufferInfo out = {};
-        out.buffer = buffer->buffer;
-        out.offset = offset;
-        out.range = count * sizeof(T);
-
-        if (data)
-        {
-            size_t it_offset = internalOffset + offset;
-            for (size_t it = 0; it < count; ++it)
-            {
-                buffer->copyTo(it_offset, sizeof(T), &data[it]);
-                it_offset += alignedSize;
-            }
-        }
-        return out;
-    }
-    void reset() { bytesAlloced = 0; }
-};
+#include "occlusion.h"
+#include "mesh_lod.h"
+#include "meshlet.h"
+#include "light_clusters.h"
+#include "draw_list.h"
+#include "texture_streamer.h"
+#include "ktx_stream_source.h"
+#include "material_image.h"
+#include "mesh_pack.h"
+#include "gpu_cull.h"
 
 class Sample1App : public jvk::AppBase {
 private:
@@ -86,7 +55,6 @@ private:
     std::array<jvk::Image, MAX_CONCURRENT_FRAMES> HDR_NormalImage{};
     std::array<VkFramebuffer, MAX_CONCURRENT_FRAMES> HDRFramebuffer{};
     std::array<VkDescriptorSet, MAX_CONCURRENT_FRAMES> HDRDescriptor{};
-    std::array<UniformBufferPool*, MAX_CONCURRENT_FRAMES> drawPool{};
 
     VkSampler sampLinearRepeat;
     VkSampler sampNearestClampBorder;
@@ -97,36 +65,60 @@ private:
 
     jvk::Buffer vtxbuf;
     jvk::Buffer idxbuf;
-    size_t minUboAlignment = 0;
-
-    jvk::Buffer vtxStagingBuffer;
-    std::array<jvk::Buffer, MAX_CONCURRENT_FRAMES> transientVtxBuf;
-
-    std::array<jvk::BufferObject::SharedPtr, MAX_CONCURRENT_FRAMES> uboPassData;
-    std::array<jvk::BufferObject::SharedPtr, MAX_CONCURRENT_FRAMES> uboPostProcessData;
-    std::array<jvk::BufferObject::SharedPtr, MAX_CONCURRENT_FRAMES> uboLights;
-
-    std::array<jsr::Light, 16> lights;
 
-    size_t drawDataBufferSize = 0;
-
-    std::unique_ptr<jvk::UniformBuffer> uboDrawData;
-
-    size_t dynamicAlignment = 0;
-
-    struct MeshBinary {
-        uint32_t indexCount;
-        uint32_t firstIndex;
-        uint32_t firstVertex;
-    };
+    std::array<jvk::BufferObject::SharedPtr, MAX_CONCURRENT_FRAMES> ssboLights;
+    // set by init_lights, the next use of the frame slot copies the lights from the ring
+    std::array<bool, MAX_CONCURRENT_FRAMES> lightsDirty{};
+
+    static const size_t MAX_LIGHTS = 64 * 1024;
+    static const size_t MAX_LIGHT_INDICES = 1024 * 1024;
+    static const size_t MAX_DRAW_INSTANCES = 64 * 1024;
+    static const VkDeviceSize UPLOAD_RING_FRAME_SIZE = 16ULL * 1024 * 1024;
+
+    // every per-frame uniform, storage and vertex update goes through the ring,
+    // set 0 of the forward and post process passes binds it with dynamic offsets
+    std::unique_ptr<jvk::UploadRing> uploadRing;
+    // static vertex, index, draw data and texture uploads, submitted on the transfer queue
+    std::unique_ptr<jvk::UploadManager> uploadManager;
+    // rebuilt by build_command_buffers every frame
+    jvk::RenderGraph frameGraph;
+    // GPU culling of the frame on the compute queue, recorded like frameGraph
+    std::unique_ptr<jvk::AsyncCompute> asyncCompute;
+    jvk::RenderGraph computeGraph;
+    bool asyncComputeEnabled = true;
+    bool cullObjectsOnCompute = false;      // queue family owning ssboCullObjects
+    // times the debug marker regions, results are MAX_CONCURRENT_FRAMES frames late
+    std::unique_ptr<jvk::GpuProfiler> gpuProfiler;
+    bool showProfiler = true;
+    // multisampled and forward-only attachments, see setup_images
+    std::unique_ptr<jvk::TransientAllocator> transientTargets;
+    struct FrameUploads {
+        uint32_t passData;
+        uint32_t drawData;
+        uint32_t lightClusters;
+        uint32_t lightIndices;
+        uint32_t postProcessData;
+    } frameUploads{};
+
+    std::vector<jsr::Light> lights;
+    int lightCount = 256;
+    jsr::LightClusters lightClusters;
 
     struct Material {
         VkDescriptorSet resources;
+        // albedo, normal, specular, emissive: the imageCache keys
+        std::array<std::string, 4> textures;
+        std::array<uint32_t, 4> streamIds{ ~0u, ~0u, ~0u, ~0u };
+        // a material with streamed textures moves to the next set when one of its images is replaced,
+        // the set it leaves is not rewritten while a frame in flight may use it
+        std::array<VkDescriptorSet, MAX_CONCURRENT_FRAMES + 1> sets{};
+        uint32_t currentSet = 0;
     };
     std::vector<Material> materials;
 
     struct Object {
         uint32_t mesh;
+        uint32_t lod;
         glm::mat4 mtxModel;
         jsr::Bounds aabb;
         VkDescriptorSet vkResources;
@@ -139,10 +131,50 @@ private:
         glm::vec4 color;
     };
 
-    std::vector<MeshBinary> meshes;
+    // of the scene vertex buffer, compact positions are dequantized by the model matrix of DrawData
+    jsr::VertexFormat vertexFormat = jsr::VERTEX_FORMAT_COMPACT;
+    std::vector<jsr::PackedMesh> meshes;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT16;   // 32 bit when a mesh has more vertices than 16 bit indices reach
     std::vector<Object> objects;
-    std::vector<uint8_t> drawDataBufferAligned;
     std::vector<DrawData> drawDataStruct;
+    std::vector<DrawData> instanceData;     // per frame DrawData in instance order
+
+    struct DrawCommand {
+        VkDescriptorSet material;
+        jsr::PackedIndexRange range;
+        uint32_t vertexOffset;
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+    };
+    std::vector<DrawCommand> drawCommands;
+
+    // GPU driven culling, see shaders/v2/cull_v2.comp
+    struct CullBatch {
+        VkDescriptorSet material;
+        uint32_t firstCommand;
+        uint32_t maxCount;
+    };
+
+    std::vector<jsr::GpuCullObject> cullObjects;
+    std::vector<CullBatch> cullBatches;
+    jvk::BufferObject::SharedPtr ssboCullObjects;
+    std::array<jvk::BufferObject::SharedPtr, MAX_CONCURRENT_FRAMES> cullCommands;
+    std::array<jvk::BufferObject::SharedPtr, MAX_CONCURRENT_FRAMES> cullCounts;
+    std::array<VkDescriptorSet, MAX_CONCURRENT_FRAMES> cullDescriptors{};
+    std::array<int, MAX_CONCURRENT_FRAMES> cullExpected{};     // CPU reference visible count, -1 if not validated
+    VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline cullPipeline = VK_NULL_HANDLE;
+    bool gpuCulling = false;
+    bool validateGpuCulling = false;
+
+    // forward pass draws recorded into secondary command buffers by jsr::jobsys
+    static const uint32_t MAX_RECORD_THREADS = jvk::GraphicsPipeline::MAX_PARALELL_CMD_BUFFER_COUNT;
+    static const size_t MIN_DRAWS_PER_RECORD_CHUNK = 256;
+    uint32_t recordThreadCount = 1;
+    uint32_t recordChunkCount = 0;
+    bool parallelRecording = true;
+    std::array<std::array<VkCommandPool, MAX_RECORD_THREADS>, MAX_CONCURRENT_FRAMES> recordCmdPools{};
+    std::array<std::array<VkCommandBuffer, MAX_RECORD_THREADS>, MAX_CONCURRENT_FRAMES> recordCmdBuffers{};
 
     struct PassData {
         glm::mat4 mtxView;
@@ -152,6 +184,7 @@ private:
         glm::vec4 vLightPos;
         glm::vec4 vLightColor;
         glm::vec4 vParams;
+        glm::vec4 vClusterParams;   // slice scale, slice bias, tiles per pixel x/y
     } passData;
 
 
@@ -206,9 +239,71 @@ private:
         RenderPass triangle = {};
     } passes;
     uint32_t visibleObjectCount{};
+    uint32_t occludedObjectCount{};
+    uint32_t submittedTriangleCount{};
+    uint32_t descriptorBindCount{};
+    uint32_t materialBindCount{};
+    uint32_t drawCallCount{};
+    float recordTimeMs{};
+    bool instancingEnabled = true;
+
+    jsr::DrawList drawList;
+
+    bool lodEnabled = true;
+    float lodErrorBudget = 1.0f;    // pixels
+
+    jsr::OcclusionBuffer occlusionBuffer;
+    bool occlusionCulling = true;
+    float occluderMinSize = 0.1f;   // bounding radius / distance
+    static const size_t MAX_OCCLUDER_TRIANGLES = 64 * 1024;
+
+    // CPU reference meshlet culling of the visible objects, for statistics only
+    bool meshletStats = false;
+    jsr::MeshletCullStats meshletCullStats;
+    float meshletCullMs{};
+
+    // material textures with a full KTX2 mip chain are streamed, the rest is loaded whole
+    class StreamedTextureBackend : public jsr::TextureStreamBackend {
+    public:
+        StreamedTextureBackend(Sample1App* app, const jsr::KtxTranscodeTargets& targets, const jsr::TextureCache* cache) : app(app), source(targets, cache) {}
+        bool describe(uint32_t texture, jsr::TextureStreamDesc& desc) override { return source.describe(files[texture], desc); }
+        bool loadLevels(uint32_t texture, uint32_t firstLevel, jsr::TextureStreamData& out) override { return source.loadLevels(files[texture], firstLevel, out); }
+        void makeResident(uint32_t texture, uint32_t firstLevel, const jsr::TextureStreamDesc& desc, const jsr::TextureStreamData& levels) override
+        {
+            app->make_texture_resident(texture, firstLevel, desc, levels);
+        }
+        std::vector<std::string> files;     // the ktx2 file of every texture id
+    private:
+        Sample1App* app;
+        jsr::KtxStreamSource source;
+    };
+    jsr::KtxTranscodeTargets transcodeTargets;
+    std::unique_ptr<jsr::TextureCache> textureCache;    // transcoded Basis textures, in ktx/cache next to the scene
+    std::unique_ptr<StreamedTextureBackend> streamBackend;
+    std::unique_ptr<jsr::TextureStreamer> textureStreamer;
+    std::unordered_map<std::string, uint32_t> streamedTextureIds;
+    std::vector<std::string> streamedTextureNames;                  // imageCache key of every texture id
+    std::vector<std::vector<uint32_t>> streamedTextureMaterials;    // the materials using a texture id
+    std::vector<uint32_t> dirtyMaterials;
+    std::deque<std::pair<uint32_t, jvk::Image>> retiredImages;      // destroyed at the frame
+    int textureBudgetMB = 256;
+    static const uint32_t MAX_TEXTURE_STREAM_LOADS = 4;
+
+    static const uint32_t MAX_TEXTURE_DECODES_PER_WORKER = 2;
+    void create_material_image(const jsr::MaterialImage& image);
 
     static const uint32_t TRIANGLE_DESCRIPTOR_ID = 100;
     void init_lights();
+    void update_light_clusters();
+    // returns the number of material binds
+    uint32_t record_draw_commands(VkCommandBuffer cmd, size_t first, size_t last);
+    void upload_draw_data(const DrawData* data, size_t count);
+    void record_forward_pass_cpu_culled(VkCommandBuffer cmd, const VkRenderPassBeginInfo& beginPass, const glm::mat4& vp);
+    void record_gpu_cull(VkCommandBuffer cmd, const glm::mat4& vp);
+    jvk::RenderGraph::PassBuilder add_gpu_cull_passes(jvk::RenderGraph& graph, const glm::mat4& vp, jvk::RenderGraph::Handle& countsRes, jvk::RenderGraph::Handle& commandsRes);
+    void record_forward_pass_gpu_culled(VkCommandBuffer cmd, const VkRenderPassBeginInfo& beginPass, const glm::mat4& vp);
+    void setup_gpu_culling();
+    void draw_profiler_window();
 
 public:
 
@@ -232,7 +327,30 @@ public:
         ImGui::Text("Fps: %.2f", fps);
         ImGui::Text("ViewOrg: X: %.3f  Y: %.3f  Z: %.3f", camera.Position.x, camera.Position.y, camera.Position.z);
         ImGui::Text("obj in frustum: %d", visibleObjectCount);
+        ImGui::Text("obj occluded: %d, occluder tris: %d", occludedObjectCount, (int)occlusionBuffer.getTriangleCount());
+        ImGui::Text("triangles submitted: %d", submittedTriangleCount);
+        if (meshletStats) {
+            const auto& ms = meshletCullStats;
+            ImGui::Text("meshlets: %d / %d visible, frustum: %d, backface: %d, triangles culled: %.1f%%, %.3f ms",
+                int(ms.meshlets - ms.frustumCulled - ms.backfaceCulled), int(ms.meshlets), int(ms.frustumCulled), int(ms.backfaceCulled),
+                ms.triangles ? 100.0f * float(ms.triangles - ms.visibleTriangles) / float(ms.triangles) : 0.0f, meshletCullMs);
+        }
+        ImGui::Text("draws: %d, draw calls: %d, set binds: %d, material binds: %d", (int)drawList.size(), drawCallCount, descriptorBindCount, materialBindCount);
+        ImGui::Text("record time: %.3f ms, secondary buffers: %d", recordTimeMs, recordChunkCount);
+        ImGui::Text("GPU culling queue: %s", (gpuCulling && asyncCompute->IsEnabled() && cullObjectsOnCompute) ? "compute" : "graphics");
+        ImGui::Text("render graph: %d passes, %d culled, %d barriers, compile: %.3f ms", (int)frameGraph.GetStats().passCount, (int)frameGraph.GetStats().culledPassCount, (int)frameGraph.GetStats().barrierCount, frameGraph.GetStats().compileTimeMs);
+        ImGui::Text("transient targets: %d MB, %d MB saved by aliasing", int(transientTargets->GetStats().allocatedBytes >> 20), int((transientTargets->GetStats().requestedBytes - transientTargets->GetStats().allocatedBytes) >> 20));
+        ImGui::Text("upload ring: %d / %d KB, peak: %d KB", int(uploadRing->GetUsedBytes() >> 10), int(uploadRing->GetFrameSize() >> 10), int(uploadRing->GetPeakBytes() >> 10));
+        if (textureStreamer) {
+            const auto& ts = textureStreamer->getStats();
+            ImGui::Text("streamed textures: %d, resident: %d / %d MB, loads: %d, evictions: %d, pending: %d", int(ts.streamedTextures),
+                int(ts.residentBytes >> 20), textureBudgetMB, int(ts.loads), int(ts.evictions), int(ts.pendingLoads));
+        }
         ImGui::Text("maxZ: %.2f, minZ: %.2f", maxZ, minZ);
+        ImGui::Checkbox("GPU profiler", &showProfiler);
+        if (showProfiler) {
+            draw_profiler_window();
+        }
         //ImGui::DragFloat3("Light pos", &passData.vLightPos[0], 0.05f, -20.0f, 20.0f);
         //ImGui::ColorPicker3("LightColor", &passData.vLightColor[0]);
         ImGui::DragFloat("L intensity (lumen)", &passData.vLightColor.w, 1.0f, 0.0f, 100000.0f);
@@ -244,7 +362,26 @@ public:
         ImGui::DragFloat("ISO", &ISO, 50.0f, 50.0f, 800.0f);
 
 
+        if (ImGui::DragInt("Light count", &lightCount, 16.0f, 1, (int)MAX_LIGHTS)) {
+            initLights = true;
+        }
+        ImGui::Text("light indices: %d", (int)lightClusters.getLightIndices().size());
         ImGui::Checkbox("Init lights", &initLights);
+        ImGui::Checkbox("GPU culling", &gpuCulling);
+        ImGui::Checkbox("Validate GPU culling", &validateGpuCulling);
+        ImGui::BeginDisabled(!asyncCompute->IsAvailable());
+        ImGui::Checkbox("Async compute", &asyncComputeEnabled);
+        ImGui::EndDisabled();
+        ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+        ImGui::Checkbox("Meshlet culling stats", &meshletStats);
+        ImGui::DragFloat("Occluder min size", &occluderMinSize, 0.01f, 0.0f, 2.0f);
+        ImGui::Checkbox("Instancing", &instancingEnabled);
+        ImGui::Checkbox("Parallel recording", &parallelRecording);
+        ImGui::Checkbox("Mesh LODs", &lodEnabled);
+        ImGui::DragFloat("LOD error (pixels)", &lodErrorBudget, 0.1f, 0.1f, 32.0f);
+        if (ImGui::DragInt("Texture budget (MB)", &textureBudgetMB, 1.0f, 16, 4096) && textureStreamer) {
+            textureStreamer->setBudget(size_t(textureBudgetMB) << 20);
+        }
         ImGui::Checkbox("Fog On/Off", &fogEnabled);
         ImGui::Checkbox("Auto exposure On/Off", &autoExposure);
         ImGui::Checkbox("HDR On/Off", (bool*)(&postProcessData.bHDR));
@@ -315,13 +452,16 @@ public:
 
     void update_uniforms() {
 
-        uboPassData[currentFrame]->CopyTo(0, sizeof(passData), &passData);
-        uboPostProcessData[currentFrame]->CopyTo(0, sizeof(PostProcessData), &postProcessData);
+        // the fence of this frame has been waited for, its partition can be reused
+        uploadRing->BeginFrame(currentFrame);
+        frameUploads.passData = uint32_t(uploadRing->UploadUniform(passData).offset);
+        frameUploads.postProcessData = uint32_t(uploadRing->UploadUniform(postProcessData).offset);
         if (initLights)
         {
             initLights = false;
             init_lights();
         }
+        update_light_clusters();
     }
 
     virtual void prepare() override;
@@ -330,6 +470,12 @@ public:
 
     virtual void get_enabled_extensions() override;
 
-    void create_material_texture(const std::string& filename);
+    // loads the images not in imageCache yet, decoding and transcoding runs on the job system
+    void create_material_textures(const std::vector<std::string>& filenames);
+    // registers the texture with the streamer if it has a ktx2 file, returns its id or ~0
+    uint32_t add_streamed_texture(const std::string& filename, uint32_t material);
+    void make_texture_resident(uint32_t texture, uint32_t firstLevel, const jsr::TextureStreamDesc& desc, const jsr::TextureStreamData& levels);
+    void request_streamed_textures(const glm::mat4& vp);
+    void update_streamed_materials();
     bool load_texture2d(std::string filename, jvk::Image* dest, bool autoMipmap, int& w, int& h, int& nchannel);
 };
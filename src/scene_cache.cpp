@@ -0,0 +1,750 @@
+#include "pch.h"
+#include "scene_cache.h"
+#include "mapped_file.h"
+#include <cstring>
+#include <algorithm>
+#include <jsrlib/jsr_logger.h>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace jsr {
+
+	namespace fs = std::filesystem;
+
+	static const char MAGIC[8] = { 'J','S','R','S','C','E','N','E' };
+	static const uint64_t SECTION_ALIGNMENT = 16;
+
+	enum SectionId : uint32_t {
+		SECTION_SOURCES,
+		SECTION_STRINGS,
+		SECTION_MATERIALS,
+		SECTION_MESHES,
+		SECTION_LODS,
+		SECTION_INDICES,			// full detail and LOD indices of every mesh
+		SECTION_POSITIONS,
+		SECTION_NORMALS,
+		SECTION_TANGENTS,
+		SECTION_UVS,
+		SECTION_NODES,
+		SECTION_NODE_LINKS,			// entities and children of the nodes
+		SECTION_ROOT_NODES,
+		SECTION_MESH_BVHS,
+		SECTION_BVH_NODES,
+		SECTION_BVH_INDICES,
+		SECTION_BVH_TRIANGLES,
+		SECTION_MESHLETS,
+		SECTION_MESHLET_VERTICES,
+		SECTION_MESHLET_TRIANGLES,
+		SECTION_GPU_VERTICES,
+		SECTION_GPU_INDICES,
+		SECTION_COUNT
+	};
+
+	struct FileHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t sectionCount;
+		uint64_t fileSize;
+		uint32_t vertexStride;
+		uint32_t indexSize;
+	};
+
+	struct Section {
+		uint64_t offset;
+		uint64_t size;
+		uint32_t count;
+		uint32_t pad[3];
+	};
+
+	struct StringRef {
+		uint32_t offset;
+		uint32_t length;
+	};
+
+	struct CachedSource {
+		StringRef path;
+		uint64_t size;
+		int64_t time;
+		uint64_t hash;
+	};
+
+	struct CachedMaterial {
+		int32_t type;
+		int32_t alphaMode;
+		int32_t doubleSided;
+		float baseColorFactor[4];
+		float emissiveFactor[3];
+		float normalScale[3];
+		float alphaCutoff;
+		float occlusionStrenght;
+		float metallicFactor;
+		float roughnessFactor;
+		StringRef name;
+		StringRef albedoTexture;
+		StringRef normalTexture;
+		StringRef specularTexture;
+		StringRef emissiveTexture;
+	};
+
+	struct CachedMesh {
+		int32_t material;
+		float aabbMin[3];
+		float aabbMax[3];
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+		uint32_t firstLod;
+		uint32_t lodCount;
+		uint32_t firstMeshlet;
+		uint32_t meshletCount;
+		uint32_t firstMeshletVertex;
+		uint32_t meshletVertexCount;
+		uint32_t firstMeshletTriangle;	// in bytes, 3 per triangle
+		uint32_t meshletTriangleBytes;
+	};
+
+	struct CachedLod {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float error;
+	};
+
+	// offsets are relative to the mesh
+	struct CachedMeshlet {
+		uint32_t vertexOffset;
+		uint32_t triangleOffset;
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+		float center[3];
+		float radius;
+		float aabbMin[3];
+		float aabbMax[3];
+		float coneApex[3];
+		float coneAxis[3];
+		float coneCutoff;
+	};
+
+	struct CachedNode {
+		int32_t type;
+		int32_t parent;
+		float position[3];
+		float rotation[4];			// x, y, z, w
+		float scale[3];
+		uint32_t firstEntity;
+		uint32_t entityCount;
+		uint32_t firstChild;
+		uint32_t childCount;
+	};
+
+	struct CachedMeshBVH {
+		uint32_t firstNode;
+		uint32_t nodeCount;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t firstTriangle;
+		uint32_t triangleCount;
+	};
+
+	struct CachedBVHNode {
+		float aabbMin[3];
+		float aabbMax[3];
+		uint32_t leftFirst;
+		uint32_t primCount;
+	};
+
+	// attribute strides of gltfLoadWorld
+	static const size_t POSITION_SIZE = 3 * sizeof(float);
+	static const size_t NORMAL_SIZE = 3 * sizeof(float);
+	static const size_t TANGENT_SIZE = 4 * sizeof(float);
+	static const size_t UV_SIZE = 2 * sizeof(float);
+
+	static bool statFile(const fs::path& path, uint64_t& size, int64_t& time)
+	{
+		std::error_code ec;
+		size = fs::file_size(path, ec);
+		if (ec) return false;
+		const auto t = fs::last_write_time(path, ec);
+		if (ec) return false;
+		time = int64_t(t.time_since_epoch().count());
+
+		return true;
+	}
+
+	// appends the sections at 16 byte aligned offsets after the header and the section table
+	class CacheWriter
+	{
+	public:
+		CacheWriter() : m_bytes(sizeof(FileHeader) + SECTION_COUNT * sizeof(Section)), m_sections(SECTION_COUNT) {}
+
+		template<class T> void add(uint32_t id, const T* data, size_t count) {
+			add(id, data, count * sizeof(T), uint32_t(count));
+		}
+		template<class T> void add(uint32_t id, const std::vector<T>& v) {
+			add(id, v.data(), v.size() * sizeof(T), uint32_t(v.size()));
+		}
+		void add(uint32_t id, const void* data, size_t size, uint32_t count)
+		{
+			m_bytes.resize((m_bytes.size() + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT, 0);
+			m_sections[id].offset = m_bytes.size();
+			m_sections[id].size = size;
+			m_sections[id].count = count;
+			if (size > 0) {
+				m_bytes.insert(m_bytes.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+			}
+		}
+		StringRef addString(const std::string& s)
+		{
+			const StringRef result{ uint32_t(m_strings.size()), uint32_t(s.size()) };
+			m_strings.insert(m_strings.end(), s.begin(), s.end());
+			return result;
+		}
+		bool write(const fs::path& path, uint32_t vertexStride, uint32_t indexSize)
+		{
+			add(SECTION_STRINGS, m_strings);
+
+			FileHeader header{};
+			memcpy(header.magic, MAGIC, sizeof(MAGIC));
+			header.version = SceneCache::VERSION;
+			header.sectionCount = SECTION_COUNT;
+			header.fileSize = m_bytes.size();
+			header.vertexStride = vertexStride;
+			header.indexSize = indexSize;
+			memcpy(m_bytes.data(), &header, sizeof(header));
+			memcpy(m_bytes.data() + sizeof(header), m_sections.data(), m_sections.size() * sizeof(Section));
+
+			// a partially written file never has the final name
+			fs::path tmpPath = path;
+			tmpPath += ".tmp";
+			{
+				std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+				if (!out) return false;
+				out.write(reinterpret_cast<const char*>(m_bytes.data()), m_bytes.size());
+				if (!out) return false;
+			}
+			std::error_code ec;
+			fs::rename(tmpPath, path, ec);
+
+			return !ec;
+		}
+		size_t size() const { return m_bytes.size(); }
+	private:
+		std::vector<uint8_t> m_bytes;
+		std::vector<Section> m_sections;
+		std::vector<char> m_strings;
+	};
+
+	SceneCache::~SceneCache()
+	{
+		close();
+	}
+
+	bool SceneCache::open(const fs::path& path, uint32_t vertexStride, uint32_t indexSize)
+	{
+		close();
+
+		if (!m_file.open(path)) return false;
+		const uint8_t* data = m_file.data();
+		const size_t size = m_file.size();
+
+		FileHeader header{};
+		bool valid = size >= sizeof(FileHeader) + SECTION_COUNT * sizeof(Section);
+		if (valid) {
+			memcpy(&header, data, sizeof(header));
+			valid = memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+				header.version == VERSION &&
+				header.sectionCount == SECTION_COUNT &&
+				header.fileSize == size &&
+				header.vertexStride == vertexStride &&
+				(indexSize ? header.indexSize == indexSize : header.indexSize == 2 || header.indexSize == 4);
+		}
+		if (!valid || !validateSources()) {
+			close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void SceneCache::close()
+	{
+		m_file.close();
+	}
+
+	const void* SceneCache::getSection(uint32_t id, size_t elementSize, uint32_t& count) const
+	{
+		count = 0;
+		if (!m_file.isOpen() || id >= SECTION_COUNT) return nullptr;
+
+		const uint8_t* data = m_file.data();
+		const size_t size = m_file.size();
+		Section section;
+		memcpy(&section, data + sizeof(FileHeader) + id * sizeof(Section), sizeof(section));
+		if (section.offset % SECTION_ALIGNMENT != 0 || section.offset > size || section.size > size - section.offset ||
+			uint64_t(section.count) * elementSize != section.size)
+		{
+			return nullptr;
+		}
+		count = section.count;
+
+		return data + section.offset;
+	}
+
+	bool SceneCache::validateSources() const
+	{
+		uint32_t sourceCount, stringCount;
+		const CachedSource* sources = getSection<CachedSource>(SECTION_SOURCES, sourceCount);
+		const char* strings = getSection<char>(SECTION_STRINGS, stringCount);
+		if (!sources || sourceCount == 0 || !strings) return false;
+
+		for (uint32_t i = 0; i < sourceCount; ++i)
+		{
+			const CachedSource& src = sources[i];
+			if (uint64_t(src.path.offset) + src.path.length > stringCount) return false;
+
+			const fs::path path = fs::u8path(std::string(strings + src.path.offset, src.path.length));
+			uint64_t size;
+			int64_t time;
+			if (!statFile(path, size, time) || size != src.size) {
+				return false;
+			}
+			if (time != src.time)
+			{
+				uint64_t hash;
+				if (!hashFile(path, hash) || hash != src.hash) {
+					return false;
+				}
+				jsrlib::Info("%s is touched but not modified", path.u8string().c_str());
+			}
+		}
+
+		return true;
+	}
+
+	bool SceneCache::load(World& world) const
+	{
+		uint32_t stringCount, materialCount, meshCount, lodCount, indexCount, nodeCount, linkCount, rootCount;
+		uint32_t positionCount, normalCount, tangentCount, uvCount;
+		uint32_t bvhCount, bvhNodeCount, bvhIndexCount, bvhTriangleCount;
+		uint32_t meshletCount, meshletVertexCount, meshletTriangleCount;
+		const char* strings = getSection<char>(SECTION_STRINGS, stringCount);
+		const CachedMaterial* materials = getSection<CachedMaterial>(SECTION_MATERIALS, materialCount);
+		const CachedMesh* meshes = getSection<CachedMesh>(SECTION_MESHES, meshCount);
+		const CachedLod* lods = getSection<CachedLod>(SECTION_LODS, lodCount);
+		const uint32_t* indices = getSection<uint32_t>(SECTION_INDICES, indexCount);
+		const uint8_t* positions = getSection<uint8_t>(SECTION_POSITIONS, positionCount);
+		const uint8_t* normals = getSection<uint8_t>(SECTION_NORMALS, normalCount);
+		const uint8_t* tangents = getSection<uint8_t>(SECTION_TANGENTS, tangentCount);
+		const uint8_t* uvs = getSection<uint8_t>(SECTION_UVS, uvCount);
+		const CachedNode* nodes = getSection<CachedNode>(SECTION_NODES, nodeCount);
+		const int32_t* links = getSection<int32_t>(SECTION_NODE_LINKS, linkCount);
+		const int32_t* roots = getSection<int32_t>(SECTION_ROOT_NODES, rootCount);
+		const CachedMeshBVH* bvhs = getSection<CachedMeshBVH>(SECTION_MESH_BVHS, bvhCount);
+		const CachedBVHNode* bvhNodes = getSection<CachedBVHNode>(SECTION_BVH_NODES, bvhNodeCount);
+		const uint32_t* bvhIndices = getSection<uint32_t>(SECTION_BVH_INDICES, bvhIndexCount);
+		const uint32_t* bvhTriangles = getSection<uint32_t>(SECTION_BVH_TRIANGLES, bvhTriangleCount);
+		const CachedMeshlet* meshlets = getSection<CachedMeshlet>(SECTION_MESHLETS, meshletCount);
+		const uint32_t* meshletVertices = getSection<uint32_t>(SECTION_MESHLET_VERTICES, meshletVertexCount);
+		const uint8_t* meshletTriangles = getSection<uint8_t>(SECTION_MESHLET_TRIANGLES, meshletTriangleCount);
+
+		// empty sections have a valid pointer too, only a corrupt table gives nullptr
+		if (!strings || !materials || !meshes || !lods || !indices || !positions || !normals || !tangents || !uvs ||
+			!nodes || !links || !roots || !bvhs || !bvhNodes || !bvhIndices || !bvhTriangles || !meshlets || !meshletVertices || !meshletTriangles)
+		{
+			jsrlib::Error("Scene cache is corrupt");
+			return false;
+		}
+		assert(world.meshes.empty() && world.scene.nodes.empty());
+
+		auto getString = [&](const StringRef& ref) {
+			return ref.offset + uint64_t(ref.length) <= stringCount ? std::string(strings + ref.offset, ref.length) : std::string();
+		};
+
+		world.materials.resize(materialCount);
+		for (uint32_t i = 0; i < materialCount; ++i)
+		{
+			const CachedMaterial& src = materials[i];
+			Material& dst = world.materials[i];
+			dst.type = MaterialType(src.type);
+			dst.alphaMode = AlphaMode(src.alphaMode);
+			dst.doubleSided = src.doubleSided != 0;
+			dst.baseColorFactor = glm::make_vec4(src.baseColorFactor);
+			dst.emissiveFactor = glm::make_vec3(src.emissiveFactor);
+			dst.normalScale = glm::make_vec3(src.normalScale);
+			dst.alphaCutoff = src.alphaCutoff;
+			dst.occlusionStrenght = src.occlusionStrenght;
+			dst.metallicFactor = src.metallicFactor;
+			dst.roughnessFactor = src.roughnessFactor;
+			dst.name = getString(src.name);
+			dst.texturePaths.albedoTexturePath = fs::u8path(getString(src.albedoTexture));
+			dst.texturePaths.normalTexturePath = fs::u8path(getString(src.normalTexture));
+			dst.texturePaths.specularTexturePath = fs::u8path(getString(src.specularTexture));
+			dst.texturePaths.emissiveTexturePath = fs::u8path(getString(src.emissiveTexture));
+		}
+
+		auto copyBytes = [](std::vector<uint8_t>& dst, const uint8_t* src, uint64_t offset, uint64_t size, uint32_t srcSize) {
+			if (offset + size > srcSize) return false;
+			dst.assign(src + offset, src + offset + size);
+			return true;
+		};
+		auto copyIndices = [&](std::vector<uint32_t>& dst, uint32_t first, uint32_t count) {
+			if (uint64_t(first) + count > indexCount) return false;
+			dst.assign(indices + first, indices + first + count);
+			return true;
+		};
+		// every value of an index list points into a list of count elements
+		auto inRange = [](const uint32_t* first, size_t size, uint32_t count) {
+			return std::all_of(first, first + size, [count](uint32_t i) { return i < count; });
+		};
+
+		// the GPU blobs hold every mesh at its offsets here, as layoutPackedMeshes() lays them out
+		uint64_t gpuVertexCount = 0, gpuIndexCount = 0;
+		world.meshes.resize(meshCount);
+		for (uint32_t i = 0; i < meshCount; ++i)
+		{
+			const CachedMesh& src = meshes[i];
+			MeshData& dst = world.meshes[i];
+			dst.material = src.material;
+			dst.aabb.Min() = glm::make_vec3(src.aabbMin);
+			dst.aabb.Max() = glm::make_vec3(src.aabbMax);
+			gpuVertexCount = std::max(gpuVertexCount, uint64_t(src.firstVertex) + src.vertexCount);
+			gpuIndexCount = std::max(gpuIndexCount, uint64_t(src.firstIndex) + src.indexCount);
+
+			bool ok = copyIndices(dst.indices, src.firstIndex, src.indexCount) && src.indexCount % 3 == 0 &&
+				inRange(dst.indices.data(), dst.indices.size(), src.vertexCount) && src.lodCount < uint32_t(MAX_MESH_LODS);
+			ok = ok && copyBytes(dst.positions, positions, src.firstVertex * POSITION_SIZE, src.vertexCount * POSITION_SIZE, positionCount);
+			ok = ok && copyBytes(dst.normals, normals, src.firstVertex * NORMAL_SIZE, src.vertexCount * NORMAL_SIZE, normalCount);
+			ok = ok && copyBytes(dst.tangents, tangents, src.firstVertex * TANGENT_SIZE, src.vertexCount * TANGENT_SIZE, tangentCount);
+			ok = ok && copyBytes(dst.uvs, uvs, src.firstVertex * UV_SIZE, src.vertexCount * UV_SIZE, uvCount);
+			ok = ok && uint64_t(src.firstLod) + src.lodCount <= lodCount;
+
+			dst.lods.resize(ok ? src.lodCount : 0);
+			for (uint32_t l = 0; ok && l < src.lodCount; ++l)
+			{
+				const CachedLod& lod = lods[src.firstLod + l];
+				dst.lods[l].error = lod.error;
+				gpuIndexCount = std::max(gpuIndexCount, uint64_t(lod.firstIndex) + lod.indexCount);
+				ok = copyIndices(dst.lods[l].indices, lod.firstIndex, lod.indexCount) && lod.indexCount % 3 == 0 &&
+					inRange(dst.lods[l].indices.data(), lod.indexCount, src.vertexCount);
+			}
+
+			ok = ok && uint64_t(src.firstMeshlet) + src.meshletCount <= meshletCount &&
+				uint64_t(src.firstMeshletVertex) + src.meshletVertexCount <= meshletVertexCount;
+			ok = ok && copyBytes(dst.meshletTriangles, meshletTriangles, src.firstMeshletTriangle, src.meshletTriangleBytes, meshletTriangleCount);
+			ok = ok && inRange(meshletVertices + src.firstMeshletVertex, src.meshletVertexCount, src.vertexCount);
+			if (ok) {
+				dst.meshletVertices.assign(meshletVertices + src.firstMeshletVertex, meshletVertices + src.firstMeshletVertex + src.meshletVertexCount);
+			}
+			dst.meshlets.resize(ok ? src.meshletCount : 0);
+			for (uint32_t m = 0; ok && m < src.meshletCount; ++m)
+			{
+				const CachedMeshlet& meshlet = meshlets[src.firstMeshlet + m];
+				Meshlet& out = dst.meshlets[m];
+				out.vertexOffset = meshlet.vertexOffset;
+				out.triangleOffset = meshlet.triangleOffset;
+				out.vertexCount = meshlet.vertexCount;
+				out.triangleCount = meshlet.triangleCount;
+				out.sphere = Sphere(glm::make_vec3(meshlet.center), meshlet.radius);
+				out.aabb.Min() = glm::make_vec3(meshlet.aabbMin);
+				out.aabb.Max() = glm::make_vec3(meshlet.aabbMax);
+				out.coneApex = glm::make_vec3(meshlet.coneApex);
+				out.coneAxis = glm::make_vec3(meshlet.coneAxis);
+				out.coneCutoff = meshlet.coneCutoff;
+				ok = uint64_t(out.vertexOffset) + out.vertexCount <= src.meshletVertexCount &&
+					uint64_t(out.triangleOffset) + out.triangleCount * 3ull <= src.meshletTriangleBytes;
+			}
+			if (!ok) {
+				jsrlib::Error("Scene cache is corrupt");
+				return false;
+			}
+		}
+
+		// draws read every range of the mesh table, a short or mismatched blob would take them past the buffers
+		const GpuBlobs blobs = getGpuBlobs();
+		if (!blobs.vertices || !blobs.indices ||
+			blobs.vertexBytes != gpuVertexCount * blobs.vertexStride || blobs.indexBytes != gpuIndexCount * blobs.indexSize)
+		{
+			jsrlib::Error("Scene cache is corrupt");
+			return false;
+		}
+
+		world.scene.nodes.resize(nodeCount);
+		for (uint32_t i = 0; i < nodeCount; ++i)
+		{
+			const CachedNode& src = nodes[i];
+			Node3d& dst = world.scene.nodes[i];
+			if (uint64_t(src.firstEntity) + src.entityCount > linkCount || uint64_t(src.firstChild) + src.childCount > linkCount ||
+				src.type < 0 || src.type > EntityType_Empty || src.parent < -1 || src.parent >= int32_t(nodeCount) ||
+				!inRange(reinterpret_cast<const uint32_t*>(links + src.firstChild), src.childCount, nodeCount) ||
+				(src.type == EntityType_Mesh && !inRange(reinterpret_cast<const uint32_t*>(links + src.firstEntity), src.entityCount, meshCount)))
+			{
+				jsrlib::Error("Scene cache is corrupt");
+				return false;
+			}
+
+			dst.nodeType = EntityType(src.type);
+			if (!dst.isEmpty()) {
+				world.scene.entities[dst.nodeType].push_back(int(i));
+			}
+			dst.setEntity(std::vector<int>(links + src.firstEntity, links + src.firstEntity + src.entityCount));
+			dst.setChildren(std::vector<int>(links + src.firstChild, links + src.firstChild + src.childCount));
+			dst.setParent(src.parent);
+			dst.setPosition(glm::make_vec3(src.position));
+			dst.setRotation(glm::quat(src.rotation[3], src.rotation[0], src.rotation[1], src.rotation[2]));
+			dst.setScale(glm::make_vec3(src.scale));
+		}
+		if (!inRange(reinterpret_cast<const uint32_t*>(roots), rootCount, nodeCount)) {
+			jsrlib::Error("Scene cache is corrupt");
+			return false;
+		}
+		for (uint32_t i = 0; i < rootCount; ++i)
+		{
+			world.scene.rootNodes.push_back(roots[i]);
+			world.addUpdatableNode(roots[i]);
+		}
+		world.update();
+
+		// without all of them updateBVH() builds the mesh BVHs as usual
+		if (bvhCount == meshCount)
+		{
+			std::vector<MeshBVH> meshBVH(bvhCount);
+			for (uint32_t i = 0; i < bvhCount; ++i)
+			{
+				const CachedMeshBVH& src = bvhs[i];
+				MeshBVH& dst = meshBVH[i];
+				// three indices per leaf triangle, of the mesh the BVH belongs to
+				const MeshData& mesh = world.meshes[i];
+				const uint32_t vertexCount = uint32_t(mesh.positions.size() / POSITION_SIZE);
+				if (uint64_t(src.firstNode) + src.nodeCount > bvhNodeCount ||
+					uint64_t(src.firstIndex) + src.indexCount > bvhIndexCount ||
+					uint64_t(src.firstTriangle) + src.triangleCount > bvhTriangleCount ||
+					uint64_t(src.triangleCount) * 3 != src.indexCount ||
+					(src.nodeCount == 0 && src.triangleCount > 0) ||
+					!inRange(bvhIndices + src.firstIndex, src.indexCount, vertexCount) ||
+					!inRange(bvhTriangles + src.firstTriangle, src.triangleCount, uint32_t(mesh.indices.size() / 3)))
+				{
+					jsrlib::Error("Scene cache is corrupt");
+					return false;
+				}
+
+				dst.nodes.resize(src.nodeCount);
+				for (uint32_t n = 0; n < src.nodeCount; ++n)
+				{
+					const CachedBVHNode& node = bvhNodes[src.firstNode + n];
+					// leaves address leaf triangles, inner nodes two children after them so the walk ends
+					const bool valid = node.primCount > 0 ?
+						uint64_t(node.leftFirst) + node.primCount <= src.triangleCount :
+						node.leftFirst > n && uint64_t(node.leftFirst) + 1 < src.nodeCount;
+					if (!valid) {
+						jsrlib::Error("Scene cache is corrupt");
+						return false;
+					}
+					dst.nodes[n].aabb.Min() = glm::make_vec3(node.aabbMin);
+					dst.nodes[n].aabb.Max() = glm::make_vec3(node.aabbMax);
+					dst.nodes[n].leftFirst = node.leftFirst;
+					dst.nodes[n].primCount = node.primCount;
+				}
+				dst.indices.assign(bvhIndices + src.firstIndex, bvhIndices + src.firstIndex + src.indexCount);
+				dst.triangles.assign(bvhTriangles + src.firstTriangle, bvhTriangles + src.firstTriangle + src.triangleCount);
+			}
+			world.setMeshBVH(std::move(meshBVH));
+		}
+
+		return true;
+	}
+
+	SceneCache::GpuBlobs SceneCache::getGpuBlobs() const
+	{
+		GpuBlobs result{};
+		if (!m_file.isOpen()) return result;
+
+		FileHeader header;
+		memcpy(&header, m_file.data(), sizeof(header));
+		uint32_t count;
+		result.vertices = getSection<uint8_t>(SECTION_GPU_VERTICES, count);
+		result.vertexBytes = count;
+		result.vertexStride = header.vertexStride;
+		result.indices = getSection<uint8_t>(SECTION_GPU_INDICES, count);
+		result.indexBytes = count;
+		result.indexSize = header.indexSize;
+
+		return result;
+	}
+
+	bool SceneCache::write(const fs::path& path, const std::vector<fs::path>& sources, World& world, const GpuBlobs& blobs)
+	{
+		assert(blobs.vertexBytes < UINT32_MAX && blobs.indexBytes < UINT32_MAX);
+		CacheWriter writer;
+
+		std::vector<CachedSource> cachedSources;
+		for (const auto& src : sources)
+		{
+			CachedSource cs{};
+			if (!statFile(src, cs.size, cs.time) || !hashFile(src, cs.hash)) {
+				jsrlib::Error("Cannot read %s", src.u8string().c_str());
+				return false;
+			}
+			cs.path = writer.addString(fs::absolute(src).u8string());
+			cachedSources.push_back(cs);
+		}
+		writer.add(SECTION_SOURCES, cachedSources);
+
+		std::vector<CachedMaterial> materials;
+		for (const auto& m : world.materials)
+		{
+			CachedMaterial cm{};
+			cm.type = int32_t(m.type);
+			cm.alphaMode = int32_t(m.alphaMode);
+			cm.doubleSided = m.doubleSided ? 1 : 0;
+			memcpy(cm.baseColorFactor, &m.baseColorFactor[0], sizeof(cm.baseColorFactor));
+			memcpy(cm.emissiveFactor, &m.emissiveFactor[0], sizeof(cm.emissiveFactor));
+			memcpy(cm.normalScale, &m.normalScale[0], sizeof(cm.normalScale));
+			cm.alphaCutoff = m.alphaCutoff;
+			cm.occlusionStrenght = m.occlusionStrenght;
+			cm.metallicFactor = m.metallicFactor;
+			cm.roughnessFactor = m.roughnessFactor;
+			cm.name = writer.addString(m.name);
+			cm.albedoTexture = writer.addString(m.texturePaths.albedoTexturePath.u8string());
+			cm.normalTexture = writer.addString(m.texturePaths.normalTexturePath.u8string());
+			cm.specularTexture = writer.addString(m.texturePaths.specularTexturePath.u8string());
+			cm.emissiveTexture = writer.addString(m.texturePaths.emissiveTexturePath.u8string());
+			materials.push_back(cm);
+		}
+		writer.add(SECTION_MATERIALS, materials);
+
+		std::vector<CachedMesh> meshes;
+		std::vector<CachedLod> lods;
+		std::vector<CachedMeshlet> meshlets;
+		std::vector<uint32_t> indices, meshletVertices;
+		std::vector<uint8_t> meshletTriangles;
+		std::vector<uint8_t> positions, normals, tangents, uvs;
+		uint32_t vertexCount = 0;
+		for (const auto& mesh : world.meshes)
+		{
+			CachedMesh cm{};
+			cm.material = mesh.material;
+			memcpy(cm.aabbMin, &mesh.aabb.Min()[0], sizeof(cm.aabbMin));
+			memcpy(cm.aabbMax, &mesh.aabb.Max()[0], sizeof(cm.aabbMax));
+			cm.firstIndex = uint32_t(indices.size());
+			cm.indexCount = uint32_t(mesh.indices.size());
+			indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+			cm.firstVertex = vertexCount;
+			cm.vertexCount = uint32_t(mesh.positions.size() / POSITION_SIZE);
+			vertexCount += cm.vertexCount;
+			positions.insert(positions.end(), mesh.positions.begin(), mesh.positions.end());
+			normals.insert(normals.end(), mesh.normals.begin(), mesh.normals.end());
+			tangents.insert(tangents.end(), mesh.tangents.begin(), mesh.tangents.end());
+			uvs.insert(uvs.end(), mesh.uvs.begin(), mesh.uvs.end());
+			cm.firstLod = uint32_t(lods.size());
+			cm.lodCount = uint32_t(mesh.lods.size());
+			for (const auto& lod : mesh.lods)
+			{
+				lods.push_back({ uint32_t(indices.size()), uint32_t(lod.indices.size()), lod.error });
+				indices.insert(indices.end(), lod.indices.begin(), lod.indices.end());
+			}
+			cm.firstMeshlet = uint32_t(meshlets.size());
+			cm.meshletCount = uint32_t(mesh.meshlets.size());
+			cm.firstMeshletVertex = uint32_t(meshletVertices.size());
+			cm.meshletVertexCount = uint32_t(mesh.meshletVertices.size());
+			cm.firstMeshletTriangle = uint32_t(meshletTriangles.size());
+			cm.meshletTriangleBytes = uint32_t(mesh.meshletTriangles.size());
+			meshletVertices.insert(meshletVertices.end(), mesh.meshletVertices.begin(), mesh.meshletVertices.end());
+			meshletTriangles.insert(meshletTriangles.end(), mesh.meshletTriangles.begin(), mesh.meshletTriangles.end());
+			for (const auto& meshlet : mesh.meshlets)
+			{
+				CachedMeshlet cl{};
+				cl.vertexOffset = meshlet.vertexOffset;
+				cl.triangleOffset = meshlet.triangleOffset;
+				cl.vertexCount = meshlet.vertexCount;
+				cl.triangleCount = meshlet.triangleCount;
+				memcpy(cl.center, &meshlet.sphere.GetCenter()[0], sizeof(cl.center));
+				cl.radius = meshlet.sphere.GetRadius();
+				memcpy(cl.aabbMin, &meshlet.aabb.Min()[0], sizeof(cl.aabbMin));
+				memcpy(cl.aabbMax, &meshlet.aabb.Max()[0], sizeof(cl.aabbMax));
+				memcpy(cl.coneApex, &meshlet.coneApex[0], sizeof(cl.coneApex));
+				memcpy(cl.coneAxis, &meshlet.coneAxis[0], sizeof(cl.coneAxis));
+				cl.coneCutoff = meshlet.coneCutoff;
+				meshlets.push_back(cl);
+			}
+			meshes.push_back(cm);
+		}
+		writer.add(SECTION_MESHES, meshes);
+		writer.add(SECTION_LODS, lods);
+		writer.add(SECTION_MESHLETS, meshlets);
+		writer.add(SECTION_MESHLET_VERTICES, meshletVertices);
+		writer.add(SECTION_MESHLET_TRIANGLES, meshletTriangles);
+		writer.add(SECTION_INDICES, indices);
+		writer.add(SECTION_POSITIONS, positions);
+		writer.add(SECTION_NORMALS, normals);
+		writer.add(SECTION_TANGENTS, tangents);
+		writer.add(SECTION_UVS, uvs);
+
+		std::vector<CachedNode> nodes;
+		std::vector<int32_t> links;
+		for (const auto& node : world.scene.nodes)
+		{
+			CachedNode cn{};
+			cn.type = int32_t(node.getType());
+			cn.parent = node.getParent();
+			memcpy(cn.position, &node.getPosition()[0], sizeof(cn.position));
+			const glm::quat& q = node.getRotation();
+			cn.rotation[0] = q.x;
+			cn.rotation[1] = q.y;
+			cn.rotation[2] = q.z;
+			cn.rotation[3] = q.w;
+			memcpy(cn.scale, &node.getScale()[0], sizeof(cn.scale));
+			cn.firstEntity = uint32_t(links.size());
+			cn.entityCount = uint32_t(node.getEntities().size());
+			links.insert(links.end(), node.getEntities().begin(), node.getEntities().end());
+			cn.firstChild = uint32_t(links.size());
+			cn.childCount = uint32_t(node.getChildren().size());
+			links.insert(links.end(), node.getChildren().begin(), node.getChildren().end());
+			nodes.push_back(cn);
+		}
+		writer.add(SECTION_NODES, nodes);
+		writer.add(SECTION_NODE_LINKS, links);
+		writer.add(SECTION_ROOT_NODES, world.scene.rootNodes);
+
+		world.updateMeshBVH();
+		std::vector<CachedMeshBVH> bvhs;
+		std::vector<CachedBVHNode> bvhNodes;
+		std::vector<uint32_t> bvhIndices, bvhTriangles;
+		for (const auto& bvh : world.getMeshBVH())
+		{
+			CachedMeshBVH cb{};
+			cb.firstNode = uint32_t(bvhNodes.size());
+			cb.nodeCount = uint32_t(bvh.nodes.size());
+			for (const auto& node : bvh.nodes)
+			{
+				CachedBVHNode cn{};
+				memcpy(cn.aabbMin, &node.aabb.Min()[0], sizeof(cn.aabbMin));
+				memcpy(cn.aabbMax, &node.aabb.Max()[0], sizeof(cn.aabbMax));
+				cn.leftFirst = node.leftFirst;
+				cn.primCount = node.primCount;
+				bvhNodes.push_back(cn);
+			}
+			cb.firstIndex = uint32_t(bvhIndices.size());
+			cb.indexCount = uint32_t(bvh.indices.size());
+			bvhIndices.insert(bvhIndices.end(), bvh.indices.begin(), bvh.indices.end());
+			cb.firstTriangle = uint32_t(bvhTriangles.size());
+			cb.triangleCount = uint32_t(bvh.triangles.size());
+			bvhTriangles.insert(bvhTriangles.end(), bvh.triangles.begin(), bvh.triangles.end());
+			bvhs.push_back(cb);
+		}
+		writer.add(SECTION_MESH_BVHS, bvhs);
+		writer.add(SECTION_BVH_NODES, bvhNodes);
+		writer.add(SECTION_BVH_INDICES, bvhIndices);
+		writer.add(SECTION_BVH_TRIANGLES, bvhTriangles);
+
+		writer.add(SECTION_GPU_VERTICES, static_cast<const uint8_t*>(blobs.vertices), blobs.vertexBytes);
+		writer.add(SECTION_GPU_INDICES, static_cast<const uint8_t*>(blobs.indices), blobs.indexBytes);
+
+		if (!writer.write(path, blobs.vertexStride, blobs.indexSize))
+		{
+			jsrlib::Error("Cannot write scene cache %s", path.u8string().c_str());
+			return false;
+		}
+		jsrlib::Info("Scene cache written: %s (%.1f MB)", path.u8string().c_str(), double(writer.size()) / (1024.0 * 1024.0));
+
+		return true;
+	}
+}
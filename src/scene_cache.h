@@ -0,0 +1,64 @@
+#pragma once
+
+#include "pch.h"
+#include "world.h"
+#include "mapped_file.h"
+
+namespace jsr {
+
+	/*
+	Baked form of a loaded World, written after the first glTF load and memory mapped on the next start.
+	Every section (materials, mesh table, LODs, meshlets, attribute streams, node hierarchy, mesh BVHs and the
+	GPU ready interleaved vertex and index blobs of the renderer) starts at a 16 byte aligned offset,
+	so the blobs can be uploaded straight from the mapping.
+	The cache records size, modification time and a 64 bit FNV-1a hash of each source file (the glTF
+	and its buffers), open() fails when any of them changed. A changed time with the same content
+	is still accepted, the hash is only computed in that case.
+	*/
+	class SceneCache
+	{
+	public:
+		// 2: vertex cache and fetch optimized meshes
+		// 3: meshlets
+		// 4: welded meshes and generated tangents
+		// 5: LOD errors measured against the full detail surface
+		static const uint32_t VERSION = 5;
+
+		struct GpuBlobs {
+			const void* vertices = nullptr;
+			size_t vertexBytes = 0;
+			uint32_t vertexStride = 0;
+			const void* indices = nullptr;
+			size_t indexBytes = 0;
+			uint32_t indexSize = 0;
+		};
+
+		SceneCache() = default;
+		SceneCache(const SceneCache&) = delete;
+		SceneCache& operator=(const SceneCache&) = delete;
+		~SceneCache();
+
+		// false if the file is missing, has another version or blob layout, or a source changed.
+		// indexSize 0 accepts 2 and 4 byte indices, getGpuBlobs() tells which one it has
+		bool open(const std::filesystem::path& path, uint32_t vertexStride, uint32_t indexSize);
+		void close();
+		bool isOpen() const { return m_file.isOpen(); }
+
+		// fills an empty world, node transforms are updated and the mesh BVHs are set.
+		// false if any table points out of its arrays or the GPU blobs do not hold the ranges of the mesh table
+		bool load(World& world) const;
+		// points into the mapping, valid until close()
+		GpuBlobs getGpuBlobs() const;
+
+		// builds the mesh BVHs of the world if they are not built yet
+		static bool write(const std::filesystem::path& path, const std::vector<std::filesystem::path>& sources, World& world, const GpuBlobs& blobs);
+	private:
+		const void* getSection(uint32_t id, size_t elementSize, uint32_t& count) const;
+		template<class T> const T* getSection(uint32_t id, uint32_t& count) const {
+			return static_cast<const T*>(getSection(id, sizeof(T), count));
+		}
+		bool validateSources() const;
+
+		MappedFile m_file;
+	};
+}
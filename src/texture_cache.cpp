@@ -0,0 +1,369 @@
+#include <cstring>
+#include <cinttypes>
+#include <thread>
+#include "texture_cache.h"
+
+namespace jsr {
+
+	namespace fs = std::filesystem;
+
+	static const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	static const size_t KTX2_LEVEL_INDEX_OFFSET = 80;
+	static const char CACHE_KEY[] = "JSRtextureCache";
+	static const char SOURCE_HASHES_FILE[] = "sources.bin";
+	static const uint32_t SOURCE_HASHES_MAGIC = 0x48535254;		// "TRSH"
+
+	// the fixed part of the KTX2 header
+	struct Ktx2Header {
+		uint8_t identifier[12];
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+	static_assert(sizeof(Ktx2Header) == KTX2_LEVEL_INDEX_OFFSET, "KTX2 header layout");
+
+	struct Ktx2LevelIndex {
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	// the value of CACHE_KEY in the key/value data of an entry
+	struct CacheTag {
+		uint32_t version;
+		uint32_t transcodeFormat;
+		uint64_t sourceHash;
+		uint64_t dataHash;		// of the levels from level 0 down
+	};
+
+	TextureCache::TextureCache(const fs::path& directory, bool verifyData) : m_directory(directory), m_verifyData(verifyData)
+	{
+		std::error_code ec;
+		fs::create_directories(m_directory, ec);
+		loadSourceHashes();
+	}
+
+	TextureCache::~TextureCache()
+	{
+		if (m_sourceHashesChanged) {
+			saveSourceHashes();
+		}
+	}
+
+	static bool getFileTime(const fs::path& path, uint64_t& size, int64_t& time)
+	{
+		std::error_code ec;
+		size = fs::file_size(path, ec);
+		if (ec) return false;
+		const auto t = fs::last_write_time(path, ec);
+		if (ec) return false;
+		time = int64_t(t.time_since_epoch().count());
+		return true;
+	}
+
+	template<class Map>
+	static bool readFileHashes(std::istream& in, Map& hashes)
+	{
+		uint32_t count;
+		if (!in.read(reinterpret_cast<char*>(&count), sizeof(count))) return false;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			uint32_t length;
+			if (!in.read(reinterpret_cast<char*>(&length), sizeof(length)) || length > 4096) return false;
+			std::string path(length, '\0');
+			typename Map::mapped_type hash;
+			if (!in.read(&path[0], length) ||
+				!in.read(reinterpret_cast<char*>(&hash.size), sizeof(hash.size)) ||
+				!in.read(reinterpret_cast<char*>(&hash.time), sizeof(hash.time)) ||
+				!in.read(reinterpret_cast<char*>(&hash.hash), sizeof(hash.hash)))
+			{
+				return false;
+			}
+			hashes[path] = hash;
+		}
+		return true;
+	}
+
+	template<class Map>
+	static void writeFileHashes(std::ostream& out, const Map& hashes)
+	{
+		const uint32_t count = uint32_t(hashes.size());
+		out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+		for (const auto& it : hashes)
+		{
+			const uint32_t length = uint32_t(it.first.size());
+			out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+			out.write(it.first.data(), length);
+			out.write(reinterpret_cast<const char*>(&it.second.size), sizeof(it.second.size));
+			out.write(reinterpret_cast<const char*>(&it.second.time), sizeof(it.second.time));
+			out.write(reinterpret_cast<const char*>(&it.second.hash), sizeof(it.second.hash));
+		}
+	}
+
+	/*
+	sources.bin: magic, version, then the sources and the verified entries, each as a record count and
+	the records: path length, utf-8 path, size, modification time and hash. A file that does not parse
+	is ignored, the sources are hashed and the entries checked again.
+	*/
+	void TextureCache::loadSourceHashes()
+	{
+		std::ifstream in(m_directory / SOURCE_HASHES_FILE, std::ios::binary);
+		uint32_t head[2];
+		if (!in.read(reinterpret_cast<char*>(head), sizeof(head)) || head[0] != SOURCE_HASHES_MAGIC || head[1] != SOURCE_HASHES_VERSION) {
+			return;
+		}
+
+		FileHashes sources, entries;
+		if (readFileHashes(in, sources) && readFileHashes(in, entries))
+		{
+			m_sourceHashes = std::move(sources);
+			m_verifiedEntries = std::move(entries);
+		}
+	}
+
+	void TextureCache::saveSourceHashes() const
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		const fs::path path = m_directory / SOURCE_HASHES_FILE;
+		fs::path temp = path;
+		temp += ".tmp";
+		{
+			std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+			const uint32_t head[2] = { SOURCE_HASHES_MAGIC, SOURCE_HASHES_VERSION };
+			out.write(reinterpret_cast<const char*>(head), sizeof(head));
+			writeFileHashes(out, m_sourceHashes);
+			writeFileHashes(out, m_verifiedEntries);
+			if (!out) return;
+		}
+		std::error_code ec;
+		fs::rename(temp, path, ec);
+		if (ec) {
+			fs::remove(temp, ec);
+			return;
+		}
+		m_sourceHashesChanged = false;
+	}
+
+	bool TextureCache::getSourceHash(const fs::path& source, uint64_t& hash) const
+	{
+		uint64_t size;
+		int64_t time;
+		if (!getFileTime(source, size, time)) return false;
+
+		const std::string key = source.u8string();
+		{
+			std::lock_guard<std::mutex> lck(m_mutex);
+			auto it = m_sourceHashes.find(key);
+			if (it != m_sourceHashes.end() && it->second.size == size && it->second.time == time)
+			{
+				hash = it->second.hash;
+				return true;
+			}
+		}
+
+		if (!hashFile(source, hash)) return false;
+		uint64_t staleHash = hash;
+		{
+			std::lock_guard<std::mutex> lck(m_mutex);
+			auto it = m_sourceHashes.find(key);
+			if (it != m_sourceHashes.end()) {
+				staleHash = it->second.hash;
+			}
+			m_sourceHashes[key] = { size, time, hash };
+			m_sourceHashesChanged = true;
+		}
+		if (staleHash != hash) {
+			removeEntries(staleHash);
+		}
+
+		return true;
+	}
+
+	// the entries of a source that changed since, for every transcode format
+	void TextureCache::removeEntries(uint64_t sourceHash) const
+	{
+		char prefix[32];
+		snprintf(prefix, sizeof(prefix), "%016" PRIx64 "_", sourceHash);
+		std::error_code ec;
+		std::vector<fs::path> stale;
+		for (fs::directory_iterator it(m_directory, ec), end; !ec && it != end; it.increment(ec))
+		{
+			const std::string name = it->path().filename().u8string();
+			if (name.compare(0, strlen(prefix), prefix) == 0 && it->path().extension() == ".ktx2") {
+				stale.push_back(it->path());
+			}
+		}
+		for (const auto& path : stale)
+		{
+			if (fs::remove(path, ec)) {
+				m_stats.rejected++;
+			}
+			std::lock_guard<std::mutex> lck(m_mutex);
+			m_verifiedEntries.erase(path.filename().u8string());
+		}
+	}
+
+	bool TextureCache::isVerified(const fs::path& entry, uint64_t dataHash) const
+	{
+		uint64_t size;
+		int64_t time;
+		if (!getFileTime(entry, size, time)) return false;
+
+		std::lock_guard<std::mutex> lck(m_mutex);
+		auto it = m_verifiedEntries.find(entry.filename().u8string());
+		return it != m_verifiedEntries.end() && it->second.size == size && it->second.time == time && it->second.hash == dataHash;
+	}
+
+	void TextureCache::setVerified(const fs::path& entry, uint64_t dataHash) const
+	{
+		uint64_t size;
+		int64_t time;
+		if (!getFileTime(entry, size, time)) return;
+
+		std::lock_guard<std::mutex> lck(m_mutex);
+		m_verifiedEntries[entry.filename().u8string()] = { size, time, dataHash };
+		m_sourceHashesChanged = true;
+	}
+
+	fs::path TextureCache::getEntryPath(uint64_t sourceHash, uint32_t transcodeFormat) const
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "%016" PRIx64 "_%u.ktx2", sourceHash, transcodeFormat);
+		return m_directory / name;
+	}
+
+	bool TextureCache::open(const fs::path& source, uint32_t transcodeFormat, CachedTexture& entry) const
+	{
+		entry.m_file.close();
+		uint64_t sourceHash = 0;
+		const bool hashed = getSourceHash(source, sourceHash);
+		const fs::path path = getEntryPath(sourceHash, transcodeFormat);
+		if (!hashed || !entry.m_file.open(path))
+		{
+			m_stats.misses++;
+			return false;
+		}
+
+		const uint8_t* data = entry.m_file.data();
+		const size_t size = entry.m_file.size();
+		auto reject = [&]()
+		{
+			entry.m_file.close();
+			m_stats.rejected++;
+			m_stats.misses++;
+			return false;
+		};
+
+		Ktx2Header header;
+		if (size < sizeof(header)) return reject();
+		memcpy(&header, data, sizeof(header));
+		if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0 ||
+			header.vkFormat == 0 || header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 ||
+			header.layerCount != 0 || header.faceCount != 1 || header.levelCount == 0 || header.supercompressionScheme != 0 ||
+			sizeof(header) + uint64_t(header.levelCount) * sizeof(Ktx2LevelIndex) > size ||
+			uint64_t(header.kvdByteOffset) + header.kvdByteLength > size)
+		{
+			return reject();
+		}
+
+		entry.m_levels.resize(header.levelCount);
+		for (uint32_t level = 0; level < header.levelCount; ++level)
+		{
+			Ktx2LevelIndex index;
+			memcpy(&index, data + sizeof(header) + level * sizeof(index), sizeof(index));
+			if (index.byteOffset > size || index.byteLength > size - index.byteOffset) return reject();
+			entry.m_levels[level] = { index.byteOffset, index.byteLength };
+		}
+
+		// entries of the key/value data: length, key, terminating zero, value, padding to 4 bytes
+		CacheTag tag{};
+		bool tagged = false;
+		for (size_t pos = header.kvdByteOffset, end = pos + header.kvdByteLength; pos + sizeof(uint32_t) <= end;)
+		{
+			uint32_t length;
+			memcpy(&length, data + pos, sizeof(length));
+			pos += sizeof(length);
+			if (length > end - pos) break;
+			if (length == sizeof(CACHE_KEY) + sizeof(tag) && memcmp(data + pos, CACHE_KEY, sizeof(CACHE_KEY)) == 0)
+			{
+				memcpy(&tag, data + pos + sizeof(CACHE_KEY), sizeof(tag));
+				tagged = true;
+				break;
+			}
+			pos += (length + 3) & ~size_t(3);
+		}
+		if (!tagged || tag.version != VERSION || tag.transcodeFormat != transcodeFormat || tag.sourceHash != sourceHash) {
+			return reject();
+		}
+
+		// reads every byte of the entry, it costs about as much as the upload, so once per entry file
+		if (m_verifyData || !isVerified(path, tag.dataHash))
+		{
+			uint64_t dataHash = FNV1A_SEED;
+			for (const auto& level : entry.m_levels) {
+				dataHash = fnv1a(dataHash, data + level.offset, size_t(level.size));
+			}
+			if (dataHash != tag.dataHash) return reject();
+			setVerified(path, tag.dataHash);
+		}
+
+		entry.m_format = header.vkFormat;
+		entry.m_width = header.pixelWidth;
+		entry.m_height = header.pixelHeight;
+		m_stats.hits++;
+
+		return true;
+	}
+
+	bool TextureCache::write(const fs::path& source, uint32_t transcodeFormat, ktxTexture2* texture) const
+	{
+		uint64_t sourceHash;
+		if (texture->supercompressionScheme != KTX_SS_NONE || texture->numDimensions != 2 || texture->isArray || texture->numFaces != 1 ||
+			!ktxTexture_GetData(ktxTexture(texture)) || !getSourceHash(source, sourceHash))
+		{
+			return false;
+		}
+
+		CacheTag tag{ VERSION, transcodeFormat, sourceHash, FNV1A_SEED };
+		for (uint32_t level = 0; level < texture->numLevels; ++level)
+		{
+			ktx_size_t offset;
+			if (ktxTexture_GetImageOffset(ktxTexture(texture), level, 0, 0, &offset) != KTX_SUCCESS) return false;
+			tag.dataHash = fnv1a(tag.dataHash, ktxTexture_GetData(ktxTexture(texture)) + offset, ktxTexture_GetImageSize(ktxTexture(texture), level));
+		}
+		if (ktxHashList_AddKVPair(&texture->kvDataHead, CACHE_KEY, sizeof(tag), &tag) != KTX_SUCCESS) {
+			return false;
+		}
+
+		// a partly written entry never has the final name
+		const fs::path path = getEntryPath(sourceHash, transcodeFormat);
+		fs::path temp = path;
+		temp += ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+		if (ktxTexture_WriteToNamedFile(ktxTexture(texture), temp.u8string().c_str()) != KTX_SUCCESS) {
+			return false;
+		}
+		std::error_code ec;
+		fs::rename(temp, path, ec);
+		if (ec) {
+			fs::remove(temp, ec);
+			return false;
+		}
+		// hashed from the memory it was written from
+		setVerified(path, tag.dataHash);
+		m_stats.writes++;
+
+		return true;
+	}
+}
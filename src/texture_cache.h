@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include "pch.h"
+#include "ktx.h"
+#include "mapped_file.h"
+
+namespace jsr {
+
+	/*
+	A memory mapped cache entry, checked by TextureCache::open(). The levels point into the mapping.
+	*/
+	class CachedTexture
+	{
+	public:
+		uint32_t getFormat() const { return m_format; }		// VkFormat
+		uint32_t getWidth() const { return m_width; }
+		uint32_t getHeight() const { return m_height; }
+		uint32_t getLevelCount() const { return uint32_t(m_levels.size()); }
+		const uint8_t* getLevel(uint32_t level) const { return m_file.data() + m_levels[level].offset; }
+		size_t getLevelSize(uint32_t level) const { return size_t(m_levels[level].size); }
+	private:
+		friend class TextureCache;
+		struct Level {
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		MappedFile m_file;
+		uint32_t m_format = 0;
+		uint32_t m_width = 0;
+		uint32_t m_height = 0;
+		std::vector<Level> m_levels;
+	};
+
+	/*
+	Transcoded Basis textures on disk, so the same file is not transcoded again for the same target format.
+	Entries are named by the FNV-1a hash of the source file and the transcode format, a changed source
+	gets a new entry and its old ones are removed. An entry is a plain KTX2 file with the final VkFormat
+	and no supercompression, a key/value entry records the version, the source hash and the hash of the
+	level data. Entries failing any check are transcoded and written again. Can be used from several threads.
+	sources.bin of the directory keeps the hashes of the sources and the entries whose level data matched
+	their tag, both by path, size and modification time. A source is hashed again and the data of an entry
+	checked again only when one of them changes, with verifyData the data is checked on every open().
+	*/
+	class TextureCache
+	{
+	public:
+		static const uint32_t VERSION = 1;
+		static const uint32_t SOURCE_HASHES_VERSION = 2;
+
+		struct Stats {
+			std::atomic<uint32_t> hits{ 0 };
+			std::atomic<uint32_t> misses{ 0 };
+			std::atomic<uint32_t> rejected{ 0 };	// present but stale or corrupt, entries of changed sources too
+			std::atomic<uint32_t> writes{ 0 };
+		};
+
+		explicit TextureCache(const std::filesystem::path& directory, bool verifyData = false);
+		TextureCache(const TextureCache&) = delete;
+		TextureCache& operator=(const TextureCache&) = delete;
+		// writes sources.bin if new hashes were computed
+		~TextureCache();
+
+		// false on a miss, the entry is left closed
+		bool open(const std::filesystem::path& source, uint32_t transcodeFormat, CachedTexture& entry) const;
+		// stores a texture transcoded from source, levels of 2D textures without layers and faces only
+		bool write(const std::filesystem::path& source, uint32_t transcodeFormat, ktxTexture2* texture) const;
+
+		const Stats& getStats() const { return m_stats; }
+	private:
+		struct FileHash {
+			uint64_t size;
+			int64_t time;
+			uint64_t hash;
+		};
+		using FileHashes = std::unordered_map<std::string, FileHash>;
+
+		// hashed once per size and modification time, the entries of the previous hash are removed when it changed
+		bool getSourceHash(const std::filesystem::path& source, uint64_t& hash) const;
+		void removeEntries(uint64_t sourceHash) const;
+		// the level data of the entry was checked against dataHash at its size and modification time
+		bool isVerified(const std::filesystem::path& entry, uint64_t dataHash) const;
+		void setVerified(const std::filesystem::path& entry, uint64_t dataHash) const;
+		std::filesystem::path getEntryPath(uint64_t sourceHash, uint32_t transcodeFormat) const;
+		void loadSourceHashes();
+		void saveSourceHashes() const;
+
+		std::filesystem::path m_directory;
+		bool m_verifyData;
+		mutable std::mutex m_mutex;
+		mutable FileHashes m_sourceHashes;
+		mutable FileHashes m_verifiedEntries;	// by file name, the hash is the data hash of the tag
+		mutable bool m_sourceHashesChanged = false;
+		mutable Stats m_stats;
+	};
+}
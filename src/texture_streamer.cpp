@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include "texture_streamer.h"
+#include "jobsys.h"
+
+namespace jsr {
+
+	TextureStreamer::TextureStreamer(TextureStreamBackend& backend, size_t budgetBytes, uint32_t maxPendingLoads) :
+		m_backend(backend),
+		m_budget(budgetBytes),
+		m_maxPendingLoads(std::max(1u, maxPendingLoads))
+	{
+	}
+
+	TextureStreamer::~TextureStreamer()
+	{
+		m_jobs.wait();
+	}
+
+	uint32_t TextureStreamer::addTexture()
+	{
+		m_textures.emplace_back();
+		return uint32_t(m_textures.size() - 1);
+	}
+
+	void TextureStreamer::loadMipTails()
+	{
+		for (uint32_t i = 0; i < uint32_t(m_textures.size()); ++i)
+		{
+			if (m_textures[i].state != State_New || m_textures[i].pendingLevel != ~0u) continue;
+			m_textures[i].pendingLevel = 0;
+			jobsys.submitJob([this, i](int)
+				{
+					Completed c{ i, 0, false };
+					c.ok = m_backend.describe(i, c.desc) && c.desc.width > 0 && c.desc.height > 0 && !c.desc.levelSizes.empty();
+					if (c.ok)
+					{
+						const uint32_t levelCount = uint32_t(c.desc.levelSizes.size());
+						while (c.level + 1 < levelCount && std::max(c.desc.width >> c.level, c.desc.height >> c.level) > TEXTURE_MIP_TAIL_SIZE) {
+							++c.level;
+						}
+						c.ok = m_backend.loadLevels(i, c.level, c.levels);
+					}
+					std::lock_guard<std::mutex> lck(m_completedMutex);
+					m_completed.push_back(std::move(c));
+				}, &m_jobs);
+		}
+		m_jobs.wait();
+		applyCompleted();
+	}
+
+	void TextureStreamer::requestTexture(uint32_t texture, float screenPixels)
+	{
+		if (texture >= m_textures.size()) return;
+		Texture& t = m_textures[texture];
+		if (t.requestFrame != m_frame)
+		{
+			t.requestFrame = m_frame;
+			t.screenPixels = screenPixels;
+		}
+		else
+		{
+			t.screenPixels = std::max(t.screenPixels, screenPixels);
+		}
+	}
+
+	void TextureStreamer::update()
+	{
+		applyCompleted();
+
+		// the tails are not negotiable, the rest of the budget goes to the most wanted textures first
+		std::vector<uint32_t> order;
+		size_t available = m_budget;
+		for (uint32_t i = 0; i < uint32_t(m_textures.size()); ++i)
+		{
+			Texture& t = m_textures[i];
+			if (t.state != State_Streamed) continue;
+			if (m_frame - t.requestFrame >= REQUEST_FRAMES) t.screenPixels = 0.0f;
+			const size_t tail = bytesFrom(t, t.tailLevel);
+			available -= std::min(available, tail);
+			order.push_back(i);
+		}
+		std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return m_textures[a].screenPixels > m_textures[b].screenPixels; });
+
+		for (uint32_t i : order)
+		{
+			Texture& t = m_textures[i];
+			const size_t tail = bytesFrom(t, t.tailLevel);
+			// a texture waiting to retry a failed load keeps what it has
+			uint32_t level = t.residentLevel;
+			if (m_frame >= t.retryFrame)
+			{
+				level = wantedLevel(t);
+				while (level < t.tailLevel && bytesFrom(t, level) - tail > available) {
+					++level;
+				}
+			}
+			available -= std::min(available, bytesFrom(t, level) - tail);
+			t.targetLevel = level;
+		}
+
+		// shrinking first, the least wanted textures first, it makes room for the growth of the next frames
+		size_t pending = m_stats.pendingLoads;
+		for (auto it = order.rbegin(); it != order.rend() && pending < m_maxPendingLoads; ++it)
+		{
+			Texture& t = m_textures[*it];
+			if (t.pendingLevel == ~0u && t.targetLevel > t.residentLevel) {
+				submitLoad(*it, t.targetLevel);
+				++pending;
+			}
+		}
+
+		// a texture grows only as far as the memory resident now and the loads in flight leave room for
+		for (uint32_t i : order)
+		{
+			if (pending >= m_maxPendingLoads) break;
+			Texture& t = m_textures[i];
+			if (t.pendingLevel != ~0u || t.targetLevel >= t.residentLevel) continue;
+			const size_t resident = bytesFrom(t, t.residentLevel);
+			for (uint32_t level = t.targetLevel; level < t.residentLevel; ++level)
+			{
+				const size_t growth = bytesFrom(t, level) - resident;
+				if (m_stats.residentBytes + m_pendingGrowth + growth <= m_budget)
+				{
+					m_pendingGrowth += growth;
+					submitLoad(i, level);
+					++pending;
+					break;
+				}
+			}
+		}
+		m_stats.pendingLoads = pending;
+
+		++m_frame;
+	}
+
+	void TextureStreamer::flush()
+	{
+		m_jobs.wait();
+		applyCompleted();
+	}
+
+	bool TextureStreamer::isStreamed(uint32_t texture) const
+	{
+		return texture < m_textures.size() && m_textures[texture].state == State_Streamed;
+	}
+
+	uint32_t TextureStreamer::getResidentLevel(uint32_t texture) const
+	{
+		return isStreamed(texture) ? m_textures[texture].residentLevel : ~0u;
+	}
+
+	uint32_t TextureStreamer::getTargetLevel(uint32_t texture) const
+	{
+		return isStreamed(texture) ? m_textures[texture].targetLevel : ~0u;
+	}
+
+	size_t TextureStreamer::bytesFrom(const Texture& t, uint32_t level) const
+	{
+		return std::accumulate(t.desc.levelSizes.begin() + std::min(size_t(level), t.desc.levelSizes.size()), t.desc.levelSizes.end(), size_t(0));
+	}
+
+	uint32_t TextureStreamer::wantedLevel(const Texture& t) const
+	{
+		if (t.screenPixels <= 0.0f) return t.tailLevel;
+
+		// the level with about as many texels as the object covers pixels
+		const float texels = float(std::max(t.desc.width, t.desc.height));
+		const float level = std::floor(std::log2(texels / t.screenPixels));
+		return uint32_t(glm::clamp(level, 0.0f, float(t.tailLevel)));
+	}
+
+	void TextureStreamer::applyCompleted()
+	{
+		std::vector<Completed> completed;
+		{
+			std::lock_guard<std::mutex> lck(m_completedMutex);
+			completed.swap(m_completed);
+		}
+
+		for (auto& c : completed)
+		{
+			Texture& t = m_textures[c.texture];
+			t.pendingLevel = ~0u;
+
+			if (t.state == State_New)
+			{
+				if (!c.ok)
+				{
+					t.state = State_Failed;
+					continue;
+				}
+				t.state = State_Streamed;
+				t.desc = std::move(c.desc);
+				t.tailLevel = c.level;
+				t.residentLevel = c.level;
+				t.targetLevel = c.level;
+				m_backend.makeResident(c.texture, c.level, t.desc, c.levels);
+				m_stats.residentBytes += bytesFrom(t, c.level);
+				m_stats.loadedBytes += c.levels.getSize();
+				m_stats.streamedTextures++;
+				continue;
+			}
+
+			m_stats.pendingLoads -= std::min(m_stats.pendingLoads, size_t(1));
+			const size_t before = bytesFrom(t, t.residentLevel);
+			const size_t after = bytesFrom(t, c.level);
+			if (after > before) m_pendingGrowth -= std::min(m_pendingGrowth, after - before);
+			if (!c.ok)
+			{
+				// a missing or corrupt file fails again, without a wait it would be loaded every frame
+				m_stats.failedLoads++;
+				t.retryFrame = m_frame + std::min(uint64_t(RETRY_FRAMES) << std::min(t.failures, 31u), uint64_t(MAX_RETRY_FRAMES));
+				t.failures++;
+				continue;
+			}
+			t.failures = 0;
+
+			m_backend.makeResident(c.texture, c.level, t.desc, c.levels);
+			m_stats.residentBytes = m_stats.residentBytes - before + after;
+			m_stats.loadedBytes += c.levels.getSize();
+			if (c.level < t.residentLevel) m_stats.loads++;
+			else m_stats.evictions++;
+			t.residentLevel = c.level;
+		}
+	}
+
+	void TextureStreamer::submitLoad(uint32_t texture, uint32_t level)
+	{
+		m_textures[texture].pendingLevel = level;
+		jobsys.submitJob([this, texture, level](int)
+			{
+				Completed c{ texture, level, false };
+				c.ok = m_backend.loadLevels(texture, level, c.levels);
+				std::lock_guard<std::mutex> lck(m_completedMutex);
+				m_completed.push_back(std::move(c));
+			}, &m_jobs);
+	}
+}
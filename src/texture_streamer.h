@@ -0,0 +1,142 @@
+#pragma once
+
+#include "pch.h"
+#include "jsrlib/jsr_semaphore.h"
+
+namespace jsr {
+
+	// levels not larger than this are loaded up front and never evicted
+	static const uint32_t TEXTURE_MIP_TAIL_SIZE = 64;
+
+	struct TextureStreamDesc {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<size_t> levelSizes;		// bytes of every level, level 0 is the largest
+	};
+
+	struct TextureStreamData {
+		std::vector<uint8_t> data;			// the loaded levels tightly packed, largest first
+		uint32_t format = 0;				// defined by the backend
+		// or the levels in memory owned by owner, a mapped file, at levelOffsets from mapped
+		std::shared_ptr<const void> owner;
+		const uint8_t* mapped = nullptr;
+		size_t mappedSize = 0;
+		std::vector<size_t> levelOffsets;
+
+		const uint8_t* getData() const { return mapped ? mapped : data.data(); }
+		size_t getSize() const { return mapped ? mappedSize : data.size(); }
+	};
+
+	/*
+	Where the streamed textures come from and go to. describe() and loadLevels() run on the job system,
+	makeResident() on the thread calling TextureStreamer::update().
+	*/
+	class TextureStreamBackend
+	{
+	public:
+		virtual ~TextureStreamBackend() = default;
+		// false: the texture cannot be streamed, it is left to the application
+		virtual bool describe(uint32_t texture, TextureStreamDesc& desc) = 0;
+		// levels [firstLevel, levelCount)
+		virtual bool loadLevels(uint32_t texture, uint32_t firstLevel, TextureStreamData& out) = 0;
+		// replaces the resident levels of the texture with [firstLevel, levelCount)
+		virtual void makeResident(uint32_t texture, uint32_t firstLevel, const TextureStreamDesc& desc, const TextureStreamData& levels) = 0;
+	};
+
+	/*
+	Mip residency of textures under a memory budget. The mip tail of every texture is loaded first,
+	the finer levels are streamed on the job system, most wanted first. A texture wants the level matching
+	the largest screen size its objects were requested with. When the wanted levels do not fit the
+	budget the lower priority textures get coarser levels, resident ones are shrunk to free room.
+	Every residency change reloads the levels from the backend and swaps them in at once,
+	so a texture is always complete from its resident level down to 1x1. A texture whose load failed
+	keeps its resident levels and is not loaded again for RETRY_FRAMES, twice as long after every
+	further failure.
+	*/
+	class TextureStreamer
+	{
+	public:
+		struct Stats {
+			size_t residentBytes = 0;
+			size_t pendingLoads = 0;
+			size_t streamedTextures = 0;
+			size_t loads = 0;					// finished residency increases
+			size_t evictions = 0;				// finished residency decreases
+			size_t loadedBytes = 0;
+			size_t failedLoads = 0;				// of residency changes, the tails are not counted
+		};
+
+		// maxPendingLoads: residency changes in flight, the shrinking ones too
+		TextureStreamer(TextureStreamBackend& backend, size_t budgetBytes, uint32_t maxPendingLoads = 4);
+		TextureStreamer(const TextureStreamer&) = delete;
+		TextureStreamer& operator=(const TextureStreamer&) = delete;
+		~TextureStreamer();
+
+		// the id the backend gets, ids are consecutive from 0
+		uint32_t addTexture();
+		// describes the new textures and loads their mip tails on the job system, blocks until they are resident
+		void loadMipTails();
+
+		// screenPixels: size of an object using the texture on the screen this frame
+		void requestTexture(uint32_t texture, float screenPixels);
+		// once a frame: makes the finished loads resident, then schedules new loads and evictions
+		void update();
+		// blocks until nothing is pending, the finished loads are made resident
+		void flush();
+
+		void setBudget(size_t budgetBytes) { m_budget = budgetBytes; }
+		size_t getBudget() const { return m_budget; }
+		bool isStreamed(uint32_t texture) const;
+		// the finest resident level, ~0 if the texture is not streamed
+		uint32_t getResidentLevel(uint32_t texture) const;
+		// the level the budget allows at the last update
+		uint32_t getTargetLevel(uint32_t texture) const;
+		const Stats& getStats() const { return m_stats; }
+
+		// frames a request keeps a texture wanted
+		static const uint32_t REQUEST_FRAMES = 30;
+		// frames a texture waits after a failed load, doubled up to MAX_RETRY_FRAMES while it keeps failing
+		static const uint32_t RETRY_FRAMES = 30;
+		static const uint32_t MAX_RETRY_FRAMES = 30 * 64;
+	private:
+		enum State { State_New, State_Streamed, State_Failed };
+
+		struct Texture {
+			State state = State_New;
+			TextureStreamDesc desc;
+			uint32_t tailLevel = 0;
+			uint32_t residentLevel = ~0u;
+			uint32_t targetLevel = ~0u;
+			uint32_t pendingLevel = ~0u;		// ~0: no load in flight
+			float screenPixels = 0.0f;			// largest request of the last REQUEST_FRAMES frames
+			uint64_t requestFrame = 0;
+			uint32_t failures = 0;				// failed loads since the last one that finished
+			uint64_t retryFrame = 0;			// no loads before this frame
+		};
+
+		struct Completed {
+			uint32_t texture;
+			uint32_t level;
+			bool ok;
+			TextureStreamData levels;
+			TextureStreamDesc desc;				// of the tail loads
+		};
+
+		size_t bytesFrom(const Texture& t, uint32_t level) const;
+		uint32_t wantedLevel(const Texture& t) const;
+		void applyCompleted();
+		void submitLoad(uint32_t texture, uint32_t level);
+
+		TextureStreamBackend& m_backend;
+		size_t m_budget;
+		uint32_t m_maxPendingLoads;
+		uint64_t m_frame = 0;
+		size_t m_pendingGrowth = 0;			// bytes the loads in flight add when they finish
+		std::vector<Texture> m_textures;
+		Stats m_stats;
+
+		std::mutex m_completedMutex;
+		std::vector<Completed> m_completed;
+		jsrlib::counting_semaphore m_jobs;
+	};
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "pch.h"
+#include "texture_streamer.h"
+
+namespace jsr {
+
+	/*
+	In-memory textures for running the TextureStreamer without a GPU. Every texel byte of level n is n,
+	the resident levels of every texture and the residency changes are recorded.
+	*/
+	class MockTextureStreamBackend : public TextureStreamBackend
+	{
+	public:
+		struct Residency {
+			uint32_t texture;
+			uint32_t firstLevel;
+			size_t bytes;
+		};
+
+		// bytesPerTexel: 4 for RGBA8, 1 for a 4x4 block of 16 bytes
+		uint32_t addTexture(uint32_t width, uint32_t height, size_t bytesPerTexel = 4)
+		{
+			TextureStreamDesc desc;
+			desc.width = width;
+			desc.height = height;
+			for (uint32_t w = width, h = height;; w = std::max(1u, w / 2), h = std::max(1u, h / 2))
+			{
+				desc.levelSizes.push_back(size_t(w) * h * bytesPerTexel);
+				if (w == 1 && h == 1) break;
+			}
+			std::lock_guard<std::mutex> lck(m_mutex);
+			m_textures.push_back(desc);
+			m_resident.push_back(~0u);
+			m_failBelow.push_back(0);
+			return uint32_t(m_textures.size() - 1);
+		}
+
+		bool describe(uint32_t texture, TextureStreamDesc& desc) override
+		{
+			std::lock_guard<std::mutex> lck(m_mutex);
+			if (texture >= m_textures.size()) return false;
+			desc = m_textures[texture];
+			return true;
+		}
+
+		bool loadLevels(uint32_t texture, uint32_t firstLevel, TextureStreamData& out) override
+		{
+			std::lock_guard<std::mutex> lck(m_mutex);
+			if (texture >= m_textures.size()) return false;
+			if (firstLevel < m_failBelow[texture])
+			{
+				m_failedLoads++;
+				return false;
+			}
+			const auto& sizes = m_textures[texture].levelSizes;
+			out.data.clear();
+			for (uint32_t level = firstLevel; level < uint32_t(sizes.size()); ++level) {
+				out.data.insert(out.data.end(), sizes[level], uint8_t(level));
+			}
+			m_loads++;
+			return true;
+		}
+
+		void makeResident(uint32_t texture, uint32_t firstLevel, const TextureStreamDesc& desc, const TextureStreamData& levels) override
+		{
+			std::lock_guard<std::mutex> lck(m_mutex);
+			m_resident[texture] = firstLevel;
+			m_history.push_back({ texture, firstLevel, levels.getSize() });
+		}
+
+		// loads of the levels finer than level fail as a corrupt file would, 0 lets them all succeed
+		void setFailingLevels(uint32_t texture, uint32_t level)
+		{
+			std::lock_guard<std::mutex> lck(m_mutex);
+			m_failBelow[texture] = level;
+		}
+
+		uint32_t getResidentLevel(uint32_t texture) const { return m_resident[texture]; }
+		size_t getResidentBytes() const
+		{
+			size_t bytes = 0;
+			for (size_t i = 0; i < m_textures.size(); ++i)
+			{
+				if (m_resident[i] == ~0u) continue;
+				const auto& sizes = m_textures[i].levelSizes;
+				for (size_t level = m_resident[i]; level < sizes.size(); ++level) bytes += sizes[level];
+			}
+			return bytes;
+		}
+		size_t getLoadCount() const { return m_loads; }
+		size_t getFailedLoadCount() const { return m_failedLoads; }
+		const std::vector<Residency>& getHistory() const { return m_history; }
+	private:
+		std::mutex m_mutex;
+		std::vector<TextureStreamDesc> m_textures;
+		std::vector<uint32_t> m_resident;
+		std::vector<Residency> m_history;
+		std::vector<uint32_t> m_failBelow;
+		size_t m_loads = 0;
+		size_t m_failedLoads = 0;
+	};
+}
@@ -3,9 +3,13 @@
 
 #include "vkjs/vkjs.h"
 #include "glm/glm.hpp"
+#include "glm/gtc/packing.hpp"
+#include "bounds.h"
 
 namespace jsr {
 
+	enum VertexFormat { VERTEX_FORMAT_FULL, VERTEX_FORMAT_COMPACT };
+
 	struct Vertex {
 		float				xyz[4];
 		float				uv[2];
@@ -131,5 +135,158 @@ namespace jsr {
 
 	};
 	static_assert(sizeof(Vertex) == 40);
+
+	/*
+	20 byte vertex for the main passes. The position is 16 bit unorm relative to the bounds of its mesh,
+	dequantization() maps it back and is folded into the model matrix of the draw, so the vertex shader
+	only differs in decoding the normal and the tangent. Those are octahedral encoded 16 bit snorm pairs,
+	the sign of the tangent w goes into position w. UVs are half floats, fine up to a few thousand repeats.
+	Worst case errors: position extent / 131070 per axis, normal and tangent direction 0.004 degrees,
+	UV 1/2048 relative.
+	*/
+	struct VertexCompact {
+		uint16_t			position[4];	// xyz: unorm in the mesh bounds, w: tangent w, 0 is -1
+		int16_t				normal[2];
+		int16_t				tangent[2];
+		uint16_t			uv[2];
+
+		static inline VertexInputDescription vertex_input_description() {
+
+			VertexInputDescription ret{};
+
+			VkVertexInputBindingDescription mainBinding = {};
+			mainBinding.binding = 0;
+			mainBinding.stride = sizeof(VertexCompact);
+			mainBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+			ret.bindings.push_back(mainBinding);
+
+			// the locations are the same as of Vertex
+			VkVertexInputAttributeDescription positionAttribute = {};
+			positionAttribute.binding = 0;
+			positionAttribute.location = 0;
+			positionAttribute.format = VK_FORMAT_R16G16B16A16_UNORM;
+			positionAttribute.offset = offsetof(VertexCompact, position);
+
+			VkVertexInputAttributeDescription uvAttribute = {};
+			uvAttribute.binding = 0;
+			uvAttribute.location = 1;
+			uvAttribute.format = VK_FORMAT_R16G16_SFLOAT;
+			uvAttribute.offset = offsetof(VertexCompact, uv);
+
+			VkVertexInputAttributeDescription normalAttribute = {};
+			normalAttribute.binding = 0;
+			normalAttribute.location = 2;
+			normalAttribute.format = VK_FORMAT_R16G16_SNORM;
+			normalAttribute.offset = offsetof(VertexCompact, normal);
+
+			VkVertexInputAttributeDescription tangentAttribute = {};
+			tangentAttribute.binding = 0;
+			tangentAttribute.location = 3;
+			tangentAttribute.format = VK_FORMAT_R16G16_SNORM;
+			tangentAttribute.offset = offsetof(VertexCompact, tangent);
+
+			ret.attributes.push_back(positionAttribute);
+			ret.attributes.push_back(uvAttribute);
+			ret.attributes.push_back(normalAttribute);
+			ret.attributes.push_back(tangentAttribute);
+
+			return ret;
+		}
+		static inline VertexInputDescription vertex_input_description_position_only()
+		{
+			VertexInputDescription ret{};
+
+			VkVertexInputBindingDescription mainBinding = {};
+			mainBinding.binding = 0;
+			mainBinding.stride = sizeof(VertexCompact);
+			mainBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+			ret.bindings.push_back(mainBinding);
+
+			VkVertexInputAttributeDescription positionAttribute = {};
+			positionAttribute.binding = 0;
+			positionAttribute.location = 0;
+			positionAttribute.format = VK_FORMAT_R16G16B16A16_UNORM;
+			positionAttribute.offset = offsetof(VertexCompact, position);
+
+			ret.attributes.push_back(positionAttribute);
+
+			return ret;
+		}
+
+		// object space position = dequantization(bounds) * vec4(position.xyz, 1)
+		static inline glm::mat4 dequantization(const Bounds& bounds) {
+			const glm::vec3 extent = bounds.GetMax() - bounds.GetMin();
+			glm::mat4 m(1.0f);
+			m[0][0] = extent.x;
+			m[1][1] = extent.y;
+			m[2][2] = extent.z;
+			m[3] = glm::vec4(bounds.GetMin(), 1.0f);
+			return m;
+		}
+
+		static inline glm::vec2 oct_encode(const glm::vec3& v) {
+			const glm::vec3 n = v / (glm::abs(v.x) + glm::abs(v.y) + glm::abs(v.z));
+			if (n.z >= 0.0f) {
+				return glm::vec2(n);
+			}
+			return (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+		}
+
+		static inline glm::vec3 oct_decode(const glm::vec2& e) {
+			glm::vec3 n(e.x, e.y, 1.0f - glm::abs(e.x) - glm::abs(e.y));
+			const float t = glm::max(-n.z, 0.0f);
+			n.x += n.x >= 0.0f ? -t : t;
+			n.y += n.y >= 0.0f ? -t : t;
+			return glm::normalize(n);
+		}
+
+		inline void set_position(const float* v, const Bounds& bounds) {
+			const glm::vec3 extent = bounds.GetMax() - bounds.GetMin();
+			for (int i = 0; i < 3; ++i) {
+				const float q = extent[i] > 0.0f ? (v[i] - bounds.GetMin()[i]) / extent[i] : 0.0f;
+				position[i] = static_cast<uint16_t>(glm::round(glm::clamp(q, 0.0f, 1.0f) * 65535.0f));
+			}
+		}
+
+		inline void set_uv(const float* v) {
+			uv[0] = glm::packHalf1x16(v[0]);
+			uv[1] = glm::packHalf1x16(v[1]);
+		}
+
+		inline void pack_normal(const float* v) {
+			pack_oct(glm::vec3(v[0], v[1], v[2]), normal);
+		}
+
+		inline void pack_tangent(const float* v) {
+			pack_oct(glm::vec3(v[0], v[1], v[2]), tangent);
+			position[3] = v[3] < 0.0f ? 0 : 65535;
+		}
+
+		inline glm::vec3 get_position(const Bounds& bounds) const {
+			return glm::vec3(dequantization(bounds) * glm::vec4(glm::vec3(position[0], position[1], position[2]) / 65535.0f, 1.0f));
+		}
+
+		inline glm::vec3 get_normal() const {
+			return oct_decode(glm::max(glm::vec2(normal[0], normal[1]) / 32767.0f, -1.0f));
+		}
+
+		inline glm::vec3 get_tangent() const {
+			return oct_decode(glm::max(glm::vec2(tangent[0], tangent[1]) / 32767.0f, -1.0f));
+		}
+
+	private:
+		static inline void pack_oct(const glm::vec3& v, int16_t* dst) {
+			if (glm::abs(v.x) + glm::abs(v.y) + glm::abs(v.z) == 0.0f) {
+				dst[0] = dst[1] = 0;
+				return;
+			}
+			const glm::vec2 e = glm::round(glm::clamp(oct_encode(v), -1.0f, 1.0f) * 32767.0f);
+			dst[0] = static_cast<int16_t>(e.x);
+			dst[1] = static_cast<int16_t>(e.y);
+		}
+	};
+	static_assert(sizeof(VertexCompact) == 20);
 }
 #endif
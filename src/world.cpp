@@ -1,6 +1,9 @@
 #include "pch.h"
+#include <xmmintrin.h>
+#include <cassert>
 #include "world.h"
 #include "frustum.h"
+#include "jobsys.h"
 #include <jsrlib/jsr_logger.h>
 #include <glm/gtx/matrix_decompose.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -128,7 +131,7 @@ namespace jsr {
 	{
 		const glm::mat4 initialMatrix = glm::mat4(1.f);
 
-		const bool dirty = !_nodesToUpdate.empty();
+		bool meshMoved = false;
 		std::vector<glm::mat4> parentMatrices(_nodesToUpdate.size(), initialMatrix);
 		while (!_nodesToUpdate.empty())
 		{
@@ -142,6 +145,7 @@ namespace jsr {
 
 			node.updateTransform(parentMatrix);
 			node.setNeedToUpdate(false);
+			meshMoved |= node.isMesh();
 
 			for (const int child : node.getChildren()) {
 				_nodesToUpdate.push_back(child);
@@ -149,6 +153,15 @@ namespace jsr {
 				scene.nodes[child].setNeedToUpdate(true);
 			}
 		}
+
+		// culling and ray queries would see the bounds of the last build
+		const size_t count = scene.entities[EntityType_Mesh].size();
+		assert((bvhPrimitiveCount == 0 || bvhPrimitiveCount == count) && "mesh nodes added after updateBVH()");
+		if (meshMoved && bvhPrimitiveCount > 0 && bvhPrimitiveCount == count)
+		{
+			UpdatePrimitiveBounds();
+			RefitBVH();
+		}
 	}
 	RenderEntityList World::getVisibleEntities(const Frustum& frustum)
 	{
@@ -156,17 +169,25 @@ namespace jsr {
 		RenderEntityList result;
 
 		intersectTestCount = 0;
-#if 0
-		IntersectBVH(frustum, bvhRootNodeIdx, result);
-#else
+		planeTestCount = 0;
+		UpdateCullStates();
+		if (!lst.empty() && !bvhNode.empty())
+		{
+			// children of a node fully inside a plane skip that plane
+			IntersectBVH(frustum, bvhRootNodeIdx, result);
+			return result;
+		}
+
 		for (const int e : lst) {
 			const Node3d& node = scene.nodes[e];
+			CullState* states = &cullStates[cullStateFirst[e]];
 			for (const int p : node.getEntities())
 			{
 				const MeshData& md = meshes[p];
 				const Bounds bounds = md.aabb.Transform(node.getTransform());
+				uint8_t planeMask = FRUSTUM_ALL_PLANES;
 				intersectTestCount++;
-				if (frustum.Intersects2(bounds)) {
+				if (frustum.Intersects2(bounds, planeMask, *states++, planeTestCount) != CullResult_Outside) {
 					RenderEntity ent;
 					ent.aabb = bounds;
 					ent.object.modelMatrix = node.getTransform();
@@ -175,24 +196,51 @@ namespace jsr {
 				}
 			}
 		}
-#endif
-		jsrlib::Info("Intersect tested: %d", intersectTestCount);
 		return result;
 	}
 	void World::updateBVH()
 	{
-		if (bvhNode.size() < scene.entities[EntityType_Mesh].size()) {
-			bvhNode.resize(scene.entities[EntityType_Mesh].size());
-			aabbs.resize(scene.entities[EntityType_Mesh].size());
+		const size_t count = scene.entities[EntityType_Mesh].size();
+		// a binary tree with N leaves has at most 2N-1 nodes (+1 for the unused slot)
+		if (bvhNode.size() < 2 * count) {
+			bvhNode.resize(2 * count);
+			aabbs.resize(count);
+		}
+
+		if (count > 0) {
+			buildBVH();
 		}
+		bvhPrimitiveCount = count;
+		bvhCullStates.assign(bvhNode.size(), CullState{});
+
+		updateMeshBVH();
+	}
 
-		buildBVH();
+	void World::updateMeshBVH()
+	{
+		if (meshBVH.size() != meshes.size()) {
+			meshBVH.resize(meshes.size());
+			for (size_t i = 0; i < meshes.size(); ++i) {
+				BuildMeshBVH(meshes[i], meshBVH[i]);
+			}
+		}
 	}
 
 	void World::buildBVH()
 	{
 		bvhNodesUsed = 2;
+		UpdatePrimitiveBounds();
 
+		BVHNode& root = bvhNode[0];
+		root.leftFirst = 0;
+		root.primCount = scene.entities[EntityType_Mesh].size();
+
+		UdateNodeBounds(0);
+		Subdivide(0);
+	}
+	// world bounds of every mesh node, in the leaf order of the BVH
+	void World::UpdatePrimitiveBounds()
+	{
 		for (size_t i = 0; i < scene.entities[EntityType_Mesh].size(); ++i)
 		{
 			const Node3d& node = scene.nodes[scene.entities[EntityType_Mesh][i]];
@@ -203,13 +251,6 @@ namespace jsr {
 			}
 			aabbs[i] = b;
 		}
-
-		BVHNode& root = bvhNode[0];
-		root.leftFirst = 0;
-		root.primCount = scene.entities[EntityType_Mesh].size();
-
-		UdateNodeBounds(0);
-		Subdivide(0);
 	}
 	void World::UdateNodeBounds(uint32_t nodeIdx)
 	{
@@ -246,8 +287,8 @@ namespace jsr {
 		float splitPos = node.aabb.min()[axis] + extent[axis] * 0.5f;
 		*/
 
-		size_t i = node.leftFirst;
-		size_t j = i + node.primCount - 1;
+		int64_t i = node.leftFirst;
+		int64_t j = i + node.primCount - 1;
 
 		while (i <= j)
 		{
@@ -263,7 +304,7 @@ namespace jsr {
 			}
 		}
 
-		size_t leftCount = i - node.leftFirst;
+		size_t leftCount = size_t(i - node.leftFirst);
 		if (leftCount == 0 || leftCount == node.primCount) {
 			return;
 		}
@@ -291,29 +332,35 @@ namespace jsr {
 	}
 	void World::IntersectBVH(const Frustum& frustum, uint32_t nodeIdx, RenderEntityList& out)
 	{
-		std::vector<uint32_t> nodeToTest = { nodeIdx };
+		struct StackEntry { uint32_t node; uint8_t planeMask; };
+		std::vector<StackEntry> nodeToTest = { { nodeIdx, FRUSTUM_ALL_PLANES } };
 
 		while (!nodeToTest.empty())
 		{
-			const uint32_t _nodeIdx = nodeToTest.back();
+			const StackEntry top = nodeToTest.back();
 			nodeToTest.pop_back();
 
-			BVHNode& node = bvhNode[_nodeIdx];
+			BVHNode& node = bvhNode[top.node];
+			uint8_t planeMask = top.planeMask;
 			intersectTestCount++;
-			if (!frustum.Intersects2(node.aabb)) {
+			if (frustum.Intersects2(node.aabb, planeMask, bvhCullStates[top.node], planeTestCount) == CullResult_Outside) {
 				continue;
 			}
 
 			if (node.isLeaf())
 			{
 				for (size_t i = 0; i < node.primCount; ++i) {
-					const Node3d& p = scene.nodes[scene.entities[EntityType_Mesh][node.leftFirst + i]];
+					const int nodeId = scene.entities[EntityType_Mesh][node.leftFirst + i];
+					const Node3d& p = scene.nodes[nodeId];
+					CullState* states = &cullStates[cullStateFirst[nodeId]];
 					for (const int e : p.getEntities()) {
 						const MeshData& md = meshes[e];
 						Bounds bbox = md.aabb.Transform(p.getTransform());
 
+						// fully inside parents need no plane tests at all
+						uint8_t primMask = planeMask;
 						intersectTestCount++;
-						if (frustum.Intersects2(bbox)) {
+						if (frustum.Intersects2(bbox, primMask, *states++, planeTestCount) != CullResult_Outside) {
 							out.emplace_back();
 							RenderEntity& ent = out.back();
 							ent.aabb = bbox;
@@ -325,13 +372,363 @@ namespace jsr {
 			}
 			else
 			{
-				//IntersectBVH(frustum, node.leftChild, out);
-				//IntersectBVH(frustum, node.leftChild + 1, out);
-				nodeToTest.push_back(node.leftFirst);
-				nodeToTest.push_back(node.leftFirst + 1);
+				nodeToTest.push_back({ node.leftFirst, planeMask });
+				nodeToTest.push_back({ node.leftFirst + 1, planeMask });
+			}
+		}
+	}
+	void World::UpdateCullStates()
+	{
+		if (cullStateFirst.size() == scene.nodes.size()) {
+			return;
+		}
+
+		cullStateFirst.resize(scene.nodes.size());
+		uint32_t count = 0;
+		for (size_t i = 0; i < scene.nodes.size(); ++i)
+		{
+			cullStateFirst[i] = count;
+			if (scene.nodes[i].isMesh()) {
+				count += (uint32_t)scene.nodes[i].getEntities().size();
+			}
+		}
+		cullStates.assign(count, CullState{});
+	}
+	// sine of the smallest angle between the ray and a triangle that still hits it
+	static const float RAY_EPSILON = 1e-6f;
+
+	/*
+	Moller-Trumbore ray-triangle test, 4 triangles at a time (double sided).
+	The determinant is compared relative to the edge and direction lengths, it does not depend on
+	the size of the triangle or the scale of the scene. Returns true if a hit closer than tbest was found.
+	*/
+	static bool IntersectTriangles(const float* positions, const uint32_t* indices, size_t triCount, const vec3& o, const vec3& d, float& tbest, uint32_t& triangle, vec2& bary)
+	{
+		alignas(16) float v0[3][4], e1[3][4], e2[3][4];
+		alignas(16) float tt[4], uu[4], vv[4];
+		bool found = false;
+
+		const __m128 ox = _mm_set1_ps(o.x), oy = _mm_set1_ps(o.y), oz = _mm_set1_ps(o.z);
+		const __m128 dx = _mm_set1_ps(d.x), dy = _mm_set1_ps(d.y), dz = _mm_set1_ps(d.z);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 eps2 = _mm_set1_ps(RAY_EPSILON * RAY_EPSILON * dot(d, d));
+
+		for (size_t base = 0; base < triCount; base += 4)
+		{
+			const size_t n = std::min<size_t>(4, triCount - base);
+			for (size_t k = 0; k < 4; ++k)
+			{
+				// the last batch is padded with its last triangle
+				const size_t tri = base + std::min(k, n - 1);
+				const float* a = &positions[indices[tri * 3 + 0] * 3];
+				const float* b = &positions[indices[tri * 3 + 1] * 3];
+				const float* c = &positions[indices[tri * 3 + 2] * 3];
+				for (int i = 0; i < 3; ++i)
+				{
+					v0[i][k] = a[i];
+					e1[i][k] = b[i] - a[i];
+					e2[i][k] = c[i] - a[i];
+				}
+			}
+
+			const __m128 e1x = _mm_load_ps(e1[0]), e1y = _mm_load_ps(e1[1]), e1z = _mm_load_ps(e1[2]);
+			const __m128 e2x = _mm_load_ps(e2[0]), e2y = _mm_load_ps(e2[1]), e2z = _mm_load_ps(e2[2]);
+
+			// p = d x e2
+			const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+			const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+			const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+			const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+			const __m128 e1len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, e1x), _mm_mul_ps(e1y, e1y)), _mm_mul_ps(e1z, e1z));
+			const __m128 e2len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, e2x), _mm_mul_ps(e2y, e2y)), _mm_mul_ps(e2z, e2z));
+			const __m128 invDet = _mm_div_ps(one, det);
+
+			// s = o - v0
+			const __m128 sx = _mm_sub_ps(ox, _mm_load_ps(v0[0]));
+			const __m128 sy = _mm_sub_ps(oy, _mm_load_ps(v0[1]));
+			const __m128 sz = _mm_sub_ps(oz, _mm_load_ps(v0[2]));
+			const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+
+			// q = s x e1
+			const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+			const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+			const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+			const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+			const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+			// det^2 > eps^2 |e1|^2 |e2|^2 |d|^2
+			__m128 mask = _mm_cmpgt_ps(_mm_mul_ps(det, det), _mm_mul_ps(_mm_mul_ps(e1len2, e2len2), eps2));
+			mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+			mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+			mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), one));
+			mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, zero));
+			mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(tbest)));
+
+			const int bits = _mm_movemask_ps(mask);
+			if (bits == 0) continue;
+
+			_mm_store_ps(tt, t);
+			_mm_store_ps(uu, u);
+			_mm_store_ps(vv, v);
+			for (size_t k = 0; k < n; ++k)
+			{
+				if ((bits & (1 << k)) && tt[k] < tbest)
+				{
+					tbest = tt[k];
+					triangle = uint32_t(base + k);
+					bary = vec2(uu[k], vv[k]);
+					found = true;
+				}
 			}
 		}
+
+		return found;
 	}
+
+	static const uint32_t MESH_BVH_LEAF_SIZE = 8;
+	static const uint32_t MESH_BVH_STACK_SIZE = 64;
+
+	void World::BuildMeshBVH(const MeshData& mesh, MeshBVH& bvh)
+	{
+		const float* positions = reinterpret_cast<const float*>(mesh.positions.data());
+		const uint32_t triCount = uint32_t(mesh.indices.size() / 3);
+		if (triCount == 0)
+		{
+			// no nodes, Raycast tests the triangles of the mesh directly
+			bvh = MeshBVH();
+			return;
+		}
+
+		std::vector<vec3> centers(triCount);
+		std::vector<Bounds> bounds(triCount);
+		bvh.triangles.resize(triCount);
+		for (uint32_t t = 0; t < triCount; ++t)
+		{
+			Bounds b;
+			for (int i = 0; i < 3; ++i) {
+				b << make_vec3(&positions[mesh.indices[t * 3 + i] * 3]);
+			}
+			bounds[t] = b;
+			centers[t] = b.GetCenter();
+			bvh.triangles[t] = t;
+		}
+
+		bvh.nodes.clear();
+		bvh.nodes.reserve(2 * (triCount / MESH_BVH_LEAF_SIZE + 1));
+		bvh.nodes.push_back({ Bounds(), 0, triCount });
+
+		std::vector<uint32_t> nodeToSplit = { 0 };
+		while (!nodeToSplit.empty())
+		{
+			const uint32_t nodeIdx = nodeToSplit.back();
+			nodeToSplit.pop_back();
+
+			BVHNode node = bvh.nodes[nodeIdx];
+			Bounds centerBounds;
+			for (uint32_t i = 0; i < node.primCount; ++i) {
+				node.aabb << bounds[bvh.triangles[node.leftFirst + i]];
+				centerBounds << centers[bvh.triangles[node.leftFirst + i]];
+			}
+
+			if (node.primCount > MESH_BVH_LEAF_SIZE)
+			{
+				// median split on the longest axis of the centers
+				const vec3 extent = centerBounds.Max() - centerBounds.Min();
+				int axis = 0;
+				if (extent.y > extent.x) axis = 1;
+				if (extent.z > extent[axis]) axis = 2;
+
+				const uint32_t half = node.primCount / 2;
+				auto first = bvh.triangles.begin() + node.leftFirst;
+				std::nth_element(first, first + half, first + node.primCount, [&centers, axis](uint32_t a, uint32_t b)
+					{
+						return centers[a][axis] < centers[b][axis];
+					});
+
+				const uint32_t left = (uint32_t)bvh.nodes.size();
+				bvh.nodes.push_back({ Bounds(), node.leftFirst, half });
+				bvh.nodes.push_back({ Bounds(), node.leftFirst + half, node.primCount - half });
+				node.leftFirst = left;
+				node.primCount = 0;
+				nodeToSplit.push_back(left);
+				nodeToSplit.push_back(left + 1);
+			}
+
+			bvh.nodes[nodeIdx] = node;
+		}
+
+		bvh.indices.resize(size_t(triCount) * 3);
+		for (uint32_t t = 0; t < triCount; ++t)
+		{
+			for (int i = 0; i < 3; ++i) {
+				bvh.indices[t * 3 + i] = mesh.indices[bvh.triangles[t] * 3 + i];
+			}
+		}
+	}
+
+	void World::IntersectNode(int nodeIdx, const glm::vec3& origin, const glm::vec3& dir, RayHit& hit) const
+	{
+		const Node3d& node = scene.nodes[nodeIdx];
+		const mat4 invModel = inverse(node.getTransform());
+		// t is preserved by the affine transform, the direction is not normalized
+		const vec3 o = vec3(invModel * vec4(origin, 1.0f));
+		const vec3 d = mat3(invModel) * dir;
+		const vec3 invDir = 1.0f / d;
+
+		for (const int e : node.getEntities())
+		{
+			const MeshData& md = meshes[e];
+			float tnear, tfar;
+			if (!md.aabb.RayIntersect(o, invDir, tnear, tfar) || tfar < 0.0f || tnear > hit.t) {
+				continue;
+			}
+
+			const float* positions = reinterpret_cast<const float*>(md.positions.data());
+			if (size_t(e) >= meshBVH.size() || meshBVH[e].nodes.empty())
+			{
+				if (IntersectTriangles(positions, md.indices.data(), md.indices.size() / 3, o, d, hit.t, hit.triangle, hit.barycentrics)) {
+					hit.node = nodeIdx;
+					hit.mesh = e;
+				}
+				continue;
+			}
+
+			// deep enough for the median split trees, a deeper one spills over to the heap
+			const MeshBVH& bvh = meshBVH[e];
+			uint32_t stack[MESH_BVH_STACK_SIZE];
+			std::vector<uint32_t> spill;
+			int sp = 0;
+			stack[sp++] = 0;
+			while (sp > 0 || !spill.empty())
+			{
+				uint32_t bvhIdx;
+				if (!spill.empty()) {
+					bvhIdx = spill.back();
+					spill.pop_back();
+				}
+				else {
+					bvhIdx = stack[--sp];
+				}
+				const BVHNode& bn = bvh.nodes[bvhIdx];
+				if (!bn.aabb.RayIntersect(o, invDir, tnear, tfar) || tfar < 0.0f || tnear > hit.t) {
+					continue;
+				}
+				if (bn.isLeaf())
+				{
+					uint32_t local;
+					if (IntersectTriangles(positions, &bvh.indices[size_t(bn.leftFirst) * 3], bn.primCount, o, d, hit.t, local, hit.barycentrics)) {
+						hit.node = nodeIdx;
+						hit.mesh = e;
+						hit.triangle = bvh.triangles[bn.leftFirst + local];
+					}
+				}
+				else if (sp + 2 <= int(MESH_BVH_STACK_SIZE))
+				{
+					stack[sp++] = bn.leftFirst + 1;
+					stack[sp++] = bn.leftFirst;
+				}
+				else
+				{
+					spill.push_back(bn.leftFirst + 1);
+					spill.push_back(bn.leftFirst);
+				}
+			}
+		}
+	}
+
+	bool World::Raycast(const glm::vec3& origin, const glm::vec3& dir, float tmax, RayHit& hit) const
+	{
+		hit = RayHit();
+		hit.t = tmax;
+
+		const std::vector<int>& lst = scene.entities[EntityType_Mesh];
+		const vec3 invDir = 1.0f / dir;
+		float tnear, tfar;
+
+		if (bvhNode.empty())
+		{
+			for (size_t i = 0; i < lst.size(); ++i) {
+				IntersectNode(lst[i], origin, dir, hit);
+			}
+			return hit.hit();
+		}
+
+		struct StackEntry { uint32_t node; float tnear; };
+		std::vector<StackEntry> stack;
+		stack.reserve(64);
+
+		if (bvhNode[bvhRootNodeIdx].aabb.RayIntersect(origin, invDir, tnear, tfar) && tfar >= 0.0f && tnear <= hit.t) {
+			stack.push_back({ bvhRootNodeIdx, tnear });
+		}
+
+		while (!stack.empty())
+		{
+			const StackEntry top = stack.back();
+			stack.pop_back();
+
+			// a closer hit was found since the node was pushed
+			if (top.tnear > hit.t) continue;
+
+			const BVHNode& node = bvhNode[top.node];
+			if (node.isLeaf())
+			{
+				for (uint32_t i = 0; i < node.primCount; ++i)
+				{
+					const uint32_t idx = node.leftFirst + i;
+					if (aabbs[idx].RayIntersect(origin, invDir, tnear, tfar) && tfar >= 0.0f && tnear <= hit.t) {
+						IntersectNode(lst[idx], origin, dir, hit);
+					}
+				}
+				continue;
+			}
+
+			// visit the nearer child first: push it last
+			float tnear0, tnear1, tfar0, tfar1;
+			const bool hit0 = bvhNode[node.leftFirst].aabb.RayIntersect(origin, invDir, tnear0, tfar0) && tfar0 >= 0.0f && tnear0 <= hit.t;
+			const bool hit1 = bvhNode[node.leftFirst + 1].aabb.RayIntersect(origin, invDir, tnear1, tfar1) && tfar1 >= 0.0f && tnear1 <= hit.t;
+
+			if (hit0 && hit1)
+			{
+				if (tnear0 <= tnear1) {
+					stack.push_back({ node.leftFirst + 1, tnear1 });
+					stack.push_back({ node.leftFirst, tnear0 });
+				}
+				else {
+					stack.push_back({ node.leftFirst, tnear0 });
+					stack.push_back({ node.leftFirst + 1, tnear1 });
+				}
+			}
+			else if (hit0) {
+				stack.push_back({ node.leftFirst, tnear0 });
+			}
+			else if (hit1) {
+				stack.push_back({ node.leftFirst + 1, tnear1 });
+			}
+		}
+
+		return hit.hit();
+	}
+
+	void World::RaycastN(const Ray* rays, size_t count, RayHit* hits) const
+	{
+		const size_t batchSize = 64;
+		jsrlib::counting_semaphore counter;
+
+		for (size_t first = 0; first < count; first += batchSize)
+		{
+			const size_t last = std::min(count, first + batchSize);
+			jobsys.submitJob([this, rays, hits, first, last](int threadId)
+				{
+					for (size_t i = first; i < last; ++i) {
+						Raycast(rays[i].origin, rays[i].dir, rays[i].tmax, hits[i]);
+					}
+				}, &counter);
+		}
+
+		counter.wait();
+	}
+
 	float World::EvaluateSAH(BVHNode& node, int axis, float pos)
 	{
 		Bounds leftBox, rightBox;
@@ -361,10 +758,10 @@ namespace jsr {
 		float bestCost = std::numeric_limits<float>::max();
 
 		struct Bin { Bounds bounds; int primCount = 0; };
-		Bin bin[BINS];
 
 		for (int a = 0; a < 3; a++)
 		{
+			Bin bin[BINS];
 			float boundsMin = node.aabb.Min()[a];
 			float boundsMax = node.aabb.Max()[a];
 
@@ -372,7 +769,7 @@ namespace jsr {
 
 			float scale = BINS / (boundsMax - boundsMin);
 
-			for (uint32_t i = 1; i < node.primCount; i++)
+			for (uint32_t i = 0; i < node.primCount; i++)
 			{
 				int binIdx = std::min(BINS - 1, (int)((aabbs[node.leftFirst + i].GetCenter()[a] - boundsMin) * scale));
 				bin[binIdx].primCount++;
@@ -5,6 +5,7 @@
 #include "material.h"
 #include "light.h"
 #include "bounds.h"
+#include "frustum.h"
 
 namespace jsr {
 
@@ -70,6 +71,21 @@ namespace jsr {
 
 	typedef std::vector<RenderEntity> RenderEntityList;
 
+	struct Ray {
+		glm::vec3 origin;
+		glm::vec3 dir;
+		float tmax;
+	};
+
+	struct RayHit {
+		int node = -1;					// scene node of the hit entity
+		int mesh = -1;					// mesh (primitive) index
+		uint32_t triangle = 0;			// triangle index in the mesh
+		float t = std::numeric_limits<float>::max();
+		glm::vec2 barycentrics = glm::vec2(0.0f);	// weights of the 2nd and 3rd vertex
+		bool hit() const { return node >= 0; }
+	};
+
 	struct BVHNode {
 		Bounds aabb;
 		uint32_t leftFirst;
@@ -77,6 +93,13 @@ namespace jsr {
 		bool isLeaf() const { return primCount > 0; }
 	};
 
+	// triangle BVH of a mesh, used by ray queries
+	struct MeshBVH {
+		std::vector<BVHNode> nodes;
+		std::vector<uint32_t> indices;		// mesh indices in leaf order
+		std::vector<uint32_t> triangles;	// original triangle index of each leaf triangle
+	};
+
 	class World {
 	public:
 		Scene scene;
@@ -93,21 +116,45 @@ namespace jsr {
 		int add(int parent, const Node3d& n);
 		void addUpdatableNode(int n);
 		void addUpdatableNode(int n, const int* data);
+		// transforms of the queued nodes and their children, the scene BVH is refit when a mesh node moved
 		void update();
+		// builds the scene BVH, again after mesh nodes were added or moved far: a refit keeps the tree
 		void updateBVH();
+		// triangle BVH of every mesh, once, updateBVH() calls it
+		void updateMeshBVH();
+		const std::vector<MeshBVH>& getMeshBVH() const { return meshBVH; }
+		// precomputed ones, one per mesh
+		void setMeshBVH(std::vector<MeshBVH>&& bvh) { meshBVH = std::move(bvh); }
+		// walks the BVH once updateBVH() has built it
 		RenderEntityList getVisibleEntities(const Frustum& frustum);
+		int getIntersectTestCount() const { return intersectTestCount; }
+		int getPlaneTestCount() const { return planeTestCount; }
+		// closest hit along origin + t * dir, t in (0,tmax), needs updateBVH()
+		bool Raycast(const glm::vec3& origin, const glm::vec3& dir, float tmax, RayHit& hit) const;
+		// traces the rays in parallel on the job system
+		void RaycastN(const Ray* rays, size_t count, RayHit* hits) const;
 	private:
 		void buildBVH();
+		void UpdatePrimitiveBounds();
 		void UdateNodeBounds(uint32_t);
 		void Subdivide(uint32_t);
 		void IntersectBVH(const Frustum& frustum, uint32_t nodeIdx, RenderEntityList& out);
+		void UpdateCullStates();
+		void IntersectNode(int nodeIdx, const glm::vec3& origin, const glm::vec3& dir, RayHit& hit) const;
+		static void BuildMeshBVH(const MeshData& mesh, MeshBVH& bvh);
 		float EvaluateSAH(BVHNode& node, int axis, float pos);
 		float FindBestSplitPlane(BVHNode& node, int& axis, float& splitPos);
 		float CalculateNodeCost(BVHNode& node);
 		void RefitBVH();
 
 		std::vector<int> _nodesToUpdate;
+		size_t bvhPrimitiveCount = 0;			// mesh nodes when the BVH was built
 		int intersectTestCount = 0;
+		int planeTestCount = 0;
+		std::vector<uint32_t> cullStateFirst;	// first cull state of the scene node's primitives
+		std::vector<CullState> cullStates;		// one per mesh primitive instance
+		std::vector<CullState> bvhCullStates;	// one per bvh node
+		std::vector<MeshBVH> meshBVH;			// one per mesh
 	};
 
 	struct RenderWorld {
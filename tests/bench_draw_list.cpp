@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <random>
+#include "test_common.h"
+#include "draw_list.h"
+
+using namespace jsr;
+
+// opaque draw keys of a scene with 2000 mesh and material states, random depths
+static std::vector<DrawItem> makeItems(size_t count)
+{
+	std::mt19937 rng(7);
+	std::uniform_int_distribution<uint32_t> state(0, 1999), pass(0, 1);
+	std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+	std::vector<DrawItem> items(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint32_t s = state(rng);
+		items[i] = { DrawKey::make(pass(rng), 0, s % 300, s, s % 4, depth(rng), false), uint32_t(i) };
+	}
+	return items;
+}
+
+// every run sorts a fresh copy of the unsorted draws, the copy is part of each column
+static void benchSort()
+{
+	std::printf("%-8s %12s %12s %12s %8s\n", "draws", "radix ms", "sort ms", "stable ms", "speedup");
+	for (size_t count : { size_t(10000), size_t(100000), size_t(1000000) })
+	{
+		const std::vector<DrawItem> unsorted = makeItems(count);
+		std::vector<DrawItem> items(count), temp(count);
+		auto less = [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; };
+
+		const double radixMs = test::measureMs([&]()
+			{
+				items = unsorted;
+				radixSort(items.data(), temp.data(), count);
+			});
+		const double sortMs = test::measureMs([&]()
+			{
+				items = unsorted;
+				std::sort(items.begin(), items.end(), less);
+			});
+		const double stableMs = test::measureMs([&]()
+			{
+				items = unsorted;
+				std::stable_sort(items.begin(), items.end(), less);
+			});
+		std::printf("%-8zu %12.3f %12.3f %12.3f %7.1fx\n", count, radixMs, sortMs, stableMs, stableMs / radixMs);
+	}
+}
+
+int main()
+{
+	benchSort();
+	return 0;
+}
@@ -0,0 +1,63 @@
+#include <thread>
+#include "test_common.h"
+#include "test_gltf_scenes.h"
+#include "gltf_loader.h"
+#include "mesh_pack.h"
+
+using namespace jsr;
+
+/*
+The mesh decode of the glTF loader and the packing of the scene buffers on job systems of 1 to N workers,
+over a generated model of 256 primitives without a file read. Half of them generate their tangents.
+*/
+static void benchDecode()
+{
+	const tinygltf::Model model = test::makeGltfModel(32, 8, 60);
+	size_t vertexCount = 0;
+	for (const auto& mesh : model.meshes)
+	{
+		for (const auto& prim : mesh.primitives) vertexCount += model.accessors[prim.attributes.at("POSITION")].count;
+	}
+
+	std::vector<int> workerCounts;
+	const int maxWorkers = int(std::max(1u, std::thread::hardware_concurrency()));
+	for (int workers = 1; workers < maxWorkers; workers *= 2) workerCounts.push_back(workers);
+	workerCounts.push_back(maxWorkers);
+
+	std::printf("%zu primitives, %zu vertices\n", model.meshes.size() * model.meshes[0].primitives.size(), vertexCount);
+	std::printf("%-8s %12s %12s %12s %10s\n", "workers", "decode ms", "pack ms", "Mverts/s", "speedup");
+	double singleMs = 0.0;
+	for (int workers : workerCounts)
+	{
+		jsrlib::JobSystem jobs(workers, 256);
+		World world;
+		bool ok = true;
+		const double decodeMs = test::measureMs([&]()
+			{
+				world.meshes.clear();
+				ok = gltfProcessMeshes(model, world, &jobs) && ok;
+			}, 1000.0);
+
+		std::vector<PackedMesh> packed;
+		uint32_t packedVertices, packedIndices;
+		layoutPackedMeshes(world.meshes, packed, packedVertices, packedIndices);
+		std::vector<uint8_t> vertices, indices;
+		const double packMs = test::measureMs([&]()
+			{
+				ok = packMeshes(world.meshes, packed, VERTEX_FORMAT_COMPACT, getPackedIndexSize(world.meshes), vertices, indices, &jobs) && ok;
+			});
+		if (!ok) {
+			std::printf("the model did not load\n");
+			return;
+		}
+		const double ms = decodeMs + packMs;
+		if (workers == 1) singleMs = ms;
+		std::printf("%-8d %12.2f %12.2f %12.1f %9.2fx\n", workers, decodeMs, packMs, vertexCount / (1000.0 * ms), singleMs / ms);
+	}
+}
+
+int main()
+{
+	benchDecode();
+	return 0;
+}
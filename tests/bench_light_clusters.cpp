@@ -0,0 +1,45 @@
+#include <random>
+#include "test_common.h"
+#include "light_clusters.h"
+
+using namespace jsr;
+
+// lights spread over a scene growing with their count, so the density in the view stays about the same
+static void benchLightClusters()
+{
+	const float zNear = 0.1f;
+	std::printf("%-8s %12s %12s %14s %16s\n", "lights", "far depth", "ms/update", "light indices", "max per cluster");
+	for (uint32_t count : { 1024u, 4096u, 16384u, 65536u })
+	{
+		const float size = 4.0f * std::sqrt(float(count));
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> pos(-0.5f * size, 0.5f * size), height(0.0f, 10.0f), range(1.0f, 8.0f);
+		std::vector<Light> lights(count, Light{});
+		for (auto& light : lights)
+		{
+			light.set_position(glm::vec3(pos(rng), height(rng), pos(rng)));
+			light.range = range(rng);
+			light.type = LightType_Point;
+		}
+
+		// looking over the scene from its edge
+		const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 5.0f, 0.5f * size), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		const float zFar = LightClusters::getLightFarDepth(lights.data(), lights.size(), view, zNear, 60000.0f);
+		glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, zFar, zNear);
+		proj[1][1] = -proj[1][1];
+
+		LightClusters clusters;
+		clusters.setup(proj, zNear, zFar);
+		const double ms = test::measureMs([&]() { clusters.update(lights.data(), lights.size(), view); });
+
+		uint32_t maxCount = 0;
+		for (const auto& cluster : clusters.getClusters()) maxCount = std::max(maxCount, cluster.count);
+		std::printf("%-8u %12.1f %12.3f %14zu %16u\n", count, zFar, ms, clusters.getLightIndices().size(), maxCount);
+	}
+}
+
+int main()
+{
+	benchLightClusters();
+	return 0;
+}
@@ -0,0 +1,185 @@
+#include <thread>
+#include <random>
+#include "test_common.h"
+#include "material_image.h"
+
+using namespace jsr;
+namespace fs = std::filesystem;
+
+static const uint32_t TEXTURE_COUNT = 16;
+static const uint32_t TEXTURE_SIZE = 1024;
+
+// RGBA8 noise over gradients with a full box filtered mip chain, encoded like the asset build does (UASTC, zstd)
+static bool writeUastcTexture(const fs::path& path, uint32_t seed)
+{
+	const uint32_t levelCount = uint32_t(std::log2(TEXTURE_SIZE)) + 1;
+	ktxTextureCreateInfo info{};
+	info.vkFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	info.baseWidth = TEXTURE_SIZE;
+	info.baseHeight = TEXTURE_SIZE;
+	info.baseDepth = 1;
+	info.numDimensions = 2;
+	info.numLevels = levelCount;
+	info.numLayers = 1;
+	info.numFaces = 1;
+	info.isArray = KTX_FALSE;
+	info.generateMipmaps = KTX_FALSE;
+	ktxTexture2* texture;
+	if (ktxTexture2_Create(&info, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &texture) != KTX_SUCCESS) return false;
+
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> noise(-24, 24);
+	std::vector<uint8_t> level(size_t(TEXTURE_SIZE) * TEXTURE_SIZE * 4);
+	for (uint32_t y = 0; y < TEXTURE_SIZE; ++y)
+	{
+		for (uint32_t x = 0; x < TEXTURE_SIZE; ++x)
+		{
+			uint8_t* texel = &level[(size_t(y) * TEXTURE_SIZE + x) * 4];
+			const int base[4] = { int(x * 255 / TEXTURE_SIZE), int(y * 255 / TEXTURE_SIZE), int(((x ^ y) >> 4) & 0xff), 255 };
+			for (int c = 0; c < 4; ++c) texel[c] = uint8_t(glm::clamp(base[c] + (c < 3 ? noise(rng) : 0), 0, 255));
+		}
+	}
+
+	bool ok = true;
+	for (uint32_t l = 0, size = TEXTURE_SIZE; ok && l < levelCount; ++l, size /= 2)
+	{
+		ok = ktxTexture_SetImageFromMemory(ktxTexture(texture), l, 0, 0, level.data(), size_t(size) * size * 4) == KTX_SUCCESS;
+		std::vector<uint8_t> next(size_t(std::max(1u, size / 2)) * std::max(1u, size / 2) * 4);
+		for (uint32_t y = 0; y < size / 2; ++y)
+		{
+			for (uint32_t x = 0; x < size / 2; ++x)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					auto at = [&](uint32_t sx, uint32_t sy) { return int(level[(size_t(sy) * size + sx) * 4 + c]); };
+					next[(size_t(y) * (size / 2) + x) * 4 + c] = uint8_t((at(2 * x, 2 * y) + at(2 * x + 1, 2 * y) + at(2 * x, 2 * y + 1) + at(2 * x + 1, 2 * y + 1) + 2) / 4);
+				}
+			}
+		}
+		level = std::move(next);
+	}
+
+	ktxBasisParams params{};
+	params.structSize = sizeof(params);
+	params.uastc = KTX_TRUE;
+	params.uastcFlags = KTX_PACK_UASTC_LEVEL_FASTEST;
+	params.threadCount = std::max(1u, std::thread::hardware_concurrency());
+	ok = ok && ktxTexture2_CompressBasisEx(texture, &params) == KTX_SUCCESS &&
+		ktxTexture2_DeflateZstd(texture, 8) == KTX_SUCCESS &&
+		ktxTexture_WriteToNamedFile(ktxTexture(texture), path.u8string().c_str()) == KTX_SUCCESS;
+	ktxTexture_Destroy(ktxTexture(texture));
+	return ok;
+}
+
+/*
+The load of the material textures as the renderer does it, on job systems of 1 to N workers with
+the same bound of decoded images per worker. Only the decode and transcode is measured, consume()
+drops the images, there is no texture cache.
+*/
+static void benchDecode(const std::vector<std::string>& filenames)
+{
+	struct Target {
+		const char* name;
+		KtxTranscodeTargets targets;
+	};
+	KtxTranscodeTargets astc, bc;
+	astc.astc = true;
+	bc.bc = true;
+
+	std::vector<int> workerCounts;
+	const int maxWorkers = int(std::max(1u, std::thread::hardware_concurrency()));
+	for (int workers = 1; workers < maxWorkers; workers *= 2) workerCounts.push_back(workers);
+	workerCounts.push_back(maxWorkers);
+
+	std::printf("%-8s %-8s %12s %12s %12s %10s\n", "target", "workers", "ms/load", "textures/s", "MB/s out", "speedup");
+	for (const Target& target : { Target{ "ASTC", astc }, Target{ "BC7", bc } })
+	{
+		double singleMs = 0.0;
+		for (int workers : workerCounts)
+		{
+			jsrlib::JobSystem jobs(workers, 256);
+			size_t bytes = 0;
+			bool ok = true;
+			const double ms = test::measureMs([&]()
+				{
+					bytes = 0;
+					ok = loadMaterialImages(jobs, filenames, target.targets, nullptr, 2 * size_t(workers), [&bytes](MaterialImage& image)
+						{
+							bytes += image.data.size();
+						}) && ok;
+				}, 1000.0);
+			if (!ok || bytes == 0) {
+				std::printf("%-8s the textures did not load\n", target.name);
+				break;
+			}
+			if (workers == 1) singleMs = ms;
+			std::printf("%-8s %-8d %12.1f %12.1f %12.1f %9.2fx\n", target.name, workers, ms,
+				1000.0 * filenames.size() / ms, double(bytes) * 1000.0 / (1024.0 * 1024.0 * ms), singleMs / ms);
+		}
+	}
+}
+
+/*
+The same load through the texture cache on all workers. cold: an empty cache, transcoded and written.
+warm: a new cache on the entries and the source hashes of the last run, as a restart of the renderer sees it,
+without sources.bin the sources are hashed again, with verifyData the entries are hashed on open().
+*/
+static void benchCache(const std::vector<std::string>& filenames, const fs::path& directory)
+{
+	struct Mode {
+		const char* name;
+		bool clear;
+		bool clearSourceHashes;
+		bool verifyData;
+	};
+	KtxTranscodeTargets bc;
+	bc.bc = true;
+	const int workers = int(std::max(1u, std::thread::hardware_concurrency()));
+	jsrlib::JobSystem jobs(workers, 256);
+
+	std::printf("\n%-18s %12s %12s %8s %8s\n", "BC7 cache", "ms/load", "textures/s", "hits", "writes");
+	for (const Mode& mode : { Mode{ "cold", true, true, false }, Mode{ "warm, no sources", false, true, false },
+		Mode{ "warm", false, false, false }, Mode{ "warm, verify", false, false, true } })
+	{
+		uint32_t hits = 0, writes = 0;
+		bool ok = true;
+		const double ms = test::measureMs([&]()
+			{
+				std::error_code ec;
+				if (mode.clear) fs::remove_all(directory, ec);
+				if (mode.clearSourceHashes) fs::remove(directory / "sources.bin", ec);
+				TextureCache cache(directory, mode.verifyData);
+				ok = loadMaterialImages(jobs, filenames, bc, &cache, 2 * size_t(workers), [](MaterialImage&) {}) && ok;
+				hits = cache.getStats().hits;
+				writes = cache.getStats().writes;
+			}, 1000.0);
+		if (!ok) {
+			std::printf("%-18s the textures did not load\n", mode.name);
+			return;
+		}
+		std::printf("%-18s %12.1f %12.1f %8u %8u\n", mode.name, ms, 1000.0 * filenames.size() / ms, hits, writes);
+	}
+}
+
+int main()
+{
+	const fs::path directory = fs::temp_directory_path() / "bench_material_image";
+	fs::create_directories(directory / "ktx");
+
+	std::vector<std::string> filenames;
+	for (uint32_t i = 0; i < TEXTURE_COUNT; ++i)
+	{
+		const std::string name = "texture" + std::to_string(i);
+		const fs::path ktx = directory / "ktx" / (name + ".ktx2");
+		if (!fs::exists(ktx) && !writeUastcTexture(ktx, i)) {
+			std::printf("cannot write %s\n", ktx.u8string().c_str());
+			return 1;
+		}
+		filenames.push_back((directory / (name + ".png")).u8string());
+	}
+	std::printf("%u UASTC textures of %ux%u with mips, zstd supercompressed\n\n", TEXTURE_COUNT, TEXTURE_SIZE, TEXTURE_SIZE);
+
+	benchDecode(filenames);
+	benchCache(filenames, directory / "cache");
+	return 0;
+}
@@ -0,0 +1,66 @@
+#include "test_common.h"
+#include "test_scenes.h"
+#include "meshlet.h"
+#include "mesh_optimize.h"
+
+using namespace jsr;
+
+// building on vertex cache optimized spheres, as the loader does
+static void benchBuild()
+{
+	std::printf("%-10s %10s %12s %14s %14s\n", "triangles", "meshlets", "ms/build", "Mtris/s", "avg triangles");
+	for (uint32_t segments : { 32u, 128u, 512u })
+	{
+		MeshData mesh = test::makeSphereMesh(segments);
+		optimizeMesh(mesh);
+		const double ms = test::measureMs([&]() { buildMeshlets(mesh); });
+
+		const size_t triangles = mesh.indices.size() / 3;
+		std::printf("%-10zu %10zu %12.3f %14.2f %14.1f\n", triangles, mesh.meshlets.size(), ms,
+			double(triangles) / (ms * 1000.0), double(triangles) / double(mesh.meshlets.size()));
+	}
+}
+
+// the meshlets of a scattered scene seen from its center, with and without the cone test
+static void benchCull()
+{
+	std::printf("\n%-10s %-10s %12s %10s %10s %10s %14s\n", "entities", "backface", "ms/frame", "meshlets", "frustum", "cone", "visible tris");
+	for (uint32_t count : { 100u, 1000u })
+	{
+		World world;
+		const float size = 10.0f * std::cbrt(float(count));
+		test::makeScatteredWorld(world, count, size, 64);
+		for (auto& mesh : world.meshes)
+		{
+			optimizeMesh(mesh);
+			buildMeshlets(mesh);
+		}
+
+		const glm::vec3 camera(0.0f);
+		const Frustum frustum(test::makeViewProjection(camera, glm::vec3(1.0f, 0.2f, 0.5f), size));
+		for (bool backface : { false, true })
+		{
+			MeshletCullStats stats;
+			std::vector<uint32_t> visible;
+			const double ms = test::measureMs([&]()
+				{
+					stats = {};
+					for (size_t i = 0; i < world.scene.nodes.size(); ++i)
+					{
+						const Node3d& node = world.scene.nodes[i];
+						visible.clear();
+						cullMeshlets(world.meshes[node.getEntities()[0]], node.getTransform(), frustum, camera, backface, &visible, &stats);
+					}
+				});
+			std::printf("%-10u %-10s %12.3f %10zu %10zu %10zu %14zu\n", count, backface ? "on" : "off", ms,
+				stats.meshlets, stats.frustumCulled, stats.backfaceCulled, stats.visibleTriangles);
+		}
+	}
+}
+
+int main()
+{
+	benchBuild();
+	benchCull();
+	return 0;
+}
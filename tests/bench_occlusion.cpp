@@ -0,0 +1,57 @@
+#include "test_common.h"
+#include "test_scenes.h"
+#include "occlusion.h"
+
+using namespace jsr;
+
+// rasterizing spheres in front of the camera into the default 256x128 buffer, then testing boxes against it
+static void benchOcclusionBuffer()
+{
+	const glm::mat4 viewProj = glm::perspective(glm::radians(60.0f), 2.0f, 1000.0f, 0.1f) *
+		glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	std::printf("%-10s %-12s %14s %16s %10s\n", "occluders", "triangles", "raster ms", "queries/ms", "culled");
+	for (uint32_t segments : { 8u, 16u, 32u, 64u })
+	{
+		const MeshData sphere = test::makeSphereMesh(segments);
+		std::vector<glm::mat4> models;
+		for (int y = -2; y <= 2; ++y)
+		{
+			for (int x = -4; x <= 4; ++x) {
+				models.push_back(glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(x * 4.5f, y * 4.5f, -20.0f)), glm::vec3(2.5f)));
+			}
+		}
+
+		OcclusionBuffer buffer;
+		const double rasterMs = test::measureMs([&]()
+			{
+				buffer.begin(viewProj);
+				for (const auto& model : models) buffer.addOccluder(sphere, model);
+				buffer.end();
+			});
+
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> pos(-40.0f, 40.0f), depth(25.0f, 100.0f);
+		std::vector<Bounds> boxes;
+		for (int i = 0; i < 10000; ++i)
+		{
+			const glm::vec3 center(pos(rng), 0.5f * pos(rng), -depth(rng));
+			boxes.push_back(Bounds(center - glm::vec3(0.5f), center + glm::vec3(0.5f)));
+		}
+		size_t culled = 0;
+		const double queryMs = test::measureMs([&]()
+			{
+				culled = 0;
+				for (const auto& box : boxes) culled += buffer.isVisible(box) ? 0 : 1;
+			});
+
+		std::printf("%-10zu %-12zu %14.3f %16.0f %9.1f%%\n", models.size(), buffer.getTriangleCount(), rasterMs,
+			double(boxes.size()) / queryMs, 100.0 * double(culled) / double(boxes.size()));
+	}
+}
+
+int main()
+{
+	benchOcclusionBuffer();
+	return 0;
+}
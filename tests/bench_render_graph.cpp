@@ -0,0 +1,67 @@
+#include "test_common.h"
+#include "vkjs/render_graph.h"
+
+using namespace jvk;
+
+/*
+A chain of passes, each one reads the results of two earlier ones and writes its own image or buffer.
+Every 8th pass writes nothing that is used and is culled. The last result is the output.
+*/
+static void buildGraph(RenderGraph& graph, uint32_t passCount)
+{
+	VkImageSubresourceRange range{};
+	range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	range.levelCount = 1;
+	range.layerCount = 1;
+
+	std::vector<RenderGraph::Handle> results;
+	for (uint32_t i = 0; i < passCount; ++i)
+	{
+		const uintptr_t handle = i + 1;
+		const bool image = (i % 2) == 0;
+		results.push_back(image ?
+			graph.ImportImage("image", reinterpret_cast<VkImage>(handle), range, rg::None) :
+			graph.ImportBuffer("buffer", reinterpret_cast<VkBuffer>(handle)));
+
+		auto pass = graph.AddPass("pass", [](VkCommandBuffer) {});
+		if (i >= 1) pass.Read(results[i - 1], rg::FragmentShaderRead);
+		if (i >= 3) pass.Read(results[i - 3], rg::ComputeShaderRead);
+		if (image) {
+			pass.Write(results[i], rg::ColorAttachmentWrite, true);
+		}
+		else {
+			pass.Write(results[i], rg::ComputeShaderWrite);
+		}
+		if (i % 8 == 7) {
+			// the next passes read the one before
+			results[i] = results[i - 1];
+		}
+	}
+	graph.SetOutput(results.back(), rg::Present);
+}
+
+static void benchCompile()
+{
+	std::printf("%-8s %8s %10s %18s %14s\n", "passes", "culled", "barriers", "build+compile ms", "compile ms");
+	for (uint32_t passCount : { 8u, 32u, 128u, 512u })
+	{
+		RenderGraph graph;
+		const double frameMs = jsr::test::measureMs([&]()
+			{
+				graph.Reset();
+				buildGraph(graph, passCount);
+				graph.Compile();
+			});
+		const double compileMs = jsr::test::measureMs([&]() { graph.Compile(); });
+
+		const RenderGraph::Stats& stats = graph.GetStats();
+		std::printf("%-8u %8u %10u %18.4f %14.4f\n", passCount, stats.culledPassCount,
+			stats.barrierCount, frameMs, compileMs);
+	}
+}
+
+int main()
+{
+	benchCompile();
+	return 0;
+}
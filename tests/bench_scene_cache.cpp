@@ -0,0 +1,106 @@
+#include "test_common.h"
+#include "test_scenes.h"
+#include "scene_cache.h"
+#include "mesh_tangents.h"
+#include "mesh_optimize.h"
+#include "mesh_lod.h"
+#include "meshlet.h"
+#include "mesh_pack.h"
+#include "jobsys.h"
+
+using namespace jsr;
+namespace fs = std::filesystem;
+
+static const uint32_t VERTEX_STRIDE = sizeof(VertexCompact);
+static const uint32_t INDEX_SIZE = 4;
+
+static void makeWorld(World& world, uint32_t count)
+{
+	test::makeScatteredWorld(world, count, 100.0f, 48);
+	for (auto& mesh : world.meshes) test::addSphereVertexStreams(mesh);
+	world.materials.resize(1);
+}
+
+// the per mesh work of the glTF loader, on the job system like there
+static void processMeshes(World& world)
+{
+	jsrlib::counting_semaphore counter;
+	for (size_t i = 0; i < world.meshes.size(); ++i)
+	{
+		jobsys.submitJob([&world, i](int)
+			{
+				MeshData& mesh = world.meshes[i];
+				generateMeshTangents(mesh);
+				weldMeshVertices(mesh);
+				generateMeshLods(mesh);
+				optimizeMesh(mesh);
+				buildMeshlets(mesh);
+			}, &counter);
+	}
+	counter.wait();
+}
+
+/*
+Cold start: the mesh processing of the loader, packing the GPU blobs, the mesh BVHs and writing the cache.
+Warm start: open() and load() of that cache. The glTF parsing and the GPU upload are not part of
+either, the test world is built in memory and its build time is subtracted from the cold start.
+*/
+static void benchStartup()
+{
+	const fs::path source = fs::temp_directory_path() / "bench_scene_cache_source.bin";
+	const fs::path path = fs::temp_directory_path() / "bench_scene_cache.jsc";
+	{
+		std::ofstream out(source, std::ios::binary | std::ios::trunc);
+		out << "source";
+	}
+	std::printf("%-8s %12s %10s %14s %14s %10s\n", "meshes", "triangles", "cache MB", "cold ms", "warm ms", "speedup");
+	for (uint32_t count : { 8u, 32u, 128u })
+	{
+		size_t triangles = 0;
+		const double sceneMs = test::measureMs([&]()
+			{
+				World world;
+				makeWorld(world, count);
+			});
+		const double coldMs = test::measureMs([&]()
+			{
+				World world;
+				makeWorld(world, count);
+				processMeshes(world);
+				std::vector<PackedMesh> packed;
+				uint32_t vertexCount, indexCount;
+				layoutPackedMeshes(world.meshes, packed, vertexCount, indexCount);
+				std::vector<uint8_t> vertices, indices;
+				packMeshes(world.meshes, packed, VERTEX_FORMAT_COMPACT, INDEX_SIZE, vertices, indices, &jobsys);
+				SceneCache::GpuBlobs blobs{};
+				blobs.vertices = vertices.data();
+				blobs.vertexBytes = vertices.size();
+				blobs.vertexStride = VERTEX_STRIDE;
+				blobs.indices = indices.data();
+				blobs.indexBytes = indices.size();
+				blobs.indexSize = INDEX_SIZE;
+				SceneCache::write(path, { source }, world, blobs);
+				triangles = 0;
+				for (const auto& mesh : world.meshes) triangles += mesh.indices.size() / 3;
+			}) - sceneMs;
+		const double warmMs = test::measureMs([&]()
+			{
+				World world;
+				SceneCache cache;
+				if (!cache.open(path, VERTEX_STRIDE, INDEX_SIZE) || !cache.load(world)) {
+					std::printf("the cache did not load\n");
+				}
+			});
+
+		std::printf("%-8u %12zu %10.1f %14.2f %14.2f %9.1fx\n", count, triangles,
+			double(fs::file_size(path)) / (1024.0 * 1024.0), coldMs, warmMs, coldMs / warmMs);
+	}
+	fs::remove(path);
+	fs::remove(source);
+}
+
+int main()
+{
+	benchStartup();
+	return 0;
+}
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include "test_common.h"
+#include "test_scenes.h"
+
+using namespace jsr;
+
+// frustum culling of every entity against the BVH walk with plane masking
+static void benchFrustumCulling()
+{
+	std::printf("%-10s %-6s %12s %14s %14s\n", "entities", "path", "ms/frame", "box tests", "plane tests");
+	for (uint32_t count : { 1000u, 10000u, 50000u })
+	{
+		World flat, bvh;
+		const float size = 40.0f * std::cbrt(float(count));
+		test::makeScatteredWorld(flat, count, size, 2);
+		test::makeScatteredWorld(bvh, count, size, 2);
+		bvh.updateBVH();
+
+		// a camera inside the scene sees a part of it
+		const glm::mat4 vp = test::makeViewProjection(glm::vec3(0.0f), glm::vec3(1.0f, 0.2f, 0.5f), 0.5f * size);
+		const Frustum frustum(vp);
+		World* worlds[] = { &flat, &bvh };
+		const char* names[] = { "flat", "bvh" };
+		for (int i = 0; i < 2; ++i)
+		{
+			size_t visible = 0;
+			const double ms = test::measureMs([&]() { visible = worlds[i]->getVisibleEntities(frustum).size(); });
+			std::printf("%-10u %-6s %12.3f %14d %14d   (%zu visible)\n", count, names[i], ms,
+				worlds[i]->getIntersectTestCount(), worlds[i]->getPlaneTestCount(), visible);
+		}
+	}
+}
+
+// closest hit queries, one thread against RaycastN on the job system
+static void benchRaycast()
+{
+	std::printf("\n%-10s %-12s %16s %16s %8s\n", "entities", "triangles", "rays/s", "RaycastN rays/s", "hits");
+	for (uint32_t count : { 100u, 1000u, 10000u })
+	{
+		World world;
+		const float size = 10.0f * std::cbrt(float(count));
+		test::makeScatteredWorld(world, count, size, 16);
+		world.updateBVH();
+
+		std::mt19937 rng(2);
+		std::uniform_real_distribution<float> pos(-0.5f * size, 0.5f * size);
+		std::vector<Ray> rays;
+		for (int i = 0; i < 100000; ++i)
+		{
+			const glm::vec3 origin = size * glm::normalize(glm::vec3(pos(rng), pos(rng), pos(rng)));
+			rays.push_back({ origin, glm::normalize(glm::vec3(pos(rng), pos(rng), pos(rng)) - origin), 2.0f * size });
+		}
+		std::vector<RayHit> hits(rays.size());
+
+		const double singleMs = test::measureMs([&]()
+			{
+				for (size_t i = 0; i < rays.size(); ++i) world.Raycast(rays[i].origin, rays[i].dir, rays[i].tmax, hits[i]);
+			});
+		const double batchMs = test::measureMs([&]() { world.RaycastN(rays.data(), rays.size(), hits.data()); });
+		const size_t hitCount = std::count_if(hits.begin(), hits.end(), [](const RayHit& h) { return h.hit(); });
+
+		std::printf("%-10u %-12zu %16.0f %16.0f %7.1f%%\n", count, size_t(count) * world.meshes[0].indices.size() / 3,
+			1000.0 * rays.size() / singleMs, 1000.0 * rays.size() / batchMs, 100.0 * hitCount / rays.size());
+	}
+}
+
+int main()
+{
+	benchFrustumCulling();
+	benchRaycast();
+	return 0;
+}
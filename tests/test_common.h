@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdio>
+#include <chrono>
+#include <functional>
+
+/*
+The tests are plain executables run by ctest, a failed check is printed and the test returns 1.
+The benchmarks print a table and are run by hand, they take no arguments.
+*/
+
+#define TEST_CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			jsr::test::failures()++; \
+		} \
+	} while (0)
+
+namespace jsr {
+	namespace test {
+
+		inline int& failures()
+		{
+			static int count = 0;
+			return count;
+		}
+
+		// the exit code of the test
+		inline int result(const char* name)
+		{
+			if (failures() == 0) {
+				std::printf("%s: passed\n", name);
+				return 0;
+			}
+			std::printf("%s: %d checks failed\n", name, failures());
+			return 1;
+		}
+
+		// average time of one call in milliseconds, after a warm up call fn is repeated for at least minMs
+		inline double measureMs(const std::function<void()>& fn, double minMs = 200.0)
+		{
+			using clock = std::chrono::steady_clock;
+			fn();
+			int runs = 0;
+			const auto start = clock::now();
+			double elapsed = 0.0;
+			do {
+				fn();
+				++runs;
+				elapsed = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+			} while (elapsed < minMs);
+			return elapsed / runs;
+		}
+	}
+}
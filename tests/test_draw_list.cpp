@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <random>
+#include <tuple>
+#include "test_common.h"
+#include "draw_list.h"
+
+using namespace jsr;
+
+struct TestDraw {
+	uint32_t pass;
+	uint32_t material;
+	uint32_t mesh;
+	uint32_t lod;
+	float depth;
+};
+
+// few states and many depths, like a scene of repeated meshes
+static std::vector<TestDraw> makeDraws(size_t count, uint32_t stateCount, std::mt19937& rng)
+{
+	std::uniform_int_distribution<uint32_t> state(0, stateCount - 1), pass(0, 2);
+	std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+	std::vector<TestDraw> draws(count);
+	for (auto& draw : draws)
+	{
+		const uint32_t s = state(rng);
+		draw = { pass(rng), s % 37, s, s % 3, depth(rng) };
+	}
+	return draws;
+}
+
+static uint64_t makeKey(const TestDraw& draw)
+{
+	return DrawKey::make(draw.pass, 0, draw.material, draw.mesh, draw.lod, draw.depth, draw.pass == DrawPass_Blend);
+}
+
+static bool sameOrder(const std::vector<DrawItem>& a, const std::vector<DrawItem>& b)
+{
+	return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+		[](const DrawItem& x, const DrawItem& y) { return x.key == y.key && x.index == y.index; });
+}
+
+/*
+The radix sort against std::stable_sort on the key: the same keys in the same order, equal keys in
+the order they were added. The sizes cover one chunk and the parallel chunks, the key sets digits
+that differ in every byte and ones where most digits are constant.
+*/
+static void testRadixSortMatchesStableSort()
+{
+	std::mt19937 rng(3);
+	for (size_t count : { size_t(0), size_t(1), size_t(2), size_t(100), size_t(5000), size_t(100000), size_t(250007) })
+	{
+		for (int keys = 0; keys < 3; ++keys)
+		{
+			std::vector<DrawItem> items(count);
+			std::uniform_int_distribution<uint64_t> full;
+			std::uniform_int_distribution<uint32_t> few(0, 15);
+			const std::vector<TestDraw> draws = makeDraws(count, 500, rng);
+			for (size_t i = 0; i < count; ++i)
+			{
+				// random 64 bit keys, draw keys, and few distinct keys for long runs of equal ones
+				const uint64_t key = keys == 0 ? full(rng) : keys == 1 ? makeKey(draws[i]) : uint64_t(few(rng)) << 40;
+				items[i] = { key, uint32_t(i) };
+			}
+
+			std::vector<DrawItem> expected = items;
+			std::stable_sort(expected.begin(), expected.end(), [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+			std::vector<DrawItem> temp(count);
+			radixSort(items.data(), temp.data(), count);
+			TEST_CHECK(sameOrder(items, expected));
+		}
+	}
+}
+
+// every field reads back, the depth orders front to back for opaque draws and back to front for blended ones
+static void testKeyFields()
+{
+	const uint64_t key = DrawKey::make(DrawPass_AlphaTest, 7, 4095, 65535, 15, 0.25f, false);
+	TEST_CHECK(DrawKey::getPass(key) == DrawPass_AlphaTest);
+	TEST_CHECK(DrawKey::getPipeline(key) == 7);
+	TEST_CHECK(DrawKey::getMaterial(key) == 4095);
+	TEST_CHECK(DrawKey::getMesh(key) == 65535);
+	TEST_CHECK(DrawKey::getLod(key) == 15);
+
+	const uint64_t blend = DrawKey::make(DrawPass_Blend, 3, 100, 200, 2, 0.75f, true);
+	TEST_CHECK(DrawKey::isBackToFront(blend));
+	TEST_CHECK(DrawKey::getMaterial(blend) == 100 && DrawKey::getMesh(blend) == 200 && DrawKey::getLod(blend) == 2);
+
+	TEST_CHECK(DrawKey::make(DrawPass_Opaque, 0, 1, 1, 0, 0.1f, false) < DrawKey::make(DrawPass_Opaque, 0, 1, 1, 0, 0.9f, false));
+	TEST_CHECK(DrawKey::make(DrawPass_Blend, 0, 1, 1, 0, 0.9f, true) < DrawKey::make(DrawPass_Blend, 0, 1, 1, 0, 0.1f, true));
+	// the state sorts before depth for opaque draws, after it for blended ones
+	TEST_CHECK(DrawKey::make(DrawPass_Opaque, 0, 1, 1, 0, 0.9f, false) < DrawKey::make(DrawPass_Opaque, 0, 2, 1, 0, 0.1f, false));
+	TEST_CHECK(DrawKey::make(DrawPass_Blend, 0, 2, 1, 0, 0.9f, true) < DrawKey::make(DrawPass_Blend, 0, 1, 1, 0, 0.1f, true));
+	TEST_CHECK(DrawKey::getState(DrawKey::make(DrawPass_Blend, 0, 1, 1, 0, 0.9f, true)) == DrawKey::getState(DrawKey::make(DrawPass_Blend, 0, 1, 1, 0, 0.1f, true)));
+}
+
+// a mesh or material past its bits saturates, the fields around it keep their values
+static void testFieldsSaturate()
+{
+	for (bool backToFront : { false, true })
+	{
+		const uint32_t pass = backToFront ? DrawPass_Blend : DrawPass_Opaque;
+		const uint64_t mesh = DrawKey::make(pass, 5, 300, 70000, 3, 0.5f, backToFront);
+		TEST_CHECK(DrawKey::getMesh(mesh) == 65535);
+		TEST_CHECK(DrawKey::getPass(mesh) == pass && DrawKey::getPipeline(mesh) == 5 && DrawKey::getMaterial(mesh) == 300 && DrawKey::getLod(mesh) == 3);
+
+		const uint64_t material = DrawKey::make(pass, 5, 5000, 1234, 3, 0.5f, backToFront);
+		TEST_CHECK(DrawKey::getMaterial(material) == 4095);
+		TEST_CHECK(DrawKey::getPass(material) == pass && DrawKey::getPipeline(material) == 5 && DrawKey::getMesh(material) == 1234 && DrawKey::getLod(material) == 3);
+
+		const uint64_t lod = DrawKey::make(pass, 5, 300, 1234, 40, 0.5f, backToFront);
+		TEST_CHECK(DrawKey::getLod(lod) == 15 && DrawKey::getMesh(lod) == 1234);
+		// the depth is left alone too
+		TEST_CHECK(mesh == DrawKey::make(pass, 5, 300, 65535, 3, 0.5f, backToFront));
+		TEST_CHECK(DrawKey::getPass(DrawKey::make(20, 5, 300, 1234, 3, 0.5f, false)) == 15);
+	}
+}
+
+/*
+The runs of equal states after the sort, as the renderer forms its instanced draws: one run per pass
+and state, and every draw of a run has the material, mesh and LOD of the run.
+*/
+static void testInstancingRuns()
+{
+	std::mt19937 rng(11);
+	const std::vector<TestDraw> draws = makeDraws(20000, 300, rng);
+	DrawList list;
+	for (size_t i = 0; i < draws.size(); ++i) list.add(makeKey(draws[i]), uint32_t(i));
+	list.sort();
+
+	std::vector<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>> states;
+	for (const auto& draw : draws) {
+		if (draw.pass != DrawPass_Blend) states.emplace_back(draw.pass, draw.material, draw.mesh, draw.lod);
+	}
+	std::sort(states.begin(), states.end());
+	const size_t stateCount = std::unique(states.begin(), states.end()) - states.begin();
+
+	size_t runCount = 0, drawCount = 0;
+	for (size_t first = 0; first < list.size();)
+	{
+		const uint64_t state = DrawKey::getState(list[first].key);
+		size_t last = first + 1;
+		while (last < list.size() && DrawKey::getState(list[last].key) == state) ++last;
+
+		const TestDraw& head = draws[list[first].index];
+		for (size_t i = first; i < last; ++i)
+		{
+			const TestDraw& draw = draws[list[i].index];
+			TEST_CHECK(draw.pass == head.pass && draw.material == head.material && draw.mesh == head.mesh && draw.lod == head.lod);
+		}
+		if (head.pass != DrawPass_Blend)
+		{
+			runCount++;
+			drawCount += last - first;
+		}
+		first = last;
+	}
+	TEST_CHECK(runCount == stateCount);
+	TEST_CHECK(drawCount == size_t(std::count_if(draws.begin(), draws.end(), [](const TestDraw& d) { return d.pass != DrawPass_Blend; })));
+}
+
+int main()
+{
+	testRadixSortMatchesStableSort();
+	testKeyFields();
+	testFieldsSaturate();
+	testInstancingRuns();
+
+	return test::result("test_draw_list");
+}
@@ -0,0 +1,105 @@
+#include <thread>
+#include "test_common.h"
+#include "test_gltf_scenes.h"
+#include "gltf_loader.h"
+#include "mesh_pack.h"
+
+using namespace jsr;
+
+static bool sameMesh(const MeshData& a, const MeshData& b)
+{
+	return a.indices == b.indices && a.positions == b.positions && a.normals == b.normals &&
+		a.tangents == b.tangents && a.uvs == b.uvs && a.material == b.material &&
+		a.aabb.GetMin() == b.aabb.GetMin() && a.aabb.GetMax() == b.aabb.GetMax();
+}
+
+struct PackedScene {
+	std::vector<PackedMesh> meshes;
+	std::vector<uint8_t> vertices;
+	std::vector<uint8_t> indices;
+};
+
+static bool packScene(const World& world, VertexFormat format, jsrlib::JobSystem* jobs, PackedScene& scene)
+{
+	uint32_t vertexCount, indexCount;
+	layoutPackedMeshes(world.meshes, scene.meshes, vertexCount, indexCount);
+	return packMeshes(world.meshes, scene.meshes, format, getPackedIndexSize(world.meshes), scene.vertices, scene.indices, jobs);
+}
+
+/*
+The primitives of a generated model decoded serially and on job systems of 1 to N workers, then packed
+serially and with the jobs: the same meshes and the same bytes in the scene buffers.
+*/
+static void testParallelDecodeMatchesSerial()
+{
+	const tinygltf::Model model = test::makeGltfModel(8, 6, 20);
+	World serial;
+	TEST_CHECK(gltfProcessMeshes(model, serial, nullptr));
+	TEST_CHECK(serial.meshes.size() == 48);
+
+	size_t tangentsMissing = 0;
+	for (size_t i = 0; i < serial.meshes.size(); ++i)
+	{
+		const MeshData& mesh = serial.meshes[i];
+		const size_t vertexCount = mesh.positions.size() / sizeof(glm::vec3);
+		TEST_CHECK(vertexCount > 0 && !mesh.indices.empty());
+		TEST_CHECK(mesh.normals.size() == vertexCount * sizeof(glm::vec3) && mesh.uvs.size() == vertexCount * sizeof(glm::vec2));
+		TEST_CHECK(mesh.tangents.size() == vertexCount * sizeof(glm::vec4));
+		tangentsMissing += model.meshes[i / 6].primitives[i % 6].attributes.count("TANGENT") ? 0 : 1;
+	}
+	TEST_CHECK(tangentsMissing == serial.meshes.size() / 2);
+
+	PackedScene serialFull, serialCompact;
+	TEST_CHECK(packScene(serial, VERTEX_FORMAT_FULL, nullptr, serialFull));
+	TEST_CHECK(packScene(serial, VERTEX_FORMAT_COMPACT, nullptr, serialCompact));
+
+	const int maxWorkers = int(std::max(1u, std::thread::hardware_concurrency()));
+	for (int workers : { 1, 2, 4, maxWorkers })
+	{
+		jsrlib::JobSystem jobs(workers, 256);
+		World parallel;
+		TEST_CHECK(gltfProcessMeshes(model, parallel, &jobs));
+		TEST_CHECK(parallel.meshes.size() == serial.meshes.size());
+		for (size_t i = 0; i < parallel.meshes.size() && i < serial.meshes.size(); ++i) {
+			TEST_CHECK(sameMesh(parallel.meshes[i], serial.meshes[i]));
+		}
+
+		PackedScene full, compact;
+		TEST_CHECK(packScene(parallel, VERTEX_FORMAT_FULL, &jobs, full));
+		TEST_CHECK(packScene(parallel, VERTEX_FORMAT_COMPACT, &jobs, compact));
+		TEST_CHECK(full.vertices == serialFull.vertices && full.indices == serialFull.indices);
+		TEST_CHECK(compact.vertices == serialCompact.vertices && compact.indices == serialCompact.indices);
+	}
+}
+
+// the meshes are appended after the ones already in the world
+static void testMeshesAreAppended()
+{
+	const tinygltf::Model model = test::makeGltfModel(2, 3, 4);
+	World world;
+	world.meshes.resize(5);
+	jsrlib::JobSystem jobs(2, 256);
+	TEST_CHECK(gltfProcessMeshes(model, world, &jobs));
+	TEST_CHECK(world.meshes.size() == 11);
+	for (size_t i = 0; i < world.meshes.size(); ++i) {
+		TEST_CHECK(world.meshes[i].positions.empty() == (i < 5));
+	}
+}
+
+// a primitive without normals fails the load
+static void testMissingAttributeFails()
+{
+	tinygltf::Model model = test::makeGltfModel(2, 2, 4);
+	model.meshes[1].primitives[0].attributes.erase("NORMAL");
+	World world;
+	TEST_CHECK(!gltfProcessMeshes(model, world, nullptr));
+}
+
+int main()
+{
+	testParallelDecodeMatchesSerial();
+	testMeshesAreAppended();
+	testMissingAttributeFails();
+
+	return test::result("test_gltf_loader");
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <tiny_gltf.h>
+#include "test_scenes.h"
+
+namespace jsr {
+	namespace test {
+
+		// appends the bytes to the only buffer of the model as a buffer view, returns its index
+		inline int addGltfBufferView(tinygltf::Model& model, const void* data, size_t size, size_t stride = 0)
+		{
+			if (model.buffers.empty()) model.buffers.emplace_back();
+			std::vector<unsigned char>& bytes = model.buffers[0].data;
+			bytes.resize((bytes.size() + 3) & ~size_t(3));
+			tinygltf::BufferView view;
+			view.buffer = 0;
+			view.byteOffset = bytes.size();
+			view.byteLength = size;
+			view.byteStride = stride;
+			bytes.insert(bytes.end(), static_cast<const unsigned char*>(data), static_cast<const unsigned char*>(data) + size);
+			model.bufferViews.push_back(view);
+			return int(model.bufferViews.size()) - 1;
+		}
+
+		inline int addGltfAccessor(tinygltf::Model& model, int view, size_t offset, size_t count, int componentType, int type)
+		{
+			tinygltf::Accessor accessor;
+			accessor.bufferView = view;
+			accessor.byteOffset = offset;
+			accessor.count = count;
+			accessor.componentType = componentType;
+			accessor.type = type;
+			model.accessors.push_back(accessor);
+			return int(model.accessors.size()) - 1;
+		}
+
+		/*
+		Spheres of 4 to 4 + segments segments as the primitives of meshCount meshes, primitivesPerMesh each.
+		They vary like exported files do: 16 and 32 bit indices, interleaved position and normal, and every
+		other primitive without tangents so they are generated.
+		*/
+		inline tinygltf::Model makeGltfModel(uint32_t meshCount, uint32_t primitivesPerMesh, uint32_t segments)
+		{
+			tinygltf::Model model;
+			uint32_t n = 0;
+			for (uint32_t m = 0; m < meshCount; ++m)
+			{
+				tinygltf::Mesh mesh;
+				for (uint32_t p = 0; p < primitivesPerMesh; ++p, ++n)
+				{
+					MeshData sphere = makeSphereMesh(4 + n % (segments + 1));
+					addSphereVertexStreams(sphere);
+					const size_t vertexCount = sphere.positions.size() / sizeof(glm::vec3);
+
+					tinygltf::Primitive prim;
+					prim.material = int(n % 3);
+					int position;
+					if (n % 3 == 0)
+					{
+						std::vector<uint8_t> interleaved(vertexCount * 2 * sizeof(glm::vec3));
+						for (size_t v = 0; v < vertexCount; ++v)
+						{
+							memcpy(&interleaved[v * 24], &sphere.positions[v * 12], 12);
+							memcpy(&interleaved[v * 24 + 12], &sphere.normals[v * 12], 12);
+						}
+						const int view = addGltfBufferView(model, interleaved.data(), interleaved.size(), 24);
+						position = addGltfAccessor(model, view, 0, vertexCount, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3);
+						prim.attributes["NORMAL"] = addGltfAccessor(model, view, 12, vertexCount, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3);
+					}
+					else
+					{
+						position = addGltfAccessor(model, addGltfBufferView(model, sphere.positions.data(), sphere.positions.size()), 0, vertexCount, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3);
+						prim.attributes["NORMAL"] = addGltfAccessor(model, addGltfBufferView(model, sphere.normals.data(), sphere.normals.size()), 0, vertexCount, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3);
+					}
+					model.accessors[position].minValues = { -1.0, -1.0, -1.0 };
+					model.accessors[position].maxValues = { 1.0, 1.0, 1.0 };
+					prim.attributes["POSITION"] = position;
+					prim.attributes["TEXCOORD_0"] = addGltfAccessor(model, addGltfBufferView(model, sphere.uvs.data(), sphere.uvs.size()), 0, vertexCount, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC2);
+					if (n % 2 == 0) {
+						prim.attributes["TANGENT"] = addGltfAccessor(model, addGltfBufferView(model, sphere.tangents.data(), sphere.tangents.size()), 0, vertexCount, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC4);
+					}
+
+					if (n % 4 == 1)
+					{
+						prim.indices = addGltfAccessor(model, addGltfBufferView(model, sphere.indices.data(), sphere.indices.size() * sizeof(uint32_t)), 0,
+							sphere.indices.size(), TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT, TINYGLTF_TYPE_SCALAR);
+					}
+					else
+					{
+						const std::vector<uint16_t> indices(sphere.indices.begin(), sphere.indices.end());
+						prim.indices = addGltfAccessor(model, addGltfBufferView(model, indices.data(), indices.size() * sizeof(uint16_t)), 0,
+							indices.size(), TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, TINYGLTF_TYPE_SCALAR);
+					}
+					prim.mode = TINYGLTF_MODE_TRIANGLES;
+					mesh.primitives.push_back(prim);
+				}
+				model.meshes.push_back(mesh);
+			}
+			model.buffers[0].data.resize((model.buffers[0].data.size() + 3) & ~size_t(3));
+			return model;
+		}
+	}
+}
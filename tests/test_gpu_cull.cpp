@@ -0,0 +1,177 @@
+#include <algorithm>
+#include "test_common.h"
+#include "test_scenes.h"
+#include "gpu_cull.h"
+
+using namespace jsr;
+
+static const uint32_t BATCH_COUNT = 7;
+
+/*
+cull_v2.comp on the CPU, statement by statement. The invocations run in the given order, the GPU
+gives no order of the atomicAdd() between them.
+*/
+static void runCullShader(const std::vector<GpuCullObject>& objects, const GpuCullConstants& pc, const std::vector<uint32_t>& order,
+	std::vector<GpuDrawCommand>& commands, std::vector<uint32_t>& drawCounts)
+{
+	for (uint32_t id : order)
+	{
+		if (id >= pc.objectCount) {
+			continue;
+		}
+		const GpuCullObject& obj = objects[id];
+		bool visible = true;
+		for (int i = 0; i < 6 && visible; ++i)
+		{
+			const glm::vec4 plane = pc.frustumPlanes[i];
+			const glm::vec3 p = glm::mix(glm::vec3(obj.boundsMin), glm::vec3(obj.boundsMax), glm::greaterThanEqual(glm::vec3(plane), glm::vec3(0.0f)));
+			visible = glm::dot(glm::vec3(plane), p) + plane.w >= 0.0f;
+		}
+		if (!visible) {
+			continue;
+		}
+
+		const uint32_t slot = drawCounts[obj.batch]++;
+		GpuDrawCommand cmd;
+		cmd.indexCount = obj.indexCount;
+		cmd.instanceCount = 1;
+		cmd.firstIndex = obj.firstIndex;
+		cmd.vertexOffset = obj.vertexOffset;
+		cmd.firstInstance = obj.drawDataIndex;
+		commands.at(obj.commandBase + slot) = cmd;
+	}
+}
+
+// objects of random size and material, the batches own consecutive command ranges as setup_gpu_culling() lays them out
+static std::vector<GpuCullObject> makeCullObjects(uint32_t count, float size, std::vector<uint32_t>& batchCommands, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> pos(-0.5f * size, 0.5f * size), extent(0.1f, 8.0f);
+	std::uniform_int_distribution<uint32_t> batch(0, BATCH_COUNT - 1), indices(1, 3000);
+	std::vector<GpuCullObject> objects(count);
+	std::vector<uint32_t> maxCount(BATCH_COUNT, 0);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		GpuCullObject& obj = objects[i];
+		const glm::vec3 center(pos(rng), pos(rng), pos(rng)), half(extent(rng), extent(rng), extent(rng));
+		obj.boundsMin = glm::vec4(center - half, 1.0f);
+		obj.boundsMax = glm::vec4(center + half, 1.0f);
+		obj.indexCount = 3 * indices(rng);
+		obj.firstIndex = indices(rng) * 3;
+		obj.vertexOffset = int32_t(indices(rng));
+		obj.batch = batch(rng);
+		obj.drawDataIndex = i;
+		maxCount[obj.batch]++;
+	}
+	batchCommands.assign(BATCH_COUNT + 1, 0);
+	for (uint32_t b = 0; b < BATCH_COUNT; ++b) batchCommands[b + 1] = batchCommands[b] + maxCount[b];
+	for (auto& obj : objects) obj.commandBase = batchCommands[obj.batch];
+	return objects;
+}
+
+// found by the comparison of the vectors
+namespace jsr {
+	static bool operator==(const GpuDrawCommand& a, const GpuDrawCommand& b)
+	{
+		return a.indexCount == b.indexCount && a.instanceCount == b.instanceCount && a.firstIndex == b.firstIndex &&
+			a.vertexOffset == b.vertexOffset && a.firstInstance == b.firstInstance;
+	}
+}
+
+/*
+The compacted commands of the shader against gpuCullVisible(), the reference of the renderer, and against the
+box test of the CPU path: the same count per batch and the same commands, whatever order the invocations run in.
+*/
+static void testShaderMatchesReference()
+{
+	std::mt19937 rng(5);
+	const float size = 400.0f;
+	std::vector<uint32_t> batchCommands;
+	// not a multiple of the group size, the last group has idle invocations
+	const std::vector<GpuCullObject> objects = makeCullObjects(5000 + 17, size, batchCommands, rng);
+	const uint32_t groupCount = (uint32_t(objects.size()) + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE;
+
+	std::uniform_real_distribution<float> pos(-0.6f * size, 0.6f * size);
+	int visibleTotal = 0, boxMismatches = 0;
+	for (int view = 0; view < 40; ++view)
+	{
+		const Frustum frustum(test::makeViewProjection(glm::vec3(pos(rng), pos(rng), pos(rng)), glm::vec3(pos(rng), pos(rng), pos(rng)), 300.0f));
+		GpuCullConstants pc{};
+		memcpy(pc.frustumPlanes, frustum.GetPlanes(), sizeof(pc.frustumPlanes));
+		pc.objectCount = uint32_t(objects.size());
+
+		// the workgroups in random order, the invocations of a group too
+		std::vector<uint32_t> groups(groupCount), order;
+		for (uint32_t g = 0; g < groupCount; ++g) groups[g] = g;
+		std::shuffle(groups.begin(), groups.end(), rng);
+		for (uint32_t g : groups)
+		{
+			const size_t first = order.size();
+			for (uint32_t l = 0; l < GPU_CULL_GROUP_SIZE; ++l) order.push_back(g * GPU_CULL_GROUP_SIZE + l);
+			std::shuffle(order.begin() + first, order.end(), rng);
+		}
+
+		const GpuDrawCommand unwritten{ ~0u, ~0u, ~0u, -1, ~0u };
+		std::vector<GpuDrawCommand> commands(batchCommands.back(), unwritten);
+		std::vector<uint32_t> drawCounts(BATCH_COUNT, 0);
+		runCullShader(objects, pc, order, commands, drawCounts);
+
+		std::vector<std::vector<GpuDrawCommand>> expected(BATCH_COUNT);
+		for (const auto& obj : objects)
+		{
+			const bool visible = gpuCullVisible(frustum.GetPlanes(), obj.boundsMin, obj.boundsMax);
+			boxMismatches += visible != frustum.Intersects(Bounds(glm::vec3(obj.boundsMin), glm::vec3(obj.boundsMax))) ? 1 : 0;
+			if (visible) {
+				expected[obj.batch].push_back({ obj.indexCount, 1, obj.firstIndex, obj.vertexOffset, obj.drawDataIndex });
+			}
+		}
+
+		for (uint32_t b = 0; b < BATCH_COUNT; ++b)
+		{
+			TEST_CHECK(drawCounts[b] == expected[b].size());
+			visibleTotal += int(drawCounts[b]);
+			// the slots are unique and packed from the start of the range, the rest is untouched
+			std::vector<GpuDrawCommand> actual(commands.begin() + batchCommands[b], commands.begin() + batchCommands[b + 1]);
+			const auto written = std::stable_partition(actual.begin(), actual.end(), [&](const GpuDrawCommand& c) { return !(c == unwritten); });
+			TEST_CHECK(size_t(written - actual.begin()) == drawCounts[b]);
+			TEST_CHECK(std::all_of(actual.begin(), actual.begin() + std::min<size_t>(drawCounts[b], actual.size()), [&](const GpuDrawCommand& c) { return !(c == unwritten); }));
+			actual.erase(written, actual.end());
+			std::sort(actual.begin(), actual.end(), [](const GpuDrawCommand& x, const GpuDrawCommand& y) { return x.firstInstance < y.firstInstance; });
+			TEST_CHECK(actual == expected[b]);
+		}
+	}
+	// some visible and some culled in most views
+	TEST_CHECK(visibleTotal > 40 * 50 && visibleTotal < 40 * 4000);
+	TEST_CHECK(boxMismatches == 0);
+}
+
+// the invocations past objectCount write nothing, no objects nothing at all
+static void testIdleInvocations()
+{
+	std::mt19937 rng(9);
+	std::vector<uint32_t> batchCommands;
+	const std::vector<GpuCullObject> objects = makeCullObjects(10, 10.0f, batchCommands, rng);
+	const Frustum frustum(test::makeViewProjection(glm::vec3(0.0f, 0.0f, 100.0f), glm::vec3(0.0f)));
+	GpuCullConstants pc{};
+	memcpy(pc.frustumPlanes, frustum.GetPlanes(), sizeof(pc.frustumPlanes));
+
+	std::vector<uint32_t> order(GPU_CULL_GROUP_SIZE);
+	for (uint32_t i = 0; i < GPU_CULL_GROUP_SIZE; ++i) order[i] = i;
+	for (uint32_t count : { 0u, 10u })
+	{
+		pc.objectCount = count;
+		std::vector<GpuDrawCommand> commands(batchCommands.back());
+		std::vector<uint32_t> drawCounts(BATCH_COUNT, 0);
+		runCullShader(objects, pc, order, commands, drawCounts);
+		uint32_t visible = 0;
+		for (uint32_t c : drawCounts) visible += c;
+		TEST_CHECK(visible == count);
+	}
+}
+
+int main()
+{
+	testShaderMatchesReference();
+	testIdleInvocations();
+
+	return test::result("test_gpu_cull");
+}
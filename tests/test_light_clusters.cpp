@@ -0,0 +1,140 @@
+#include <random>
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
+#include "test_common.h"
+#include "light_clusters.h"
+
+using namespace jsr;
+
+static const float Z_NEAR = 0.1f;
+
+// framebuffer oriented like the renderer sets it up, reversed-Z with y flipped
+static glm::mat4 makeClusterProjection(float zFar)
+{
+	glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, zFar, Z_NEAR);
+	proj[1][1] = -proj[1][1];
+	return proj;
+}
+
+static std::vector<Light> makeLights(size_t count, float size, float rangeMin, float rangeMax, uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> pos(-0.5f * size, 0.5f * size);
+	std::uniform_real_distribution<float> range(rangeMin, rangeMax);
+	std::vector<Light> lights(count, Light{});
+	for (auto& light : lights)
+	{
+		light.set_position(glm::vec3(pos(rng), 0.2f * pos(rng), pos(rng)));
+		light.range = range(rng);
+		light.type = LightType_Point;
+	}
+	return lights;
+}
+
+/*
+Every light reaching a point is in the cluster of the point, and every light of a cluster touches
+the box around the cluster's corners unprojected with the inverse projection.
+*/
+static void testAssignmentAgainstBruteForce()
+{
+	const std::vector<Light> lights = makeLights(2000, 100.0f, 0.5f, 6.0f, 1);
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 45.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	const float zFar = LightClusters::getLightFarDepth(lights.data(), lights.size(), view, Z_NEAR, 10000.0f);
+	const glm::mat4 proj = makeClusterProjection(zFar);
+
+	LightClusters clusters;
+	clusters.setup(proj, Z_NEAR, zFar);
+	clusters.update(lights.data(), lights.size(), view);
+	const auto& grid = clusters.getClusters();
+	const auto& indices = clusters.getLightIndices();
+	auto clusterHas = [&](uint32_t cluster, uint32_t light)
+		{
+			const auto first = indices.begin() + grid[cluster].offset;
+			return std::find(first, first + grid[cluster].count, light) != first + grid[cluster].count;
+		};
+
+	// random points of the view frustum
+	std::mt19937 rng(2);
+	std::uniform_real_distribution<float> ndc(-0.999f, 0.999f), logDepth(std::log(Z_NEAR), std::log(zFar));
+	int missing = 0;
+	for (int i = 0; i < 20000; ++i)
+	{
+		const float depth = std::exp(logDepth(rng));
+		const glm::vec2 p(ndc(rng), ndc(rng));
+		const glm::vec3 viewPos(p.x * depth / proj[0][0], p.y * depth / proj[1][1], -depth);
+		const uint32_t x = uint32_t((p.x + 1.0f) * 0.5f * LightClusters::GRID_X);
+		const uint32_t y = uint32_t((p.y + 1.0f) * 0.5f * LightClusters::GRID_Y);
+		const uint32_t cluster = LightClusters::getClusterIndex(x, y, clusters.getSlice(depth));
+
+		for (uint32_t l = 0; l < lights.size(); ++l)
+		{
+			const glm::vec3 lightPos = glm::vec3(view * glm::vec4(glm::make_vec3(lights[l].position), 1.0f));
+			if (glm::distance(lightPos, viewPos) < lights[l].range && !clusterHas(cluster, l)) missing++;
+		}
+	}
+	TEST_CHECK(missing == 0);
+
+	const glm::mat4 invProj = glm::inverse(proj);
+	int extra = 0;
+	for (uint32_t z = 0; z < LightClusters::GRID_Z; ++z)
+	{
+		const float d0 = Z_NEAR * std::pow(zFar / Z_NEAR, float(z) / LightClusters::GRID_Z);
+		const float d1 = Z_NEAR * std::pow(zFar / Z_NEAR, float(z + 1) / LightClusters::GRID_Z);
+		for (uint32_t y = 0; y < LightClusters::GRID_Y; ++y)
+		{
+			for (uint32_t x = 0; x < LightClusters::GRID_X; ++x)
+			{
+				glm::vec3 boxMin(std::numeric_limits<float>::max()), boxMax(std::numeric_limits<float>::lowest());
+				for (int corner = 0; corner < 8; ++corner)
+				{
+					const float nx = -1.0f + 2.0f * float(x + (corner & 1)) / LightClusters::GRID_X;
+					const float ny = -1.0f + 2.0f * float(y + ((corner >> 1) & 1)) / LightClusters::GRID_Y;
+					const float d = (corner & 4) ? d1 : d0;
+					// a point of the pixel ray, scaled to the depth
+					const glm::vec4 onRay = invProj * glm::vec4(nx, ny, 0.5f, 1.0f);
+					const glm::vec3 dir = glm::vec3(onRay) / onRay.w;
+					boxMin = glm::min(boxMin, dir * (d / -dir.z));
+					boxMax = glm::max(boxMax, dir * (d / -dir.z));
+				}
+
+				const uint32_t cluster = LightClusters::getClusterIndex(x, y, z);
+				for (uint32_t n = 0; n < grid[cluster].count; ++n)
+				{
+					const Light& light = lights[indices[grid[cluster].offset + n]];
+					const glm::vec3 lightPos = glm::vec3(view * glm::vec4(glm::make_vec3(light.position), 1.0f));
+					const glm::vec3 closest = glm::clamp(lightPos, boxMin, boxMax);
+					if (glm::distance(closest, lightPos) > light.range * 1.001f) extra++;
+				}
+			}
+		}
+	}
+	TEST_CHECK(extra == 0);
+	TEST_CHECK(!indices.empty());
+}
+
+static void testLightFarDepth()
+{
+	std::vector<Light> lights = makeLights(3, 10.0f, 1.0f, 1.0f, 3);
+	lights[0].set_position(glm::vec3(0.0f, 0.0f, -50.0f));
+	lights[0].range = 5.0f;
+	const glm::mat4 view(1.0f);
+	TEST_CHECK(std::abs(LightClusters::getLightFarDepth(lights.data(), lights.size(), view, Z_NEAR, 1000.0f) - 55.0f) < 1e-3f);
+
+	// clamped to the camera range
+	TEST_CHECK(LightClusters::getLightFarDepth(lights.data(), lights.size(), view, Z_NEAR, 20.0f) == 20.0f);
+	TEST_CHECK(LightClusters::getLightFarDepth(lights.data(), 0, view, Z_NEAR, 1000.0f) == 2.0f * Z_NEAR);
+
+	// directional lights do not count, infinite ones reach the far plane
+	lights[0].type = LightType_Directional;
+	TEST_CHECK(LightClusters::getLightFarDepth(lights.data(), lights.size(), view, Z_NEAR, 1000.0f) < 20.0f);
+	lights[1].range = 0.0f;
+	TEST_CHECK(LightClusters::getLightFarDepth(lights.data(), lights.size(), view, Z_NEAR, 1000.0f) == 1000.0f);
+}
+
+int main()
+{
+	testAssignmentAgainstBruteForce();
+	testLightFarDepth();
+
+	return test::result("test_light_clusters");
+}
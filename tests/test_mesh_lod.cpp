@@ -0,0 +1,191 @@
+#include <map>
+#include "test_common.h"
+#include "test_scenes.h"
+#include "mesh_lod.h"
+
+using namespace jsr;
+
+static std::vector<glm::vec3> getPositions(const MeshData& mesh)
+{
+	std::vector<glm::vec3> positions(mesh.positions.size() / sizeof(glm::vec3));
+	memcpy(positions.data(), mesh.positions.data(), positions.size() * sizeof(glm::vec3));
+	return positions;
+}
+
+static void setPositions(MeshData& mesh, const std::vector<glm::vec3>& positions)
+{
+	mesh.positions.resize(positions.size() * sizeof(glm::vec3));
+	memcpy(mesh.positions.data(), positions.data(), mesh.positions.size());
+}
+
+// a closed sphere: the seam and pole duplicates of makeSphereMesh merged, only the positions
+static MeshData makeClosedSphere(uint32_t segments)
+{
+	MeshData mesh = test::makeSphereMesh(segments);
+	const std::vector<glm::vec3> positions = getPositions(mesh);
+	std::map<std::tuple<float, float, float>, uint32_t> ids;
+	std::vector<glm::vec3> unique;
+	std::vector<uint32_t> remap(positions.size());
+	for (size_t v = 0; v < positions.size(); ++v)
+	{
+		const auto key = std::make_tuple(positions[v].x, positions[v].y, positions[v].z);
+		const auto it = ids.emplace(key, uint32_t(unique.size()));
+		if (it.second) unique.push_back(positions[v]);
+		remap[v] = it.first->second;
+	}
+	for (auto& index : mesh.indices) index = remap[index];
+	setPositions(mesh, unique);
+	return mesh;
+}
+
+// size x size quads of a height field, flat when amplitude is 0
+static MeshData makeHeightField(uint32_t size, float amplitude)
+{
+	const uint32_t row = size + 1;
+	std::vector<glm::vec3> positions;
+	for (uint32_t z = 0; z <= size; ++z)
+	{
+		for (uint32_t x = 0; x <= size; ++x) {
+			positions.push_back(glm::vec3(0.1f * x, amplitude * std::sin(0.2f * x) * std::cos(0.15f * z), 0.1f * z));
+		}
+	}
+	MeshData mesh{};
+	for (uint32_t z = 0; z < size; ++z)
+	{
+		for (uint32_t x = 0; x < size; ++x)
+		{
+			const uint32_t a = z * row + x, b = a + 1, c = a + row, d = c + 1;
+			mesh.indices.insert(mesh.indices.end(), { a, c, b, b, c, d });
+		}
+	}
+	setPositions(mesh, positions);
+	return mesh;
+}
+
+// the nearest of the interior of the triangle, when p projects into it, and its three edges
+static float distanceToTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	auto distanceToSegment = [&p](const glm::vec3& s, const glm::vec3& e)
+		{
+			const float t = glm::clamp(glm::dot(p - s, e - s) / glm::dot(e - s, e - s), 0.0f, 1.0f);
+			return glm::length(p - (s + t * (e - s)));
+		};
+	float nearest = std::min(distanceToSegment(a, b), std::min(distanceToSegment(b, c), distanceToSegment(c, a)));
+
+	const glm::vec3 n = glm::cross(b - a, c - a);
+	if (glm::dot(n, n) > 0.0f)
+	{
+		const glm::vec3 q = p - n * (glm::dot(p - a, n) / glm::dot(n, n));
+		const bool inside = glm::dot(glm::cross(b - a, q - a), n) >= 0.0f && glm::dot(glm::cross(c - b, q - b), n) >= 0.0f &&
+			glm::dot(glm::cross(a - c, q - c), n) >= 0.0f;
+		if (inside) nearest = std::min(nearest, glm::length(p - q));
+	}
+	return nearest;
+}
+
+// the largest distance of a full detail vertex to the LOD surface, every vertex against every triangle
+static float measureLodError(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& lod)
+{
+	float worst = 0.0f;
+	for (const glm::vec3& p : positions)
+	{
+		float nearest = std::numeric_limits<float>::max();
+		for (size_t t = 0; t + 2 < lod.size(); t += 3) {
+			nearest = std::min(nearest, distanceToTriangle(p, positions[lod[t]], positions[lod[t + 1]], positions[lod[t + 2]]));
+		}
+		worst = std::max(worst, nearest);
+	}
+	return worst;
+}
+
+/*
+The LOD chain of a closed sphere and of a bumpy height field with locked borders: every level has fewer
+triangles than the one before, none of them degenerate, and the stored error is the distance of the full
+detail vertices to the level, as measured against every triangle. Levels simplify the full detail mesh on
+their own, the stored errors are kept from decreasing.
+*/
+static void testLodChain()
+{
+	for (const MeshData& source : { makeClosedSphere(48), makeHeightField(64, 0.3f) })
+	{
+		MeshData mesh = source;
+		generateMeshLods(mesh);
+		const std::vector<glm::vec3> positions = getPositions(mesh);
+		TEST_CHECK(mesh.lods.size() >= 3 && mesh.lods.size() < size_t(MAX_MESH_LODS));
+
+		size_t prevCount = mesh.indices.size();
+		float prevError = 0.0f, measuredMax = 0.0f;
+		for (const MeshLod& lod : mesh.lods)
+		{
+			TEST_CHECK(!lod.indices.empty() && lod.indices.size() % 3 == 0);
+			TEST_CHECK(lod.indices.size() < prevCount);
+			TEST_CHECK(lod.error >= prevError);
+			bool valid = true;
+			for (size_t t = 0; t + 2 < lod.indices.size(); t += 3)
+			{
+				const uint32_t a = lod.indices[t], b = lod.indices[t + 1], c = lod.indices[t + 2];
+				valid = valid && a < positions.size() && b < positions.size() && c < positions.size() && a != b && b != c && c != a;
+			}
+			TEST_CHECK(valid);
+			if (!valid) break;
+
+			measuredMax = std::max(measuredMax, measureLodError(positions, lod.indices));
+			TEST_CHECK(lod.error > 0.0f);
+			TEST_CHECK(std::abs(lod.error - measuredMax) <= 1e-3f * measuredMax + 1e-6f);
+			prevCount = lod.indices.size();
+			prevError = lod.error;
+		}
+	}
+}
+
+// a flat grid halves without leaving its plane, the error is 0
+static void testFlatSimplifies()
+{
+	const MeshData grid = makeHeightField(32, 0.0f);
+	float error = -1.0f;
+	const std::vector<uint32_t> indices = simplifyMesh(reinterpret_cast<const float*>(grid.positions.data()), grid.positions.size() / sizeof(glm::vec3),
+		grid.indices, grid.indices.size() / 2, std::numeric_limits<float>::max(), &error);
+	TEST_CHECK(indices.size() <= grid.indices.size() / 2);
+	TEST_CHECK(error >= 0.0f && error < 1e-5f);
+	TEST_CHECK(measureLodError(getPositions(grid), indices) < 1e-5f);
+}
+
+/*
+Errors of 1, 2, 4 and 8 pixels at 100 pixels per unit against a budget of 4 pixels: a level at the budget is
+picked when coming from a coarser one or staying, going coarser needs 3 pixels (the hysteresis margin).
+*/
+static void testSelectLod()
+{
+	MeshData mesh{};
+	for (float error : { 0.01f, 0.02f, 0.04f, 0.08f }) mesh.lods.push_back({ {}, error });
+
+	TEST_CHECK(selectMeshLod(mesh, 100.0f, 4.0f, 0) == 2);
+	TEST_CHECK(selectMeshLod(mesh, 100.0f, 4.0f, 2) == 2);
+	TEST_CHECK(selectMeshLod(mesh, 100.0f, 4.0f, 3) == 3);
+	TEST_CHECK(selectMeshLod(mesh, 100.0f, 4.0f, 4) == 3);
+	TEST_CHECK(selectMeshLod(mesh, 100.0f, 5.4f, 0) == 3);
+	TEST_CHECK(selectMeshLod(mesh, 100.0f, 8.0f, 4) == 4);
+	TEST_CHECK(selectMeshLod(mesh, 100.0f, 0.5f, 2) == 0);
+	// farther away the same budget allows coarser levels
+	TEST_CHECK(selectMeshLod(mesh, 10.0f, 4.0f, 0) == 4);
+	TEST_CHECK(selectMeshLod(MeshData{}, 100.0f, 4.0f, 0) == 0);
+
+	// the threshold on a generated chain: the coarsest level within the budget at a distance
+	MeshData sphere = makeClosedSphere(48);
+	generateMeshLods(sphere);
+	for (float pixelsPerUnit : { 10.0f, 100.0f, 1000.0f })
+	{
+		int expected = 0;
+		for (int i = 0; i < int(sphere.lods.size()) && sphere.lods[i].error * pixelsPerUnit <= 2.0f; ++i) expected = i + 1;
+		TEST_CHECK(selectMeshLod(sphere, pixelsPerUnit, 2.0f, int(sphere.lods.size())) == expected);
+	}
+}
+
+int main()
+{
+	testLodChain();
+	testFlatSimplifies();
+	testSelectLod();
+
+	return test::result("test_mesh_lod");
+}
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include "test_common.h"
+#include "test_scenes.h"
+#include "mesh_optimize.h"
+
+using namespace jsr;
+
+typedef std::array<uint32_t, 3> Triangle;
+
+/*
+A bumpy grid of size x size quads, the rows in order or the triangles shuffled. Every vertex has its own
+position, and normal, tangent and uv values derived from its index so a vertex can be followed through
+the remap. The LOD keeps every other triangle.
+*/
+static MeshData makeGridMesh(uint32_t size, bool shuffled)
+{
+	const uint32_t row = size + 1;
+	std::vector<glm::vec3> positions, normals;
+	std::vector<glm::vec4> tangents;
+	std::vector<glm::vec2> uvs;
+	for (uint32_t z = 0; z <= size; ++z)
+	{
+		for (uint32_t x = 0; x <= size; ++x)
+		{
+			const uint32_t v = z * row + x;
+			positions.push_back(glm::vec3(float(x), std::sin(0.7f * float(x)) * std::cos(0.5f * float(z)), float(z)));
+			normals.push_back(glm::vec3(float(v), 1.0f, 0.0f));
+			tangents.push_back(glm::vec4(1.0f, 0.0f, float(v), 1.0f));
+			uvs.push_back(glm::vec2(float(v), 0.5f));
+		}
+	}
+
+	std::vector<Triangle> triangles;
+	for (uint32_t z = 0; z < size; ++z)
+	{
+		for (uint32_t x = 0; x < size; ++x)
+		{
+			const uint32_t a = z * row + x, b = a + 1, c = a + row, d = c + 1;
+			triangles.push_back({ a, c, b });
+			triangles.push_back({ b, c, d });
+		}
+	}
+	if (shuffled)
+	{
+		std::mt19937 rng(5);
+		std::shuffle(triangles.begin(), triangles.end(), rng);
+	}
+
+	MeshData mesh{};
+	for (const Triangle& t : triangles) mesh.indices.insert(mesh.indices.end(), t.begin(), t.end());
+	MeshLod lod{ {}, 1.0f };
+	for (size_t t = 0; t < triangles.size(); t += 2) lod.indices.insert(lod.indices.end(), triangles[t].begin(), triangles[t].end());
+	mesh.lods.push_back(std::move(lod));
+
+	auto setStream = [](std::vector<uint8_t>& stream, const void* data, size_t size)
+		{
+			stream.resize(size);
+			memcpy(stream.data(), data, size);
+		};
+	setStream(mesh.positions, positions.data(), positions.size() * sizeof(glm::vec3));
+	setStream(mesh.normals, normals.data(), normals.size() * sizeof(glm::vec3));
+	setStream(mesh.tangents, tangents.data(), tangents.size() * sizeof(glm::vec4));
+	setStream(mesh.uvs, uvs.data(), uvs.size() * sizeof(glm::vec2));
+	mesh.aabb = Bounds(glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(float(size), 1.0f, float(size)));
+	mesh.material = 0;
+	return mesh;
+}
+
+// the original index of every vertex, read back from the normal stream
+static uint32_t vertexId(const MeshData& mesh, uint32_t index)
+{
+	glm::vec3 normal;
+	memcpy(&normal, &mesh.normals[index * sizeof(glm::vec3)], sizeof(normal));
+	return uint32_t(normal.x);
+}
+
+// every vertex still has all of its attributes
+static bool sameVertices(const MeshData& a, const MeshData& b)
+{
+	const size_t vertexCount = a.positions.size() / sizeof(glm::vec3);
+	if (b.positions.size() != a.positions.size() || b.normals.size() != a.normals.size() ||
+		b.tangents.size() != a.tangents.size() || b.uvs.size() != a.uvs.size()) {
+		return false;
+	}
+	std::vector<uint32_t> ids(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+	{
+		const uint32_t id = vertexId(b, v);
+		if (id >= vertexCount) return false;
+		ids[v] = id;
+		if (memcmp(&b.positions[v * 12], &a.positions[id * 12], 12) != 0 || memcmp(&b.tangents[v * 16], &a.tangents[id * 16], 16) != 0 ||
+			memcmp(&b.uvs[v * 8], &a.uvs[id * 8], 8) != 0) {
+			return false;
+		}
+	}
+	std::sort(ids.begin(), ids.end());
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		if (ids[v] != v) return false;
+	}
+	return true;
+}
+
+// the triangles of indices through map, each starting at its smallest vertex with its winding kept, sorted
+static std::vector<Triangle> getTriangles(const std::vector<uint32_t>& indices, const std::function<uint32_t(uint32_t)>& map)
+{
+	std::vector<Triangle> triangles;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		Triangle t = { map(indices[i]), map(indices[i + 1]), map(indices[i + 2]) };
+		std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+		triangles.push_back(t);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+static std::vector<Triangle> getTriangles(const std::vector<uint32_t>& indices)
+{
+	return getTriangles(indices, [](uint32_t v) { return v; });
+}
+
+// the steps on their own keep the triangles, the remap is a permutation in first use order
+static void testSteps()
+{
+	for (bool shuffled : { false, true })
+	{
+		const MeshData mesh = makeGridMesh(40, shuffled);
+		const size_t vertexCount = mesh.positions.size() / sizeof(glm::vec3);
+		const float acmr = analyzeVertexCache(mesh.indices, vertexCount).acmr();
+
+		std::vector<uint32_t> hardBoundaries;
+		std::vector<uint32_t> indices = optimizeVertexCache(mesh.indices, vertexCount, VERTEX_CACHE_SIZE, &hardBoundaries);
+		TEST_CHECK(getTriangles(indices) == getTriangles(mesh.indices));
+		TEST_CHECK(analyzeVertexCache(indices, vertexCount).acmr() <= acmr);
+		TEST_CHECK(std::is_sorted(hardBoundaries.begin(), hardBoundaries.end()));
+		TEST_CHECK(hardBoundaries.empty() || (hardBoundaries.front() > 0 && hardBoundaries.back() < indices.size()));
+		for (const uint32_t boundary : hardBoundaries) TEST_CHECK(boundary % 3 == 0);
+
+		const float cacheAcmr = analyzeVertexCache(indices, vertexCount).acmr();
+		optimizeOverdraw(indices, hardBoundaries, reinterpret_cast<const float*>(mesh.positions.data()), vertexCount);
+		TEST_CHECK(getTriangles(indices) == getTriangles(mesh.indices));
+		// the clusters restart the cache, a few misses more than the cache order and still fewer than the input
+		TEST_CHECK(analyzeVertexCache(indices, vertexCount).acmr() >= cacheAcmr);
+		TEST_CHECK(analyzeVertexCache(indices, vertexCount).acmr() < acmr);
+
+		const std::vector<uint32_t> remap = optimizeVertexFetchRemap(indices, vertexCount);
+		std::vector<uint32_t> sorted = remap;
+		std::sort(sorted.begin(), sorted.end());
+		std::vector<uint32_t> identity(vertexCount);
+		std::iota(identity.begin(), identity.end(), 0u);
+		TEST_CHECK(sorted == identity);
+		// first use order: the remapped indices never jump past the next new vertex
+		uint32_t next = 0;
+		for (const uint32_t index : indices)
+		{
+			TEST_CHECK(remap[index] <= next);
+			if (remap[index] == next) ++next;
+		}
+	}
+}
+
+/*
+The whole optimization on a grid in row order and shuffled: the same triangles of the same vertices
+after the remap, in the full detail indices and the LOD, and the ACMR not worse than before.
+*/
+static void testOptimizeMesh()
+{
+	for (bool shuffled : { false, true })
+	{
+		const MeshData original = makeGridMesh(40, shuffled);
+		MeshData mesh = original;
+		VertexCacheStats before, after;
+		optimizeMesh(mesh, &before, &after);
+
+		TEST_CHECK(sameVertices(original, mesh));
+		auto id = [&mesh](uint32_t v) { return vertexId(mesh, v); };
+		TEST_CHECK(getTriangles(mesh.indices, id) == getTriangles(original.indices));
+		TEST_CHECK(mesh.lods.size() == 1);
+		if (mesh.lods.size() == 1) TEST_CHECK(getTriangles(mesh.lods[0].indices, id) == getTriangles(original.lods[0].indices));
+
+		const size_t vertexCount = original.positions.size() / sizeof(glm::vec3);
+		TEST_CHECK(before.acmr() == analyzeVertexCache(original.indices, vertexCount).acmr());
+		TEST_CHECK(after.acmr() == analyzeVertexCache(mesh.indices, vertexCount).acmr());
+		TEST_CHECK(after.acmr() <= before.acmr());
+		const float lodBefore = analyzeVertexCache(original.lods[0].indices, vertexCount).acmr();
+		const float lodAfter = analyzeVertexCache(mesh.lods[0].indices, vertexCount).acmr();
+		TEST_CHECK(lodAfter <= lodBefore);
+		// a 16 entry cache gets a grid near 0.5 + 1 / 16 from a shuffled order near 3
+		if (shuffled) TEST_CHECK(before.acmr() > 2.0f && after.acmr() < 1.0f && lodAfter < 0.5f * lodBefore);
+	}
+}
+
+int main()
+{
+	testSteps();
+	testOptimizeMesh();
+
+	return test::result("test_mesh_optimize");
+}
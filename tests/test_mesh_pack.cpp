@@ -0,0 +1,159 @@
+#include <glm/gtc/type_ptr.hpp>
+#include "test_common.h"
+#include "test_scenes.h"
+#include "mesh_pack.h"
+
+using namespace jsr;
+
+static MeshData makePackMesh(uint32_t segments, uint32_t lodCount = 0)
+{
+	MeshData mesh = test::makeSphereMesh(segments);
+	test::addSphereVertexStreams(mesh);
+	// every other triangle, enough to have ranges of different sizes
+	for (uint32_t l = 0; l < lodCount; ++l)
+	{
+		const std::vector<uint32_t>& src = l == 0 ? mesh.indices : mesh.lods.back().indices;
+		MeshLod lod{ {}, float(l + 1) };
+		for (size_t t = 0; t < src.size(); t += 6) lod.indices.insert(lod.indices.end(), src.begin() + t, src.begin() + t + 3);
+		mesh.lods.push_back(std::move(lod));
+	}
+	return mesh;
+}
+
+static uint32_t readIndex(const std::vector<uint8_t>& indices, uint32_t indexSize, size_t i)
+{
+	if (indexSize == sizeof(uint16_t)) return reinterpret_cast<const uint16_t*>(indices.data())[i];
+	return reinterpret_cast<const uint32_t*>(indices.data())[i];
+}
+
+// every range of every mesh holds its own indices, relative to the first vertex of the mesh
+static int countIndexMismatches(const std::vector<MeshData>& meshes, const std::vector<PackedMesh>& packed, const std::vector<uint8_t>& indices, uint32_t indexSize)
+{
+	int mismatches = 0;
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		for (uint32_t l = 0; l < packed[i].lodCount; ++l)
+		{
+			const std::vector<uint32_t>& src = l == 0 ? meshes[i].indices : meshes[i].lods[l - 1].indices;
+			for (size_t k = 0; k < src.size(); ++k) {
+				mismatches += readIndex(indices, indexSize, packed[i].lods[l].firstIndex + k) != src[k] ? 1 : 0;
+			}
+		}
+	}
+	return mismatches;
+}
+
+// the meshes one after the other, the LODs after their full detail indices
+static void testLayout()
+{
+	std::vector<MeshData> meshes = { makePackMesh(8, 2), makePackMesh(16), makePackMesh(4, 4) };
+	std::vector<PackedMesh> packed;
+	uint32_t vertexCount, indexCount;
+	layoutPackedMeshes(meshes, packed, vertexCount, indexCount);
+
+	TEST_CHECK(packed.size() == meshes.size());
+	uint32_t firstVertex = 0, firstIndex = 0;
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		TEST_CHECK(packed[i].firstVertex == firstVertex);
+		TEST_CHECK(packed[i].vertexCount == meshes[i].positions.size() / sizeof(glm::vec3));
+		TEST_CHECK(packed[i].lodCount == meshes[i].lods.size() + 1);
+		firstVertex += packed[i].vertexCount;
+		for (uint32_t l = 0; l < packed[i].lodCount; ++l)
+		{
+			TEST_CHECK(packed[i].lods[l].firstIndex == firstIndex);
+			TEST_CHECK(packed[i].lods[l].indexCount == (l == 0 ? meshes[i].indices.size() : meshes[i].lods[l - 1].indices.size()));
+			firstIndex += packed[i].lods[l].indexCount;
+		}
+	}
+	TEST_CHECK(vertexCount == firstVertex);
+	TEST_CHECK(indexCount == firstIndex);
+}
+
+// small meshes pack to 16 bit indices, the vertices decode to the streams they came from
+static void testSmallMeshes()
+{
+	std::vector<MeshData> meshes = { makePackMesh(8, 2), makePackMesh(32, 1) };
+	std::vector<PackedMesh> packed;
+	uint32_t vertexCount, indexCount;
+	layoutPackedMeshes(meshes, packed, vertexCount, indexCount);
+	const uint32_t indexSize = getPackedIndexSize(meshes);
+	TEST_CHECK(indexSize == sizeof(uint16_t));
+
+	for (VertexFormat format : { VERTEX_FORMAT_FULL, VERTEX_FORMAT_COMPACT })
+	{
+		std::vector<uint8_t> vertices, indices;
+		TEST_CHECK(packMeshes(meshes, packed, format, indexSize, vertices, indices));
+		TEST_CHECK(indices.size() == size_t(indexCount) * indexSize);
+		TEST_CHECK(countIndexMismatches(meshes, packed, indices, indexSize) == 0);
+
+		const size_t stride = format == VERTEX_FORMAT_COMPACT ? sizeof(VertexCompact) : sizeof(Vertex);
+		TEST_CHECK(vertices.size() == size_t(vertexCount) * stride);
+		float maxError = 0.0f;
+		for (size_t i = 0; i < meshes.size(); ++i)
+		{
+			const glm::vec3* positions = reinterpret_cast<const glm::vec3*>(meshes[i].positions.data());
+			for (uint32_t v = 0; v < packed[i].vertexCount; ++v)
+			{
+				const uint8_t* dst = &vertices[(size_t(packed[i].firstVertex) + v) * stride];
+				const glm::vec3 p = format == VERTEX_FORMAT_COMPACT ?
+					reinterpret_cast<const VertexCompact*>(dst)->get_position(meshes[i].aabb) :
+					glm::make_vec3(reinterpret_cast<const Vertex*>(dst)->xyz);
+				maxError = std::max(maxError, glm::length(p - positions[v]));
+			}
+		}
+		// half a step of 16 bits over the bounds of 2 per axis
+		TEST_CHECK(maxError <= (format == VERTEX_FORMAT_COMPACT ? 1.01f * std::sqrt(3.0f) * 2.0f / 131070.0f : 0.0f));
+	}
+}
+
+// past 0x10000 vertices in a mesh the scene goes to 32 bit indices, 16 bit ones would wrap
+static void testLargeMesh()
+{
+	// 256 * 256 and 257 * 257 vertices
+	for (uint32_t segments : { 255u, 256u })
+	{
+		std::vector<MeshData> meshes = { makePackMesh(8), makePackMesh(segments, 1), makePackMesh(8) };
+		const bool large = meshes[1].positions.size() / sizeof(glm::vec3) > 0x10000;
+		std::vector<PackedMesh> packed;
+		uint32_t vertexCount, indexCount;
+		layoutPackedMeshes(meshes, packed, vertexCount, indexCount);
+
+		const uint32_t indexSize = getPackedIndexSize(meshes);
+		TEST_CHECK(indexSize == (large ? sizeof(uint32_t) : sizeof(uint16_t)));
+		std::vector<uint8_t> vertices, indices;
+		TEST_CHECK(packMeshes(meshes, packed, VERTEX_FORMAT_COMPACT, indexSize, vertices, indices));
+		TEST_CHECK(countIndexMismatches(meshes, packed, indices, indexSize) == 0);
+
+		if (large)
+		{
+			std::vector<uint8_t> narrowVertices, narrowIndices;
+			TEST_CHECK(!packMeshes(meshes, packed, VERTEX_FORMAT_COMPACT, sizeof(uint16_t), narrowVertices, narrowIndices));
+		}
+	}
+}
+
+// an index past the vertices of its mesh is reported, at both index sizes
+static void testIndexOutOfRange()
+{
+	std::vector<MeshData> meshes = { makePackMesh(8), makePackMesh(8) };
+	meshes[0].indices[5] = uint32_t(meshes[0].positions.size() / sizeof(glm::vec3));
+	std::vector<PackedMesh> packed;
+	uint32_t vertexCount, indexCount;
+	layoutPackedMeshes(meshes, packed, vertexCount, indexCount);
+	for (uint32_t indexSize : { 2u, 4u })
+	{
+		std::vector<uint8_t> vertices, indices;
+		TEST_CHECK(!packMeshes(meshes, packed, VERTEX_FORMAT_FULL, indexSize, vertices, indices));
+	}
+}
+
+int main()
+{
+	testLayout();
+	testSmallMeshes();
+	testLargeMesh();
+	testIndexOutOfRange();
+
+	return test::result("test_mesh_pack");
+}
@@ -0,0 +1,182 @@
+#include "test_common.h"
+#include "test_scenes.h"
+#include "mesh_tangents.h"
+
+using namespace jsr;
+
+template<class T> static void setStream(std::vector<uint8_t>& stream, const std::vector<T>& values)
+{
+	stream.resize(values.size() * sizeof(T));
+	memcpy(stream.data(), values.data(), stream.size());
+}
+
+template<class T> static T getElement(const std::vector<uint8_t>& stream, size_t i)
+{
+	T value;
+	memcpy(&value, &stream[i * sizeof(T)], sizeof(T));
+	return value;
+}
+
+/*
+A grid of size x size quads without indices, 6 corners per quad. doubleSided adds the same grid facing down:
+the same positions and uvs with the other normal, they are not duplicates of the first one.
+*/
+static MeshData makeUnindexedGrid(uint32_t size, bool doubleSided)
+{
+	std::vector<glm::vec3> positions, normals;
+	std::vector<glm::vec2> uvs;
+	for (float side : { 1.0f, -1.0f })
+	{
+		if (side < 0.0f && !doubleSided) break;
+		for (uint32_t z = 0; z < size; ++z)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				const uint32_t corners[6][2] = { { x, z }, { x, z + 1 }, { x + 1, z }, { x + 1, z }, { x, z + 1 }, { x + 1, z + 1 } };
+				for (const auto& c : corners)
+				{
+					positions.push_back(glm::vec3(float(c[0]), 0.0f, float(c[1])));
+					normals.push_back(glm::vec3(0.0f, side, 0.0f));
+					uvs.push_back(glm::vec2(float(c[0]), float(c[1])) / float(size));
+				}
+			}
+		}
+	}
+	MeshData mesh{};
+	setStream(mesh.positions, positions);
+	setStream(mesh.normals, normals);
+	setStream(mesh.uvs, uvs);
+	return mesh;
+}
+
+// the corners of the welded mesh read the attributes of the corners before
+static bool sameCorners(const MeshData& before, const MeshData& after)
+{
+	if (after.indices.size() != before.positions.size() / sizeof(glm::vec3)) return false;
+	for (size_t k = 0; k < after.indices.size(); ++k)
+	{
+		const uint32_t v = after.indices[k];
+		if (getElement<glm::vec3>(after.positions, v) != getElement<glm::vec3>(before.positions, k) ||
+			getElement<glm::vec3>(after.normals, v) != getElement<glm::vec3>(before.normals, k) ||
+			getElement<glm::vec2>(after.uvs, v) != getElement<glm::vec2>(before.uvs, k)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void testWeldCount()
+{
+	for (uint32_t size : { 1u, 4u, 17u })
+	{
+		const MeshData grid = makeUnindexedGrid(size, false);
+		MeshData welded = grid;
+		TEST_CHECK(weldMeshVertices(welded) == size_t(size + 1) * (size + 1));
+		TEST_CHECK(welded.positions.size() == size_t(size + 1) * (size + 1) * sizeof(glm::vec3));
+		TEST_CHECK(welded.normals.size() == size_t(size + 1) * (size + 1) * sizeof(glm::vec3));
+		TEST_CHECK(welded.uvs.size() == size_t(size + 1) * (size + 1) * sizeof(glm::vec2));
+		TEST_CHECK(sameCorners(grid, welded));
+		// a welded mesh has no duplicates left
+		TEST_CHECK(weldMeshVertices(welded) == size_t(size + 1) * (size + 1));
+		TEST_CHECK(sameCorners(grid, welded));
+
+		const MeshData doubleSided = makeUnindexedGrid(size, true);
+		welded = doubleSided;
+		TEST_CHECK(weldMeshVertices(welded) == 2 * size_t(size + 1) * (size + 1));
+		TEST_CHECK(sameCorners(doubleSided, welded));
+	}
+
+	// indexed input: the vertices in reverse order and the corners indexing them, remapped through the old vertices
+	const MeshData unindexed = makeUnindexedGrid(3, false);
+	const size_t cornerCount = unindexed.positions.size() / sizeof(glm::vec3);
+	MeshData grid{};
+	for (size_t k = 0; k < cornerCount; ++k)
+	{
+		const size_t v = cornerCount - 1 - k;
+		grid.positions.insert(grid.positions.end(), &unindexed.positions[v * sizeof(glm::vec3)], &unindexed.positions[v * sizeof(glm::vec3)] + sizeof(glm::vec3));
+		grid.normals.insert(grid.normals.end(), &unindexed.normals[v * sizeof(glm::vec3)], &unindexed.normals[v * sizeof(glm::vec3)] + sizeof(glm::vec3));
+		grid.uvs.insert(grid.uvs.end(), &unindexed.uvs[v * sizeof(glm::vec2)], &unindexed.uvs[v * sizeof(glm::vec2)] + sizeof(glm::vec2));
+		grid.indices.push_back(uint32_t(v));
+	}
+	TEST_CHECK(weldMeshVertices(grid) == 16);
+	TEST_CHECK(sameCorners(unindexed, grid));
+}
+
+// the mesh is left as it was
+static void testWeldRejectsMismatchedStreams()
+{
+	auto rejects = [](const std::function<void(MeshData&)>& edit)
+		{
+			MeshData mesh = makeUnindexedGrid(2, false);
+			edit(mesh);
+			const MeshData before = mesh;
+			return weldMeshVertices(mesh) == 0 && mesh.positions == before.positions && mesh.normals == before.normals &&
+				mesh.uvs == before.uvs && mesh.tangents == before.tangents && mesh.indices == before.indices;
+		};
+
+	TEST_CHECK(!rejects([](MeshData&) {}));
+	TEST_CHECK(rejects([](MeshData& mesh) { mesh.normals.resize(mesh.normals.size() - sizeof(glm::vec3)); }));
+	TEST_CHECK(rejects([](MeshData& mesh) { mesh.uvs.resize(mesh.uvs.size() + sizeof(glm::vec2)); }));
+	TEST_CHECK(rejects([](MeshData& mesh) { mesh.tangents.resize(sizeof(glm::vec4)); }));
+	TEST_CHECK(rejects([](MeshData& mesh) { mesh.positions.resize(mesh.positions.size() - 1); }));
+	TEST_CHECK(rejects([](MeshData& mesh)
+		{
+			for (uint32_t k = 0; k < 6; ++k) mesh.indices.push_back(k);
+			mesh.indices.back() = uint32_t(mesh.positions.size() / sizeof(glm::vec3));
+		}));
+	TEST_CHECK(rejects([](MeshData& mesh) { mesh.positions.clear(); mesh.normals.clear(); mesh.uvs.clear(); }));
+}
+
+/*
+The tangents of a sphere: one per corner before the weld, unit length, orthogonal to the normal of
+their vertex and with a sign of +-1, before and after the weld.
+*/
+static void testTangentsOrthogonalToNormals()
+{
+	MeshData mesh = test::makeSphereMesh(24);
+	test::addSphereVertexStreams(mesh);
+	mesh.tangents.clear();
+	const size_t cornerCount = mesh.indices.size();
+	TEST_CHECK(generateMeshTangents(mesh));
+	TEST_CHECK(mesh.indices.size() == cornerCount && mesh.tangents.size() == cornerCount * sizeof(glm::vec4));
+	TEST_CHECK(mesh.positions.size() == cornerCount * sizeof(glm::vec3) && mesh.normals.size() == cornerCount * sizeof(glm::vec3));
+
+	auto countBadTangents = [](const MeshData& mesh)
+		{
+			int bad = 0;
+			for (size_t v = 0; v < mesh.tangents.size() / sizeof(glm::vec4); ++v)
+			{
+				const glm::vec4 t = getElement<glm::vec4>(mesh.tangents, v);
+				const glm::vec3 n = getElement<glm::vec3>(mesh.normals, v);
+				const bool ok = std::abs(glm::dot(glm::vec3(t), n)) < 1e-4f && std::abs(glm::length(glm::vec3(t)) - 1.0f) < 1e-3f &&
+					std::abs(t.w) == 1.0f;
+				bad += ok ? 0 : 1;
+			}
+			return bad;
+		};
+	TEST_CHECK(countBadTangents(mesh) == 0);
+
+	const size_t welded = weldMeshVertices(mesh);
+	TEST_CHECK(welded > 0 && welded < cornerCount);
+	TEST_CHECK(mesh.tangents.size() == welded * sizeof(glm::vec4));
+	TEST_CHECK(countBadTangents(mesh) == 0);
+
+	// MikkTSpace needs the normals and the uvs
+	MeshData noUvs = test::makeSphereMesh(8);
+	test::addSphereVertexStreams(noUvs);
+	noUvs.uvs.clear();
+	TEST_CHECK(!generateMeshTangents(noUvs));
+	MeshData noNormals = test::makeSphereMesh(8);
+	test::addSphereVertexStreams(noNormals);
+	noNormals.normals.pop_back();
+	TEST_CHECK(!generateMeshTangents(noNormals));
+}
+
+int main()
+{
+	testWeldCount();
+	testWeldRejectsMismatchedStreams();
+	testTangentsOrthogonalToNormals();
+
+	return test::result("test_mesh_tangents");
+}
@@ -0,0 +1,176 @@
+#include <set>
+#include <array>
+#include "test_common.h"
+#include "test_scenes.h"
+#include "meshlet.h"
+#include "mesh_optimize.h"
+#include <glm/gtc/type_ptr.hpp>
+
+using namespace jsr;
+
+// a size x size grid in the xz plane facing up, so every meshlet has a zero width normal cone
+static MeshData makeGridMesh(uint32_t size)
+{
+	std::vector<glm::vec3> positions;
+	for (uint32_t z = 0; z <= size; ++z)
+	{
+		for (uint32_t x = 0; x <= size; ++x) positions.push_back(glm::vec3(float(x), 0.0f, float(z)) / float(size) - glm::vec3(0.5f, 0.0f, 0.5f));
+	}
+	MeshData md{};
+	for (uint32_t z = 0; z < size; ++z)
+	{
+		for (uint32_t x = 0; x < size; ++x)
+		{
+			const uint32_t a = z * (size + 1) + x, b = a + 1, c = a + size + 1, d = c + 1;
+			md.indices.insert(md.indices.end(), { a, c, b, b, c, d });
+		}
+	}
+	md.positions.resize(positions.size() * sizeof(glm::vec3));
+	memcpy(md.positions.data(), positions.data(), md.positions.size());
+	for (const auto& p : positions) md.aabb.Extend(p);
+	return md;
+}
+
+static glm::vec3 meshletPosition(const MeshData& mesh, const Meshlet& meshlet, uint32_t local)
+{
+	const float* positions = reinterpret_cast<const float*>(mesh.positions.data());
+	return glm::make_vec3(&positions[mesh.meshletVertices[meshlet.vertexOffset + local] * 3]);
+}
+
+// every triangle in exactly one meshlet, the limits kept, the bounds around the vertices
+static void checkMeshlets(const MeshData& mesh)
+{
+	std::multiset<std::array<uint32_t, 3>> expected, actual;
+	for (size_t t = 0; t < mesh.indices.size(); t += 3) expected.insert({ mesh.indices[t], mesh.indices[t + 1], mesh.indices[t + 2] });
+
+	int errors = 0;
+	for (const auto& meshlet : mesh.meshlets)
+	{
+		if (meshlet.vertexCount > MESHLET_MAX_VERTICES || meshlet.triangleCount > MESHLET_MAX_TRIANGLES) errors++;
+		for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+		{
+			std::array<uint32_t, 3> tri;
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint8_t local = mesh.meshletTriangles[meshlet.triangleOffset + t * 3 + k];
+				if (local >= meshlet.vertexCount) {
+					errors++;
+					continue;
+				}
+				tri[k] = mesh.meshletVertices[meshlet.vertexOffset + local];
+			}
+			actual.insert(tri);
+		}
+		for (uint32_t v = 0; v < meshlet.vertexCount; ++v)
+		{
+			const glm::vec3 p = meshletPosition(mesh, meshlet, v);
+			if (glm::length(p - meshlet.sphere.GetCenter()) > meshlet.sphere.GetRadius() * 1.0001f) errors++;
+			if (!meshlet.aabb.Contains(p)) errors++;
+		}
+	}
+	TEST_CHECK(errors == 0);
+	TEST_CHECK(actual == expected);
+}
+
+static void testBuild()
+{
+	MeshData sphere = test::makeSphereMesh(96);
+	optimizeMesh(sphere);
+	buildMeshlets(sphere);
+	checkMeshlets(sphere);
+	// the vertex cache order keeps them close to full
+	TEST_CHECK(sphere.meshlets.size() * MESHLET_MAX_TRIANGLES < 2 * sphere.indices.size() / 3);
+
+	MeshData grid = makeGridMesh(64);
+	buildMeshlets(grid);
+	checkMeshlets(grid);
+
+	MeshData empty{};
+	buildMeshlets(empty);
+	TEST_CHECK(empty.meshlets.empty());
+}
+
+/*
+From random cameras around the mesh, under a non uniform scale: a meshlet culled by its cone has every
+triangle facing away from the camera in world space, one culled by the frustum has no vertex in it.
+The test also asks for some of both, a cone test that never culls would pass the rest.
+*/
+static void checkCulling(const MeshData& mesh, const glm::mat4& model, size_t& frustumCulled, size_t& backfaceCulled, int& errors)
+{
+	std::mt19937 rng(4);
+	std::uniform_real_distribution<float> pos(-6.0f, 6.0f);
+	const glm::vec3 center(model[3]);
+	for (int i = 0; i < 500; ++i)
+	{
+		const glm::vec3 camera = center + glm::vec3(pos(rng), pos(rng), pos(rng));
+		if (glm::length(camera - center) < 3.0f) continue;
+		const Frustum frustum(test::makeViewProjection(camera, center + 0.5f * glm::vec3(pos(rng), pos(rng), pos(rng)), 100.0f));
+
+		std::vector<uint32_t> visible;
+		MeshletCullStats stats;
+		cullMeshlets(mesh, model, frustum, camera, true, &visible, &stats);
+		frustumCulled += stats.frustumCulled;
+		backfaceCulled += stats.backfaceCulled;
+		if (stats.meshlets - stats.frustumCulled - stats.backfaceCulled != visible.size()) errors++;
+
+		const std::set<uint32_t> passed(visible.begin(), visible.end());
+		for (uint32_t m = 0; m < mesh.meshlets.size(); ++m)
+		{
+			if (passed.count(m)) continue;
+			const Meshlet& meshlet = mesh.meshlets[m];
+			auto world = [&](uint32_t local) { return glm::vec3(model * glm::vec4(meshletPosition(mesh, meshlet, local), 1.0f)); };
+			bool inFrustum = false;
+			for (uint32_t v = 0; v < meshlet.vertexCount; ++v) inFrustum = inFrustum || frustum.Intersects(world(v));
+			if (!inFrustum) continue;
+
+			// in the frustum, so culled by its cone
+			for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+			{
+				const uint8_t* tri = &mesh.meshletTriangles[meshlet.triangleOffset + t * 3];
+				const glm::vec3 p0 = world(tri[0]), p1 = world(tri[1]), p2 = world(tri[2]);
+				const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+				if (glm::dot(n, camera - p0) > 1e-6f * glm::length(n)) {
+					errors++;
+					break;
+				}
+			}
+		}
+	}
+}
+
+static void testConeCulling()
+{
+	MeshData sphere = test::makeSphereMesh(96);
+	optimizeMesh(sphere);
+	buildMeshlets(sphere);
+	MeshData grid = makeGridMesh(64);
+	buildMeshlets(grid);
+
+	const glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 2.0f, 3.0f)), glm::vec3(2.0f, 1.0f, 0.5f));
+	for (const MeshData* mesh : { &sphere, &grid })
+	{
+		size_t frustumCulled = 0, backfaceCulled = 0;
+		int errors = 0;
+		checkCulling(*mesh, model, frustumCulled, backfaceCulled, errors);
+		TEST_CHECK(errors == 0);
+		TEST_CHECK(frustumCulled > 0);
+		TEST_CHECK(backfaceCulled > 0);
+	}
+
+	// below the grid every meshlet faces away, mirrored the cone test is off
+	const glm::vec3 below(0.0f, -2.0f, 0.0f);
+	const Frustum frustum(test::makeViewProjection(below, glm::vec3(0.0f), 100.0f));
+	MeshletCullStats stats, mirroredStats;
+	cullMeshlets(grid, glm::mat4(1.0f), frustum, below, true, nullptr, &stats);
+	TEST_CHECK(stats.backfaceCulled == grid.meshlets.size());
+	cullMeshlets(grid, glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, -1.0f, 1.0f)), frustum, below, true, nullptr, &mirroredStats);
+	TEST_CHECK(mirroredStats.backfaceCulled == 0);
+}
+
+int main()
+{
+	testBuild();
+	testConeCulling();
+
+	return test::result("test_meshlet");
+}
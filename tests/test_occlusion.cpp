@@ -0,0 +1,153 @@
+#include <random>
+#include "test_common.h"
+#include "occlusion.h"
+
+using namespace jsr;
+
+static const int BUFFER_WIDTH = 256;
+static const int BUFFER_HEIGHT = 128;
+
+// reversed-Z like the renderer, the camera is at the origin looking down -Z
+static glm::mat4 makeViewProjection()
+{
+	const glm::mat4 proj = glm::perspective(glm::radians(60.0f), float(BUFFER_WIDTH) / BUFFER_HEIGHT, 1000.0f, 0.1f);
+	return proj * glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+static Bounds randomBox(std::mt19937& rng, float zMin, float zMax, float sizeMin, float sizeMax)
+{
+	std::uniform_real_distribution<float> z(zMin, zMax);
+	std::uniform_real_distribution<float> size(sizeMin, sizeMax);
+	const float depth = -z(rng);
+	// spread over the view at that distance
+	std::uniform_real_distribution<float> x(-0.9f * depth, 0.9f * depth);
+	std::uniform_real_distribution<float> y(-0.5f * depth, 0.5f * depth);
+	const glm::vec3 center(x(rng), y(rng), depth);
+	const glm::vec3 half = 0.5f * glm::vec3(size(rng), size(rng), size(rng));
+	return Bounds(center - half, center + half);
+}
+
+/*
+Brute force visibility: rays through the pixel centers of the buffer over the screen rectangle of the box,
+the box is visible if any ray enters it before it enters an occluder. The buffer samples coverage at the
+same points, a gap between two occluders narrower than a pixel is closed there like on the GPU.
+*/
+static bool isVisibleReference(const glm::mat4& viewProj, const std::vector<Bounds>& occluders, const Bounds& box)
+{
+	const glm::mat4 invViewProj = glm::inverse(viewProj);
+	glm::vec2 rectMin(std::numeric_limits<float>::max());
+	glm::vec2 rectMax(std::numeric_limits<float>::lowest());
+	for (const glm::vec4& corner : box.GetHomogenousCorners())
+	{
+		const glm::vec4 clip = viewProj * corner;
+		if (clip.w <= 0.0f) return true;
+		rectMin = glm::min(rectMin, glm::vec2(clip) / clip.w);
+		rectMax = glm::max(rectMax, glm::vec2(clip) / clip.w);
+	}
+	rectMin = glm::max(rectMin, glm::vec2(-1.0f));
+	rectMax = glm::min(rectMax, glm::vec2(1.0f));
+
+	const int width = BUFFER_WIDTH, height = BUFFER_HEIGHT;
+	const int x0 = int(std::floor((rectMin.x + 1.0f) * 0.5f * width)), x1 = std::min(width - 1, int((rectMax.x + 1.0f) * 0.5f * width));
+	const int y0 = int(std::floor((rectMin.y + 1.0f) * 0.5f * height)), y1 = std::min(height - 1, int((rectMax.y + 1.0f) * 0.5f * height));
+	for (int py = y0; py <= y1; ++py)
+	{
+		for (int px = x0; px <= x1; ++px)
+		{
+			const float x = (float(px) + 0.5f) / width * 2.0f - 1.0f;
+			const float y = (float(py) + 0.5f) / height * 2.0f - 1.0f;
+			// reversed-Z: 1 is the near plane
+			const glm::vec4 nearPoint = invViewProj * glm::vec4(x, y, 1.0f, 1.0f);
+			const glm::vec4 farPoint = invViewProj * glm::vec4(x, y, 0.5f, 1.0f);
+			const glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+			const glm::vec3 dir = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+			const glm::vec3 invDir = 1.0f / dir;
+
+			float boxNear, boxFar;
+			if (!box.RayIntersect(origin, invDir, boxNear, boxFar) || boxFar < 0.0f) continue;
+			bool hidden = false;
+			for (const Bounds& occluder : occluders)
+			{
+				float tnear, tfar;
+				if (occluder.RayIntersect(origin, invDir, tnear, tfar) && tfar >= 0.0f && tnear < boxNear) {
+					hidden = true;
+					break;
+				}
+			}
+			if (!hidden) return true;
+		}
+	}
+	return false;
+}
+
+// nothing reported occluded can be seen, and most of the hidden boxes are found
+static void testConservativeAgainstBruteForce()
+{
+	std::mt19937 rng(3);
+	const glm::mat4 viewProj = makeViewProjection();
+	OcclusionBuffer buffer(BUFFER_WIDTH, BUFFER_HEIGHT);
+
+	int wrong = 0, hidden = 0, culled = 0, tested = 0;
+	for (int scene = 0; scene < 20; ++scene)
+	{
+		std::vector<Bounds> occluders;
+		buffer.begin(viewProj);
+		for (int i = 0; i < 12; ++i)
+		{
+			occluders.push_back(randomBox(rng, 15.0f, 30.0f, 3.0f, 12.0f));
+			buffer.addOccluder(occluders.back());
+		}
+		buffer.end();
+
+		for (int i = 0; i < 200; ++i)
+		{
+			const Bounds box = randomBox(rng, 5.0f, 80.0f, 0.2f, 4.0f);
+			const bool visible = isVisibleReference(viewProj, occluders, box);
+			const bool reported = buffer.isVisible(box);
+			tested++;
+			if (!visible) hidden++;
+			if (!reported) culled++;
+			if (visible && !reported) wrong++;
+		}
+	}
+
+	std::printf("%d boxes, %d hidden, %d culled, %d visible ones culled\n", tested, hidden, culled, wrong);
+	TEST_CHECK(wrong == 0);
+	TEST_CHECK(hidden > 0);
+	TEST_CHECK(culled >= hidden / 2);
+}
+
+static void testWithoutOccluders()
+{
+	std::mt19937 rng(5);
+	OcclusionBuffer buffer(BUFFER_WIDTH, BUFFER_HEIGHT);
+	buffer.begin(makeViewProjection());
+	buffer.end();
+	for (int i = 0; i < 100; ++i) {
+		TEST_CHECK(buffer.isVisible(randomBox(rng, 1.0f, 500.0f, 0.1f, 10.0f)));
+	}
+}
+
+static void testFullScreenOccluder()
+{
+	OcclusionBuffer buffer(BUFFER_WIDTH, BUFFER_HEIGHT);
+	buffer.begin(makeViewProjection());
+	buffer.addOccluder(Bounds(glm::vec3(-1000.0f, -1000.0f, -11.0f), glm::vec3(1000.0f, 1000.0f, -10.0f)));
+	buffer.end();
+
+	TEST_CHECK(!buffer.isVisible(Bounds(glm::vec3(-1.0f, -1.0f, -21.0f), glm::vec3(1.0f, 1.0f, -20.0f))));
+	TEST_CHECK(!buffer.isVisible(Bounds(glm::vec3(20.0f, 5.0f, -200.0f), glm::vec3(30.0f, 8.0f, -150.0f))));
+	// in front of the wall, crossing it, and behind the camera
+	TEST_CHECK(buffer.isVisible(Bounds(glm::vec3(-1.0f, -1.0f, -6.0f), glm::vec3(1.0f, 1.0f, -5.0f))));
+	TEST_CHECK(buffer.isVisible(Bounds(glm::vec3(-1.0f, -1.0f, -15.0f), glm::vec3(1.0f, 1.0f, -8.0f))));
+	TEST_CHECK(buffer.isVisible(Bounds(glm::vec3(-1.0f, -1.0f, 5.0f), glm::vec3(1.0f, 1.0f, 6.0f))));
+}
+
+int main()
+{
+	testConservativeAgainstBruteForce();
+	testWithoutOccluders();
+	testFullScreenOccluder();
+
+	return test::result("test_occlusion");
+}
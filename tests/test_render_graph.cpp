@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <string>
+#include "test_common.h"
+#include "vkjs/render_graph.h"
+
+using namespace jvk;
+
+/*
+Execute() records through the vkCmdPipelineBarrier pointer of volk, the test points it to a
+function that logs the barriers between the pass callbacks. No device is created.
+*/
+struct Barrier {
+	VkPipelineStageFlags srcStages;
+	VkPipelineStageFlags dstStages;
+	std::vector<VkImageMemoryBarrier> images;
+	std::vector<VkBufferMemoryBarrier> buffers;
+};
+
+struct Event {
+	std::string pass;	// empty for a barrier
+	Barrier barrier;
+};
+
+static std::vector<Event> s_events;
+
+static void VKAPI_CALL recordBarrier(VkCommandBuffer, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages, VkDependencyFlags,
+	uint32_t, const VkMemoryBarrier*, uint32_t bufferCount, const VkBufferMemoryBarrier* buffers, uint32_t imageCount, const VkImageMemoryBarrier* images)
+{
+	Event e{};
+	e.barrier.srcStages = srcStages;
+	e.barrier.dstStages = dstStages;
+	e.barrier.images.assign(images, images + imageCount);
+	e.barrier.buffers.assign(buffers, buffers + bufferCount);
+	s_events.push_back(e);
+}
+
+static void execute(RenderGraph& graph)
+{
+	s_events.clear();
+	vkCmdPipelineBarrier = recordBarrier;
+	graph.Execute(VK_NULL_HANDLE);
+}
+
+// the barrier recorded right before the pass, nullptr if there is none
+static const Barrier* barrierBefore(const std::string& pass)
+{
+	for (size_t i = 0; i < s_events.size(); ++i)
+	{
+		if (s_events[i].pass == pass) {
+			return (i > 0 && s_events[i - 1].pass.empty()) ? &s_events[i - 1].barrier : nullptr;
+		}
+	}
+	return nullptr;
+}
+
+static RenderGraph::ExecuteFn logPass(const std::string& name)
+{
+	return [name](VkCommandBuffer) { s_events.push_back({ name, {} }); };
+}
+
+template<typename T> static T fakeHandle(uintptr_t value) { return reinterpret_cast<T>(value); }
+
+static RenderGraph::Handle importColorImage(RenderGraph& graph, const std::string& name, uintptr_t handle, const RGAccess& lastAccess = rg::None)
+{
+	VkImageSubresourceRange range{};
+	range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	range.levelCount = 1;
+	range.layerCount = 1;
+	return graph.ImportImage(name, fakeHandle<VkImage>(handle), range, lastAccess);
+}
+
+static std::vector<std::string> scheduledNames(const RenderGraph& graph)
+{
+	std::vector<std::string> names;
+	for (uint32_t p : graph.GetSchedule()) names.push_back(graph.GetPassName(p));
+	return names;
+}
+
+static size_t position(const std::vector<std::string>& names, const std::string& name)
+{
+	return size_t(std::find(names.begin(), names.end(), name) - names.begin());
+}
+
+// passes whose writes reach neither an output nor a side effect pass are dropped, whole chains of them too
+static void testPassCulling()
+{
+	RenderGraph graph;
+	const auto color = importColorImage(graph, "color", 1);
+	const auto unused = importColorImage(graph, "unused", 2);
+	const auto unusedChain = graph.ImportBuffer("unused chain", fakeHandle<VkBuffer>(3));
+	const auto stats = graph.ImportBuffer("stats", fakeHandle<VkBuffer>(4));
+
+	graph.AddPass("overwritten", logPass("overwritten")).Write(color, rg::ColorAttachmentWrite, true);
+	graph.AddPass("unused", logPass("unused")).Write(unused, rg::ComputeShaderWrite);
+	graph.AddPass("unused reader", logPass("unused reader")).Read(unused, rg::ComputeShaderRead).Write(unusedChain, rg::ComputeShaderWrite);
+	graph.AddPass("side effect", logPass("side effect")).Write(stats, rg::ComputeShaderWrite).SideEffect();
+	graph.AddPass("draw", logPass("draw")).Write(color, rg::ColorAttachmentWrite, true);
+	graph.SetOutput(color, rg::Present);
+	graph.Compile();
+
+	const std::vector<std::string> names = scheduledNames(graph);
+	TEST_CHECK(names.size() == 2);
+	TEST_CHECK(position(names, "side effect") < names.size());
+	TEST_CHECK(position(names, "draw") < names.size());
+	TEST_CHECK(graph.GetStats().passCount == 2);
+	TEST_CHECK(graph.GetStats().culledPassCount == 3);
+
+	// a write that keeps part of the old contents keeps the earlier writer alive
+	RenderGraph partial;
+	const auto target = importColorImage(partial, "target", 1);
+	partial.AddPass("clear", logPass("clear")).Write(target, rg::TransferWrite, true);
+	partial.AddPass("blend", logPass("blend")).Write(target, rg::ColorAttachmentWrite);
+	partial.SetOutput(target, rg::FragmentShaderRead);
+	partial.Compile();
+	TEST_CHECK(partial.GetStats().passCount == 2);
+	TEST_CHECK(partial.GetStats().culledPassCount == 0);
+}
+
+// readers run after the writer they read from, a writer after the readers of the previous contents
+static void testDependencyOrder()
+{
+	RenderGraph graph;
+	const auto buffer = graph.ImportBuffer("buffer", fakeHandle<VkBuffer>(1));
+	const auto history = importColorImage(graph, "history", 2, { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL });
+	const auto result = importColorImage(graph, "result", 3);
+
+	graph.AddPass("fill", logPass("fill")).Write(buffer, rg::ComputeShaderWrite);
+	graph.AddPass("use", logPass("use")).Read(buffer, rg::ComputeShaderRead).Read(history, rg::ComputeShaderRead).Write(result, rg::ComputeShaderWrite, true);
+	graph.AddPass("clear history", logPass("clear history")).Write(history, rg::TransferWrite).SideEffect();
+	graph.AddPass("update history", logPass("update history")).Read(result, rg::ComputeShaderRead).Write(history, rg::ComputeShaderWrite, true);
+	graph.SetOutput(history, rg::FragmentShaderRead);
+	graph.Compile();
+
+	const std::vector<std::string> names = scheduledNames(graph);
+	TEST_CHECK(names.size() == 4);
+	// read after write
+	TEST_CHECK(position(names, "fill") < position(names, "use"));
+	TEST_CHECK(position(names, "use") < position(names, "update history"));
+	// write after read: history is read by "use" before it is written again
+	TEST_CHECK(position(names, "clear history") > position(names, "use"));
+	// write after write
+	TEST_CHECK(position(names, "update history") > position(names, "clear history"));
+
+	// a pass that does not wait for the previous one is put between a writer and its reader
+	RenderGraph overlap;
+	const auto a = overlap.ImportBuffer("a", fakeHandle<VkBuffer>(1));
+	const auto b = overlap.ImportBuffer("b", fakeHandle<VkBuffer>(2));
+	overlap.AddPass("write a", logPass("write a")).Write(a, rg::ComputeShaderWrite);
+	overlap.AddPass("read a", logPass("read a")).Read(a, rg::ComputeShaderRead).SideEffect();
+	overlap.AddPass("write b", logPass("write b")).Write(b, rg::ComputeShaderWrite).SideEffect();
+	overlap.Compile();
+	TEST_CHECK(scheduledNames(overlap) == std::vector<std::string>({ "write a", "write b", "read a" }));
+}
+
+// every access of a pass to one resource becomes one use, with a layout all of them accept
+static void testLayoutMerging()
+{
+	RenderGraph graph;
+	const auto image = importColorImage(graph, "image", 1, { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL });
+	const auto other = importColorImage(graph, "other", 2, { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL });
+
+	graph.AddPass("sample", logPass("sample"))
+		.Read(image, rg::FragmentShaderRead)
+		.Read(image, rg::ComputeShaderRead)
+		.Read(other, rg::FragmentShaderRead)
+		.SideEffect();
+	graph.AddPass("read write", logPass("read write"))
+		.Read(image, rg::FragmentShaderRead)
+		.Write(image, rg::ComputeShaderWrite)
+		.SideEffect();
+	graph.Compile();
+	execute(graph);
+
+	// both images are transitioned with one call, the two reads of image are one barrier
+	const Barrier* sample = barrierBefore("sample");
+	TEST_CHECK(sample && sample->images.size() == 2 && sample->buffers.empty());
+	TEST_CHECK(sample && sample->srcStages == VK_PIPELINE_STAGE_TRANSFER_BIT);
+	TEST_CHECK(sample && sample->dstStages == (VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT));
+	for (int i = 0; sample && i < 2; ++i)
+	{
+		TEST_CHECK(sample->images[i].oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		TEST_CHECK(sample->images[i].newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		TEST_CHECK(sample->images[i].srcAccessMask == VK_ACCESS_TRANSFER_WRITE_BIT);
+	}
+
+	// a read only layout and GENERAL meet in GENERAL
+	const Barrier* readWrite = barrierBefore("read write");
+	TEST_CHECK(readWrite && readWrite->images.size() == 1);
+	TEST_CHECK(readWrite && readWrite->images[0].oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	TEST_CHECK(readWrite && readWrite->images[0].newLayout == VK_IMAGE_LAYOUT_GENERAL);
+	TEST_CHECK(readWrite && readWrite->images[0].dstAccessMask == (VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT));
+	TEST_CHECK(graph.GetFinalLayout(image) == VK_IMAGE_LAYOUT_GENERAL);
+	TEST_CHECK(graph.GetFinalLayout(other) == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+// read after read, and reads the last write is already visible to, need no barrier
+static void testRedundantBarrierElision()
+{
+	RenderGraph graph;
+	const auto buffer = graph.ImportBuffer("buffer", fakeHandle<VkBuffer>(1));
+	const auto image = importColorImage(graph, "image", 2);
+
+	graph.AddPass("write", logPass("write")).Write(buffer, rg::ComputeShaderWrite).Write(image, rg::ColorAttachmentWrite, true);
+	graph.AddPass("read 1", logPass("read 1")).Read(buffer, rg::ComputeShaderRead).Read(image, rg::FragmentShaderRead).SideEffect();
+	graph.AddPass("read 2", logPass("read 2")).Read(buffer, rg::ComputeShaderRead).Read(image, rg::FragmentShaderRead).SideEffect();
+	graph.AddPass("read 3", logPass("read 3")).Read(buffer, rg::IndirectRead).SideEffect();
+	graph.Compile();
+	execute(graph);
+
+	// the discarded image starts from UNDEFINED, nothing was written to the buffer before
+	const Barrier* write = barrierBefore("write");
+	TEST_CHECK(write && write->images.size() == 1 && write->buffers.empty());
+	TEST_CHECK(write && write->images[0].oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+	TEST_CHECK(write && write->images[0].newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+	const Barrier* read1 = barrierBefore("read 1");
+	TEST_CHECK(read1 && read1->images.size() == 1 && read1->buffers.size() == 1);
+	TEST_CHECK(read1 && read1->srcStages == (VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT));
+
+	TEST_CHECK(barrierBefore("read 2") == nullptr);
+
+	// a new stage of the same buffer needs the write made visible to it
+	const Barrier* read3 = barrierBefore("read 3");
+	TEST_CHECK(read3 && read3->buffers.size() == 1 && read3->images.empty());
+	TEST_CHECK(read3 && read3->dstStages == VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+	TEST_CHECK(read3 && read3->buffers[0].srcAccessMask == VK_ACCESS_SHADER_WRITE_BIT);
+
+	TEST_CHECK(graph.GetStats().barrierCount == 3);
+	TEST_CHECK(graph.GetStats().imageBarrierCount == 2);
+	TEST_CHECK(graph.GetStats().bufferBarrierCount == 2);
+}
+
+// the render pass transitions its attachments, the graph only waits for the earlier accesses
+static void testAttachment()
+{
+	RenderGraph graph;
+	const auto color = importColorImage(graph, "color", 1);
+	const RGAccess after{ VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	graph.AddPass("render pass", logPass("render pass")).Attachment(color, rg::ColorAttachmentWrite, after);
+	graph.AddPass("post", logPass("post")).Read(color, rg::FragmentShaderRead).SideEffect();
+	graph.Compile();
+	execute(graph);
+
+	const Barrier* renderPass = barrierBefore("render pass");
+	TEST_CHECK(renderPass == nullptr || renderPass->images.empty());
+	TEST_CHECK(barrierBefore("post") == nullptr);
+	TEST_CHECK(graph.GetFinalLayout(color) == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+int main()
+{
+	testPassCulling();
+	testDependencyOrder();
+	testLayoutMerging();
+	testRedundantBarrierElision();
+	testAttachment();
+
+	return jsr::test::result("test_render_graph");
+}
@@ -0,0 +1,151 @@
+#include <fstream>
+#include "test_common.h"
+#include "test_scenes.h"
+#include "scene_cache.h"
+#include "mesh_pack.h"
+
+using namespace jsr;
+namespace fs = std::filesystem;
+
+static const uint32_t VERTEX_STRIDE = sizeof(VertexCompact);
+static const uint32_t INDEX_SIZE = 2;
+
+static fs::path tempPath(const char* name)
+{
+	return fs::temp_directory_path() / name;
+}
+
+// stands in for the glTF the cache was baked from
+static fs::path writeSource(const std::string& contents)
+{
+	const fs::path path = tempPath("test_scene_cache_source.bin");
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out << contents;
+	return path;
+}
+
+static void makeWorld(World& world, uint32_t count)
+{
+	test::makeScatteredWorld(world, count, 50.0f, 8);
+	for (auto& mesh : world.meshes) test::addSphereVertexStreams(mesh);
+	world.materials.resize(1);
+}
+
+// the GPU blobs packed as the renderer does, edit changes them before the write
+static bool writeCache(const fs::path& path, World& world, const std::function<void(SceneCache::GpuBlobs&)>& edit = {})
+{
+	std::vector<PackedMesh> packed;
+	uint32_t vertexCount, indexCount;
+	layoutPackedMeshes(world.meshes, packed, vertexCount, indexCount);
+	std::vector<uint8_t> vertices, indices;
+	// false for the indices past their mesh of a broken world, the blobs have the full size anyway
+	packMeshes(world.meshes, packed, VERTEX_FORMAT_COMPACT, INDEX_SIZE, vertices, indices);
+	SceneCache::GpuBlobs blobs{};
+	blobs.vertices = vertices.data();
+	blobs.vertexBytes = vertices.size();
+	blobs.vertexStride = VERTEX_STRIDE;
+	blobs.indices = indices.data();
+	blobs.indexBytes = indices.size();
+	blobs.indexSize = INDEX_SIZE;
+	if (edit) edit(blobs);
+
+	return SceneCache::write(path, { writeSource("source") }, world, blobs);
+}
+
+static bool loadCache(const fs::path& path, World& world)
+{
+	SceneCache cache;
+	return cache.open(path, VERTEX_STRIDE, INDEX_SIZE) && cache.load(world);
+}
+
+// what goes in comes back, the mesh BVHs too
+static void testRoundTrip()
+{
+	const fs::path path = tempPath("test_scene_cache.jsc");
+	World world;
+	makeWorld(world, 20);
+	TEST_CHECK(writeCache(path, world));
+
+	World loaded;
+	TEST_CHECK(loadCache(path, loaded));
+	TEST_CHECK(loaded.meshes.size() == world.meshes.size());
+	TEST_CHECK(loaded.scene.nodes.size() == world.scene.nodes.size());
+	for (size_t i = 0; i < std::min(loaded.meshes.size(), world.meshes.size()); ++i)
+	{
+		TEST_CHECK(loaded.meshes[i].indices == world.meshes[i].indices);
+		TEST_CHECK(loaded.meshes[i].positions == world.meshes[i].positions);
+		TEST_CHECK(loaded.meshes[i].uvs == world.meshes[i].uvs);
+	}
+	TEST_CHECK(loaded.getMeshBVH().size() == world.getMeshBVH().size());
+
+	world.updateBVH();
+	loaded.updateBVH();
+	RayHit expected, actual;
+	const bool hit = world.Raycast(glm::vec3(0.0f, 0.0f, 100.0f), glm::vec3(0.0f, 0.0f, -1.0f), 200.0f, expected);
+	TEST_CHECK(loaded.Raycast(glm::vec3(0.0f, 0.0f, 100.0f), glm::vec3(0.0f, 0.0f, -1.0f), 200.0f, actual) == hit);
+	TEST_CHECK(actual.t == expected.t && actual.triangle == expected.triangle);
+
+	// another size of the source
+	writeSource("changed source");
+	SceneCache cache;
+	TEST_CHECK(!cache.open(path, VERTEX_STRIDE, INDEX_SIZE));
+	fs::remove(path);
+}
+
+/*
+The writer stores whatever the world holds, so a broken world gives a cache that is well formed
+but points out of its arrays. load() has to refuse it before the renderer or Raycast reads it.
+*/
+static void testCorruptPayloadIsRejected()
+{
+	const fs::path path = tempPath("test_scene_cache_corrupt.jsc");
+	auto rejects = [&path](const std::function<void(World&)>& corrupt, const std::function<void(SceneCache::GpuBlobs&)>& editBlobs = {})
+		{
+			World world;
+			makeWorld(world, 4);
+			world.updateMeshBVH();
+			corrupt(world);
+			if (!writeCache(path, world, editBlobs)) return false;
+			World loaded;
+			const bool result = !loadCache(path, loaded);
+			fs::remove(path);
+			return result;
+		};
+	auto editBVH = [](World& world, const std::function<void(MeshBVH&)>& edit)
+		{
+			std::vector<MeshBVH> bvh = world.getMeshBVH();
+			edit(bvh[1]);
+			world.setMeshBVH(std::move(bvh));
+		};
+
+	TEST_CHECK(!rejects([](World&) {}));
+	// mesh indices
+	TEST_CHECK(rejects([](World& world) { world.meshes[2].indices[5] = uint32_t(world.meshes[2].positions.size() / 12); }));
+	TEST_CHECK(rejects([](World& world) { world.meshes[2].indices.pop_back(); }));
+	TEST_CHECK(rejects([](World& world) { world.meshes[0].meshletVertices.push_back(1000000); }));
+	// nodes
+	TEST_CHECK(rejects([](World& world) { world.scene.nodes[1].setChildren({ 17 }); }));
+	TEST_CHECK(rejects([](World& world) { world.scene.nodes[1].setEntity({ 4 }); }));
+	TEST_CHECK(rejects([](World& world) { world.scene.rootNodes.push_back(4); }));
+	TEST_CHECK(rejects([](World& world) { world.scene.nodes[2].nodeType = EntityType(EntityType_Empty + 1); }));
+	TEST_CHECK(rejects([](World& world) { world.scene.nodes[2].nodeType = EntityType(-1); }));
+	// GPU blobs shorter than the mesh table, or of another layout
+	TEST_CHECK(rejects([](World&) {}, [](SceneCache::GpuBlobs& blobs) { blobs.vertexBytes -= VERTEX_STRIDE; }));
+	TEST_CHECK(rejects([](World&) {}, [](SceneCache::GpuBlobs& blobs) { blobs.indexBytes -= 3 * INDEX_SIZE; }));
+	TEST_CHECK(rejects([](World& world) { world.meshes[3].lods.resize(MAX_MESH_LODS); }));
+	// mesh BVHs
+	TEST_CHECK(rejects([&](World& world) { editBVH(world, [](MeshBVH& bvh) { bvh.nodes[0].leftFirst = 0; }); }));
+	TEST_CHECK(rejects([&](World& world) { editBVH(world, [](MeshBVH& bvh) { bvh.nodes[0].leftFirst = uint32_t(bvh.nodes.size()) - 1; }); }));
+	TEST_CHECK(rejects([&](World& world) { editBVH(world, [](MeshBVH& bvh) { bvh.nodes.back().primCount = uint32_t(bvh.triangles.size()) + 1; }); }));
+	TEST_CHECK(rejects([&](World& world) { editBVH(world, [](MeshBVH& bvh) { bvh.indices[7] = 100000; }); }));
+	TEST_CHECK(rejects([&](World& world) { editBVH(world, [](MeshBVH& bvh) { bvh.triangles[3] = uint32_t(bvh.triangles.size()); }); }));
+	TEST_CHECK(rejects([&](World& world) { editBVH(world, [](MeshBVH& bvh) { bvh.indices.pop_back(); }); }));
+}
+
+int main()
+{
+	testRoundTrip();
+	testCorruptPayloadIsRejected();
+
+	return test::result("test_scene_cache");
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <random>
+#include <cstring>
+#include "world.h"
+
+namespace jsr {
+	namespace test {
+
+		// UV sphere of radius 1 around the origin, 2 * segments * (segments - 1) triangles
+		inline MeshData makeSphereMesh(uint32_t segments)
+		{
+			std::vector<glm::vec3> positions;
+			for (uint32_t ring = 0; ring <= segments; ++ring)
+			{
+				const float theta = glm::pi<float>() * float(ring) / float(segments);
+				for (uint32_t i = 0; i <= segments; ++i)
+				{
+					const float phi = 2.0f * glm::pi<float>() * float(i) / float(segments);
+					positions.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+				}
+			}
+
+			MeshData md{};
+			const uint32_t row = segments + 1;
+			for (uint32_t ring = 0; ring < segments; ++ring)
+			{
+				for (uint32_t i = 0; i < segments; ++i)
+				{
+					const uint32_t a = ring * row + i, b = a + 1, c = a + row, d = c + 1;
+					if (ring > 0) md.indices.insert(md.indices.end(), { a, c, b });
+					if (ring + 1 < segments) md.indices.insert(md.indices.end(), { b, c, d });
+				}
+			}
+			md.positions.resize(positions.size() * sizeof(glm::vec3));
+			memcpy(md.positions.data(), positions.data(), md.positions.size());
+			md.aabb = Bounds(glm::vec3(-1.0f), glm::vec3(1.0f));
+			md.material = 0;
+			return md;
+		}
+
+		// the normal, tangent and uv streams the glTF loader always fills, for a mesh made by makeSphereMesh
+		inline void addSphereVertexStreams(MeshData& md)
+		{
+			const size_t vertexCount = md.positions.size() / sizeof(glm::vec3);
+			const glm::vec3* positions = reinterpret_cast<const glm::vec3*>(md.positions.data());
+			std::vector<glm::vec3> normals(positions, positions + vertexCount);
+			std::vector<glm::vec4> tangents(vertexCount);
+			std::vector<glm::vec2> uvs(vertexCount);
+			for (size_t i = 0; i < vertexCount; ++i)
+			{
+				const glm::vec3& p = positions[i];
+				tangents[i] = glm::vec4(glm::normalize(glm::vec3(-p.z, 0.0f, p.x) + glm::vec3(1e-6f, 0.0f, 0.0f)), 1.0f);
+				uvs[i] = glm::vec2(0.5f + std::atan2(p.z, p.x) / glm::two_pi<float>(), std::acos(glm::clamp(p.y, -1.0f, 1.0f)) / glm::pi<float>());
+			}
+			md.normals.resize(vertexCount * sizeof(glm::vec3));
+			memcpy(md.normals.data(), normals.data(), md.normals.size());
+			md.tangents.resize(vertexCount * sizeof(glm::vec4));
+			memcpy(md.tangents.data(), tangents.data(), md.tangents.size());
+			md.uvs.resize(vertexCount * sizeof(glm::vec2));
+			memcpy(md.uvs.data(), uvs.data(), md.uvs.size());
+		}
+
+		/*
+		count spheres scattered in a cube of the given size, each node has its own mesh so
+		the mesh index identifies the node. updateBVH() is left to the caller.
+		*/
+		inline void makeScatteredWorld(World& world, uint32_t count, float size, uint32_t segments, uint32_t seed = 1)
+		{
+			std::mt19937 rng(seed);
+			std::uniform_real_distribution<float> pos(-0.5f * size, 0.5f * size);
+			std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+			const MeshData sphere = makeSphereMesh(segments);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				world.meshes.push_back(sphere);
+
+				Node3d node;
+				node.nodeType = EntityType_Mesh;
+				node.addEntity(int(i));
+				node.setPosition(glm::vec3(pos(rng), pos(rng), pos(rng)));
+				node.setScale(glm::vec3(scale(rng)));
+				node.setNeedToUpdate(true);
+				const int idx = world.add(node);
+				world.scene.entities[EntityType_Mesh].push_back(idx);
+				world.addUpdatableNode(idx);
+			}
+			world.update();
+		}
+
+		// view-projection of a camera at eye looking at target, 60 degree fov
+		inline glm::mat4 makeViewProjection(const glm::vec3& eye, const glm::vec3& target, float zFar = 1000.0f)
+		{
+			return glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, zFar) * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+		}
+	}
+}
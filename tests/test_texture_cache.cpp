@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cstring>
+#include "test_common.h"
+#include "vkjs/vkjs.h"
+#include "texture_cache.h"
+
+using namespace jsr;
+namespace fs = std::filesystem;
+
+static const uint32_t TEXTURE_SIZE = 16;
+static const uint32_t TRANSCODE_FORMAT = 6;		// any ktx_transcode_fmt_e, the cache only compares it
+
+static fs::path tempPath(const char* name)
+{
+	return fs::temp_directory_path() / name;
+}
+
+// stands in for the Basis file the entry was transcoded from
+static fs::path writeSource(const std::string& contents)
+{
+	const fs::path path = tempPath("test_texture_cache_source.ktx2");
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out << contents;
+	return path;
+}
+
+// RGBA8 with a full mip chain, every texel different
+static ktxTexture2* makeTexture()
+{
+	ktxTextureCreateInfo info{};
+	info.vkFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	info.baseWidth = TEXTURE_SIZE;
+	info.baseHeight = TEXTURE_SIZE;
+	info.baseDepth = 1;
+	info.numDimensions = 2;
+	info.numLevels = 5;
+	info.numLayers = 1;
+	info.numFaces = 1;
+	info.isArray = KTX_FALSE;
+	info.generateMipmaps = KTX_FALSE;
+	ktxTexture2* texture;
+	if (ktxTexture2_Create(&info, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &texture) != KTX_SUCCESS) return nullptr;
+
+	for (uint32_t l = 0, size = TEXTURE_SIZE; l < info.numLevels; ++l, size /= 2)
+	{
+		std::vector<uint8_t> level(size_t(size) * size * 4);
+		for (size_t i = 0; i < level.size(); ++i) level[i] = uint8_t(i * 7 + l);
+		ktxTexture_SetImageFromMemory(ktxTexture(texture), l, 0, 0, level.data(), level.size());
+	}
+	return texture;
+}
+
+static bool writeEntry(const fs::path& directory, const fs::path& source)
+{
+	ktxTexture2* texture = makeTexture();
+	if (!texture) return false;
+	const bool ok = TextureCache(directory).write(source, TRANSCODE_FORMAT, texture);
+	ktxTexture_Destroy(ktxTexture(texture));
+	return ok;
+}
+
+static fs::path findEntry(const fs::path& directory)
+{
+	for (const auto& it : fs::directory_iterator(directory))
+	{
+		if (it.path().extension() == ".ktx2") return it.path();
+	}
+	return {};
+}
+
+static std::vector<uint8_t> readFile(const fs::path& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// keeps the size and the modification time, as an edit in place on a file system of coarse times would
+static void writeFileInPlace(const fs::path& path, const std::vector<uint8_t>& data)
+{
+	const auto time = fs::last_write_time(path);
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(data.data()), data.size());
+	}
+	fs::last_write_time(path, time);
+}
+
+// the level data of an entry is written after the header, the level index and the key/value data
+static void flipDataByte(std::vector<uint8_t>& data)
+{
+	uint64_t level0;
+	memcpy(&level0, data.data() + 80, sizeof(level0));
+	data[size_t(level0) + 10] ^= 0x40;
+}
+
+static void testIntactEntryHits()
+{
+	const fs::path directory = tempPath("test_texture_cache");
+	std::error_code ec;
+	fs::remove_all(directory, ec);
+	const fs::path source = writeSource("source");
+	TEST_CHECK(writeEntry(directory, source));
+
+	ktxTexture2* texture = makeTexture();
+	TextureCache cache(directory);
+	CachedTexture entry;
+	TEST_CHECK(cache.open(source, TRANSCODE_FORMAT, entry));
+	TEST_CHECK(cache.getStats().hits == 1 && cache.getStats().rejected == 0);
+	TEST_CHECK(entry.getFormat() == VK_FORMAT_R8G8B8A8_UNORM && entry.getWidth() == TEXTURE_SIZE && entry.getHeight() == TEXTURE_SIZE);
+	TEST_CHECK(entry.getLevelCount() == texture->numLevels);
+	for (uint32_t l = 0; l < entry.getLevelCount() && l < texture->numLevels; ++l)
+	{
+		ktx_size_t offset = 0;
+		ktxTexture_GetImageOffset(ktxTexture(texture), l, 0, 0, &offset);
+		TEST_CHECK(entry.getLevelSize(l) == ktxTexture_GetImageSize(ktxTexture(texture), l));
+		TEST_CHECK(memcmp(entry.getLevel(l), ktxTexture_GetData(ktxTexture(texture)) + offset, entry.getLevelSize(l)) == 0);
+	}
+	ktxTexture_Destroy(ktxTexture(texture));
+}
+
+/*
+Each case writes an entry with one cache, changes it and opens it with a new one, as the next run of the
+renderer would: the open fails and counts one rejected entry.
+*/
+static void testCorruptEntryIsRejected()
+{
+	const fs::path directory = tempPath("test_texture_cache");
+	auto rejects = [&directory](bool verifyData, const std::function<void(const fs::path& entry)>& corrupt)
+		{
+			std::error_code ec;
+			fs::remove_all(directory, ec);
+			const fs::path source = writeSource("source");
+			if (!writeEntry(directory, source)) return false;
+			corrupt(findEntry(directory));
+			TextureCache cache(directory, verifyData);
+			CachedTexture entry;
+			return !cache.open(source, TRANSCODE_FORMAT, entry) && cache.getStats().rejected == 1 && cache.getStats().hits == 0;
+		};
+
+	TEST_CHECK(!rejects(false, [](const fs::path&) {}));
+	// a data byte, the edit changes the modification time
+	TEST_CHECK(rejects(false, [](const fs::path& entry)
+		{
+			std::vector<uint8_t> data = readFile(entry);
+			flipDataByte(data);
+			const auto time = fs::last_write_time(entry);
+			writeFileInPlace(entry, data);
+			fs::last_write_time(entry, time + std::chrono::seconds(1));
+		}));
+	// the same at the same size and time is only found by checking every open
+	TEST_CHECK(rejects(true, [](const fs::path& entry)
+		{
+			std::vector<uint8_t> data = readFile(entry);
+			flipDataByte(data);
+			writeFileInPlace(entry, data);
+		}));
+	TEST_CHECK(rejects(false, [](const fs::path& entry) { fs::resize_file(entry, fs::file_size(entry) - 5); }));
+	TEST_CHECK(rejects(false, [](const fs::path& entry) { fs::resize_file(entry, 100); }));
+	// the transcode format of the tag
+	TEST_CHECK(rejects(false, [](const fs::path& entry)
+		{
+			std::vector<uint8_t> data = readFile(entry);
+			const char key[] = "JSRtextureCache";
+			auto it = std::search(data.begin(), data.end(), key, key + sizeof(key));
+			if (it != data.end()) it[sizeof(key) + sizeof(uint32_t)] ^= 1;
+			writeFileInPlace(entry, data);
+		}));
+	// the source changes, its entry for the old contents is stale
+	TEST_CHECK(rejects(false, [](const fs::path&) { writeSource("changed source"); }));
+	TEST_CHECK(!fs::exists(findEntry(directory)));
+}
+
+int main()
+{
+	testIntactEntryHits();
+	testCorruptEntryIsRejected();
+
+	return test::result("test_texture_cache");
+}
@@ -0,0 +1,167 @@
+#include "test_common.h"
+#include "texture_streamer_mock.h"
+
+using namespace jsr;
+
+static const uint32_t TEXTURE_COUNT = 8;
+static const uint32_t TEXTURE_SIZE = 1024;
+
+struct Fixture {
+	MockTextureStreamBackend backend;
+	TextureStreamer streamer;
+	int budgetErrors = 0;
+	int pendingErrors = 0;
+	int residencyErrors = 0;
+
+	Fixture(size_t budget, uint32_t maxPendingLoads) : streamer(backend, budget, maxPendingLoads)
+	{
+		for (uint32_t i = 0; i < TEXTURE_COUNT; ++i)
+		{
+			backend.addTexture(TEXTURE_SIZE, TEXTURE_SIZE);
+			streamer.addTexture();
+		}
+		streamer.loadMipTails();
+	}
+
+	// texture i is wanted at full size, the higher i the more
+	void frame(uint32_t requested = TEXTURE_COUNT)
+	{
+		for (uint32_t i = 0; i < requested; ++i) streamer.requestTexture(i, float(TEXTURE_SIZE + i));
+		streamer.update();
+		pendingErrors += streamer.getStats().pendingLoads > MAX_PENDING ? 1 : 0;
+		streamer.flush();
+		residencyErrors += streamer.getStats().residentBytes != backend.getResidentBytes() ? 1 : 0;
+		for (uint32_t i = 0; i < TEXTURE_COUNT; ++i) residencyErrors += streamer.getResidentLevel(i) != backend.getResidentLevel(i) ? 1 : 0;
+	}
+
+	void run(int frames, uint32_t requested = TEXTURE_COUNT)
+	{
+		for (int i = 0; i < frames; ++i)
+		{
+			frame(requested);
+			budgetErrors += streamer.getStats().residentBytes > streamer.getBudget() ? 1 : 0;
+		}
+	}
+
+	static const uint32_t MAX_PENDING = 2;
+};
+
+static size_t fullBytes()
+{
+	size_t bytes = 0;
+	for (uint32_t size = TEXTURE_SIZE; size > 0; size /= 2) bytes += size_t(size) * size * 4;
+	return bytes;
+}
+
+// the tails of every texture up front, 64x64 and below
+static void testMipTails()
+{
+	Fixture f(0, Fixture::MAX_PENDING);
+	TEST_CHECK(f.streamer.getStats().streamedTextures == TEXTURE_COUNT);
+	for (uint32_t i = 0; i < TEXTURE_COUNT; ++i) TEST_CHECK(f.streamer.getResidentLevel(i) == 4);
+
+	// no budget beyond them, nothing else is loaded
+	f.run(5);
+	TEST_CHECK(f.backend.getLoadCount() == TEXTURE_COUNT);
+	TEST_CHECK(f.residencyErrors == 0);
+}
+
+// the budget is never exceeded while growing, the most wanted textures get the finest levels
+static void testBudgetAndPriority()
+{
+	const size_t budget = 3 * fullBytes();
+	Fixture f(budget, Fixture::MAX_PENDING);
+	f.run(40);
+
+	TEST_CHECK(f.budgetErrors == 0);
+	TEST_CHECK(f.pendingErrors == 0);
+	TEST_CHECK(f.residencyErrors == 0);
+	// three of them fit minus the tails of the others
+	TEST_CHECK(f.streamer.getResidentLevel(7) == 0);
+	TEST_CHECK(f.streamer.getResidentLevel(6) == 0);
+	TEST_CHECK(f.streamer.getResidentLevel(0) > 0);
+	for (uint32_t i = 1; i < TEXTURE_COUNT; ++i)
+	{
+		TEST_CHECK(f.streamer.getResidentLevel(i) <= f.streamer.getResidentLevel(i - 1));
+		TEST_CHECK(f.streamer.getResidentLevel(i) == f.streamer.getTargetLevel(i));
+	}
+	TEST_CHECK(f.streamer.getStats().residentBytes > budget / 2);
+}
+
+// a smaller budget shrinks the least wanted textures first, as many at once as loads are allowed
+static void testEvictionOrder()
+{
+	Fixture f(TEXTURE_COUNT * fullBytes(), Fixture::MAX_PENDING);
+	f.run(40);
+	for (uint32_t i = 0; i < TEXTURE_COUNT; ++i) TEST_CHECK(f.streamer.getResidentLevel(i) == 0);
+
+	const size_t mark = f.backend.getHistory().size();
+	f.streamer.setBudget(2 * fullBytes());
+	f.frame();
+	f.frame();
+	// the two least wanted in the first frame, the next two in the second
+	const auto& history = f.backend.getHistory();
+	TEST_CHECK(history.size() == mark + 4);
+	if (history.size() == mark + 4)
+	{
+		TEST_CHECK(std::min(history[mark].texture, history[mark + 1].texture) == 0);
+		TEST_CHECK(std::max(history[mark].texture, history[mark + 1].texture) == 1);
+		TEST_CHECK(std::min(history[mark + 2].texture, history[mark + 3].texture) == 2);
+		TEST_CHECK(std::max(history[mark + 2].texture, history[mark + 3].texture) == 3);
+	}
+
+	f.run(10);
+	TEST_CHECK(f.streamer.getStats().residentBytes <= 2 * fullBytes());
+	TEST_CHECK(f.streamer.getResidentLevel(7) == 0);
+	TEST_CHECK(f.streamer.getResidentLevel(0) > 0);
+	TEST_CHECK(f.pendingErrors == 0);
+	TEST_CHECK(f.residencyErrors == 0);
+}
+
+// a texture not requested for REQUEST_FRAMES falls back to its tail and leaves room to the others
+static void testStaleRequests()
+{
+	Fixture f(3 * fullBytes(), Fixture::MAX_PENDING);
+	f.run(40);
+	TEST_CHECK(f.streamer.getResidentLevel(7) == 0);
+
+	f.run(TextureStreamer::REQUEST_FRAMES + 10, TEXTURE_COUNT - 1);
+	TEST_CHECK(f.streamer.getResidentLevel(7) == 4);
+	TEST_CHECK(f.streamer.getResidentLevel(5) == 0);
+	TEST_CHECK(f.budgetErrors == 0);
+}
+
+/*
+Every load finer than the tail of one texture fails: it is retried after RETRY_FRAMES and then after twice
+as many, not every frame, and keeps its tail meanwhile. The others are streamed as usual, and once the
+loads succeed again the texture gets its levels at the next retry.
+*/
+static void testFailedLoadsBackOff()
+{
+	Fixture f(TEXTURE_COUNT * fullBytes(), Fixture::MAX_PENDING);
+	f.backend.setFailingLevels(7, 4);
+	f.run(2 * TextureStreamer::RETRY_FRAMES + 10);
+	TEST_CHECK(f.backend.getFailedLoadCount() == 2);
+	TEST_CHECK(f.streamer.getStats().failedLoads == 2);
+	TEST_CHECK(f.streamer.isStreamed(7) && f.streamer.getResidentLevel(7) == 4);
+	for (uint32_t i = 0; i + 1 < TEXTURE_COUNT; ++i) TEST_CHECK(f.streamer.getResidentLevel(i) == 0);
+	TEST_CHECK(f.residencyErrors == 0);
+	TEST_CHECK(f.budgetErrors == 0);
+
+	f.backend.setFailingLevels(7, 0);
+	f.run(2 * TextureStreamer::RETRY_FRAMES + 10);
+	TEST_CHECK(f.backend.getFailedLoadCount() == 2);
+	TEST_CHECK(f.streamer.getResidentLevel(7) == 0);
+	TEST_CHECK(f.residencyErrors == 0);
+}
+
+int main()
+{
+	testMipTails();
+	testBudgetAndPriority();
+	testEvictionOrder();
+	testStaleRequests();
+	testFailedLoadsBackOff();
+
+	return test::result("test_texture_streamer");
+}
@@ -0,0 +1,184 @@
+#include <random>
+#include <algorithm>
+#include "test_common.h"
+#include "vkjs/transient_allocator.h"
+
+using namespace jvk;
+
+// the rules of a valid packing, returns the number of broken ones
+static int checkPacking(const std::vector<TransientRequest>& requests, const std::vector<TransientPlacement>& placements, const std::vector<TransientHeap>& heaps)
+{
+	int errors = 0;
+	if (placements.size() != requests.size()) return 1;
+
+	for (size_t i = 0; i < requests.size(); ++i)
+	{
+		const TransientRequest& r = requests[i];
+		const TransientPlacement& p = placements[i];
+		if (p.heap >= heaps.size()) {
+			errors++;
+			continue;
+		}
+		const TransientHeap& heap = heaps[p.heap];
+		if (p.offset % r.alignment != 0) errors++;
+		if (p.offset + r.size > heap.size) errors++;
+		if (heap.lazy != r.lazy) errors++;
+		// the memory of the heap can back every request in it
+		if (heap.memoryTypeBits == 0 || (heap.memoryTypeBits & ~r.memoryTypeBits) != 0) errors++;
+		if (heap.alignment % r.alignment != 0) errors++;
+
+		for (size_t j = 0; j < i; ++j)
+		{
+			const TransientRequest& o = requests[j];
+			const TransientPlacement& q = placements[j];
+			const bool aliveTogether = o.firstPass <= r.lastPass && r.firstPass <= o.lastPass;
+			const bool sharedBytes = q.heap == p.heap && q.offset < p.offset + r.size && p.offset < q.offset + o.size;
+			if (aliveTogether && sharedBytes) errors++;
+		}
+	}
+	return errors;
+}
+
+static VkDeviceSize totalSize(const std::vector<TransientHeap>& heaps)
+{
+	VkDeviceSize size = 0;
+	for (const auto& heap : heaps) size += heap.size;
+	return size;
+}
+
+// targets used one after the other share one block as big as the biggest of them
+static void testDisjointLifetimes()
+{
+	const std::vector<TransientRequest> requests = {
+		{ 1000, 256, 0x3, 0, 1, false },
+		{ 3000, 256, 0x3, 2, 3, false },
+		{ 2000, 256, 0x3, 4, 4, false },
+	};
+	std::vector<TransientPlacement> placements;
+	std::vector<TransientHeap> heaps;
+	pack_transient_lifetimes(requests, placements, heaps);
+
+	TEST_CHECK(checkPacking(requests, placements, heaps) == 0);
+	TEST_CHECK(heaps.size() == 1);
+	TEST_CHECK(totalSize(heaps) == 3000);
+	for (const auto& p : placements) TEST_CHECK(p.offset == 0);
+}
+
+// targets alive in the same pass get their own bytes, the heap is their sum with the alignment gaps
+static void testOverlappingLifetimes()
+{
+	const std::vector<TransientRequest> requests = {
+		{ 1024, 256, 0x1, 0, 2, false },
+		{ 3072, 256, 0x1, 1, 3, false },
+		{ 100, 4096, 0x1, 2, 2, false },
+	};
+	std::vector<TransientPlacement> placements;
+	std::vector<TransientHeap> heaps;
+	pack_transient_lifetimes(requests, placements, heaps);
+
+	TEST_CHECK(checkPacking(requests, placements, heaps) == 0);
+	TEST_CHECK(heaps.size() == 1);
+	// the biggest first at 0, the last one at the next 4096 boundary
+	TEST_CHECK(placements[1].offset == 0);
+	TEST_CHECK(placements[0].offset == 3072);
+	TEST_CHECK(placements[2].offset == 4096);
+	TEST_CHECK(heaps[0].size == 4196);
+	TEST_CHECK(heaps[0].alignment == 4096);
+}
+
+// a request goes into a gap between two others if it fits there aligned
+static void testGapReuse()
+{
+	const std::vector<TransientRequest> requests = {
+		{ 4096, 1024, 0x1, 0, 3, false },
+		{ 4096, 1024, 0x1, 0, 0, false },
+		{ 2048, 1024, 0x1, 0, 3, false },
+		{ 3072, 1024, 0x1, 1, 3, false },
+	};
+	std::vector<TransientPlacement> placements;
+	std::vector<TransientHeap> heaps;
+	pack_transient_lifetimes(requests, placements, heaps);
+
+	TEST_CHECK(checkPacking(requests, placements, heaps) == 0);
+	TEST_CHECK(heaps.size() == 1);
+	// [0,4096) [4096,8192) [8192,10240), the last one fits where the second one was
+	TEST_CHECK(placements[3].offset == 4096);
+	TEST_CHECK(heaps[0].size == 10240);
+}
+
+// growing a heap by more than the request because of the alignment costs more than a new heap
+static void testAlignmentPadding()
+{
+	const std::vector<TransientRequest> requests = {
+		{ 3000, 256, 0x1, 0, 1, false },
+		{ 1000, 256, 0x1, 1, 2, false },
+	};
+	std::vector<TransientPlacement> placements;
+	std::vector<TransientHeap> heaps;
+	pack_transient_lifetimes(requests, placements, heaps);
+
+	TEST_CHECK(checkPacking(requests, placements, heaps) == 0);
+	TEST_CHECK(heaps.size() == 2);
+	TEST_CHECK(totalSize(heaps) == 4000);
+}
+
+// no shared memory type or a different lazy flag means another heap
+static void testIncompatibleHeaps()
+{
+	const std::vector<TransientRequest> requests = {
+		{ 1000, 256, 0x1, 0, 0, false },
+		{ 1000, 256, 0x2, 1, 1, false },
+		{ 1000, 256, 0x3, 2, 2, true },
+		{ 1000, 256, 0x6, 3, 3, false },
+	};
+	std::vector<TransientPlacement> placements;
+	std::vector<TransientHeap> heaps;
+	pack_transient_lifetimes(requests, placements, heaps);
+
+	TEST_CHECK(checkPacking(requests, placements, heaps) == 0);
+	TEST_CHECK(heaps.size() == 3);
+	TEST_CHECK(placements[0].heap != placements[1].heap);
+	TEST_CHECK(placements[2].heap != placements[0].heap && placements[2].heap != placements[1].heap);
+	TEST_CHECK(placements[3].heap == placements[1].heap);
+	TEST_CHECK(heaps[placements[1].heap].memoryTypeBits == 0x2);
+}
+
+// random frames: always valid, never bigger than without aliasing
+static void testRandomFrames()
+{
+	std::mt19937 rng(9);
+	std::uniform_int_distribution<int> count(1, 40), pass(0, 15), sizeKb(1, 4096), alignShift(8, 16), types(1, 7), lazy(0, 5);
+	int errors = 0, larger = 0;
+	for (int frame = 0; frame < 500; ++frame)
+	{
+		std::vector<TransientRequest> requests(count(rng));
+		VkDeviceSize sum = 0;
+		for (auto& r : requests)
+		{
+			const int a = pass(rng), b = pass(rng);
+			r = { VkDeviceSize(sizeKb(rng)) * 1024 - 100, VkDeviceSize(1) << alignShift(rng), uint32_t(types(rng)),
+				uint32_t(std::min(a, b)), uint32_t(std::max(a, b)), lazy(rng) == 0 };
+			sum += r.size + r.alignment;
+		}
+
+		std::vector<TransientPlacement> placements;
+		std::vector<TransientHeap> heaps;
+		pack_transient_lifetimes(requests, placements, heaps);
+		errors += checkPacking(requests, placements, heaps);
+		larger += totalSize(heaps) > sum ? 1 : 0;
+	}
+	TEST_CHECK(errors == 0);
+	TEST_CHECK(larger == 0);
+}
+
+int main()
+{
+	testDisjointLifetimes();
+	testOverlappingLifetimes();
+	testGapReuse();
+	testAlignmentPadding();
+	testIncompatibleHeaps();
+	testRandomFrames();
+
+	return jsr::test::result("test_transient_allocator");
+}
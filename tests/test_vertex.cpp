@@ -0,0 +1,135 @@
+#include <random>
+#include "test_common.h"
+#include "vertex.h"
+
+using namespace jsr;
+
+// the worst case errors stated at VertexCompact
+static const float POSITION_ERROR = 1.0f / 131070.0f;
+static const float DIRECTION_ERROR_DEGREES = 0.004f;
+static const float UV_ERROR = 1.0f / 2048.0f;
+
+static float angleDegrees(const glm::vec3& a, const glm::vec3& b)
+{
+	return glm::degrees(std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)));
+}
+
+static glm::vec3 randomDirection(std::mt19937& rng)
+{
+	std::normal_distribution<float> gauss;
+	glm::vec3 v;
+	do {
+		v = glm::vec3(gauss(rng), gauss(rng), gauss(rng));
+	} while (glm::length(v) < 1e-3f);
+	return glm::normalize(v);
+}
+
+// per axis, relative to the extent of the bounds, the corners come back exactly
+static void testPosition()
+{
+	const Bounds bounds(glm::vec3(-3.0f, 0.5f, -1000.0f), glm::vec3(5.0f, 0.75f, 250.0f));
+	const glm::vec3 extent = bounds.GetMax() - bounds.GetMin();
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> t(0.0f, 1.0f);
+
+	float maxError = 0.0f;
+	for (int i = 0; i < 100000; ++i)
+	{
+		const glm::vec3 p = bounds.GetMin() + glm::vec3(t(rng), t(rng), t(rng)) * extent;
+		VertexCompact v{};
+		v.set_position(&p[0], bounds);
+		const glm::vec3 error = glm::abs(v.get_position(bounds) - p) / extent;
+		maxError = std::max(maxError, std::max(error.x, std::max(error.y, error.z)));
+	}
+	// the float math of the dequantization adds a few ulps of the extent
+	TEST_CHECK(maxError <= POSITION_ERROR * 1.01f);
+
+	for (const glm::vec3& corner : { bounds.GetMin(), bounds.GetMax() })
+	{
+		VertexCompact v{};
+		v.set_position(&corner[0], bounds);
+		TEST_CHECK(glm::all(glm::lessThanEqual(glm::abs(v.get_position(bounds) - corner), extent * 1e-6f)));
+	}
+
+	// a flat mesh has no extent on an axis, its vertices all decode to the plane
+	const Bounds flat(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1.0f, 2.0f, 1.0f));
+	const glm::vec3 p(0.25f, 2.0f, 0.75f);
+	VertexCompact v{};
+	v.set_position(&p[0], flat);
+	TEST_CHECK(glm::abs(v.get_position(flat).y - 2.0f) == 0.0f);
+}
+
+// random directions and the ones at the folds of the octahedron
+static void testNormalAndTangent()
+{
+	std::vector<glm::vec3> directions = {
+		{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+		glm::normalize(glm::vec3(1, 1, 0)), glm::normalize(glm::vec3(-1, 1, -1e-4f)), glm::normalize(glm::vec3(1, -1, -1)),
+	};
+	std::mt19937 rng(2);
+	for (int i = 0; i < 200000; ++i) directions.push_back(randomDirection(rng));
+
+	float maxNormal = 0.0f, maxTangent = 0.0f;
+	int signErrors = 0;
+	for (size_t i = 0; i < directions.size(); ++i)
+	{
+		const glm::vec3& d = directions[i];
+		const glm::vec4 tangent(d, (i % 2) ? 1.0f : -1.0f);
+		VertexCompact v{};
+		v.pack_normal(&d[0]);
+		v.pack_tangent(&tangent[0]);
+		maxNormal = std::max(maxNormal, angleDegrees(v.get_normal(), d));
+		maxTangent = std::max(maxTangent, angleDegrees(v.get_tangent(), d));
+		// the shader reads position.w as unorm and maps it to -1 or 1
+		const float w = float(v.position[3]) / 65535.0f * 2.0f - 1.0f;
+		signErrors += w == tangent.w ? 0 : 1;
+	}
+	TEST_CHECK(maxNormal <= DIRECTION_ERROR_DEGREES);
+	TEST_CHECK(maxTangent <= DIRECTION_ERROR_DEGREES);
+	TEST_CHECK(signErrors == 0);
+
+	// the degenerate tangent of a mesh without uvs does not turn into NaNs
+	const glm::vec4 zero(0.0f);
+	VertexCompact v{};
+	v.pack_tangent(&zero[0]);
+	TEST_CHECK(!glm::any(glm::isnan(v.get_tangent())));
+}
+
+// relative to the value, and absolute under the smallest normal half where the precision ends
+static void testUv()
+{
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> tiled(-4000.0f, 4000.0f), unit(0.0f, 1.0f);
+
+	int errors = 0;
+	for (int i = 0; i < 100000; ++i)
+	{
+		const glm::vec2 uv = (i % 2) ? glm::vec2(tiled(rng), tiled(rng)) : glm::vec2(unit(rng), unit(rng));
+		VertexCompact v{};
+		v.set_uv(&uv[0]);
+		for (int c = 0; c < 2; ++c)
+		{
+			const float decoded = glm::unpackHalf1x16(v.uv[c]);
+			const float bound = std::max(std::abs(uv[c]) * UV_ERROR, 1.0f / 16777216.0f);
+			errors += std::abs(decoded - uv[c]) <= bound ? 0 : 1;
+		}
+	}
+	TEST_CHECK(errors == 0);
+
+	for (float exact : { 0.0f, 0.5f, 1.0f, -1.0f, 1024.0f })
+	{
+		const glm::vec2 uv(exact);
+		VertexCompact v{};
+		v.set_uv(&uv[0]);
+		TEST_CHECK(glm::unpackHalf1x16(v.uv[0]) == exact);
+	}
+}
+
+int main()
+{
+	testPosition();
+	testNormalAndTangent();
+	testUv();
+
+	return test::result("test_vertex");
+}
@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
+#include "test_common.h"
+#include "test_scenes.h"
+
+using namespace jsr;
+
+static std::vector<int> visibleMeshes(World& world, const glm::mat4& vp)
+{
+	std::vector<int> result;
+	for (const auto& ent : world.getVisibleEntities(Frustum(vp))) {
+		result.push_back(ent.object.meshIndex);
+	}
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+// the BVH walk with plane masking finds the same entities as testing every one of them
+static void testBVHCullingMatchesFlat()
+{
+	World flat, bvh;
+	test::makeScatteredWorld(flat, 2000, 400.0f, 4);
+	test::makeScatteredWorld(bvh, 2000, 400.0f, 4);
+	bvh.updateBVH();
+
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> pos(-300.0f, 300.0f);
+	for (int view = 0; view < 50; ++view)
+	{
+		const glm::mat4 vp = test::makeViewProjection(glm::vec3(pos(rng), pos(rng), pos(rng)), glm::vec3(pos(rng), pos(rng), pos(rng)), 250.0f);
+		// twice, the second frame starts with the planes that rejected the boxes in the first one
+		for (int frame = 0; frame < 2; ++frame)
+		{
+			const std::vector<int> expected = visibleMeshes(flat, vp);
+			const std::vector<int> actual = visibleMeshes(bvh, vp);
+			TEST_CHECK(expected == actual);
+		}
+	}
+}
+
+static void testBVHCullingEdgeCases()
+{
+	World world;
+	test::makeScatteredWorld(world, 500, 100.0f, 4);
+	world.updateBVH();
+
+	// everything in front of a far away camera
+	const std::vector<int> all = visibleMeshes(world, test::makeViewProjection(glm::vec3(0.0f, 0.0f, 500.0f), glm::vec3(0.0f), 2000.0f));
+	TEST_CHECK(all.size() == 500);
+
+	// looking away from the scene
+	const std::vector<int> none = visibleMeshes(world, test::makeViewProjection(glm::vec3(0.0f, 0.0f, 500.0f), glm::vec3(0.0f, 0.0f, 1000.0f), 2000.0f));
+	TEST_CHECK(none.empty());
+
+	World empty;
+	empty.updateBVH();
+	TEST_CHECK(visibleMeshes(empty, test::makeViewProjection(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f))).empty());
+}
+
+// closest hit of every triangle of the scene in world space, in double precision
+/*
+Nodes moved after updateBVH(), some of them out of the cube the tree was built over: update() refits the
+tree, culling matches the flat test and rays find the moved nodes at their new places.
+*/
+static void testBVHRefitAfterMove()
+{
+	World flat, bvh;
+	test::makeScatteredWorld(flat, 2000, 400.0f, 4);
+	test::makeScatteredWorld(bvh, 2000, 400.0f, 4);
+	bvh.updateBVH();
+
+	std::mt19937 rng(9);
+	std::uniform_int_distribution<int> pick(0, 1999);
+	std::uniform_real_distribution<float> pos(-600.0f, 600.0f);
+	for (int round = 0; round < 5; ++round)
+	{
+		std::vector<int> moved;
+		for (int i = 0; i < 100; ++i)
+		{
+			const int node = bvh.scene.entities[EntityType_Mesh][pick(rng)];
+			const glm::vec3 p(pos(rng), pos(rng), pos(rng));
+			for (World* world : { &flat, &bvh })
+			{
+				world->scene.nodes[node].setPosition(p);
+				world->addUpdatableNode(node);
+			}
+			moved.push_back(node);
+		}
+		flat.update();
+		bvh.update();
+
+		for (int view = 0; view < 10; ++view)
+		{
+			const glm::mat4 vp = test::makeViewProjection(glm::vec3(pos(rng), pos(rng), pos(rng)), glm::vec3(pos(rng), pos(rng), pos(rng)), 400.0f);
+			TEST_CHECK(visibleMeshes(flat, vp) == visibleMeshes(bvh, vp));
+		}
+		// straight down onto a moved sphere, from above everything else
+		for (size_t i = 0; i < 10; ++i)
+		{
+			const glm::vec3 center = bvh.scene.nodes[moved[i]].getPosition();
+			RayHit hit;
+			TEST_CHECK(bvh.Raycast(glm::vec3(center.x, 1000.0f, center.z), glm::vec3(0.0f, -1.0f, 0.0f), 2000.0f, hit));
+			TEST_CHECK(hit.hit() && hit.t <= 1000.0f - center.y);
+		}
+	}
+}
+
+static bool raycastReference(const World& world, const glm::dvec3& o, const glm::dvec3& d, double tmax, double& tbest, int& hitNode, int& hitMesh)
+{
+	tbest = tmax;
+	hitNode = hitMesh = -1;
+	for (const int n : world.scene.entities[EntityType_Mesh])
+	{
+		const Node3d& node = world.scene.nodes[n];
+		const glm::dmat4 model(node.getTransform());
+		for (const int e : node.getEntities())
+		{
+			const MeshData& md = world.meshes[e];
+			const float* positions = reinterpret_cast<const float*>(md.positions.data());
+			for (size_t i = 0; i < md.indices.size(); i += 3)
+			{
+				glm::dvec3 v[3];
+				for (int k = 0; k < 3; ++k) {
+					v[k] = glm::dvec3(model * glm::dvec4(glm::dvec3(glm::make_vec3(&positions[md.indices[i + k] * 3])), 1.0));
+				}
+				const glm::dvec3 e1 = v[1] - v[0], e2 = v[2] - v[0];
+				const glm::dvec3 p = glm::cross(d, e2);
+				const double det = glm::dot(e1, p);
+				if (det == 0.0) continue;
+				const glm::dvec3 s = o - v[0];
+				const double u = glm::dot(s, p) / det;
+				const glm::dvec3 q = glm::cross(s, e1);
+				const double w = glm::dot(d, q) / det;
+				const double t = glm::dot(e2, q) / det;
+				if (u >= 0.0 && w >= 0.0 && u + w <= 1.0 && t > 0.0 && t < tbest)
+				{
+					tbest = t;
+					hitNode = n;
+					hitMesh = e;
+				}
+			}
+		}
+	}
+	return tbest < tmax;
+}
+
+// Raycast finds the closest triangle like testing all of them, RaycastN the same as Raycast
+static void testRaycastMatchesBruteForce()
+{
+	World world;
+	test::makeScatteredWorld(world, 200, 100.0f, 8);
+	world.updateBVH();
+
+	// from outside of the scene towards the spheres, about half of the rays hit one
+	std::mt19937 rng(11);
+	std::uniform_real_distribution<float> pos(-50.0f, 50.0f), jitter(-1.5f, 1.5f);
+	std::uniform_int_distribution<size_t> node(0, world.scene.nodes.size() - 1);
+	std::vector<Ray> rays;
+	for (int i = 0; i < 500; ++i)
+	{
+		const glm::vec3 origin = 150.0f * glm::normalize(glm::vec3(pos(rng), pos(rng), pos(rng)));
+		const glm::vec3 target = world.scene.nodes[node(rng)].getPosition() + glm::vec3(jitter(rng), jitter(rng), jitter(rng));
+		rays.push_back({ origin, glm::normalize(target - origin), 1000.0f });
+	}
+
+	int mismatches = 0, hits = 0;
+	std::vector<RayHit> batch(rays.size());
+	world.RaycastN(rays.data(), rays.size(), batch.data());
+	for (size_t i = 0; i < rays.size(); ++i)
+	{
+		RayHit hit;
+		const bool found = world.Raycast(rays[i].origin, rays[i].dir, rays[i].tmax, hit);
+		double t;
+		int node, mesh;
+		const bool expected = raycastReference(world, rays[i].origin, rays[i].dir, rays[i].tmax, t, node, mesh);
+		hits += expected ? 1 : 0;
+		// rays grazing an edge of the silhouette may go either way
+		if (found != expected || (found && (std::abs(hit.t - t) > 1e-3 * t || hit.node != node || hit.mesh != mesh))) mismatches++;
+		TEST_CHECK(batch[i].hit() == found && batch[i].t == hit.t && batch[i].node == hit.node && batch[i].mesh == hit.mesh);
+	}
+	TEST_CHECK(hits > 150);
+	TEST_CHECK(mismatches <= 1);
+}
+
+// the determinant test is relative, a millimeter sized triangle far away is still hit
+static void testRaycastSmallTriangles()
+{
+	for (float scale : { 1e-4f, 1e-2f, 1.0f, 1e3f })
+	{
+		World world;
+		MeshData md{};
+		// in the mesh, the node transform would scale the ray instead
+		const float positions[] = { -scale, -scale, 0.0f, scale, -scale, 0.0f, 0.0f, scale, 0.0f };
+		md.positions.resize(sizeof(positions));
+		memcpy(md.positions.data(), positions, sizeof(positions));
+		md.indices = { 0, 1, 2 };
+		md.aabb = Bounds(glm::vec3(-scale, -scale, 0.0f), glm::vec3(scale, scale, 0.0f));
+		world.meshes.push_back(md);
+
+		Node3d node;
+		node.nodeType = EntityType_Mesh;
+		node.addEntity(0);
+		const int idx = world.add(node);
+		world.scene.entities[EntityType_Mesh].push_back(idx);
+		world.updateBVH();
+
+		RayHit hit;
+		const float distance = 1000.0f * scale;
+		TEST_CHECK(world.Raycast(glm::vec3(0.0f, 0.0f, distance), glm::vec3(0.0f, 0.0f, -1.0f), 2.0f * distance, hit));
+		TEST_CHECK(std::abs(hit.t - distance) <= 1e-4f * distance);
+		// just outside of it
+		TEST_CHECK(!world.Raycast(glm::vec3(1.01f * scale, 0.0f, distance), glm::vec3(0.0f, 0.0f, -1.0f), 2.0f * distance, hit));
+	}
+}
+
+// a precomputed triangle BVH deeper than the traversal stack is walked completely
+static void testRaycastDeepMeshBVH()
+{
+	const uint32_t depth = 100;
+	World world;
+	MeshData md{};
+	std::vector<float> positions;
+	for (uint32_t i = 0; i <= depth; ++i)
+	{
+		const float x = float(i) * 2.0f;
+		positions.insert(positions.end(), { x, 0.0f, 0.0f, x + 1.0f, 0.0f, 0.0f, x, 1.0f, 0.0f });
+		md.indices.insert(md.indices.end(), { i * 3, i * 3 + 1, i * 3 + 2 });
+	}
+	md.positions.resize(positions.size() * sizeof(float));
+	memcpy(md.positions.data(), positions.data(), md.positions.size());
+	md.aabb = Bounds(glm::vec3(0.0f), glm::vec3(depth * 2.0f + 1.0f, 1.0f, 0.0f));
+	world.meshes.push_back(md);
+
+	// every left child is the next inner node, every right child a leaf with one triangle,
+	// the last triangle is at the bottom of the tree
+	MeshBVH bvh;
+	for (uint32_t level = 0; level < depth; ++level)
+	{
+		const Bounds bounds(glm::vec3(level * 2.0f, 0.0f, 0.0f), glm::vec3(depth * 2.0f + 1.0f, 1.0f, 0.0f));
+		bvh.nodes.resize(std::max<size_t>(bvh.nodes.size(), level * 2 + 3));
+		bvh.nodes[level == 0 ? 0 : level * 2 - 1] = { bounds, level * 2 + 1, 0 };
+		bvh.nodes[level * 2 + 2] = { Bounds(glm::vec3(level * 2.0f, 0.0f, 0.0f), glm::vec3(level * 2.0f + 1.0f, 1.0f, 0.0f)), level, 1 };
+	}
+	bvh.nodes[depth * 2 - 1] = { Bounds(glm::vec3(depth * 2.0f, 0.0f, 0.0f), glm::vec3(depth * 2.0f + 1.0f, 1.0f, 0.0f)), depth, 1 };
+	bvh.indices = md.indices;
+	for (uint32_t i = 0; i <= depth; ++i) bvh.triangles.push_back(i);
+	std::vector<MeshBVH> meshBVH;
+	meshBVH.push_back(std::move(bvh));
+	world.setMeshBVH(std::move(meshBVH));
+
+	Node3d node;
+	node.nodeType = EntityType_Mesh;
+	node.addEntity(0);
+	const int idx = world.add(node);
+	world.scene.entities[EntityType_Mesh].push_back(idx);
+	world.updateBVH();
+
+	// along the row of triangles, the farthest is the last one found
+	for (uint32_t target : { 0u, depth / 2, depth })
+	{
+		RayHit hit;
+		TEST_CHECK(world.Raycast(glm::vec3(target * 2.0f + 0.25f, 0.25f, 10.0f), glm::vec3(0.0f, 0.0f, -1.0f), 100.0f, hit));
+		TEST_CHECK(hit.triangle == target);
+	}
+}
+
+int main()
+{
+	testBVHCullingMatchesFlat();
+	testBVHCullingEdgeCases();
+	testBVHRefitAfterMove();
+	testRaycastMatchesBruteForce();
+	testRaycastSmallTriangles();
+	testRaycastDeepMeshBVH();
+
+	return test::result("test_world");
+}
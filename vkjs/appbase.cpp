@@ -148,16 +148,44 @@ namespace jvk
 		}
 		VK_CHECK(vkEndCommandBuffer(cmd));
 
-		VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		std::vector<VkSemaphore> waitSemaphores{ semaphores[currentFrame].present_complete };
+		std::vector<VkPipelineStageFlags> waitStages{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+		std::vector<uint64_t> waitValues{ 0 };		// ignored for binary semaphores
+		for (const auto& it : frame_waits)
+		{
+			waitSemaphores.push_back(it.semaphore);
+			waitStages.push_back(it.stages);
+			waitValues.push_back(it.value);
+		}
+		std::vector<VkSemaphore> signalSemaphores{ semaphores[currentFrame].render_complete };
+		std::vector<uint64_t> signalValues{ 0 };
+		for (const auto& it : frame_signals)
+		{
+			signalSemaphores.push_back(it.semaphore);
+			signalValues.push_back(it.value);
+		}
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.waitSemaphoreValueCount = uint32_t(waitValues.size());
+		timelineInfo.pWaitSemaphoreValues = waitValues.data();
+		timelineInfo.signalSemaphoreValueCount = uint32_t(signalValues.size());
+		timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
 		VkSubmitInfo submit = vks::initializers::submitInfo();
+		submit.pNext = (frame_waits.empty() && frame_signals.empty()) ? nullptr : &timelineInfo;
 		submit.commandBufferCount = 1;
 		submit.pCommandBuffers = &cmd;
-		submit.pSignalSemaphores = &semaphores[currentFrame].render_complete;
-		submit.signalSemaphoreCount = 1;
-		submit.waitSemaphoreCount = 1;
-		submit.pWaitSemaphores = &semaphores[currentFrame].present_complete;
-		submit.pWaitDstStageMask = &stageMask;
-		VK_CHECK(vkQueueSubmit(queue, 1, &submit, wait_fences[currentFrame]));
+		submit.pSignalSemaphores = signalSemaphores.data();
+		submit.signalSemaphoreCount = uint32_t(signalSemaphores.size());
+		submit.waitSemaphoreCount = uint32_t(waitSemaphores.size());
+		submit.pWaitSemaphores = waitSemaphores.data();
+		submit.pWaitDstStageMask = waitStages.data();
+		{
+			std::lock_guard<std::mutex> lck(pDevice->submit_queue_mutex);
+			VK_CHECK(vkQueueSubmit(queue, 1, &submit, wait_fences[currentFrame]));
+		}
+		frame_waits.clear();
+		frame_signals.clear();
 
 		result = swapchain.present_image(queue, currentBuffer, semaphores[currentFrame].render_complete);
 		swapchain_images[currentBuffer].layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
@@ -171,6 +199,14 @@ namespace jvk
 
 		frameCounter++;
 	}
+	void AppBase::add_frame_wait(VkSemaphore timeline, uint64_t value, VkPipelineStageFlags stages)
+	{
+		frame_waits.push_back({ timeline, value, stages });
+	}
+	void AppBase::add_frame_signal(VkSemaphore timeline, uint64_t value)
+	{
+		frame_signals.push_back({ timeline, value, 0 });
+	}
 	void AppBase::create_pipeline_cache()
 	{
 	}
@@ -496,9 +532,12 @@ namespace jvk
 		renderPassInfo.renderPass = imguiRenderPass;
 
 		const auto cmd = drawCmdBuffers[currentFrame];
+		const float color[4] = { .5f, .5f, 1.f, 1.f };
+		pDevice->begin_debug_marker_region(cmd, color, "ImGui");
 		vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 		ImGui_ImplVulkan_RenderDrawData(draw_data, cmd);
 		vkCmdEndRenderPass(cmd);
+		pDevice->end_debug_marker_region(cmd);
 
 	}
 
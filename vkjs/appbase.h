@@ -46,6 +46,15 @@ namespace jvk {
 		void init_imgui();
 		void render_imgui();
 
+		struct TimelineWait {
+			VkSemaphore semaphore;
+			uint64_t value;
+			VkPipelineStageFlags stages;
+		};
+		// extra waits and signals of the next frame submission, cleared after it
+		std::vector<TimelineWait> frame_waits;
+		std::vector<TimelineWait> frame_signals;
+
 		std::string shaderDir = "shaders";
 		/** @brief Encapsulated physical and logical vulkan device */
 	protected:
@@ -58,6 +67,10 @@ namespace jvk {
 		std::vector<jvk::Image> swapchain_images;
 
 		std::string shader_path() const;
+		// the frame being recorded waits for the timeline semaphore to reach value before stages
+		void add_frame_wait(VkSemaphore timeline, uint64_t value, VkPipelineStageFlags stages);
+		// the frame being recorded sets the timeline semaphore to value once it completes
+		void add_frame_signal(VkSemaphore timeline, uint64_t value);
 		u32 frameCounter{ 0 };
 		u32 currentFrame;
 		u32 lastFPS;
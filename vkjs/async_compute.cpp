@@ -0,0 +1,248 @@
+#include "async_compute.h"
+#include "gpu_profiler.h"
+#include "VulkanInitializers.hpp"
+#include "vkcheck.h"
+
+namespace jvk {
+
+	static VkSemaphore create_timeline(Device* pDevice)
+	{
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+		VkSemaphoreCreateInfo sci = vks::initializers::semaphoreCreateInfo();
+		sci.pNext = &typeInfo;
+
+		VkSemaphore result = VK_NULL_HANDLE;
+		VK_CHECK(vkCreateSemaphore(*pDevice, &sci, nullptr, &result));
+
+		return result;
+	}
+
+	AsyncCompute::AsyncCompute(Device* pDevice, uint32_t frameCount) :
+		m_device(pDevice),
+		m_family(pDevice->queue_family_indices.compute),
+		m_graphicsFamily(pDevice->queue_family_indices.graphics),
+		m_pools(frameCount),
+		m_cmds(frameCount),
+		m_frameTickets(frameCount)
+	{
+		if (m_family == m_graphicsFamily)
+		{
+			return;
+		}
+		m_queue = pDevice->get_compute_queue();
+		if (m_queue == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		for (uint32_t i = 0; i < frameCount; ++i)
+		{
+			VK_CHECK(pDevice->create_command_pool(m_family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, &m_pools[i]));
+			VkCommandBufferAllocateInfo cbai = vks::initializers::commandBufferAllocateInfo(m_pools[i], VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+			VK_CHECK(vkAllocateCommandBuffers(*pDevice, &cbai, &m_cmds[i]));
+			pDevice->set_object_name((uint64_t)m_cmds[i], VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT, ("Async compute " + std::to_string(i)).c_str());
+		}
+		m_timeline = create_timeline(pDevice);
+		m_graphicsTimeline = create_timeline(pDevice);
+	}
+
+	AsyncCompute::~AsyncCompute()
+	{
+		if (!IsAvailable()) return;
+
+		WaitIdle();
+		for (auto pool : m_pools)
+		{
+			vkDestroyCommandPool(*m_device, pool, nullptr);
+		}
+		vkDestroySemaphore(*m_device, m_timeline, nullptr);
+		vkDestroySemaphore(*m_device, m_graphicsTimeline, nullptr);
+	}
+
+	VkCommandBuffer AsyncCompute::Begin(uint32_t frame)
+	{
+		assert(IsAvailable() && m_open == VK_NULL_HANDLE && frame < m_cmds.size());
+		// releases of the graphics frame being recorded cannot be acquired before it is submitted
+		assert(m_toCompute.empty() || !m_graphicsSignal);
+
+		Wait(m_frameTickets[frame]);
+		VK_CHECK(vkResetCommandPool(*m_device, m_pools[frame], 0));
+
+		m_open = m_cmds[frame];
+		m_openFrame = frame;
+		VK_CHECK(m_device->begin_command_buffer(m_open));
+		if (m_device->profiler) {
+			// the profiler may be set after this was created
+			m_device->profiler->AddComputeCommandBuffer(m_open);
+		}
+
+		// the acquire half of ReleaseToCompute, Submit waits for the graphics frame that released
+		if (!m_toCompute.empty())
+		{
+			std::vector<VkBufferMemoryBarrier> barriers;
+			VkPipelineStageFlags dstStages = 0;
+			for (const auto& it : m_toCompute)
+			{
+				VkBufferMemoryBarrier bbar = vks::initializers::bufferMemoryBarrier();
+				bbar.srcAccessMask = 0;
+				bbar.dstAccessMask = it.dstAccess;
+				bbar.srcQueueFamilyIndex = m_graphicsFamily;
+				bbar.dstQueueFamilyIndex = m_family;
+				bbar.buffer = it.buffer;
+				bbar.offset = 0;
+				bbar.size = VK_WHOLE_SIZE;
+				barriers.push_back(bbar);
+				dstStages |= it.dstStage;
+			}
+			vkCmdPipelineBarrier(m_open, dstStages, dstStages, 0,
+				0, nullptr,
+				uint32_t(barriers.size()), barriers.data(),
+				0, nullptr);
+			m_computeWaitStages = dstStages;
+			m_toCompute.clear();
+		}
+
+		return m_open;
+	}
+
+	void AsyncCompute::ReleaseToGraphics(VkBuffer buffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+	{
+		assert(m_open != VK_NULL_HANDLE);
+
+		VkBufferMemoryBarrier bbar = vks::initializers::bufferMemoryBarrier();
+		bbar.srcAccessMask = srcAccess;
+		bbar.dstAccessMask = 0;
+		bbar.srcQueueFamilyIndex = m_family;
+		bbar.dstQueueFamilyIndex = m_graphicsFamily;
+		bbar.buffer = buffer;
+		bbar.offset = 0;
+		bbar.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(m_open, srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr,
+			1, &bbar,
+			0, nullptr);
+
+		m_toGraphics.push_back({ buffer, dstStage, dstAccess });
+	}
+
+	AsyncCompute::Ticket AsyncCompute::Submit()
+	{
+		assert(m_open != VK_NULL_HANDLE);
+
+		VK_CHECK(vkEndCommandBuffer(m_open));
+
+		const Ticket ticket = ++m_lastTicket;
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &ticket;
+
+		VkSubmitInfo submit = vks::initializers::submitInfo();
+		submit.pNext = &timelineInfo;
+		submit.commandBufferCount = 1;
+		submit.pCommandBuffers = &m_open;
+		submit.signalSemaphoreCount = 1;
+		submit.pSignalSemaphores = &m_timeline;
+		if (m_computeWaitStages)
+		{
+			timelineInfo.waitSemaphoreValueCount = 1;
+			timelineInfo.pWaitSemaphoreValues = &m_graphicsValue;
+			submit.waitSemaphoreCount = 1;
+			submit.pWaitSemaphores = &m_graphicsTimeline;
+			submit.pWaitDstStageMask = &m_computeWaitStages;
+		}
+		{
+			std::lock_guard<std::mutex> lck(m_device->submit_queue_mutex);
+			VK_CHECK(vkQueueSubmit(m_queue, 1, &submit, VK_NULL_HANDLE));
+		}
+
+		m_frameTickets[m_openFrame] = ticket;
+		m_computeWaitStages = 0;
+		m_open = VK_NULL_HANDLE;
+
+		return ticket;
+	}
+
+	void AsyncCompute::ReleaseToCompute(VkCommandBuffer cmd, VkBuffer buffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+	{
+		assert(IsAvailable());
+
+		VkBufferMemoryBarrier bbar = vks::initializers::bufferMemoryBarrier();
+		bbar.srcAccessMask = srcAccess;
+		bbar.dstAccessMask = 0;
+		bbar.srcQueueFamilyIndex = m_graphicsFamily;
+		bbar.dstQueueFamilyIndex = m_family;
+		bbar.buffer = buffer;
+		bbar.offset = 0;
+		bbar.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(cmd, srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr,
+			1, &bbar,
+			0, nullptr);
+
+		m_toCompute.push_back({ buffer, dstStage, dstAccess });
+		m_graphicsSignal = true;
+	}
+
+	VkPipelineStageFlags AsyncCompute::RecordAcquire(VkCommandBuffer cmd)
+	{
+		if (m_toGraphics.empty()) return 0;
+
+		std::vector<VkBufferMemoryBarrier> barriers;
+		VkPipelineStageFlags dstStages = 0;
+		for (const auto& it : m_toGraphics)
+		{
+			VkBufferMemoryBarrier bbar = vks::initializers::bufferMemoryBarrier();
+			bbar.srcAccessMask = 0;
+			bbar.dstAccessMask = it.dstAccess;
+			bbar.srcQueueFamilyIndex = m_family;
+			bbar.dstQueueFamilyIndex = m_graphicsFamily;
+			bbar.buffer = it.buffer;
+			bbar.offset = 0;
+			bbar.size = VK_WHOLE_SIZE;
+			barriers.push_back(bbar);
+			dstStages |= it.dstStage;
+		}
+		m_toGraphics.clear();
+
+		// the semaphore wait has to cover the first scope of the acquire, host reads are not a queue stage
+		VkPipelineStageFlags waitStages = dstStages & ~VK_PIPELINE_STAGE_HOST_BIT;
+		if (waitStages == 0) {
+			waitStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		}
+		vkCmdPipelineBarrier(cmd, waitStages, dstStages, 0,
+			0, nullptr,
+			uint32_t(barriers.size()), barriers.data(),
+			0, nullptr);
+
+		return waitStages;
+	}
+
+	AsyncCompute::Ticket AsyncCompute::TakeGraphicsSignal()
+	{
+		if (!m_graphicsSignal) return 0;
+
+		m_graphicsSignal = false;
+		return ++m_graphicsValue;
+	}
+
+	void AsyncCompute::WaitIdle() const
+	{
+		Wait(m_lastTicket);
+	}
+
+	void AsyncCompute::Wait(Ticket ticket) const
+	{
+		if (ticket == 0) return;
+
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &m_timeline;
+		waitInfo.pValues = &ticket;
+		VK_CHECK(vkWaitSemaphores(*m_device, &waitInfo, UINT64_MAX));
+	}
+}
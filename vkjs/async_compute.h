@@ -0,0 +1,82 @@
+#ifndef VKJS_ASYNC_COMPUTE_H_
+#define VKJS_ASYNC_COMPUTE_H_
+
+#include "vkjs.h"
+
+namespace jvk {
+
+	/**
+	* Compute work of a frame submitted on the dedicated compute queue, so it overlaps the
+	* graphics work still in flight. Every Submit signals a ticket on a timeline semaphore,
+	* the graphics submission that consumes the results waits for it on the GPU.
+	* Buffers used by both queues change queue family ownership explicitly:
+	* ReleaseToGraphics is recorded on the compute side and RecordAcquire on the graphics side,
+	* ReleaseToCompute goes the other way and the next Submit waits for the graphics frame that released.
+	* Without a separate compute family, or while disabled, IsEnabled() is false and the caller
+	* records its compute work into the graphics command buffer.
+	*/
+	class AsyncCompute
+	{
+	public:
+		using Ticket = uint64_t;
+
+		AsyncCompute(Device* pDevice, uint32_t frameCount);
+		AsyncCompute() = delete;
+		AsyncCompute(const AsyncCompute&) = delete;
+		AsyncCompute& operator=(const AsyncCompute&) = delete;
+		~AsyncCompute();
+
+		// there is a compute family apart from the graphics one
+		bool IsAvailable() const { return m_queue != VK_NULL_HANDLE; }
+		bool IsEnabled() const { return m_enabled && IsAvailable(); }
+		// single queue fallback when false, for A/B timing
+		void SetEnabled(bool enabled) { m_enabled = enabled; }
+
+		// compute side, frame is the frame slot, Begin waits until its previous batch completes
+		VkCommandBuffer Begin(uint32_t frame);
+		void ReleaseToGraphics(VkBuffer buffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+		Ticket Submit();
+
+		// graphics side, the release is acquired by the first Begin after the graphics submission signaled
+		void ReleaseToCompute(VkCommandBuffer cmd, VkBuffer buffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+		// returns the stages the graphics submission has to wait for the last ticket at, 0 if there was nothing to acquire
+		VkPipelineStageFlags RecordAcquire(VkCommandBuffer cmd);
+		// value the graphics submission has to signal on GetGraphicsSemaphore(), 0 if nothing waits for it
+		Ticket TakeGraphicsSignal();
+
+		VkSemaphore GetSemaphore() const { return m_timeline; }
+		VkSemaphore GetGraphicsSemaphore() const { return m_graphicsTimeline; }
+		void WaitIdle() const;
+	private:
+		struct Transfer {
+			VkBuffer				buffer;
+			VkPipelineStageFlags	dstStage;
+			VkAccessFlags			dstAccess;
+		};
+
+		void Wait(Ticket ticket) const;
+
+		Device*					m_device;
+		VkQueue					m_queue = VK_NULL_HANDLE;
+		uint32_t				m_family;
+		uint32_t				m_graphicsFamily;
+		bool					m_enabled = true;
+
+		std::vector<VkCommandPool>		m_pools;
+		std::vector<VkCommandBuffer>	m_cmds;
+		std::vector<Ticket>				m_frameTickets;
+		VkCommandBuffer			m_open = VK_NULL_HANDLE;
+		uint32_t				m_openFrame = 0;
+
+		VkSemaphore				m_timeline = VK_NULL_HANDLE;
+		Ticket					m_lastTicket = 0;
+		VkSemaphore				m_graphicsTimeline = VK_NULL_HANDLE;
+		Ticket					m_graphicsValue = 0;
+		bool					m_graphicsSignal = false;	// a release waits for the current graphics frame
+		VkPipelineStageFlags	m_computeWaitStages = 0;	// of the graphics timeline by the next Submit
+
+		std::vector<Transfer>	m_toGraphics;			// acquired by the next RecordAcquire
+		std::vector<Transfer>	m_toCompute;			// acquired by the next Begin
+	};
+}
+#endif // !VKJS_ASYNC_COMPUTE_H_
@@ -121,6 +121,77 @@ namespace jvk {
 		return m_buffer.map();
 	}
 
+	StorageBuffer::StorageBuffer(Device* pDevice, VkDeviceSize size, bool hostVisible)
+	{
+		VkResult result;
+		if (hostVisible)
+		{
+			result = pDevice->create_buffer(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				size,
+				&m_buffer);
+		}
+		else
+		{
+			result = pDevice->create_storage_buffer(size, &m_buffer);
+		}
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Cannot create storage buffer; VkResult: " + std::to_string(result));
+		}
+		statistics.allocCount.fetch_add(1, std::memory_order_relaxed);
+		statistics.allocBytes.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	BufferUsage StorageBuffer::GetUsage() const
+	{
+		return BufferUsage::SSBO;
+	}
+
+	BufferObject::SharedPtr StorageBuffer::CreateShared(Device* pDevice, VkDeviceSize size, bool hostVisible)
+	{
+		return SharedPtr(new StorageBuffer(pDevice, size, hostVisible));
+	}
+
+	BufferObject::UniquePtr StorageBuffer::Create(Device* pDevice, VkDeviceSize size, bool hostVisible)
+	{
+		return UniquePtr(new StorageBuffer(pDevice, size, hostVisible));
+	}
+
+	IndirectBuffer::IndirectBuffer(Device* pDevice, VkDeviceSize size, bool hostVisible)
+	{
+		const VkMemoryPropertyFlags memFlags = hostVisible ?
+			(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) :
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		VkResult result = pDevice->create_buffer(
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			memFlags,
+			size,
+			&m_buffer);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Cannot create indirect buffer; VkResult: " + std::to_string(result));
+		}
+		statistics.allocCount.fetch_add(1, std::memory_order_relaxed);
+		statistics.allocBytes.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	BufferUsage IndirectBuffer::GetUsage() const
+	{
+		return BufferUsage::Indirect;
+	}
+
+	BufferObject::SharedPtr IndirectBuffer::CreateShared(Device* pDevice, VkDeviceSize size, bool hostVisible)
+	{
+		return SharedPtr(new IndirectBuffer(pDevice, size, hostVisible));
+	}
+
+	BufferObject::UniquePtr IndirectBuffer::Create(Device* pDevice, VkDeviceSize size, bool hostVisible)
+	{
+		return UniquePtr(new IndirectBuffer(pDevice, size, hostVisible));
+	}
+
 	StagingBuffer::StagingBuffer(Device* pDevice, VkDeviceSize size)
 	{
 		auto result = pDevice->create_staging_buffer(size, &m_buffer);
@@ -5,7 +5,7 @@
 
 namespace jvk {
 	
-	enum class BufferUsage { UBO, SSBO, Vertex, Index, Staging };
+	enum class BufferUsage { UBO, SSBO, Vertex, Index, Staging, Indirect };
 
 	struct Device;
 	struct Buffer {
@@ -78,6 +78,33 @@ namespace jvk {
 
 	};
 
+	class StorageBuffer : public BufferObject
+	{
+	public:
+
+		StorageBuffer(Device* pDevice, VkDeviceSize size, bool hostVisible);
+		StorageBuffer() = delete;
+		virtual BufferUsage GetUsage() const override;
+		static SharedPtr CreateShared(Device* pDevice, VkDeviceSize size, bool hostVisible);
+		static UniquePtr Create(Device* pDevice, VkDeviceSize size, bool hostVisible);
+
+	};
+
+	/**
+	* Indirect draw/dispatch arguments written by shaders, usable as storage buffer as well
+	*/
+	class IndirectBuffer : public BufferObject
+	{
+	public:
+
+		IndirectBuffer(Device* pDevice, VkDeviceSize size, bool hostVisible);
+		IndirectBuffer() = delete;
+		virtual BufferUsage GetUsage() const override;
+		static SharedPtr CreateShared(Device* pDevice, VkDeviceSize size, bool hostVisible);
+		static UniquePtr Create(Device* pDevice, VkDeviceSize size, bool hostVisible);
+
+	};
+
 	class StagingBuffer : public BufferObject
 	{
 	public:
@@ -1,6 +1,7 @@
 #include "vkjs.h"
 #include "vkcheck.h"
 #include "jsrlib/jsr_logger.h"
+#include "gpu_profiler.h"
 
 namespace jvk {
 
@@ -227,10 +228,18 @@ namespace jvk {
 			markerInfo.pMarkerName = name.c_str();
 			vkCmdDebugMarkerBeginEXT(cmd, &markerInfo);
 		}
+		if (profiler)
+		{
+			profiler->BeginRegion(cmd, name);
+		}
 	}
 
 	void Device::end_debug_marker_region(VkCommandBuffer cmd)
 	{
+		if (profiler)
+		{
+			profiler->EndRegion(cmd);
+		}
 		if (debugMarkerPresent)
 		{
 			vkCmdDebugMarkerEndEXT(cmd);
@@ -7,10 +7,13 @@ namespace jvk {
 
 	struct Buffer;
 	struct Image;
+	class GpuProfiler;
 
 	struct Device {
 
 		bool debugMarkerPresent = false;
+		// times every debug marker region when set
+		GpuProfiler* profiler = nullptr;
 		VkDevice logicalDevice = VK_NULL_HANDLE;
 		VmaAllocator allocator = {};
 		vkb::Device vkbDevice = {};
@@ -0,0 +1,338 @@
+#include "gpu_profiler.h"
+#include "vkcheck.h"
+#include <algorithm>
+
+namespace jvk {
+
+	// CPU events kept for the trace
+	static const size_t MAX_CPU_EVENTS = 256 * 1024;
+
+	static std::string csv_escape(const std::string& s)
+	{
+		std::string result = "\"";
+		for (char c : s) {
+			if (c == '"') result += '"';
+			result += c;
+		}
+		return result + "\"";
+	}
+
+	static std::string json_escape(const char* s)
+	{
+		std::string result;
+		for (; *s; ++s) {
+			if (*s == '"' || *s == '\\') result += '\\';
+			result += *s;
+		}
+		return result;
+	}
+
+	GpuProfiler::CpuScope::CpuScope(GpuProfiler* profiler, const char* name, uint32_t threadId) :
+		m_profiler(profiler),
+		m_name(name),
+		m_threadId(threadId),
+		m_startUs(profiler ? profiler->GetCpuTimeUs() : 0.0)
+	{
+	}
+
+	GpuProfiler::CpuScope::~CpuScope()
+	{
+		if (m_profiler) {
+			m_profiler->AddCpuEvent(m_name, m_threadId, m_startUs, m_profiler->GetCpuTimeUs() - m_startUs);
+		}
+	}
+
+	GpuProfiler::GpuProfiler(Device* pDevice, uint32_t frameCount, uint32_t maxRegions, uint32_t windowSize) :
+		m_device(pDevice),
+		m_maxRegions(maxRegions),
+		m_windowSize(windowSize),
+		m_frames(frameCount),
+		m_start(std::chrono::steady_clock::now())
+	{
+		GetSeries("GPU frame", 0);
+
+		const VkPhysicalDeviceLimits& limits = pDevice->vkbPhysicalDevice.properties.limits;
+		uint32_t familyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(pDevice->vkbPhysicalDevice.physical_device, &familyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> families(familyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(pDevice->vkbPhysicalDevice.physical_device, &familyCount, families.data());
+
+		auto validMask = [](uint32_t validBits) { return validBits >= 64 ? ~0ull : (1ull << validBits) - 1; };
+		const uint32_t validBits = families[pDevice->queue_family_indices.graphics].timestampValidBits;
+		m_supported = validBits > 0;
+		if (!m_supported)
+		{
+			return;
+		}
+		m_timestampPeriod = limits.timestampPeriod;
+		m_timestampMask = validMask(validBits);
+		// a dedicated compute family may have no timestamps even if the graphics one does
+		m_computeTimestampMask = validMask(families[pDevice->queue_family_indices.compute].timestampValidBits);
+
+		VkQueryPoolCreateInfo qpci{};
+		qpci.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		qpci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		qpci.queryCount = 2 * maxRegions;
+		for (auto& frame : m_frames)
+		{
+			VK_CHECK(vkCreateQueryPool(*pDevice, &qpci, nullptr, &frame.pool));
+			vkResetQueryPool(*pDevice, frame.pool, 0, qpci.queryCount);
+		}
+		// begin, availability, end, availability
+		m_results.resize(4 * size_t(maxRegions));
+	}
+
+	GpuProfiler::~GpuProfiler()
+	{
+		for (auto& frame : m_frames)
+		{
+			if (frame.pool) vkDestroyQueryPool(*m_device, frame.pool, nullptr);
+		}
+	}
+
+	uint32_t GpuProfiler::GetSeries(const std::string& name, uint32_t depth)
+	{
+		auto it = m_seriesIndex.find(name);
+		if (it != m_seriesIndex.end())
+		{
+			return it->second;
+		}
+
+		const uint32_t index = uint32_t(m_series.size());
+		Series series{};
+		series.name = name;
+		series.depth = depth;
+		series.samples.reserve(m_windowSize);
+		m_series.push_back(std::move(series));
+		m_seriesIndex.emplace(name, index);
+
+		return index;
+	}
+
+	void GpuProfiler::AddSample(uint32_t series, float ms)
+	{
+		Series& s = m_series[series];
+		if (s.samples.size() < m_windowSize)
+		{
+			s.samples.push_back(ms);
+		}
+		else
+		{
+			s.samples[s.next] = ms;
+		}
+		s.next = (s.next + 1) % m_windowSize;
+		s.last = ms;
+	}
+
+	void GpuProfiler::ReadBack(Frame& frame)
+	{
+		if (frame.queryCount == 0) return;
+
+		// no WAIT_BIT, queries that are not available yet are skipped
+		const VkResult result = vkGetQueryPoolResults(*m_device, frame.pool, 0, frame.queryCount,
+			frame.queryCount * 2 * sizeof(uint64_t), m_results.data(), 2 * sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		if (result != VK_SUCCESS && result != VK_NOT_READY)
+		{
+			return;
+		}
+
+		const double usPerTick = double(m_timestampPeriod) / 1000.0;
+		uint64_t frameBegin = ~0ull;
+		uint64_t frameEnd = 0;
+		for (const auto& region : frame.regions)
+		{
+			if (region.query == ~0u || !region.closed) continue;
+
+			const uint64_t* r = &m_results[2 * size_t(region.query)];
+			if (r[1] == 0 || r[3] == 0) continue;
+
+			const uint64_t mask = region.compute ? m_computeTimestampMask : m_timestampMask;
+			const uint64_t begin = r[0] & mask;
+			const uint64_t end = r[2] & mask;
+			const uint64_t ticks = (end - begin) & mask;
+			AddSample(region.series, float(double(ticks) * usPerTick / 1000.0));
+
+			if (m_firstTimestamp == 0) {
+				m_firstTimestamp = begin;
+			}
+			TraceEvent ev{};
+			ev.name = region.series;
+			ev.frame = frame.index;
+			ev.startUs = (double(begin) - double(m_firstTimestamp)) * usPerTick;
+			ev.durationUs = double(ticks) * usPerTick;
+			m_gpuEvents.push_back(ev);
+
+			frameBegin = std::min(frameBegin, begin);
+			frameEnd = std::max(frameEnd, begin + ticks);
+		}
+		if (frameEnd > frameBegin)
+		{
+			AddSample(0, float(double(frameEnd - frameBegin) * usPerTick / 1000.0));
+		}
+
+		while (!m_gpuEvents.empty() && m_gpuEvents.front().frame + m_windowSize <= frame.index)
+		{
+			m_gpuEvents.pop_front();
+		}
+	}
+
+	void GpuProfiler::BeginFrame(uint32_t frame)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+
+		m_current = &m_frames[frame];
+		if (m_supported)
+		{
+			ReadBack(*m_current);
+			vkResetQueryPool(*m_device, m_current->pool, 0, 2 * m_maxRegions);
+		}
+		m_current->regions.clear();
+		m_current->queryCount = 0;
+		m_current->index = m_frameIndex++;
+	}
+
+	void GpuProfiler::BeginRegion(VkCommandBuffer cmd, const std::string& name)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		if (!m_current) return;
+
+		uint32_t depth = 0;
+		for (const auto& region : m_current->regions)
+		{
+			if (region.cmd == cmd && !region.closed) ++depth;
+		}
+
+		Region region{};
+		region.series = GetSeries(name, depth);
+		region.cmd = cmd;
+		region.query = ~0u;
+		region.compute = std::find(m_computeCmds.begin(), m_computeCmds.end(), cmd) != m_computeCmds.end();
+		const bool timed = region.compute ? m_computeTimestampMask != 0 : m_supported;
+		if (timed && m_current->queryCount + 2 <= 2 * m_maxRegions)
+		{
+			region.query = m_current->queryCount;
+			m_current->queryCount += 2;
+			vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_current->pool, region.query);
+		}
+		m_current->regions.push_back(region);
+	}
+
+	void GpuProfiler::EndRegion(VkCommandBuffer cmd)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		if (!m_current) return;
+
+		for (auto it = m_current->regions.rbegin(); it != m_current->regions.rend(); ++it)
+		{
+			if (it->cmd != cmd || it->closed) continue;
+
+			if (it->query != ~0u) {
+				vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_current->pool, it->query + 1);
+			}
+			it->closed = true;
+			break;
+		}
+	}
+
+	void GpuProfiler::AddComputeCommandBuffer(VkCommandBuffer cmd)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+
+		if (std::find(m_computeCmds.begin(), m_computeCmds.end(), cmd) == m_computeCmds.end()) {
+			m_computeCmds.push_back(cmd);
+		}
+	}
+
+	void GpuProfiler::AddCpuEvent(const char* name, uint32_t threadId, double startUs, double durationUs)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+
+		TraceEvent ev{};
+		ev.cpuName = name;
+		ev.threadId = threadId;
+		ev.frame = m_frameIndex;
+		ev.startUs = startUs;
+		ev.durationUs = durationUs;
+		m_cpuEvents.push_back(ev);
+		if (m_cpuEvents.size() > MAX_CPU_EVENTS) {
+			m_cpuEvents.pop_front();
+		}
+	}
+
+	double GpuProfiler::GetCpuTimeUs() const
+	{
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_start).count();
+	}
+
+	std::vector<GpuProfiler::RegionStats> GpuProfiler::GetStats() const
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+
+		std::vector<RegionStats> result;
+		std::vector<float> sorted;
+		for (const auto& s : m_series)
+		{
+			if (s.samples.empty()) continue;
+
+			sorted = s.samples;
+			std::sort(sorted.begin(), sorted.end());
+			double sum = 0.0;
+			for (float v : sorted) sum += v;
+
+			RegionStats stats{};
+			stats.name = s.name;
+			stats.depth = s.depth;
+			stats.sampleCount = uint32_t(sorted.size());
+			stats.lastMs = s.last;
+			stats.minMs = sorted.front();
+			stats.avgMs = float(sum / double(sorted.size()));
+			stats.p99Ms = sorted[std::min(sorted.size() - 1, (sorted.size() * 99 + 99) / 100 - 1)];
+			result.push_back(stats);
+		}
+
+		return result;
+	}
+
+	bool GpuProfiler::WriteCsv(const std::filesystem::path& path) const
+	{
+		std::ofstream out(path);
+		if (!out) return false;
+
+		out << "region,depth,samples,last_ms,min_ms,avg_ms,p99_ms\n";
+		for (const auto& s : GetStats())
+		{
+			out << csv_escape(s.name) << ',' << s.depth << ',' << s.sampleCount << ','
+				<< s.lastMs << ',' << s.minMs << ',' << s.avgMs << ',' << s.p99Ms << '\n';
+		}
+
+		return bool(out);
+	}
+
+	bool GpuProfiler::WriteChromeTrace(const std::filesystem::path& path) const
+	{
+		std::ofstream out(path);
+		if (!out) return false;
+
+		std::lock_guard<std::mutex> lck(m_mutex);
+
+		out << "{\"traceEvents\":[\n";
+		out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GPU\"}},\n";
+		out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"CPU\"}}";
+		out.precision(3);
+		out << std::fixed;
+		for (const auto& ev : m_gpuEvents)
+		{
+			out << ",\n{\"name\":\"" << json_escape(m_series[ev.name].name.c_str()) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":0"
+				<< ",\"ts\":" << ev.startUs << ",\"dur\":" << ev.durationUs << ",\"args\":{\"frame\":" << ev.frame << "}}";
+		}
+		for (const auto& ev : m_cpuEvents)
+		{
+			out << ",\n{\"name\":\"" << json_escape(ev.cpuName) << "\",\"ph\":\"X\",\"pid\":2,\"tid\":" << ev.threadId
+				<< ",\"ts\":" << ev.startUs << ",\"dur\":" << ev.durationUs << ",\"args\":{\"frame\":" << ev.frame << "}}";
+		}
+		out << "\n]}\n";
+
+		return bool(out);
+	}
+}
@@ -0,0 +1,128 @@
+#ifndef VKJS_GPU_PROFILER_H_
+#define VKJS_GPU_PROFILER_H_
+
+#include "vkjs.h"
+
+namespace jvk {
+
+	/**
+	* Timestamp queries around every debug marker region of a frame, Device::begin_debug_marker_region
+	* and end_debug_marker_region forward to it while Device::profiler is set.
+	* Each frame slot has its own query pool, reset from the host. BeginFrame reads the results of the
+	* previous use of the slot, which the frame fence has already waited for, so it never stalls:
+	* the numbers are MAX_CONCURRENT_FRAMES frames late. Per region min/avg/p99 are kept over a rolling window.
+	* CPU scopes of the main thread and the jobs go into the same Chrome trace, the GPU and CPU clocks
+	* are not calibrated against each other, they are two separate processes in the trace.
+	*/
+	class GpuProfiler
+	{
+	public:
+		struct RegionStats {
+			std::string		name;
+			uint32_t		depth;
+			uint32_t		sampleCount;
+			float			lastMs;
+			float			minMs;
+			float			avgMs;
+			float			p99Ms;
+		};
+
+		// records a CPU event between construction and destruction
+		class CpuScope
+		{
+		public:
+			// name has to outlive the profiler, a literal
+			// threadId: 0 for the main thread, the job system worker index + 1 in jobs
+			CpuScope(GpuProfiler* profiler, const char* name, uint32_t threadId = 0);
+			~CpuScope();
+			CpuScope(const CpuScope&) = delete;
+			CpuScope& operator=(const CpuScope&) = delete;
+		private:
+			GpuProfiler*	m_profiler;
+			const char*		m_name;
+			uint32_t		m_threadId;
+			double			m_startUs;
+		};
+
+		GpuProfiler(Device* pDevice, uint32_t frameCount, uint32_t maxRegions = 128, uint32_t windowSize = 256);
+		GpuProfiler() = delete;
+		GpuProfiler(const GpuProfiler&) = delete;
+		GpuProfiler& operator=(const GpuProfiler&) = delete;
+		~GpuProfiler();
+
+		// timestamps on the graphics queue, the host query reset feature is enabled
+		bool IsSupported() const { return m_supported; }
+		// regions recorded into cmd run on the compute queue, they are skipped if its family has no timestamps
+		void AddComputeCommandBuffer(VkCommandBuffer cmd);
+
+		// after the fence of the frame slot has been waited for, before any region of the frame
+		void BeginFrame(uint32_t frame);
+		// any primary command buffer submitted in the frame, regions nest per command buffer
+		void BeginRegion(VkCommandBuffer cmd, const std::string& name);
+		void EndRegion(VkCommandBuffer cmd);
+
+		// thread safe, microseconds since the profiler was created
+		void AddCpuEvent(const char* name, uint32_t threadId, double startUs, double durationUs);
+		double GetCpuTimeUs() const;
+
+		// in the order the regions were first seen, "GPU frame" (first begin to last end of a frame) first
+		std::vector<RegionStats> GetStats() const;
+		bool WriteCsv(const std::filesystem::path& path) const;
+		bool WriteChromeTrace(const std::filesystem::path& path) const;
+	private:
+		struct Region {
+			uint32_t		series;
+			VkCommandBuffer	cmd;
+			uint32_t		query;			// begin, end is query + 1, ~0u if the pool was full or not timed
+			bool			closed;
+			bool			compute;
+		};
+		struct Frame {
+			VkQueryPool				pool = VK_NULL_HANDLE;
+			std::vector<Region>		regions;
+			uint32_t				queryCount = 0;
+			uint64_t				index = 0;
+		};
+		struct Series {
+			std::string			name;
+			uint32_t			depth;
+			std::vector<float>	samples;		// ring of the last windowSize values
+			uint32_t			next;
+			float				last;
+		};
+		struct TraceEvent {
+			uint32_t	name;			// series of GPU events
+			const char*	cpuName;		// CPU events
+			uint32_t	threadId;
+			uint64_t	frame;
+			double		startUs;
+			double		durationUs;
+		};
+
+		uint32_t GetSeries(const std::string& name, uint32_t depth);
+		void AddSample(uint32_t series, float ms);
+		void ReadBack(Frame& frame);
+
+		Device*					m_device;
+		bool					m_supported = false;
+		float					m_timestampPeriod = 1.0f;	// nanoseconds per tick
+		uint64_t				m_timestampMask = ~0ull;
+		uint64_t				m_computeTimestampMask = 0;	// 0 if the compute family has no timestamps
+		std::vector<VkCommandBuffer>	m_computeCmds;
+		uint32_t				m_maxRegions;
+		uint32_t				m_windowSize;
+		std::vector<Frame>		m_frames;
+		Frame*					m_current = nullptr;
+		uint64_t				m_frameIndex = 0;
+		uint64_t				m_firstTimestamp = 0;
+
+		std::vector<Series>							m_series;
+		std::unordered_map<std::string, uint32_t>	m_seriesIndex;
+		std::vector<uint64_t>						m_results;
+		std::deque<TraceEvent>						m_gpuEvents;
+		std::deque<TraceEvent>						m_cpuEvents;
+		std::chrono::steady_clock::time_point		m_start;
+		mutable std::mutex							m_mutex;
+	};
+}
+#endif // !VKJS_GPU_PROFILER_H_
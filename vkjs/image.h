@@ -56,8 +56,10 @@ namespace jvk {
 			VkAccessFlags dstAccess = 0,
 			bool updateLayout = false);
 		void record_upload(VkCommandBuffer cmd, UploadCallbackFn callback, Buffer* buffer);
-		VkImageMemoryBarrier get_layout_transition_barrier(VkImageLayout newLayout, VkAccessFlags srcAccess = 0, VkAccessFlags dstAccess = 0);
+		VkImageMemoryBarrier get_layout_transition_barrier(VkImageLayout newLayout, VkAccessFlags srcAccess = 0, VkAccessFlags dstAccess = 0) const;
 		void generate_mipmaps(VkFilter filter = VK_FILTER_LINEAR);
+		// every level must be in TRANSFER_DST_OPTIMAL, leaves the image in SHADER_READ_ONLY_OPTIMAL
+		void record_generate_mipmaps(VkCommandBuffer cmd, VkFilter filter = VK_FILTER_LINEAR);
 
 		void setup_descriptor();
 	};
@@ -74,6 +74,7 @@ namespace jvk {
 		virtual VulkanPipeline& add_push_constant_range(const VkPushConstantRange& pcRange) = 0;
 		virtual void set_specialization_info(VkShaderStageFlagBits stageBits, const VkSpecializationInfo* info) = 0;
 		void bind_descriptor_sets(VkCommandBuffer cmd, uint32_t count, const VkDescriptorSet* sets, uint32_t dynamicOffsetCount = 0, const uint32_t* dynamicOffsets = nullptr);
+		void bind_descriptor_sets(VkCommandBuffer cmd, uint32_t firstSet, uint32_t count, const VkDescriptorSet* sets, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets);
 	protected:
 
 		void prepare();
@@ -171,5 +172,9 @@ namespace jvk {
 	{
 		vkCmdBindDescriptorSets(cmd, pipeline_bind_point(), _pipelineLayout, 0, count, sets, dynamicOffsetCount, dynamicOffsets);
 	}
+	inline void VulkanPipeline::bind_descriptor_sets(VkCommandBuffer cmd, uint32_t firstSet, uint32_t count, const VkDescriptorSet* sets, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets)
+	{
+		vkCmdBindDescriptorSets(cmd, pipeline_bind_point(), _pipelineLayout, firstSet, count, sets, dynamicOffsetCount, dynamicOffsets);
+	}
 }
 #endif // !VKJS_PIPELINE_H_
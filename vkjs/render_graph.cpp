@@ -0,0 +1,483 @@
+#include "render_graph.h"
+#include <algorithm>
+
+namespace jvk {
+
+	static const VkAccessFlags WRITE_ACCESS_MASK =
+		VK_ACCESS_SHADER_WRITE_BIT |
+		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_TRANSFER_WRITE_BIT |
+		VK_ACCESS_HOST_WRITE_BIT |
+		VK_ACCESS_MEMORY_WRITE_BIT;
+
+	static bool contains(const std::vector<uint32_t>& v, uint32_t value)
+	{
+		return std::find(v.begin(), v.end(), value) != v.end();
+	}
+
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::Read(Handle res, const RGAccess& access)
+	{
+		Use& use = m_graph->GetUse(m_pass, res);
+		use.access.stages |= access.stages;
+		use.access.access |= access.access;
+		if (use.access.layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+			use.access.layout = access.layout;
+		}
+		else if (access.layout != VK_IMAGE_LAYOUT_UNDEFINED && access.layout != use.access.layout) {
+			use.access.layout = VK_IMAGE_LAYOUT_GENERAL;
+		}
+		use.read = true;
+		use.discard = false;
+
+		return *this;
+	}
+
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::Write(Handle res, const RGAccess& access, bool discard)
+	{
+		Use& use = m_graph->GetUse(m_pass, res);
+		const bool first = !use.read && !use.write;
+		use.access.stages |= access.stages;
+		use.access.access |= access.access;
+		if (use.access.layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+			use.access.layout = access.layout;
+		}
+		else if (access.layout != VK_IMAGE_LAYOUT_UNDEFINED && access.layout != use.access.layout) {
+			use.access.layout = VK_IMAGE_LAYOUT_GENERAL;
+		}
+		use.discard = discard && (first || use.discard);
+		use.write = true;
+
+		return *this;
+	}
+
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::Attachment(Handle res, const RGAccess& access, const RGAccess& after, bool discard)
+	{
+		Write(res, access, discard);
+		Use& use = m_graph->GetUse(m_pass, res);
+		use.attachment = true;
+		use.after = after;
+
+		return *this;
+	}
+
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::SideEffect()
+	{
+		m_graph->m_passes[m_pass].sideEffect = true;
+
+		return *this;
+	}
+
+	RenderGraph::Handle RenderGraph::ImportImage(const std::string& name, VkImage image, const VkImageSubresourceRange& range, const RGAccess& lastAccess)
+	{
+		assert(image != VK_NULL_HANDLE);
+
+		Resource res{};
+		res.name = name;
+		res.image = image;
+		res.range = range;
+		res.lastAccess = lastAccess;
+		m_resources.push_back(res);
+		m_compiled = false;
+
+		return Handle(m_resources.size() - 1);
+	}
+
+	RenderGraph::Handle RenderGraph::ImportImage(const std::string& name, Image* image, const RGAccess& lastAccess)
+	{
+		VkImageSubresourceRange range{};
+		range.aspectMask = image->aspect_flags;
+		range.levelCount = image->levels;
+		range.layerCount = image->layers * image->faces;
+
+		RGAccess access = lastAccess;
+		access.layout = image->layout;
+		const Handle h = ImportImage(name, image->image, range, access);
+		m_resources[h].owner = image;
+
+		return h;
+	}
+
+	RenderGraph::Handle RenderGraph::ImportBuffer(const std::string& name, VkBuffer buffer, const RGAccess& lastAccess)
+	{
+		assert(buffer != VK_NULL_HANDLE);
+
+		Resource res{};
+		res.name = name;
+		res.buffer = buffer;
+		res.lastAccess = lastAccess;
+		m_resources.push_back(res);
+		m_compiled = false;
+
+		return Handle(m_resources.size() - 1);
+	}
+
+	void RenderGraph::SetOutput(Handle res, const RGAccess& finalAccess)
+	{
+		assert(res < m_resources.size());
+
+		m_resources[res].output = true;
+		m_resources[res].finalAccess = finalAccess;
+		m_compiled = false;
+	}
+
+	RenderGraph::PassBuilder RenderGraph::AddPass(const std::string& name, ExecuteFn&& fn)
+	{
+		Pass pass{};
+		pass.name = name;
+		pass.fn = std::move(fn);
+		m_passes.push_back(std::move(pass));
+		m_compiled = false;
+
+		return PassBuilder(this, uint32_t(m_passes.size() - 1));
+	}
+
+	RenderGraph::Use& RenderGraph::GetUse(uint32_t pass, Handle res)
+	{
+		assert(res < m_resources.size());
+
+		// every resource has one merged use per pass
+		auto& uses = m_passes[pass].uses;
+		for (auto& use : uses) {
+			if (use.res == res) return use;
+		}
+		Use use{};
+		use.res = res;
+		uses.push_back(use);
+		m_compiled = false;
+
+		return uses.back();
+	}
+
+	void RenderGraph::CullPasses()
+	{
+		// walk backwards from the outputs, a pass is live if a later live pass or an output needs one of its writes
+		std::vector<bool> needed(m_resources.size());
+		for (size_t i = 0; i < m_resources.size(); ++i) {
+			needed[i] = m_resources[i].output;
+		}
+
+		for (size_t i = m_passes.size(); i-- > 0;)
+		{
+			Pass& pass = m_passes[i];
+			pass.live = pass.sideEffect;
+			for (const auto& use : pass.uses) {
+				if (use.write && needed[use.res]) pass.live = true;
+			}
+			if (!pass.live) continue;
+
+			// a discarding write hides every earlier writer, a partial one does not
+			for (const auto& use : pass.uses) {
+				if (use.write && use.discard && !use.read) needed[use.res] = false;
+			}
+			for (const auto& use : pass.uses) {
+				if (use.read || (use.write && !use.discard)) needed[use.res] = true;
+			}
+		}
+	}
+
+	void RenderGraph::BuildDependencies()
+	{
+		std::vector<uint32_t> lastWriter(m_resources.size(), INVALID_HANDLE);
+		std::vector<std::vector<uint32_t>> readers(m_resources.size());
+
+		auto addEdge = [this](uint32_t from, uint32_t to)
+		{
+			if (from == INVALID_HANDLE || from == to) return;
+			auto& succ = m_passes[from].successors;
+			if (!contains(succ, to)) {
+				succ.push_back(to);
+				m_passes[to].dependencyCount++;
+			}
+		};
+
+		for (uint32_t p = 0; p < uint32_t(m_passes.size()); ++p)
+		{
+			Pass& pass = m_passes[p];
+			if (!pass.live) continue;
+
+			for (const auto& use : pass.uses)
+			{
+				// read after write
+				if (use.read) addEdge(lastWriter[use.res], p);
+				if (use.write)
+				{
+					// write after read, write after write
+					for (uint32_t r : readers[use.res]) addEdge(r, p);
+					addEdge(lastWriter[use.res], p);
+					lastWriter[use.res] = p;
+					readers[use.res].clear();
+				}
+				else if (use.read)
+				{
+					readers[use.res].push_back(p);
+				}
+			}
+		}
+	}
+
+	void RenderGraph::SchedulePasses()
+	{
+		std::vector<uint32_t> pending(m_passes.size());
+		std::vector<uint32_t> ready;
+		for (uint32_t p = 0; p < uint32_t(m_passes.size()); ++p)
+		{
+			pending[p] = m_passes[p].dependencyCount;
+			if (m_passes[p].live && pending[p] == 0) ready.push_back(p);
+		}
+
+		// ready is kept in declaration order, the first pass not depending on the previous one is
+		// preferred so the barrier in front of a dependent pass has some work to overlap with
+		uint32_t last = INVALID_HANDLE;
+		while (!ready.empty())
+		{
+			size_t pick = 0;
+			if (last != INVALID_HANDLE)
+			{
+				for (size_t i = 0; i < ready.size(); ++i)
+				{
+					if (!contains(m_passes[last].successors, ready[i])) {
+						pick = i;
+						break;
+					}
+				}
+			}
+
+			const uint32_t p = ready[pick];
+			ready.erase(ready.begin() + pick);
+			m_schedule.push_back(p);
+			last = p;
+
+			for (uint32_t s : m_passes[p].successors)
+			{
+				if (--pending[s] == 0) {
+					ready.insert(std::upper_bound(ready.begin(), ready.end(), s), s);
+				}
+			}
+		}
+	}
+
+	void RenderGraph::AddBarrier(BarrierBatch& batch, State& state, const Resource& res, const Use& use)
+	{
+		const bool isImage = res.image != VK_NULL_HANDLE;
+		VkImageLayout newLayout = state.layout;
+		if (isImage && !use.attachment && use.access.layout != VK_IMAGE_LAYOUT_UNDEFINED) {
+			newLayout = use.access.layout;
+		}
+		const bool layoutChange = newLayout != state.layout;
+
+		VkPipelineStageFlags srcStages = 0;
+		VkAccessFlags srcAccess = 0;
+		bool needed = false;
+		if (use.write || layoutChange)
+		{
+			// writes and layout transitions wait for every earlier access
+			srcStages = state.writeStages | state.readStages;
+			srcAccess = state.writeAccess;
+			needed = layoutChange || (srcStages & ~VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT) != 0;
+		}
+		else
+		{
+			// read after read needs nothing unless the write is not visible to this stage yet
+			srcStages = state.writeStages;
+			srcAccess = state.writeAccess;
+			needed = state.writeStages != 0 &&
+				((use.access.stages & ~state.visibleStages) != 0 || (use.access.access & ~state.visibleAccess) != 0);
+		}
+
+		if (needed)
+		{
+			batch.srcStages |= srcStages ? srcStages : VkPipelineStageFlags(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+			batch.dstStages |= use.access.stages;
+			if (isImage && use.attachment && state.layout == VK_IMAGE_LAYOUT_UNDEFINED)
+			{
+				// nothing to transition, the render pass starts from UNDEFINED as well
+			}
+			else if (isImage)
+			{
+				VkImageMemoryBarrier ibar{};
+				ibar.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				ibar.srcAccessMask = srcAccess;
+				ibar.dstAccessMask = use.access.access;
+				ibar.oldLayout = (use.write && use.discard && layoutChange) ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+				ibar.newLayout = newLayout;
+				ibar.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				ibar.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				ibar.image = res.image;
+				ibar.subresourceRange = res.range;
+				batch.images.push_back(ibar);
+			}
+			else
+			{
+				VkBufferMemoryBarrier bbar{};
+				bbar.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				bbar.srcAccessMask = srcAccess;
+				bbar.dstAccessMask = use.access.access;
+				bbar.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				bbar.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				bbar.buffer = res.buffer;
+				bbar.offset = 0;
+				bbar.size = VK_WHOLE_SIZE;
+				batch.buffers.push_back(bbar);
+			}
+		}
+
+		if (use.write)
+		{
+			state.writeStages = use.access.stages;
+			state.writeAccess = use.access.access & WRITE_ACCESS_MASK;
+			state.readStages = 0;
+			if (use.attachment)
+			{
+				// the external dependency of the render pass did the rest
+				if (use.after.layout != VK_IMAGE_LAYOUT_UNDEFINED) newLayout = use.after.layout;
+				state.visibleStages = use.after.stages;
+				state.visibleAccess = use.after.access;
+			}
+			else
+			{
+				state.visibleStages = 0;
+				state.visibleAccess = 0;
+			}
+		}
+		else if (layoutChange)
+		{
+			// the transition is a write only the stages of this use are ordered after
+			state.writeStages = use.access.stages;
+			state.readStages = use.access.stages;
+			state.visibleStages = use.access.stages;
+			state.visibleAccess = use.access.access;
+		}
+		else
+		{
+			state.readStages |= use.access.stages;
+			if (needed)
+			{
+				state.visibleStages |= use.access.stages;
+				state.visibleAccess |= use.access.access;
+			}
+		}
+		state.layout = newLayout;
+	}
+
+	void RenderGraph::BuildBarriers()
+	{
+		m_states.resize(m_resources.size());
+		for (size_t i = 0; i < m_resources.size(); ++i)
+		{
+			const RGAccess& last = m_resources[i].lastAccess;
+			State& state = m_states[i];
+			state = {};
+			state.layout = last.layout;
+			if (last.access & WRITE_ACCESS_MASK) {
+				state.writeStages = last.stages;
+				state.writeAccess = last.access & WRITE_ACCESS_MASK;
+			}
+			else {
+				state.readStages = last.stages;
+			}
+		}
+
+		// keep the barrier vectors of the previous frames
+		if (m_barriers.size() < m_schedule.size() + 1) {
+			m_barriers.resize(m_schedule.size() + 1);
+		}
+		for (size_t i = 0; i <= m_schedule.size(); ++i) {
+			m_barriers[i].clear();
+		}
+
+		for (size_t i = 0; i < m_schedule.size(); ++i)
+		{
+			for (const auto& use : m_passes[m_schedule[i]].uses) {
+				AddBarrier(m_barriers[i], m_states[use.res], m_resources[use.res], use);
+			}
+		}
+
+		BarrierBatch& tail = m_barriers[m_schedule.size()];
+		for (Handle h = 0; h < Handle(m_resources.size()); ++h)
+		{
+			Resource& res = m_resources[h];
+			if (res.output)
+			{
+				Use use{};
+				use.res = h;
+				use.access = res.finalAccess;
+				use.write = (res.finalAccess.access & WRITE_ACCESS_MASK) != 0;
+				use.read = !use.write;
+				AddBarrier(tail, m_states[h], res, use);
+			}
+			res.finalLayout = m_states[h].layout;
+		}
+	}
+
+	void RenderGraph::Compile()
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		m_schedule.clear();
+		for (auto& pass : m_passes) {
+			pass.successors.clear();
+			pass.dependencyCount = 0;
+		}
+
+		CullPasses();
+		BuildDependencies();
+		SchedulePasses();
+		BuildBarriers();
+
+		m_stats = {};
+		m_stats.passCount = uint32_t(m_schedule.size());
+		m_stats.culledPassCount = uint32_t(m_passes.size() - m_schedule.size());
+		for (size_t i = 0; i <= m_schedule.size(); ++i)
+		{
+			const BarrierBatch& batch = m_barriers[i];
+			if (batch.empty()) continue;
+			m_stats.barrierCount++;
+			m_stats.imageBarrierCount += uint32_t(batch.images.size());
+			m_stats.bufferBarrierCount += uint32_t(batch.buffers.size());
+		}
+		m_stats.compileTimeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		m_compiled = true;
+	}
+
+	void RenderGraph::Execute(VkCommandBuffer cmd)
+	{
+		if (!m_compiled) {
+			Compile();
+		}
+
+		auto record = [cmd](const BarrierBatch& batch)
+		{
+			if (batch.empty()) return;
+			vkCmdPipelineBarrier(cmd, batch.srcStages, batch.dstStages, 0,
+				0, nullptr,
+				uint32_t(batch.buffers.size()), batch.buffers.data(),
+				uint32_t(batch.images.size()), batch.images.data());
+		};
+
+		for (size_t i = 0; i < m_schedule.size(); ++i)
+		{
+			record(m_barriers[i]);
+			Pass& pass = m_passes[m_schedule[i]];
+			if (pass.fn) {
+				pass.fn(cmd);
+			}
+		}
+		record(m_barriers[m_schedule.size()]);
+
+		for (const auto& res : m_resources)
+		{
+			if (res.owner) {
+				res.owner->layout = res.finalLayout;
+			}
+		}
+	}
+
+	void RenderGraph::Reset()
+	{
+		m_resources.clear();
+		m_passes.clear();
+		m_schedule.clear();
+		m_compiled = false;
+	}
+}
@@ -0,0 +1,166 @@
+#ifndef VKJS_RENDER_GRAPH_H_
+#define VKJS_RENDER_GRAPH_H_
+
+#include "vkjs.h"
+#include <functional>
+
+namespace jvk {
+
+	// how a pass touches a resource, layout is ignored for buffers
+	struct RGAccess {
+		VkPipelineStageFlags	stages = 0;
+		VkAccessFlags			access = 0;
+		VkImageLayout			layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	};
+
+	namespace rg {
+		constexpr RGAccess None{ VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED };
+		constexpr RGAccess TransferRead{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+		constexpr RGAccess TransferWrite{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+		constexpr RGAccess VertexBufferRead{ VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT };
+		constexpr RGAccess IndexBufferRead{ VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT };
+		constexpr RGAccess IndirectRead{ VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT };
+		constexpr RGAccess UniformRead{ VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT };
+		constexpr RGAccess FragmentShaderRead{ VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		constexpr RGAccess ComputeShaderRead{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		constexpr RGAccess ComputeShaderWrite{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+		constexpr RGAccess ComputeShaderReadWrite{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+		constexpr RGAccess ColorAttachmentWrite{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		constexpr RGAccess DepthAttachmentWrite{ VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+		constexpr RGAccess DepthAttachmentRead{ VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+		constexpr RGAccess HostRead{ VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT };
+		constexpr RGAccess Present{ VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+	}
+
+	/**
+	* Frame graph over imported images and buffers. Passes declare what they read and write,
+	* Compile() culls passes whose results are never used, orders the rest by their dependencies
+	* and infers one merged pipeline barrier per pass, including the layout transitions.
+	* Compile() only touches CPU memory, Execute() records the barriers and the pass callbacks.
+	* Rebuild it every frame: Reset(), import, add passes, Compile(), Execute().
+	*/
+	class RenderGraph
+	{
+	public:
+		using Handle = uint32_t;
+		using ExecuteFn = std::function<void(VkCommandBuffer cmd)>;
+		static constexpr Handle INVALID_HANDLE = ~0u;
+
+		struct Stats {
+			uint32_t passCount = 0;
+			uint32_t culledPassCount = 0;
+			uint32_t barrierCount = 0;		// vkCmdPipelineBarrier calls
+			uint32_t imageBarrierCount = 0;
+			uint32_t bufferBarrierCount = 0;
+			float compileTimeMs = 0.0f;
+		};
+
+		class PassBuilder
+		{
+		public:
+			PassBuilder(RenderGraph* graph, uint32_t pass) : m_graph(graph), m_pass(pass) {}
+			PassBuilder& Read(Handle res, const RGAccess& access);
+			// discard: the previous contents are not needed, an image may start from UNDEFINED
+			PassBuilder& Write(Handle res, const RGAccess& access, bool discard = false);
+			/*
+			Attachment of a VkRenderPass that does the layout transitions itself.
+			after: layout at the end of the render pass and the stages/access its
+			external dependency already made the writes visible to.
+			*/
+			PassBuilder& Attachment(Handle res, const RGAccess& access, const RGAccess& after, bool discard = true);
+			// keeps the pass even if none of its writes is used
+			PassBuilder& SideEffect();
+		private:
+			RenderGraph*	m_graph;
+			uint32_t		m_pass;
+		};
+
+		RenderGraph() = default;
+		RenderGraph(const RenderGraph&) = delete;
+		RenderGraph& operator=(const RenderGraph&) = delete;
+
+		// lastAccess: the access before the graph, its layout is the current layout of the image
+		Handle ImportImage(const std::string& name, VkImage image, const VkImageSubresourceRange& range, const RGAccess& lastAccess);
+		// image->layout is used as the current layout and is updated by Execute
+		Handle ImportImage(const std::string& name, Image* image, const RGAccess& lastAccess = rg::None);
+		Handle ImportBuffer(const std::string& name, VkBuffer buffer, const RGAccess& lastAccess = rg::None);
+		// the resource is used after the graph with finalAccess, writers of it are never culled
+		void SetOutput(Handle res, const RGAccess& finalAccess);
+
+		PassBuilder AddPass(const std::string& name, ExecuteFn&& fn);
+
+		void Compile();
+		void Execute(VkCommandBuffer cmd);
+		// drops every pass and resource
+		void Reset();
+
+		const Stats& GetStats() const { return m_stats; }
+		// pass indices in execution order, culled passes are left out
+		const std::vector<uint32_t>& GetSchedule() const { return m_schedule; }
+		const std::string& GetPassName(uint32_t pass) const { return m_passes[pass].name; }
+		VkImageLayout GetFinalLayout(Handle res) const { return m_resources[res].finalLayout; }
+	private:
+		struct Resource {
+			std::string				name;
+			VkImage					image = VK_NULL_HANDLE;
+			VkBuffer				buffer = VK_NULL_HANDLE;
+			VkImageSubresourceRange	range = {};
+			Image*					owner = nullptr;
+			RGAccess				lastAccess;
+			RGAccess				finalAccess;
+			VkImageLayout			finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			bool					output = false;
+		};
+		struct Use {
+			Handle			res;
+			RGAccess		access;
+			RGAccess		after;			// attachments only
+			bool			read;
+			bool			write;
+			bool			discard;
+			bool			attachment;
+		};
+		struct Pass {
+			std::string				name;
+			ExecuteFn				fn;
+			std::vector<Use>		uses;
+			std::vector<uint32_t>	successors;
+			uint32_t				dependencyCount = 0;
+			bool					sideEffect = false;
+			bool					live = false;
+		};
+		struct BarrierBatch {
+			VkPipelineStageFlags				srcStages = 0;
+			VkPipelineStageFlags				dstStages = 0;
+			std::vector<VkImageMemoryBarrier>	images;
+			std::vector<VkBufferMemoryBarrier>	buffers;
+			void clear() { srcStages = dstStages = 0; images.clear(); buffers.clear(); }
+			bool empty() const { return srcStages == 0; }
+		};
+		// access state of a resource while walking the schedule
+		struct State {
+			VkImageLayout			layout;
+			VkPipelineStageFlags	writeStages;	// last write or layout transition
+			VkAccessFlags			writeAccess;
+			VkPipelineStageFlags	readStages;		// reads since the last write
+			VkPipelineStageFlags	visibleStages;	// stages and access the last write is visible to
+			VkAccessFlags			visibleAccess;
+		};
+
+		Use& GetUse(uint32_t pass, Handle res);
+		void CullPasses();
+		void BuildDependencies();
+		void SchedulePasses();
+		void AddBarrier(BarrierBatch& batch, State& state, const Resource& res, const Use& use);
+		void BuildBarriers();
+
+		std::vector<Resource>		m_resources;
+		std::vector<Pass>			m_passes;
+		std::vector<uint32_t>		m_schedule;
+		std::vector<BarrierBatch>	m_barriers;		// recorded before m_schedule[i], the last one after every pass
+		std::vector<State>			m_states;
+		Stats						m_stats;
+		bool						m_compiled = false;
+	};
+}
+#endif // !VKJS_RENDER_GRAPH_H_
@@ -103,12 +103,15 @@ namespace jvk {
 
         for (auto& it : out)
         {
-            for (auto& bind : it.bindings) {
-                if (bind.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER && it.binding_typename[bind.binding].substr(0, 3) == "dyn")
+            for (size_t i_binding(0); i_binding < it.bindings.size(); ++i_binding) {
+                auto& bind = it.bindings[i_binding];
+                // binding_typename is parallel to bindings, binding numbers may have gaps
+                const bool dynamic = it.binding_typename[i_binding].substr(0, 3) == "dyn";
+                if (bind.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER && dynamic)
                 {   
                     bind.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
                 }
-                else if (bind.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER && it.binding_typename[bind.binding].substr(0, 3) == "dyn")
+                else if (bind.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER && dynamic)
                 {
                     bind.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
                 }
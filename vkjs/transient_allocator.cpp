@@ -0,0 +1,246 @@
+#include "transient_allocator.h"
+#include "vkcheck.h"
+#include <algorithm>
+#include <numeric>
+
+namespace jvk {
+
+	static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	void pack_transient_lifetimes(const std::vector<TransientRequest>& requests, std::vector<TransientPlacement>& placements, std::vector<TransientHeap>& heaps)
+	{
+		placements.assign(requests.size(), {});
+		heaps.clear();
+
+		std::vector<uint32_t> order(requests.size());
+		std::iota(order.begin(), order.end(), 0u);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return requests[a].size > requests[b].size; });
+
+		std::vector<std::vector<uint32_t>> members;
+		std::vector<std::pair<VkDeviceSize, VkDeviceSize>> busy;
+
+		for (uint32_t i : order)
+		{
+			const TransientRequest& r = requests[i];
+			assert(r.alignment > 0 && r.firstPass <= r.lastPass);
+
+			// the heap that has to grow the least, a new heap would grow by the full size
+			uint32_t best = ~0u;
+			VkDeviceSize bestOffset = 0;
+			VkDeviceSize bestGrowth = r.size;
+			for (uint32_t h = 0; h < uint32_t(heaps.size()); ++h)
+			{
+				const TransientHeap& heap = heaps[h];
+				if (heap.lazy != r.lazy || (heap.memoryTypeBits & r.memoryTypeBits) == 0) continue;
+
+				// byte ranges of the heap used while r is alive
+				busy.clear();
+				for (uint32_t j : members[h])
+				{
+					const TransientRequest& o = requests[j];
+					if (o.firstPass <= r.lastPass && r.firstPass <= o.lastPass) {
+						busy.emplace_back(placements[j].offset, placements[j].offset + o.size);
+					}
+				}
+				std::sort(busy.begin(), busy.end());
+
+				VkDeviceSize offset = 0;
+				for (const auto& b : busy)
+				{
+					if (align_up(offset, r.alignment) + r.size <= b.first) break;
+					offset = std::max(offset, b.second);
+				}
+				offset = align_up(offset, r.alignment);
+
+				const VkDeviceSize end = offset + r.size;
+				const VkDeviceSize growth = end > heap.size ? end - heap.size : 0;
+				if (growth < bestGrowth || (best == ~0u && growth == bestGrowth))
+				{
+					best = h;
+					bestOffset = offset;
+					bestGrowth = growth;
+				}
+			}
+
+			if (best == ~0u)
+			{
+				best = uint32_t(heaps.size());
+				heaps.push_back({ 0, r.alignment, r.memoryTypeBits, r.lazy });
+				members.emplace_back();
+			}
+
+			TransientHeap& heap = heaps[best];
+			placements[i] = { best, bestOffset };
+			members[best].push_back(i);
+			heap.size = std::max(heap.size, bestOffset + r.size);
+			heap.memoryTypeBits &= r.memoryTypeBits;
+			heap.alignment = std::max(heap.alignment, r.alignment);
+		}
+	}
+
+	TransientAllocator::~TransientAllocator()
+	{
+		Release();
+	}
+
+	void TransientAllocator::AddColorAttachment(Image* result, VkFormat format, const VkExtent3D& extent, VkSampleCountFlagBits samples, uint32_t firstPass, uint32_t lastPass)
+	{
+		// same usage as Device::create_color_attachment
+		const VkImageUsageFlags usage = (samples > VK_SAMPLE_COUNT_1_BIT) ?
+			VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT :
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+		Add(result, format, extent, samples, usage, VK_IMAGE_ASPECT_COLOR_BIT, firstPass, lastPass);
+		result->final_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	}
+
+	void TransientAllocator::AddDepthStencilAttachment(Image* result, VkFormat format, const VkExtent3D& extent, VkSampleCountFlagBits samples, uint32_t firstPass, uint32_t lastPass)
+	{
+		const VkImageUsageFlags usage = (samples > VK_SAMPLE_COUNT_1_BIT) ?
+			VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT :
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+		Add(result, format, extent, samples, usage, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT, firstPass, lastPass);
+		result->final_layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	}
+
+	void TransientAllocator::Add(Image* result, VkFormat format, const VkExtent3D& extent, VkSampleCountFlagBits samples, VkImageUsageFlags usage, VkImageAspectFlags aspect, uint32_t firstPass, uint32_t lastPass)
+	{
+		assert(result && m_heaps.empty());
+
+		VkImageCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		info.imageType = VK_IMAGE_TYPE_2D;
+		info.format = format;
+		info.extent = extent;
+		info.mipLevels = 1;
+		info.arrayLayers = 1;
+		info.samples = samples;
+		info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		info.usage = usage;
+		info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		m_entries.push_back({ result, info, aspect, firstPass, lastPass });
+	}
+
+	VkResult TransientAllocator::Allocate()
+	{
+		assert(m_heaps.empty());
+
+		VmaAllocationCreateInfo lazyInfo = {};
+		lazyInfo.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+
+		std::vector<TransientRequest> requests;
+		requests.reserve(m_entries.size());
+		for (auto& e : m_entries)
+		{
+			VkResult err = vkCreateImage(*m_device, &e.info, nullptr, &e.image->image);
+			if (err) {
+				return err;
+			}
+
+			VkMemoryRequirements req;
+			vkGetImageMemoryRequirements(*m_device, e.image->image, &req);
+
+			uint32_t lazyType = 0;
+			const bool lazy = (e.info.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) &&
+				vmaFindMemoryTypeIndex(m_device->allocator, req.memoryTypeBits, &lazyInfo, &lazyType) == VK_SUCCESS;
+
+			requests.push_back({ req.size, req.alignment, req.memoryTypeBits, e.firstPass, e.lastPass, lazy });
+			m_stats.requestedBytes += req.size;
+		}
+
+		std::vector<TransientPlacement> placements;
+		std::vector<TransientHeap> heaps;
+		pack_transient_lifetimes(requests, placements, heaps);
+
+		for (const auto& heap : heaps)
+		{
+			VkMemoryRequirements req = {};
+			req.size = heap.size;
+			req.alignment = heap.alignment;
+			req.memoryTypeBits = heap.memoryTypeBits;
+
+			VmaAllocationCreateInfo ai = {};
+			if (heap.lazy) {
+				ai.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+			}
+			else {
+				ai.usage = VMA_MEMORY_USAGE_UNKNOWN;
+				ai.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			}
+			ai.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+
+			VmaAllocation mem = VK_NULL_HANDLE;
+			VkResult err = vmaAllocateMemory(m_device->allocator, &req, &ai, &mem, nullptr);
+			if (err) {
+				return err;
+			}
+			m_heaps.push_back(mem);
+			m_stats.allocatedBytes += heap.size;
+			m_stats.lazyBytes += heap.lazy ? heap.size : 0;
+		}
+		m_stats.heapCount = uint32_t(heaps.size());
+		m_stats.imageCount = uint32_t(m_entries.size());
+
+		for (size_t i = 0; i < m_entries.size(); ++i)
+		{
+			const Entry& e = m_entries[i];
+			Image* result = e.image;
+			VK_CHECK(vmaBindImageMemory2(m_device->allocator, m_heaps[placements[i].heap], placements[i].offset, result->image, nullptr));
+
+			result->device_ = m_device;
+			result->mem = m_heaps[placements[i].heap];
+			result->extent = e.info.extent;
+			result->format = e.info.format;
+			result->type = e.info.imageType;
+			result->written = false;
+			result->levels = 1;
+			result->faces = 1;
+			result->layers = 1;
+			result->tiling = e.info.tiling;
+			result->samples = e.info.samples;
+			result->usage = e.info.usage;
+			result->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			result->aspect_flags = e.aspect;
+			// the heap is not owned by the image, Device::destroy_image skips it
+			result->alias = true;
+
+			VkImageViewCreateInfo vinfo = {};
+			vinfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			vinfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			vinfo.image = result->image;
+			vinfo.format = e.info.format;
+			vinfo.subresourceRange.levelCount = 1;
+			vinfo.subresourceRange.layerCount = 1;
+			vinfo.subresourceRange.aspectMask = e.aspect;
+			VkResult err = vkCreateImageView(*m_device, &vinfo, nullptr, &result->view);
+			if (err) {
+				return err;
+			}
+			result->setup_descriptor();
+		}
+
+		return VK_SUCCESS;
+	}
+
+	void TransientAllocator::Release()
+	{
+		for (auto& e : m_entries)
+		{
+			if (e.image->view) vkDestroyImageView(*m_device, e.image->view, nullptr);
+			if (e.image->image) vkDestroyImage(*m_device, e.image->image, nullptr);
+			*e.image = {};
+		}
+		for (auto mem : m_heaps)
+		{
+			vmaFreeMemory(m_device->allocator, mem);
+		}
+		m_entries.clear();
+		m_heaps.clear();
+		m_stats = {};
+	}
+}
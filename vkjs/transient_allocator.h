@@ -0,0 +1,85 @@
+#ifndef VKJS_TRANSIENT_ALLOCATOR_H_
+#define VKJS_TRANSIENT_ALLOCATOR_H_
+
+#include "vkjs.h"
+
+namespace jvk {
+
+	struct TransientRequest {
+		VkDeviceSize	size;
+		VkDeviceSize	alignment;
+		uint32_t		memoryTypeBits;
+		uint32_t		firstPass;		// inclusive
+		uint32_t		lastPass;		// inclusive
+		bool			lazy;			// wants lazily allocated memory
+	};
+
+	struct TransientHeap {
+		VkDeviceSize	size;
+		VkDeviceSize	alignment;
+		uint32_t		memoryTypeBits;
+		bool			lazy;
+	};
+
+	struct TransientPlacement {
+		uint32_t		heap;
+		VkDeviceSize	offset;
+	};
+
+	/*
+	Packs the requests into heaps, requests with overlapping pass ranges never share bytes.
+	Largest first, every request goes to the lowest free offset of the compatible heap that grows the least.
+	CPU only, placements[i] belongs to requests[i].
+	*/
+	void pack_transient_lifetimes(const std::vector<TransientRequest>& requests, std::vector<TransientPlacement>& placements, std::vector<TransientHeap>& heaps);
+
+	/**
+	* Render targets that are only alive for a few passes of the frame. Each target declares
+	* the range of passes it is used in, targets with disjoint ranges are bound to the same memory.
+	* Multisampled targets go to lazily allocated memory if the device has any.
+	* The images are aliases: their contents are undefined at their first pass, which has to
+	* start from VK_IMAGE_LAYOUT_UNDEFINED. Destroy them with Release(), not Device::destroy_image.
+	*/
+	class TransientAllocator
+	{
+	public:
+		struct Stats {
+			VkDeviceSize	requestedBytes = 0;		// without aliasing
+			VkDeviceSize	allocatedBytes = 0;
+			VkDeviceSize	lazyBytes = 0;			// part of allocatedBytes
+			uint32_t		imageCount = 0;
+			uint32_t		heapCount = 0;
+		};
+
+		explicit TransientAllocator(Device* pDevice) : m_device(pDevice) {}
+		TransientAllocator() = delete;
+		TransientAllocator(const TransientAllocator&) = delete;
+		TransientAllocator& operator=(const TransientAllocator&) = delete;
+		~TransientAllocator();
+
+		// result is valid after Allocate()
+		void AddColorAttachment(Image* result, VkFormat format, const VkExtent3D& extent, VkSampleCountFlagBits samples, uint32_t firstPass, uint32_t lastPass);
+		void AddDepthStencilAttachment(Image* result, VkFormat format, const VkExtent3D& extent, VkSampleCountFlagBits samples, uint32_t firstPass, uint32_t lastPass);
+		VkResult Allocate();
+		// destroys every image and heap, the next Add starts a new set
+		void Release();
+
+		const Stats& GetStats() const { return m_stats; }
+	private:
+		struct Entry {
+			Image*				image;
+			VkImageCreateInfo	info;
+			VkImageAspectFlags	aspect;
+			uint32_t			firstPass;
+			uint32_t			lastPass;
+		};
+
+		void Add(Image* result, VkFormat format, const VkExtent3D& extent, VkSampleCountFlagBits samples, VkImageUsageFlags usage, VkImageAspectFlags aspect, uint32_t firstPass, uint32_t lastPass);
+
+		Device*						m_device;
+		std::vector<Entry>			m_entries;
+		std::vector<VmaAllocation>	m_heaps;
+		Stats						m_stats;
+	};
+}
+#endif // !VKJS_TRANSIENT_ALLOCATOR_H_
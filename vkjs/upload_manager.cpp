@@ -0,0 +1,360 @@
+#include "upload_manager.h"
+#include "VulkanInitializers.hpp"
+#include "vkcheck.h"
+#include <algorithm>
+
+namespace jvk {
+
+	// covers the 4 byte and the texel block alignment of buffer-image copies
+	static const VkDeviceSize STAGING_ALIGNMENT = 16;
+	// a batch is submitted on its own once it holds this many staging blocks
+	static const VkDeviceSize MAX_BLOCKS_PER_BATCH = 4;
+
+	UploadManager::UploadManager(Device* pDevice, VkDeviceSize stagingBlockSize) :
+		m_device(pDevice),
+		m_family(pDevice->queue_family_indices.transfer),
+		m_graphicsFamily(pDevice->queue_family_indices.graphics),
+		m_blockSize(stagingBlockSize)
+	{
+		if (pDevice->has_dedicated_transfer_queue())
+		{
+			m_queue = pDevice->get_transfer_queue();
+		}
+		if (m_queue == VK_NULL_HANDLE)
+		{
+			m_queue = pDevice->graphics_queue;
+			m_family = m_graphicsFamily;
+		}
+
+		VK_CHECK(pDevice->create_command_pool(m_family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, &m_pool));
+
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+		VkSemaphoreCreateInfo sci = vks::initializers::semaphoreCreateInfo();
+		sci.pNext = &typeInfo;
+		VK_CHECK(vkCreateSemaphore(*pDevice, &sci, nullptr, &m_timeline));
+	}
+
+	UploadManager::~UploadManager()
+	{
+		Wait(m_lastTicket);
+		for (auto& batch : m_submitted)
+		{
+			for (auto& buf : batch.staging)
+			{
+				m_device->destroy_buffer(&buf);
+			}
+		}
+		for (auto& buf : m_open.staging)
+		{
+			m_device->destroy_buffer(&buf);
+		}
+		vkDestroyCommandPool(*m_device, m_pool, nullptr);
+		vkDestroySemaphore(*m_device, m_timeline, nullptr);
+	}
+
+	VkDeviceSize UploadManager::Stage(const void* data, VkDeviceSize size, VkBuffer* buffer)
+	{
+		VkDeviceSize offset = (m_blockOffset + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+		if (m_open.staging.empty() || offset + size > m_open.staging.back().size)
+		{
+			if (m_open.stagedBytes >= MAX_BLOCKS_PER_BATCH * m_blockSize)
+			{
+				SubmitLocked();
+			}
+			Buffer block;
+			VK_CHECK(m_device->create_staging_buffer(std::max(m_blockSize, size), &block));
+			m_open.staging.push_back(block);
+			offset = 0;
+		}
+
+		Buffer& block = m_open.staging.back();
+		block.copyTo(offset, size, data);
+		m_blockOffset = offset + size;
+		m_open.stagedBytes += size;
+		*buffer = block.buffer;
+
+		return offset;
+	}
+
+	void UploadManager::UploadBuffer(const Buffer* dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+	{
+		assert(dst && dst->buffer && (dstOffset + size) <= dst->size);
+		if (size == 0) return;
+
+		std::lock_guard<std::mutex> lck(m_mutex);
+
+		BufferCopy copy{};
+		copy.dst = dst->buffer;
+		copy.region.srcOffset = Stage(data, size, &copy.src);
+		copy.region.dstOffset = dstOffset;
+		copy.region.size = size;
+		copy.dstStage = dstStage;
+		copy.dstAccess = dstAccess;
+		m_open.buffers.push_back(copy);
+	}
+
+	void UploadManager::UploadImage(Image* dst, const void* data, VkDeviceSize size, const Image::UploadCallbackFn& regions, bool generateMips)
+	{
+		assert(dst && dst->image);
+
+		std::lock_guard<std::mutex> lck(m_mutex);
+
+		ImageCopy copy{};
+		copy.image = *dst;
+		copy.generateMips = generateMips && dst->levels > 1;
+		const VkDeviceSize baseOffset = Stage(data, size, &copy.src);
+
+		const uint32_t levels = copy.generateMips ? 1 : dst->levels;
+		Image::UploadInfo ui{};
+		for (uint32_t layer = 0; layer < dst->layers; ++layer) {
+			for (uint32_t face = 0; face < dst->faces; ++face) {
+				for (uint32_t level = 0; level < levels; ++level) {
+					regions(layer, face, level, &ui);
+
+					VkBufferImageCopy region = {};
+					region.imageSubresource.aspectMask = dst->aspect_flags;
+					region.imageSubresource.mipLevel = level;
+					region.imageSubresource.baseArrayLayer = layer * dst->faces + face;
+					region.imageSubresource.layerCount = 1;
+					region.imageExtent = ui.extent;
+					region.bufferOffset = baseOffset + ui.offset;
+					copy.regions.push_back(region);
+				}
+			}
+		}
+		m_open.images.push_back(std::move(copy));
+
+		// the layout the image has by the time anyone can use it
+		dst->layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
+
+	UploadManager::Ticket UploadManager::Submit()
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+		return SubmitLocked();
+	}
+
+	UploadManager::Ticket UploadManager::SubmitLocked()
+	{
+		Retire();
+
+		if (m_open.buffers.empty() && m_open.images.empty())
+		{
+			return 0;
+		}
+
+		Batch& batch = m_open;
+		VK_CHECK(m_device->create_command_buffer(m_pool, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, false, &batch.cmd, true));
+		RecordBatch(batch);
+		VK_CHECK(vkEndCommandBuffer(batch.cmd));
+
+		batch.ticket = ++m_lastTicket;
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &batch.ticket;
+
+		VkSubmitInfo submit = vks::initializers::submitInfo();
+		submit.pNext = &timelineInfo;
+		submit.commandBufferCount = 1;
+		submit.pCommandBuffers = &batch.cmd;
+		submit.signalSemaphoreCount = 1;
+		submit.pSignalSemaphores = &m_timeline;
+		{
+			std::lock_guard<std::mutex> queueLock(m_device->submit_queue_mutex);
+			VK_CHECK(vkQueueSubmit(m_queue, 1, &submit, VK_NULL_HANDLE));
+		}
+
+		const Ticket ticket = batch.ticket;
+		m_submitted.push_back(std::move(m_open));
+		m_open = {};
+		m_blockOffset = 0;
+
+		return ticket;
+	}
+
+	void UploadManager::RecordBatch(Batch& batch)
+	{
+		const bool transfer = HasOwnershipTransfer();
+		const uint32_t srcFamily = transfer ? m_family : VK_QUEUE_FAMILY_IGNORED;
+		const uint32_t dstFamily = transfer ? m_graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		imageBarriers.reserve(batch.images.size());
+		for (const auto& it : batch.images)
+		{
+			VkImageMemoryBarrier ibar = it.image.get_layout_transition_barrier(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+			ibar.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			ibar.subresourceRange.layerCount = it.image.layers * it.image.faces;
+			imageBarriers.push_back(ibar);
+		}
+		if (!imageBarriers.empty())
+		{
+			vkCmdPipelineBarrier(batch.cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				0, nullptr, 0, nullptr, uint32_t(imageBarriers.size()), imageBarriers.data());
+		}
+
+		for (const auto& it : batch.buffers)
+		{
+			vkCmdCopyBuffer(batch.cmd, it.src, it.dst, 1, &it.region);
+		}
+		for (const auto& it : batch.images)
+		{
+			vkCmdCopyBufferToImage(batch.cmd, it.src, it.image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, uint32_t(it.regions.size()), it.regions.data());
+		}
+
+		// release to the graphics family, or make the data visible to the first use on the same queue
+		VkPipelineStageFlags dstStages = 0;
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		bufferBarriers.reserve(batch.buffers.size());
+		for (const auto& it : batch.buffers)
+		{
+			VkBufferMemoryBarrier bbar = vks::initializers::bufferMemoryBarrier();
+			bbar.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bbar.dstAccessMask = transfer ? 0 : it.dstAccess;
+			bbar.srcQueueFamilyIndex = srcFamily;
+			bbar.dstQueueFamilyIndex = dstFamily;
+			bbar.buffer = it.dst;
+			bbar.offset = it.region.dstOffset;
+			bbar.size = it.region.size;
+			bufferBarriers.push_back(bbar);
+			dstStages |= it.dstStage;
+		}
+		for (size_t i = 0; i < batch.images.size(); ++i)
+		{
+			const ImageCopy& it = batch.images[i];
+			VkImageMemoryBarrier& ibar = imageBarriers[i];
+			ibar.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			ibar.newLayout = it.generateMips ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			ibar.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			ibar.dstAccessMask = transfer ? 0 : (it.generateMips ? VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_SHADER_READ_BIT);
+			ibar.srcQueueFamilyIndex = srcFamily;
+			ibar.dstQueueFamilyIndex = dstFamily;
+			dstStages |= it.generateMips ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		}
+		if (transfer || dstStages == 0)
+		{
+			// the dst stage of a release is ignored, the transfer family may not support the real one
+			dstStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		}
+		vkCmdPipelineBarrier(batch.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStages, 0,
+			0, nullptr,
+			uint32_t(bufferBarriers.size()), bufferBarriers.data(),
+			uint32_t(imageBarriers.size()), imageBarriers.data());
+	}
+
+	UploadManager::Ticket UploadManager::RecordAcquire(VkCommandBuffer cmd)
+	{
+		std::lock_guard<std::mutex> lck(m_mutex);
+
+		const bool transfer = HasOwnershipTransfer();
+		Ticket ticket = 0;
+		VkPipelineStageFlags dstStages = 0;
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		std::vector<Image*> mipImages;
+
+		for (auto& batch : m_submitted)
+		{
+			if (batch.acquired) continue;
+			batch.acquired = true;
+			ticket = std::max(ticket, batch.ticket);
+
+			for (auto& it : batch.images)
+			{
+				if (it.generateMips) mipImages.push_back(&it.image);
+			}
+			if (!transfer) continue;
+
+			for (const auto& it : batch.buffers)
+			{
+				VkBufferMemoryBarrier bbar = vks::initializers::bufferMemoryBarrier();
+				bbar.srcAccessMask = 0;
+				bbar.dstAccessMask = it.dstAccess;
+				bbar.srcQueueFamilyIndex = m_family;
+				bbar.dstQueueFamilyIndex = m_graphicsFamily;
+				bbar.buffer = it.dst;
+				bbar.offset = it.region.dstOffset;
+				bbar.size = it.region.size;
+				bufferBarriers.push_back(bbar);
+				dstStages |= it.dstStage;
+			}
+			for (const auto& it : batch.images)
+			{
+				const VkImageLayout layout = it.generateMips ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				VkImageMemoryBarrier ibar = it.image.get_layout_transition_barrier(layout, 0,
+					it.generateMips ? VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_SHADER_READ_BIT);
+				ibar.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				ibar.subresourceRange.layerCount = it.image.layers * it.image.faces;
+				ibar.srcQueueFamilyIndex = m_family;
+				ibar.dstQueueFamilyIndex = m_graphicsFamily;
+				imageBarriers.push_back(ibar);
+				dstStages |= it.generateMips ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			}
+		}
+
+		if (!bufferBarriers.empty() || !imageBarriers.empty())
+		{
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages, 0,
+				0, nullptr,
+				uint32_t(bufferBarriers.size()), bufferBarriers.data(),
+				uint32_t(imageBarriers.size()), imageBarriers.data());
+		}
+		for (Image* image : mipImages)
+		{
+			image->record_generate_mipmaps(cmd);
+		}
+
+		Retire();
+
+		return ticket;
+	}
+
+	bool UploadManager::IsComplete(Ticket ticket) const
+	{
+		uint64_t value = 0;
+		VK_CHECK(vkGetSemaphoreCounterValue(*m_device, m_timeline, &value));
+		return value >= ticket;
+	}
+
+	void UploadManager::Wait(Ticket ticket) const
+	{
+		if (ticket == 0) return;
+
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &m_timeline;
+		waitInfo.pValues = &ticket;
+		VK_CHECK(vkWaitSemaphores(*m_device, &waitInfo, UINT64_MAX));
+	}
+
+	void UploadManager::Retire()
+	{
+		uint64_t value = 0;
+		VK_CHECK(vkGetSemaphoreCounterValue(*m_device, m_timeline, &value));
+
+		for (auto& batch : m_submitted)
+		{
+			if (batch.ticket > value) break;
+			for (auto& buf : batch.staging)
+			{
+				m_device->destroy_buffer(&buf);
+			}
+			batch.staging.clear();
+			if (batch.cmd != VK_NULL_HANDLE)
+			{
+				vkFreeCommandBuffers(*m_device, m_pool, 1, &batch.cmd);
+				batch.cmd = VK_NULL_HANDLE;
+			}
+		}
+		while (!m_submitted.empty() && m_submitted.front().ticket <= value && m_submitted.front().acquired)
+		{
+			m_submitted.pop_front();
+		}
+	}
+}
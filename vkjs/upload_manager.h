@@ -0,0 +1,89 @@
+#ifndef VKJS_UPLOAD_MANAGER_H_
+#define VKJS_UPLOAD_MANAGER_H_
+
+#include "vkjs.h"
+
+namespace jvk {
+
+	/**
+	* Batches buffer and image uploads into one command buffer per Submit on the dedicated
+	* transfer queue, or on the graphics queue if there is none. Every batch signals its
+	* ticket on a timeline semaphore, the CPU never waits for it.
+	* With a separate transfer family the resources are released on the transfer queue and
+	* RecordAcquire records the matching acquire barriers into a graphics command buffer.
+	* That submission has to wait for GetSemaphore() to reach the returned ticket.
+	* Staging memory of a batch is freed once its ticket has been reached.
+	*/
+	class UploadManager
+	{
+	public:
+		using Ticket = uint64_t;
+
+		explicit UploadManager(Device* pDevice, VkDeviceSize stagingBlockSize = 64ULL * 1024 * 1024);
+		UploadManager() = delete;
+		UploadManager(const UploadManager&) = delete;
+		UploadManager& operator=(const UploadManager&) = delete;
+		~UploadManager();
+
+		// dstStage, dstAccess: first use of the buffer on the graphics queue
+		void UploadBuffer(const Buffer* dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+		/*
+		data holds every level/layer/face, regions are located by the callback like with Image::upload.
+		The image ends up in SHADER_READ_ONLY_OPTIMAL. With generateMips only level 0 is copied,
+		the rest is blitted on the graphics queue by RecordAcquire.
+		*/
+		void UploadImage(Image* dst, const void* data, VkDeviceSize size, const Image::UploadCallbackFn& regions, bool generateMips = false);
+
+		// submits everything queued since the last call, returns 0 if there was nothing to submit
+		Ticket Submit();
+		// records the acquire side of every submitted batch not acquired yet, returns the ticket to wait for or 0
+		Ticket RecordAcquire(VkCommandBuffer cmd);
+		bool IsComplete(Ticket ticket) const;
+		void Wait(Ticket ticket) const;
+
+		VkSemaphore GetSemaphore() const { return m_timeline; }
+		bool HasOwnershipTransfer() const { return m_family != m_graphicsFamily; }
+	private:
+		struct BufferCopy {
+			VkBuffer				dst;
+			VkBuffer				src;
+			VkBufferCopy			region;
+			VkPipelineStageFlags	dstStage;
+			VkAccessFlags			dstAccess;
+		};
+		struct ImageCopy {
+			Image							image;		// handle copy, the caller's Image may be moved meanwhile
+			VkBuffer						src;
+			std::vector<VkBufferImageCopy>	regions;
+			bool							generateMips;
+		};
+		struct Batch {
+			Ticket						ticket = 0;
+			VkCommandBuffer				cmd = VK_NULL_HANDLE;
+			std::vector<Buffer>			staging;
+			std::vector<BufferCopy>		buffers;
+			std::vector<ImageCopy>		images;
+			VkDeviceSize				stagedBytes = 0;
+			bool						acquired = false;
+		};
+
+		VkDeviceSize Stage(const void* data, VkDeviceSize size, VkBuffer* buffer);
+		Ticket SubmitLocked();
+		void RecordBatch(Batch& batch);
+		void Retire();
+
+		Device*				m_device;
+		VkQueue				m_queue = VK_NULL_HANDLE;
+		uint32_t			m_family;
+		uint32_t			m_graphicsFamily;
+		VkCommandPool		m_pool = VK_NULL_HANDLE;
+		VkSemaphore			m_timeline = VK_NULL_HANDLE;
+		Ticket				m_lastTicket = 0;
+		VkDeviceSize		m_blockSize;
+		VkDeviceSize		m_blockOffset = 0;
+		Batch				m_open;
+		std::deque<Batch>	m_submitted;
+		std::mutex			m_mutex;
+	};
+}
+#endif // !VKJS_UPLOAD_MANAGER_H_
@@ -0,0 +1,107 @@
+#include "upload_ring.h"
+#include "vkcheck.h"
+#include <algorithm>
+
+namespace jvk {
+
+	static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	UploadRing::UploadRing(Device* pDevice, VkDeviceSize frameSize, uint32_t frameCount, VkBufferUsageFlags usage, bool coherent) :
+		m_device(pDevice),
+		m_frameCount(frameCount),
+		m_coherent(coherent)
+	{
+		assert(frameCount > 0);
+
+		const VkPhysicalDeviceLimits& limits = pDevice->vkbPhysicalDevice.properties.limits;
+		m_uniformAlignment = std::max(VkDeviceSize(16), limits.minUniformBufferOffsetAlignment);
+		m_storageAlignment = std::max(VkDeviceSize(16), limits.minStorageBufferOffsetAlignment);
+
+		// every partition starts at an offset valid for any allocation
+		const VkDeviceSize partitionAlignment = std::max({ m_uniformAlignment, m_storageAlignment, limits.nonCoherentAtomSize, VkDeviceSize(256) });
+		m_frameSize = align_up(frameSize, partitionAlignment);
+
+		VkMemoryPropertyFlags memFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		if (coherent)
+		{
+			memFlags |= VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		}
+		VkResult result = pDevice->create_buffer(usage, memFlags, m_frameSize * frameCount, &m_buffer);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Cannot create upload ring; VkResult: " + std::to_string(result));
+		}
+		if (!m_buffer.map())
+		{
+			throw std::runtime_error("Cannot map upload ring");
+		}
+	}
+
+	UploadRing::~UploadRing()
+	{
+		if (m_buffer.buffer != VK_NULL_HANDLE)
+		{
+			m_device->destroy_buffer(&m_buffer);
+		}
+	}
+
+	void UploadRing::BeginFrame(uint32_t frame)
+	{
+		assert(frame < m_frameCount);
+
+		m_frame = frame;
+		m_head.store(0, std::memory_order_relaxed);
+	}
+
+	void UploadRing::Flush()
+	{
+		const VkDeviceSize used = m_head.load(std::memory_order_acquire);
+		m_peak = std::max(m_peak, used);
+		if (m_coherent || used == 0)
+		{
+			return;
+		}
+		VK_CHECK(vmaFlushAllocation(m_device->allocator, m_buffer.mem, m_frame * m_frameSize, used));
+	}
+
+	UploadRing::Allocation UploadRing::Allocate(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+		VkDeviceSize head = m_head.load(std::memory_order_relaxed);
+		VkDeviceSize offset;
+		do
+		{
+			offset = align_up(head, alignment);
+			if (offset + size > m_frameSize)
+			{
+				return {};
+			}
+		} while (!m_head.compare_exchange_weak(head, offset + size, std::memory_order_relaxed));
+
+		Allocation out;
+		out.buffer = m_buffer.buffer;
+		out.offset = m_frame * m_frameSize + offset;
+		out.size = size;
+		out.data = m_buffer.mapped + out.offset;
+		return out;
+	}
+
+	UploadRing::Allocation UploadRing::Upload(const void* data, VkDeviceSize size, VkDeviceSize alignment)
+	{
+		Allocation out = Allocate(size, alignment);
+		if (out && size > 0)
+		{
+			memcpy(out.data, data, size);
+		}
+		return out;
+	}
+
+	void UploadRing::SetName(const std::string& name)
+	{
+		m_device->set_buffer_name(&m_buffer, name);
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef VKJS_UPLOAD_RING_H_
+#define VKJS_UPLOAD_RING_H_
+
+#include "vkjs.h"
+#include <atomic>
+
+namespace jvk {
+
+	/**
+	* Persistently mapped, host visible buffer for per-frame uniform, storage and vertex data.
+	* The buffer is split into one partition per frame in flight, a partition is reset
+	* by BeginFrame once the fence of its previous use has been waited for.
+	* Allocate/Upload are lock-free and may be called from any thread.
+	* Bind the returned offsets as dynamic descriptor offsets or vertex buffer offsets.
+	*/
+	class UploadRing
+	{
+	public:
+		struct Allocation {
+			VkBuffer		buffer = VK_NULL_HANDLE;
+			VkDeviceSize	offset = 0;			// from the start of the buffer
+			VkDeviceSize	size = 0;
+			uint8_t*		data = nullptr;
+			explicit operator bool() const { return data != nullptr; }
+		};
+
+		UploadRing(Device* pDevice, VkDeviceSize frameSize, uint32_t frameCount, VkBufferUsageFlags usage, bool coherent = true);
+		UploadRing() = delete;
+		UploadRing(const UploadRing&) = delete;
+		UploadRing& operator=(const UploadRing&) = delete;
+		~UploadRing();
+
+		void BeginFrame(uint32_t frame);
+		// makes the writes of the current frame visible to the device, no-op on coherent memory
+		void Flush();
+
+		// returns an empty allocation if the partition of the frame is full
+		Allocation Allocate(VkDeviceSize size, VkDeviceSize alignment);
+		Allocation Upload(const void* data, VkDeviceSize size, VkDeviceSize alignment);
+
+		Allocation AllocateUniform(VkDeviceSize size) { return Allocate(size, m_uniformAlignment); }
+		Allocation AllocateStorage(VkDeviceSize size) { return Allocate(size, m_storageAlignment); }
+		template<class T> Allocation UploadUniform(const T& data) { return Upload(&data, sizeof(T), m_uniformAlignment); }
+		template<class T> Allocation UploadStorage(const T* data, size_t count) { return Upload(data, count * sizeof(T), m_storageAlignment); }
+
+		VkBuffer GetBuffer() const { return m_buffer.buffer; }
+		VkDeviceSize GetFrameSize() const { return m_frameSize; }
+		VkDeviceSize GetUsedBytes() const { return m_head.load(std::memory_order_relaxed); }
+		VkDeviceSize GetPeakBytes() const { return m_peak; }
+		VkDeviceSize GetUniformAlignment() const { return m_uniformAlignment; }
+		VkDeviceSize GetStorageAlignment() const { return m_storageAlignment; }
+		void SetName(const std::string& name);
+	private:
+		Device*			m_device;
+		Buffer			m_buffer;
+		VkDeviceSize	m_frameSize;
+		uint32_t		m_frameCount;
+		uint32_t		m_frame = 0;
+		VkDeviceSize	m_uniformAlignment;
+		VkDeviceSize	m_storageAlignment;
+		VkDeviceSize	m_peak = 0;
+		bool			m_coherent;
+		std::atomic<VkDeviceSize> m_head{ 0 };		// bytes used in the partition of m_frame
+	};
+}
+#endif // !VKJS_UPLOAD_RING_H_